@@ -0,0 +1,584 @@
+// ----------------------------------------------------------------------
+// AnomalyDetector.cpp
+//
+// The sum over a window of n values which average a baseline of b is
+// taken to be Poisson with a mean of n * b, and a window is alerting when
+// the chance of a sum that high or higher is no more than the chance of
+// a normal value the alert sigma above its mean. The chance is looked up
+// rather than worked out, so it costs the same for the small counts of a
+// single minute as for an hour, and only sums above the mean are looked
+// up at all.
+//
+// The baseline only learns from a value up to what a single value may
+// reach without alerting, so that a long event does not drag the
+// baseline up and hide itself.
+//
+// ----------------------------------------------------------------------
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "AnomalyDetector.h"
+#include "ArchiveStore.h"
+#include "BatchDecode.h"
+#include "PoissonTable.h"
+#include "QueryEngine.h"
+#include "ReadGeiger.h"
+#include "SeriesFile.h"
+
+using namespace std;
+
+/// <summary>
+/// Empties a detector and sets up its windows
+/// </summary>
+/// <param name="r_Detector">The detector to start</param>
+/// <param name="pHandler">Told of every alert as it is raised and as it ends, or nullptr</param>
+/// <param name="pContext">Passed to the handler</param>
+void StartAnomalyDetector(AnomalyDetector & r_Detector, AnomalyAlertHandler pHandler, void * pContext)
+{
+    const ulong windowSeconds[ANOMALY_WINDOW_COUNT] = ANOMALY_WINDOW_SECONDS;
+
+    for (size_t thisWindow = 0; thisWindow < ANOMALY_WINDOW_COUNT; thisWindow++)
+    {
+        AnomalyWindow & r_Window = r_Detector.theWindows[thisWindow];
+
+        r_Window.windowSeconds = windowSeconds[thisWindow];
+        r_Window.windowSum     = 0;
+        r_Window.isAlerting    = false;
+
+        r_Window.theSamples.clear();
+    }
+
+    r_Detector.baselineMean   = 0.0;
+    r_Detector.alertSigma     = ANOMALY_ALERT_SIGMA;
+    r_Detector.offeredCount   = 0;
+    r_Detector.sampleCount    = 0;
+    r_Detector.lastEpoch      = 0;
+    r_Detector.alertCount     = static_cast<ulong>(0);
+    r_Detector.superHighCount = static_cast<ulong>(0);
+    r_Detector.pHandler       = pHandler;
+    r_Detector.pContext       = pContext;
+}
+
+/// <summary>
+/// Ends a window's open alert and hands it to the handler
+/// </summary>
+static void CloseAnomalyAlert(AnomalyDetector & r_Detector, AnomalyWindow & r_Window, long long endEpoch)
+{
+    r_Window.isAlerting             = false;
+    r_Window.currentAlert.isOpen    = false;
+    r_Window.currentAlert.endEpoch  = endEpoch;
+
+    if (true == r_Window.currentAlert.isSuperHigh)
+    {
+        r_Detector.superHighCount++;
+    }
+
+    if (nullptr != r_Detector.pHandler)
+    {
+        r_Detector.pHandler(r_Detector.pContext, r_Window.currentAlert);
+    }
+}
+
+/// <summary>
+/// Compares a window's sum with what the baseline predicts, raising an alert when it
+/// goes over the threshold, following the peak while it stays over, and ending the
+/// alert when it comes back under
+/// </summary>
+static void EvaluateAnomalyWindow(AnomalyDetector & r_Detector,
+    AnomalyWindow & r_Window,
+    const AnomalySample & r_Sample,
+    double alertSignificance)
+{
+    double expectedSum  = r_Detector.baselineMean * static_cast<double>(r_Window.theSamples.size());
+    double significance = 0.0;
+
+    if (static_cast<double>(r_Window.windowSum) > expectedSum)
+    {
+        significance = GetPoissonSignificance(r_Window.windowSum, expectedSum);
+    }
+
+    if (significance < alertSignificance)
+    {
+        if (true == r_Window.isAlerting)
+        {
+            CloseAnomalyAlert(r_Detector, r_Window, r_Sample.sampleEpoch);
+        }
+
+        return;
+    }
+
+    AnomalyAlert & r_Alert = r_Window.currentAlert;
+
+    if (false == r_Window.isAlerting || significance > r_Alert.peakSignificance)
+    {
+        r_Alert.peakEpoch   = r_Sample.sampleEpoch;
+        r_Alert.peakSample  = r_Sample.sampleNumber;
+        r_Alert.peakSum     = static_cast<ulong>(r_Window.windowSum);
+        r_Alert.peakSamples = static_cast<ulong>(r_Window.theSamples.size());
+        r_Alert.expectedSum      = expectedSum;
+        r_Alert.peakSignificance = significance;
+        r_Alert.isSuperHigh      = significance >= GetSigmaSignificance(ANOMALY_SUPER_HIGH_SIGMA);
+    }
+
+    r_Alert.endEpoch   = r_Sample.sampleEpoch;
+    r_Alert.lastSample = r_Sample.sampleNumber;
+
+    if (false == r_Window.isAlerting)
+    {
+        r_Window.isAlerting = true;
+
+        r_Alert.windowSeconds = r_Window.windowSeconds;
+        r_Alert.isOpen        = true;
+        r_Alert.startEpoch    = r_Window.theSamples.front().sampleEpoch;
+        r_Alert.startSample   = r_Window.theSamples.front().sampleNumber;
+
+        r_Detector.alertCount++;
+
+        if (nullptr != r_Detector.pHandler)
+        {
+            r_Detector.pHandler(r_Detector.pContext, r_Alert);
+        }
+    }
+}
+
+/// <summary>
+/// Offers the next value to the detector. Each window takes the value in, lets go of
+/// the values which are now older than the window, and is compared with the baseline;
+/// then the baseline learns from the value.
+/// </summary>
+/// <param name="r_Detector">The started detector</param>
+/// <param name="sampleEpoch">When the value was recorded, in seconds since 1970</param>
+/// <param name="countValue">The CPS/CPM/CPH value</param>
+/// <returns>true if the value was taken, false if it is not later than the last one,
+/// as when the same history is offered again from a later harvest</returns>
+bool FeedAnomalyDetector(AnomalyDetector & r_Detector, long long sampleEpoch, uint32_t countValue)
+{
+    unsigned long long sampleNumber      = r_Detector.offeredCount++;
+    double             alertSignificance = GetSigmaSignificance(r_Detector.alertSigma);
+
+    if (r_Detector.sampleCount > 0 && sampleEpoch <= r_Detector.lastEpoch)
+    {
+        return false;
+    }
+
+    AnomalySample theSample = { sampleEpoch, sampleNumber, countValue };
+
+    for (size_t thisWindow = 0; thisWindow < ANOMALY_WINDOW_COUNT; thisWindow++)
+    {
+        AnomalyWindow & r_Window = r_Detector.theWindows[thisWindow];
+
+        r_Window.theSamples.push_back(theSample);
+        r_Window.windowSum += countValue;
+
+        while (r_Window.theSamples.front().sampleEpoch <= sampleEpoch - static_cast<long long>(r_Window.windowSeconds))
+        {
+            r_Window.windowSum -= r_Window.theSamples.front().countValue;
+            r_Window.theSamples.pop_front();
+        }
+
+        if (r_Detector.sampleCount >= ANOMALY_WARMUP_SAMPLES)
+        {
+            EvaluateAnomalyWindow(r_Detector, r_Window, theSample, alertSignificance);
+        }
+    }
+
+    // Until the baseline has seen enough it is the plain mean of what it has seen
+    if (r_Detector.sampleCount < ANOMALY_WARMUP_SAMPLES)
+    {
+        r_Detector.baselineMean += (static_cast<double>(countValue) - r_Detector.baselineMean) / static_cast<double>(r_Detector.sampleCount + 1);
+    }
+    else
+    {
+        double highestLearned = sqrt(r_Detector.baselineMean) + (r_Detector.alertSigma / 2.0);
+        double learnedValue   = static_cast<double>(countValue);
+
+        highestLearned *= highestLearned;
+
+        if (learnedValue > highestLearned)
+        {
+            learnedValue = highestLearned;
+        }
+
+        r_Detector.baselineMean += (learnedValue - r_Detector.baselineMean) * (2.0 / (ANOMALY_BASELINE_SAMPLES + 1.0));
+    }
+
+    r_Detector.sampleCount++;
+    r_Detector.lastEpoch = sampleEpoch;
+
+    return true;
+}
+
+/// <summary>
+/// Ends every alert which is still open, as at the end of the data
+/// </summary>
+/// <param name="r_Detector">The started detector</param>
+void FinishAnomalyDetector(AnomalyDetector & r_Detector)
+{
+    for (size_t thisWindow = 0; thisWindow < ANOMALY_WINDOW_COUNT; thisWindow++)
+    {
+        if (true == r_Detector.theWindows[thisWindow].isAlerting)
+        {
+            CloseAnomalyAlert(r_Detector, r_Detector.theWindows[thisWindow], r_Detector.lastEpoch);
+        }
+    }
+}
+
+/// <summary>
+/// Writes each alert of the scan as a comma-delimited line once it has ended
+/// </summary>
+static void WriteAnomalyAlert(void * pContext, const AnomalyAlert & r_Alert)
+{
+    const string * pSerialNumber = static_cast<const string *>(pContext);
+    char           startTime[31] = { 0 };
+    char           peakTime[31]  = { 0 };
+    char           endTime[31]   = { 0 };
+
+    if (true == r_Alert.isOpen)
+    {
+        return;
+    }
+
+    FormatQueryTime(r_Alert.startEpoch, startTime, sizeof(startTime));
+    FormatQueryTime(r_Alert.peakEpoch, peakTime, sizeof(peakTime));
+    FormatQueryTime(r_Alert.endEpoch, endTime, sizeof(endTime));
+
+    (void)printf("%s,%lu,%s,%s,%s,%lu,%lu,%.1f,%.2e,%s\n",
+        pSerialNumber->c_str(),
+        r_Alert.windowSeconds / 60,
+        startTime,
+        peakTime,
+        endTime,
+        r_Alert.peakSum,
+        r_Alert.peakSamples,
+        r_Alert.expectedSum,
+        GetPoissonPValue(r_Alert.peakSignificance),
+        (true == r_Alert.isSuperHigh) ? "yes" : "no");
+}
+
+/// <summary>
+/// Displays how the anomaly scan is used
+/// </summary>
+static void DisplayAnomalyUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -anomaly <directory|pattern> [...] [-serial <serial>] [-sigma <deviations>]\n");
+    (void)printf("  A directory selects every *.%s file within it; comma-delimited files\n", DATA_OUTPUT_SERIES_FILE_NAME);
+    (void)printf("  and FLASH images may also be named. Each device's files are scanned oldest\n");
+    (void)printf("  first and the history that a later file repeats is only scanned once.\n");
+}
+
+/// <summary>
+/// The entry point for the anomaly scan. Each device's files are streamed through a
+/// detector of its own, one file at a time, and every alert is written as a line of
+/// comma-delimited text.
+/// </summary>
+/// <param name="argc">The number of arguments following "-anomaly"</param>
+/// <param name="argv">The arguments following "-anomaly"</param>
+/// <returns>0 if every file was scanned, otherwise 1</returns>
+int RunAnomalyScan(int argc, char * argv[])
+{
+    vector<string>       inputFileNames;
+    vector<ArchiveInput> theInputs;
+    string               defaultSerialNumber = ARCHIVE_UNKNOWN_SERIAL_NUMBER;
+    string               serialNumber;
+    AnomalyDetector      theDetector;
+    double               alertSigma          = ANOMALY_ALERT_SIGMA;
+    ulong                failedCount         = static_cast<ulong>(0);
+    ulong                alertCount          = static_cast<ulong>(0);
+    unsigned long long   sampleCount         = 0;
+
+    for (int thisArgument = 0; thisArgument < argc; thisArgument++)
+    {
+        if (0 == strcmp(argv[thisArgument], "-serial") && thisArgument + 1 < argc)
+        {
+            defaultSerialNumber = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-sigma") && thisArgument + 1 < argc)
+        {
+            alertSigma = strtod(argv[++thisArgument], nullptr);
+        }
+        else
+        {
+            CollectInputFileNames(argv[thisArgument], SERIES_INPUT_FILE_PATTERN, inputFileNames);
+        }
+    }
+
+    if (alertSigma <= 0.0)
+    {
+        DisplayAnomalyUsage();
+        (void)printf("The deviations given with -sigma must be more than 0\n");
+        return 1;
+    }
+
+    if (inputFileNames.empty())
+    {
+        DisplayAnomalyUsage();
+        (void)printf("There were no files found to scan\n");
+        return 1;
+    }
+
+    SortArchiveInputs(inputFileNames, defaultSerialNumber, theInputs);
+
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    (void)printf("Serial,Window,Start,Peak,End,Peak Sum,Samples,Expected,P Value,Super High\n");
+
+    for (size_t thisInput = 0; thisInput <= theInputs.size(); thisInput++)
+    {
+        // Each device gets a detector of its own
+        if (thisInput == theInputs.size() || theInputs[thisInput].serialNumber != serialNumber)
+        {
+            if (thisInput > 0)
+            {
+                FinishAnomalyDetector(theDetector);
+
+                alertCount  += theDetector.alertCount;
+                sampleCount += theDetector.sampleCount;
+            }
+
+            if (thisInput == theInputs.size())
+            {
+                break;
+            }
+
+            serialNumber = theInputs[thisInput].serialNumber;
+
+            StartAnomalyDetector(theDetector, WriteAnomalyAlert, &serialNumber);
+
+            theDetector.alertSigma = alertSigma;
+        }
+
+        SampleStore theStore;
+
+        if (false == LoadSampleFile(theInputs[thisInput].fileName.c_str(), theStore))
+        {
+            (void)fprintf(stderr, "FAILED  %s\n", theInputs[thisInput].fileName.c_str());
+            failedCount++;
+            continue;
+        }
+
+        for (size_t thisSample = 0; thisSample < theStore.counts.size(); thisSample++)
+        {
+            (void)FeedAnomalyDetector(theDetector, theStore.epochSeconds[thisSample], theStore.counts[thisSample]);
+        }
+    }
+
+    double elapsedSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    // The totals go to the error stream so that the alerts may be redirected to a file
+    (void)fprintf(stderr, "%lu alerts in %llu samples from %lu files in %.3f seconds\n",
+        alertCount,
+        sampleCount,
+        static_cast<ulong>(theInputs.size()) - failedCount,
+        elapsedSeconds);
+
+    return (failedCount == static_cast<ulong>(0)) ? 0 : 1;
+}
+
+/// <summary>
+/// Displays how the significance scoring is used
+/// </summary>
+static void DisplayScoreUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -score <directory|pattern> [...] [-serial <serial>] [-device <serial|label>]\n");
+    (void)printf("       [-window <minutes>] [-below <p-value>]\n");
+    (void)printf("  Every value, and the sum over the window of 1, 5, 10 or 60 minutes ending at each\n");
+    (void)printf("  value, is given its Poisson p-value against the running baseline. Those below the\n");
+    (void)printf("  p-value (%.0e unless given) are listed, and how many fell in each decade is totalled.\n", ANOMALY_SCORE_BELOW_P);
+}
+
+/// <summary>
+/// The entry point for scoring every value of every device. Each device's files are
+/// merged in to one timeline and streamed through a detector for its baseline, and each
+/// value and each window sum is given its p-value from the tables in PoissonTable.h.
+/// </summary>
+/// <param name="argc">The number of arguments following "-score"</param>
+/// <param name="argv">The arguments following "-score"</param>
+/// <returns>0 if every file was scored, otherwise 1</returns>
+int RunSignificanceScore(int argc, char * argv[])
+{
+    const ulong        windowSeconds[ANOMALY_WINDOW_COUNT]  = ANOMALY_WINDOW_SECONDS;
+    QueryEngine        theEngine;
+    vector<string>     inputFileNames;
+    string             defaultSerialNumber                  = ARCHIVE_UNKNOWN_SERIAL_NUMBER;
+    const char *       pch_Filter                           = nullptr;
+    ulong              windowMinutes                        = static_cast<ulong>(10);
+    size_t             whichWindow                          = ANOMALY_WINDOW_COUNT;
+    double             belowPValue                          = ANOMALY_SCORE_BELOW_P;
+    ulong              failedCount                          = static_cast<ulong>(0);
+    unsigned long long scoredCount                          = 0;
+    unsigned long long listedCount                          = 0;
+    unsigned long long sampleDecades[ANOMALY_SCORE_DECADES] = { 0 };
+    unsigned long long windowDecades[ANOMALY_SCORE_DECADES] = { 0 };
+
+    for (int thisArgument = 0; thisArgument < argc; thisArgument++)
+    {
+        if (0 == strcmp(argv[thisArgument], "-serial") && thisArgument + 1 < argc)
+        {
+            defaultSerialNumber = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-device") && thisArgument + 1 < argc)
+        {
+            pch_Filter = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-window") && thisArgument + 1 < argc)
+        {
+            windowMinutes = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-below") && thisArgument + 1 < argc)
+        {
+            belowPValue = strtod(argv[++thisArgument], nullptr);
+        }
+        else
+        {
+            CollectInputFileNames(argv[thisArgument], SERIES_INPUT_FILE_PATTERN, inputFileNames);
+        }
+    }
+
+    for (size_t thisWindow = 0; thisWindow < ANOMALY_WINDOW_COUNT; thisWindow++)
+    {
+        if (windowSeconds[thisWindow] == windowMinutes * 60)
+        {
+            whichWindow = thisWindow;
+        }
+    }
+
+    if (whichWindow == ANOMALY_WINDOW_COUNT)
+    {
+        DisplayScoreUsage();
+        (void)printf("A window of %lu minutes is not one of those scored, -window must be 1, 5, 10 or 60\n", windowMinutes);
+        return 1;
+    }
+
+    if (belowPValue <= 0.0)
+    {
+        DisplayScoreUsage();
+        (void)printf("The p-value given with -below must be more than 0\n");
+        return 1;
+    }
+
+    if (inputFileNames.empty())
+    {
+        DisplayScoreUsage();
+        (void)printf("There were no files found to score\n");
+        return 1;
+    }
+
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    for (size_t thisFile = 0; thisFile < inputFileNames.size(); thisFile++)
+    {
+        if (false == AddQueryFile(theEngine, inputFileNames[thisFile].c_str(), defaultSerialNumber.c_str()))
+        {
+            (void)fprintf(stderr, "FAILED  %s\n", inputFileNames[thisFile].c_str());
+            failedCount++;
+        }
+    }
+
+    BuildQueryIndex(theEngine);
+
+    // The tables are built before the scoring is timed
+    (void)GetPoissonTable();
+
+    chrono::steady_clock::time_point scoreTime = chrono::steady_clock::now();
+
+    double listedSignificance = -log10(belowPValue);
+
+    (void)printf("Serial,Date/Time,Counts,Expected,P Value,Window Sum,Window Expected,Window P Value\n");
+
+    for (size_t thisDevice = 0; thisDevice < theEngine.theDevices.size(); thisDevice++)
+    {
+        const QueryDevice & r_Device = theEngine.theDevices[thisDevice];
+        AnomalyDetector     theDetector;
+
+        if (false == IsQueryDeviceSelected(r_Device, pch_Filter))
+        {
+            continue;
+        }
+
+        StartAnomalyDetector(theDetector, nullptr, nullptr);
+
+        const AnomalyWindow & r_Window = theDetector.theWindows[whichWindow];
+
+        for (size_t thisSample = 0; thisSample < r_Device.counts.size(); thisSample++)
+        {
+            uint32_t countValue   = r_Device.counts[thisSample];
+            double   baselineMean = theDetector.baselineMean;
+
+            // The value is scored against the baseline from before it, as the detector does
+            if (false == FeedAnomalyDetector(theDetector, r_Device.epochSeconds[thisSample], countValue)
+                || theDetector.sampleCount <= ANOMALY_WARMUP_SAMPLES)
+            {
+                continue;
+            }
+
+            double windowExpected     = baselineMean * static_cast<double>(r_Window.theSamples.size());
+            double sampleSignificance = 0.0;
+            double windowSignificance = 0.0;
+
+            if (static_cast<double>(countValue) > baselineMean)
+            {
+                sampleSignificance = GetPoissonSignificance(countValue, baselineMean);
+            }
+
+            if (static_cast<double>(r_Window.windowSum) > windowExpected)
+            {
+                windowSignificance = GetPoissonSignificance(r_Window.windowSum, windowExpected);
+            }
+
+            sampleDecades[(sampleSignificance < ANOMALY_SCORE_DECADES - 1) ? static_cast<size_t>(sampleSignificance) : ANOMALY_SCORE_DECADES - 1]++;
+            windowDecades[(windowSignificance < ANOMALY_SCORE_DECADES - 1) ? static_cast<size_t>(windowSignificance) : ANOMALY_SCORE_DECADES - 1]++;
+
+            scoredCount++;
+
+            if (sampleSignificance >= listedSignificance || windowSignificance >= listedSignificance)
+            {
+                char theTime[31] = { 0 };
+
+                FormatQueryTime(r_Device.epochSeconds[thisSample], theTime, sizeof(theTime));
+
+                (void)printf("%s,%s,%lu,%.2f,%.2e,%llu,%.1f,%.2e\n",
+                    r_Device.serialNumber.c_str(),
+                    theTime,
+                    static_cast<ulong>(countValue),
+                    baselineMean,
+                    GetPoissonPValue(sampleSignificance),
+                    r_Window.windowSum,
+                    windowExpected,
+                    GetPoissonPValue(windowSignificance));
+
+                listedCount++;
+            }
+        }
+    }
+
+    chrono::steady_clock::time_point endTime = chrono::steady_clock::now();
+
+    double loadSeconds  = chrono::duration<double>(scoreTime - startTime).count();
+    double scoreSeconds = chrono::duration<double>(endTime - scoreTime).count();
+
+    // The totals go to the error stream so that the listing may be redirected to a file
+    (void)fprintf(stderr, "P-value below     Values      %2lu minute windows\n", windowMinutes);
+
+    for (size_t thisDecade = 0; thisDecade < ANOMALY_SCORE_DECADES; thisDecade++)
+    {
+        (void)fprintf(stderr, "1e-%-2u%s %12llu %12llu\n",
+            static_cast<unsigned>(thisDecade),
+            (thisDecade + 1 == ANOMALY_SCORE_DECADES) ? " or less " : "         ",
+            sampleDecades[thisDecade],
+            windowDecades[thisDecade]);
+    }
+
+    (void)fprintf(stderr, "%llu values scored and %llu listed from %lu files, loaded in %.3f and scored in %.3f seconds (%.1f million per second)\n",
+        scoredCount,
+        listedCount,
+        static_cast<ulong>(inputFileNames.size()) - failedCount,
+        loadSeconds,
+        scoreSeconds,
+        (scoreSeconds > 0.0) ? static_cast<double>(scoredCount) / scoreSeconds / 1e6 : 0.0);
+
+    return (failedCount == static_cast<ulong>(0)) ? 0 : 1;
+}
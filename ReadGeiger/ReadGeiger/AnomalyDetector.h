@@ -0,0 +1,101 @@
+// ----------------------------------------------------------------------
+// AnomalyDetector.h
+//
+// Watches a stream of CPS/CPM/CPH values for periods which are higher
+// than the counting statistics allow. Several sliding windows of
+// different lengths are kept at the same time, each ending at the
+// latest value, and the sum over each window is scored by its Poisson
+// p-value given what the baseline predicts for that many values, looked
+// up in the tables of PoissonTable.h. The baseline is a running
+// exponentially weighted mean, so nothing needs a pass over all of the
+// data first and the detector works the same on a live device as on
+// years of archived images.
+//
+// Each value costs a fixed amount of work per window: the value is
+// added to the window's sum and the values which have slid out of the
+// window are taken off again. Only the values inside the longest window
+// are held.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include "Portable.h"
+
+// The sliding windows, in seconds
+#define ANOMALY_WINDOW_COUNT        static_cast<size_t>(4)
+#define ANOMALY_WINDOW_SECONDS      { 60, 5 * 60, 10 * 60, 60 * 60 }
+
+// The baseline follows roughly the last day of minute values, and no alerts are
+// raised until it has seen the first hour
+#define ANOMALY_BASELINE_SAMPLES    1440.0
+#define ANOMALY_WARMUP_SAMPLES      static_cast<ulong>(60)
+
+// How rare a window's sum must be to raise an alert, and to make it a super high one,
+// given as the standard deviations of a normal value which is as rare: 4 is a p-value
+// of about 3 in 100,000 and 6 about 1 in a billion
+#define ANOMALY_ALERT_SIGMA         4.0
+#define ANOMALY_SUPER_HIGH_SIGMA    6.0
+
+// The values which -score lists unless told otherwise, and the decades of p-value it
+// totals the values in to, the last being for everything rarer
+#define ANOMALY_SCORE_BELOW_P       1e-6
+#define ANOMALY_SCORE_DECADES       static_cast<size_t>(10)
+
+typedef struct anomaly_alert_t
+{
+    ulong              windowSeconds;       // The length of the window which raised it
+    bool               isOpen;              // true when raised, false when it has ended
+    bool               isSuperHigh;         // true if the peak was as rare as ANOMALY_SUPER_HIGH_SIGMA
+    long long          startEpoch;          // When the first value in the window was recorded
+    long long          peakEpoch;           // When the window was highest
+    long long          endEpoch;            // When the window came back down, or the peak while open
+    unsigned long long startSample;         // The number of the first value in the window, see sampleNumber
+    unsigned long long peakSample;          // The number of the value at which the window was highest
+    unsigned long long lastSample;          // The number of the last value while the window was over
+    ulong              peakSum;             // The sum over the window at its highest
+    ulong              peakSamples;         // The number of values in the window then
+    double             expectedSum;         // What the baseline predicted for that sum
+    double             peakSignificance;    // -log10 of the p-value of that sum, see PoissonTable.h
+} AnomalyAlert;
+
+typedef void (*AnomalyAlertHandler)(void * pContext, const AnomalyAlert & r_Alert);
+
+typedef struct anomaly_sample_t
+{
+    long long          sampleEpoch;         // When the value was recorded
+    unsigned long long sampleNumber;        // The number of the value, counting every value offered from 0
+    uint32_t           countValue;          // The CPS/CPM/CPH value
+} AnomalySample;
+
+typedef struct anomaly_window_t
+{
+    ulong                     windowSeconds;    // How far back the window reaches
+    std::deque<AnomalySample> theSamples;       // The values inside the window, oldest first
+    unsigned long long        windowSum;        // The sum of those values
+    bool                      isAlerting;       // true while the window is above its threshold
+    AnomalyAlert              currentAlert;     // The alert while it is open
+} AnomalyWindow;
+
+typedef struct anomaly_detector_t
+{
+    AnomalyWindow       theWindows[ANOMALY_WINDOW_COUNT];   // Shortest first
+    double              baselineMean;       // The expected value of a single sample
+    double              alertSigma;         // The threshold, as standard deviations of a normal value
+    unsigned long long  offeredCount;       // The number of values offered
+    unsigned long long  sampleCount;        // The number of those which were accepted
+    long long           lastEpoch;          // When the last accepted value was recorded
+    ulong               alertCount;         // The number of alerts raised
+    ulong               superHighCount;     // The number of those which were super high
+    AnomalyAlertHandler pHandler;           // Told of every alert, or nullptr
+    void *              pContext;           // Passed to the handler
+} AnomalyDetector;
+
+extern void StartAnomalyDetector(AnomalyDetector & r_Detector, AnomalyAlertHandler pHandler, void * pContext);
+extern bool FeedAnomalyDetector(AnomalyDetector & r_Detector, long long sampleEpoch, uint32_t countValue);
+extern void FinishAnomalyDetector(AnomalyDetector & r_Detector);
+
+extern int RunAnomalyScan(int argc, char * argv[]);
+extern int RunSignificanceScore(int argc, char * argv[]);
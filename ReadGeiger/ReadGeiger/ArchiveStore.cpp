@@ -0,0 +1,834 @@
+// ----------------------------------------------------------------------
+// ArchiveStore.cpp
+//
+// The index is text, one line per dump in the order the dumps were
+// added: "epoch,parent,address,offset,length,image length,hash,name".
+// The stored octets of every dump are appended to the segment file and
+// flushed before the dump's line is added to the index, so an index line
+// never refers to octets which are not there. A line which was torn by
+// an interruption is dropped, along with everything after it, the next
+// time the device's archive is opened.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "ArchiveStore.h"
+#include "BatchDecode.h"
+#include "DownloadJournal.h"
+#include "FlashExport.h"
+#include "FlashImage.h"
+#include "SyncCursor.h"
+
+using namespace std;
+
+/// <summary>
+/// Returns the file name part of a path
+/// </summary>
+/// <param name="r_FileName">The path</param>
+/// <returns>The file name without its directory</returns>
+string GetBaseFileName(const string & r_FileName)
+{
+    size_t separatorOffset = r_FileName.find_last_of("\\/:");
+
+    return (string::npos == separatorOffset) ? r_FileName : r_FileName.substr(separatorOffset + 1);
+}
+
+/// <summary>
+/// Builds the name of one of a device's archive files, "DIRECTORY/SERIAL.ReadGeiger.archive"
+/// for example
+/// </summary>
+static string BuildArchiveFileName(const char * pch_Directory, const string & r_Prefix, const char * pch_FileName)
+{
+    string theName = pch_Directory;
+
+    if (false == theName.empty() && theName.back() != PATH_SEPARATOR_CHARACTER && theName.back() != '/')
+    {
+        theName += PATH_SEPARATOR_CHARACTER;
+    }
+
+    return theName + r_Prefix + "." + pch_FileName;
+}
+
+/// <summary>
+/// Finds where the octets which are not erased FLASH end in an image
+/// </summary>
+/// <returns>One past the last octet which is not 0xFF, or 0 if the image is all erased</returns>
+static ulong FindEndOfStoredData(const uchar * pImage, ulong imageLength)
+{
+    while (imageLength > static_cast<ulong>(0) && pImage[imageLength - 1] == 0xFF)
+    {
+        imageLength--;
+    }
+
+    return imageLength;
+}
+
+/// <summary>
+/// Formats a dump as a line of the index
+/// </summary>
+static void FormatArchiveRecord(const ArchiveDump & r_Dump, char * pch_Buffer, size_t bufferSize)
+{
+    (void)sprintf_s(pch_Buffer, bufferSize, "%lu,%ld,%lu,%lu,%lu,%lu,%016llx,%s\n",
+        r_Dump.epoch,
+        r_Dump.parentDump,
+        r_Dump.flashAddress,
+        r_Dump.segmentOffset,
+        r_Dump.segmentLength,
+        r_Dump.imageLength,
+        static_cast<unsigned long long>(r_Dump.imageHash),
+        r_Dump.dumpName.c_str());
+}
+
+/// <summary>
+/// Parses a line of the index
+/// </summary>
+/// <param name="pch_Record">The line, which must be complete</param>
+/// <param name="r_Dump">Returns the dump</param>
+/// <returns>true if the line was complete and well formed, otherwise false</returns>
+static bool ParseArchiveRecord(const char * pch_Record, ArchiveDump & r_Dump)
+{
+    char * pch_Field = nullptr;
+
+    r_Dump.epoch = strtoul(pch_Record, &pch_Field, 10);
+
+    if (',' != *pch_Field)
+    {
+        return false;
+    }
+
+    r_Dump.parentDump = strtol(pch_Field + 1, &pch_Field, 10);
+
+    if (',' != *pch_Field)
+    {
+        return false;
+    }
+
+    r_Dump.flashAddress = strtoul(pch_Field + 1, &pch_Field, 10);
+
+    if (',' != *pch_Field)
+    {
+        return false;
+    }
+
+    r_Dump.segmentOffset = strtoul(pch_Field + 1, &pch_Field, 10);
+
+    if (',' != *pch_Field)
+    {
+        return false;
+    }
+
+    r_Dump.segmentLength = strtoul(pch_Field + 1, &pch_Field, 10);
+
+    if (',' != *pch_Field)
+    {
+        return false;
+    }
+
+    r_Dump.imageLength = strtoul(pch_Field + 1, &pch_Field, 10);
+
+    if (',' != *pch_Field)
+    {
+        return false;
+    }
+
+    r_Dump.imageHash = strtoull(pch_Field + 1, &pch_Field, 16);
+
+    if (',' != *pch_Field)
+    {
+        return false;
+    }
+
+    // The name runs to the end of the line, which must be there
+    const char * pch_Name    = pch_Field + 1;
+    const char * pch_LineEnd = strchr(pch_Name, '\n');
+
+    if (nullptr == pch_LineEnd || pch_LineEnd == pch_Name)
+    {
+        return false;
+    }
+
+    r_Dump.dumpName.assign(pch_Name, pch_LineEnd);
+
+    return true;
+}
+
+/// <summary>
+/// Writes the whole index of a device again, replacing the one there
+/// </summary>
+static bool RewriteArchiveIndex(const ArchiveDevice & r_Device)
+{
+    FILE * pIndexFile             = nullptr;
+    char   temporaryFileName[301] = { 0 };
+    char   indexRecord[501]       = { 0 };
+    bool   wasWritten             = false;
+
+    BuildTemporaryFileName(r_Device.indexFileName.c_str(), temporaryFileName, sizeof(temporaryFileName));
+
+    if (0 == fopen_s(&pIndexFile, temporaryFileName, "wb"))
+    {
+        wasWritten = true;
+
+        for (size_t thisDump = 0; thisDump < r_Device.theDumps.size(); thisDump++)
+        {
+            FormatArchiveRecord(r_Device.theDumps[thisDump], indexRecord, sizeof(indexRecord));
+
+            wasWritten = (EOF != fputs(indexRecord, pIndexFile)) && wasWritten;
+        }
+
+        wasWritten = (0 == fclose(pIndexFile)) && wasWritten;
+    }
+
+    if (false == wasWritten || false == CommitFileAtomically(temporaryFileName, r_Device.indexFileName.c_str()))
+    {
+        (void)remove(temporaryFileName);
+
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Loads the index of a device's archive. A device which has nothing archived yet
+/// simply has no dumps. An index which ends in a damaged line, or which refers to
+/// stored octets that are not there, is cut short at that point.
+/// </summary>
+/// <param name="pch_Directory">The archive directory</param>
+/// <param name="pch_SerialNumber">The device's serial number as hexadecimal text</param>
+/// <param name="r_Device">Returns the device's archive</param>
+/// <returns>true if the archive may be used, otherwise false</returns>
+bool OpenArchiveDevice(const char * pch_Directory, const char * pch_SerialNumber, ArchiveDevice & r_Device)
+{
+    FILE * pIndexFile       = nullptr;
+    FILE * pSegmentFile     = nullptr;
+    char   indexRecord[501] = { 0 };
+    ulong  segmentFileSize  = static_cast<ulong>(0);
+    bool   isDamaged        = false;
+
+    r_Device.serialNumber    = pch_SerialNumber;
+    r_Device.indexFileName   = BuildArchiveFileName(pch_Directory, r_Device.serialNumber, ARCHIVE_INDEX_FILE_NAME);
+    r_Device.segmentFileName = BuildArchiveFileName(pch_Directory, r_Device.serialNumber, ARCHIVE_SEGMENT_FILE_NAME);
+
+    r_Device.theDumps.clear();
+
+    if (0 != fopen_s(&pIndexFile, r_Device.indexFileName.c_str(), "rb"))
+    {
+        return true;
+    }
+
+    if (0 == fopen_s(&pSegmentFile, r_Device.segmentFileName.c_str(), "rb"))
+    {
+        if (0 == fseek(pSegmentFile, 0, SEEK_END))
+        {
+            segmentFileSize = static_cast<ulong>(ftell(pSegmentFile));
+        }
+
+        (void)fclose(pSegmentFile);
+    }
+
+    while (nullptr != fgets(indexRecord, sizeof(indexRecord), pIndexFile))
+    {
+        ArchiveDump theDump;
+
+        // A dump may only build on one added before it
+        if (false == ParseArchiveRecord(indexRecord, theDump) ||
+            theDump.parentDump >= static_cast<long>(r_Device.theDumps.size()) ||
+            theDump.segmentOffset > segmentFileSize ||
+            theDump.segmentLength > segmentFileSize - theDump.segmentOffset ||
+            theDump.flashAddress + theDump.segmentLength > theDump.imageLength)
+        {
+            isDamaged = true;
+            break;
+        }
+
+        r_Device.theDumps.push_back(theDump);
+    }
+
+    (void)fclose(pIndexFile);
+
+    if (true == isDamaged)
+    {
+        return RewriteArchiveIndex(r_Device);
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Rebuilds an archived image. The dump's ancestors are applied oldest first, each
+/// one keeping what it shares with its parent and adding its own stored octets, and
+/// the result is checked against the hash taken when the image was added.
+/// </summary>
+/// <param name="r_Device">The device's archive</param>
+/// <param name="whichDump">The dump to rebuild, counting from 0</param>
+/// <param name="r_Image">Returns the image</param>
+/// <returns>true if the image was rebuilt exactly, otherwise false</returns>
+bool RestoreArchiveImage(const ArchiveDevice & r_Device, size_t whichDump, vector<uchar> & r_Image)
+{
+    vector<size_t> theAncestors;
+    vector<uchar>  theImage;
+    FILE *         pSegmentFile = nullptr;
+    bool           wasRead      = true;
+
+    if (whichDump >= r_Device.theDumps.size())
+    {
+        return false;
+    }
+
+    for (long thisDump = static_cast<long>(whichDump); thisDump >= 0; thisDump = r_Device.theDumps[thisDump].parentDump)
+    {
+        theAncestors.push_back(static_cast<size_t>(thisDump));
+    }
+
+    if (0 != fopen_s(&pSegmentFile, r_Device.segmentFileName.c_str(), "rb"))
+    {
+        pSegmentFile = nullptr;
+    }
+
+    for (size_t thisStep = theAncestors.size(); thisStep > 0 && true == wasRead; thisStep--)
+    {
+        const ArchiveDump & r_Dump = r_Device.theDumps[theAncestors[thisStep - 1]];
+        vector<uchar>       nextImage(r_Dump.imageLength, static_cast<uchar>(0xFF));
+        size_t              keptLength = min(static_cast<size_t>(r_Dump.flashAddress), theImage.size());
+
+        (void)memcpy(nextImage.data(), theImage.data(), keptLength);
+
+        if (r_Dump.segmentLength > static_cast<ulong>(0))
+        {
+            wasRead = (nullptr != pSegmentFile) &&
+                (0 == fseek(pSegmentFile, static_cast<long>(r_Dump.segmentOffset), SEEK_SET)) &&
+                (1 == fread(&nextImage[r_Dump.flashAddress], r_Dump.segmentLength, 1, pSegmentFile));
+        }
+
+        theImage.swap(nextImage);
+    }
+
+    if (nullptr != pSegmentFile)
+    {
+        (void)fclose(pSegmentFile);
+    }
+
+    if (false == wasRead || r_Device.theDumps[whichDump].imageHash != HashJournalBlock(theImage.data(), static_cast<ulong>(theImage.size())))
+    {
+        return false;
+    }
+
+    r_Image.swap(theImage);
+
+    return true;
+}
+
+/// <summary>
+/// Adds an image to a device's archive, storing only what is not already held. The
+/// image is compared with the last one added: where they match from the start is
+/// shared, and only from the first difference up to where the image's data ends is
+/// stored. When they stop matching well before either one's data ends the device's
+/// history must have been erased in between, so a new epoch starts and the whole of
+/// the image's data is stored.
+/// </summary>
+/// <param name="r_Device">The device's archive</param>
+/// <param name="pch_DumpName">The name to archive the image under</param>
+/// <param name="pImage">The image</param>
+/// <param name="imageLength">The number of octets in the image</param>
+/// <param name="r_StoredOctets">Returns the number of octets which had to be stored</param>
+/// <returns>true if the image was added or was already there, otherwise false</returns>
+bool AddArchiveImage(ArchiveDevice & r_Device,
+    const char * pch_DumpName,
+    const uchar * pImage,
+    ulong imageLength,
+    ulong & r_StoredOctets)
+{
+    ArchiveDump theDump;
+    FILE *      pArchiveFile     = nullptr;
+    char        indexRecord[501] = { 0 };
+    ulong       endOfData        = FindEndOfStoredData(pImage, imageLength);
+    bool        wasWritten       = false;
+
+    r_StoredOctets = static_cast<ulong>(0);
+
+    theDump.epoch         = static_cast<ulong>(0);
+    theDump.parentDump    = -1;
+    theDump.flashAddress  = static_cast<ulong>(0);
+    theDump.segmentOffset = static_cast<ulong>(0);
+    theDump.imageLength   = imageLength;
+    theDump.imageHash     = HashJournalBlock(pImage, imageLength);
+    theDump.dumpName      = pch_DumpName;
+
+    // Adding the same image under the same name again changes nothing
+    for (size_t thisDump = 0; thisDump < r_Device.theDumps.size(); thisDump++)
+    {
+        const ArchiveDump & r_Dump = r_Device.theDumps[thisDump];
+
+        if (r_Dump.imageHash == theDump.imageHash && r_Dump.imageLength == imageLength && r_Dump.dumpName == theDump.dumpName)
+        {
+            return true;
+        }
+    }
+
+    if (false == r_Device.theDumps.empty())
+    {
+        vector<uchar> parentImage;
+        size_t        lastDump = r_Device.theDumps.size() - 1;
+
+        if (false == RestoreArchiveImage(r_Device, lastDump, parentImage))
+        {
+            return false;
+        }
+
+        ulong compareLength = min(imageLength, static_cast<ulong>(parentImage.size()));
+        ulong commonLength  = static_cast<ulong>(0);
+
+        while (commonLength < compareLength && pImage[commonLength] == parentImage[commonLength])
+        {
+            commonLength++;
+        }
+
+        ulong sharedEnd = min(endOfData, FindEndOfStoredData(parentImage.data(), static_cast<ulong>(parentImage.size())));
+
+        theDump.epoch = r_Device.theDumps[lastDump].epoch;
+
+        // The last frame written may have been completed since, so allow for a little difference
+        if (commonLength + SYNC_OVERLAP_OCTETS < sharedEnd)
+        {
+            theDump.epoch++;
+        }
+        else
+        {
+            theDump.parentDump   = static_cast<long>(lastDump);
+            theDump.flashAddress = commonLength;
+        }
+    }
+
+    theDump.segmentLength = (endOfData > theDump.flashAddress) ? endOfData - theDump.flashAddress : static_cast<ulong>(0);
+
+    // The octets go first so that the index never refers to octets which are not there
+    if (0 == fopen_s(&pArchiveFile, r_Device.segmentFileName.c_str(), "ab"))
+    {
+        wasWritten = (0 == fseek(pArchiveFile, 0, SEEK_END));
+
+        theDump.segmentOffset = static_cast<ulong>(ftell(pArchiveFile));
+
+        if (theDump.segmentLength > static_cast<ulong>(0))
+        {
+            wasWritten = (1 == fwrite(&pImage[theDump.flashAddress], theDump.segmentLength, 1, pArchiveFile)) && wasWritten;
+        }
+
+        wasWritten = (0 == fclose(pArchiveFile)) && wasWritten;
+    }
+
+    if (false == wasWritten)
+    {
+        return false;
+    }
+
+    FormatArchiveRecord(theDump, indexRecord, sizeof(indexRecord));
+
+    wasWritten = false;
+
+    if (0 == fopen_s(&pArchiveFile, r_Device.indexFileName.c_str(), "ab"))
+    {
+        wasWritten = (EOF != fputs(indexRecord, pArchiveFile));
+
+        wasWritten = (0 == fclose(pArchiveFile)) && wasWritten;
+    }
+
+    if (false == wasWritten)
+    {
+        return false;
+    }
+
+    r_Device.theDumps.push_back(theDump);
+
+    r_StoredOctets = theDump.segmentLength;
+
+    return true;
+}
+
+/// <summary>
+/// Works out which device an image came from. Fleet harvested images are named
+/// after the device's serial number; any other image belongs to the device named
+/// on the command line.
+/// </summary>
+string GetImageSerialNumber(const string & r_BaseFileName, const string & r_DefaultSerialNumber)
+{
+    if (r_BaseFileName.size() > ARCHIVE_SERIAL_NUMBER_LENGTH && '.' == r_BaseFileName[ARCHIVE_SERIAL_NUMBER_LENGTH])
+    {
+        size_t thisCharacter = 0;
+
+        while (thisCharacter < ARCHIVE_SERIAL_NUMBER_LENGTH && nullptr != strchr("0123456789abcdefABCDEF", r_BaseFileName[thisCharacter]))
+        {
+            thisCharacter++;
+        }
+
+        if (thisCharacter == ARCHIVE_SERIAL_NUMBER_LENGTH)
+        {
+            return r_BaseFileName.substr(0, ARCHIVE_SERIAL_NUMBER_LENGTH);
+        }
+    }
+
+    return r_DefaultSerialNumber;
+}
+
+/// <summary>
+/// Reads the "04Jun23.08.24.55" date and time which image file names start with,
+/// after the serial number if there is one, as a number which sorts in time order
+/// </summary>
+/// <returns>The sortable number, or 0 if the name does not carry a date and time</returns>
+static unsigned long long GetImageTimeStampKey(const string & r_BaseFileName, size_t startOffset)
+{
+    const char * pch_Stamp  = r_BaseFileName.c_str() + startOffset;
+    int          whichMonth = -1;
+
+    if (r_BaseFileName.size() < startOffset + 16)
+    {
+        return 0;
+    }
+
+    for (int thisMonth = 0; thisMonth < 12; thisMonth++)
+    {
+        if (0 == strncmp(&pch_Stamp[2], theMonths[thisMonth], 3))
+        {
+            whichMonth = thisMonth;
+        }
+    }
+
+    if (whichMonth < 0 || '.' != pch_Stamp[7] || '.' != pch_Stamp[10] || '.' != pch_Stamp[13])
+    {
+        return 0;
+    }
+
+    unsigned long long theKey = strtoul(string(&pch_Stamp[5], 2).c_str(), nullptr, 10);
+
+    theKey = (theKey * 12) + static_cast<unsigned long long>(whichMonth);
+    theKey = (theKey * 32) + strtoul(string(&pch_Stamp[0], 2).c_str(), nullptr, 10);
+    theKey = (theKey * 24) + strtoul(string(&pch_Stamp[8], 2).c_str(), nullptr, 10);
+    theKey = (theKey * 60) + strtoul(string(&pch_Stamp[11], 2).c_str(), nullptr, 10);
+    theKey = (theKey * 60) + strtoul(string(&pch_Stamp[14], 2).c_str(), nullptr, 10);
+
+    return theKey;
+}
+
+/// <summary>
+/// Works out which device each file came from and when it was harvested, and puts
+/// the files in order of device and then of harvest, oldest first
+/// </summary>
+/// <param name="r_FileNames">The image files, or the files decoded from them</param>
+/// <param name="r_DefaultSerialNumber">The device for files not named after one</param>
+/// <param name="r_Inputs">Returns the files in order</param>
+void SortArchiveInputs(const vector<string> & r_FileNames, const string & r_DefaultSerialNumber, vector<ArchiveInput> & r_Inputs)
+{
+    r_Inputs.clear();
+
+    for (size_t thisFile = 0; thisFile < r_FileNames.size(); thisFile++)
+    {
+        ArchiveInput theInput;
+        string       baseFileName = GetBaseFileName(r_FileNames[thisFile]);
+
+        theInput.fileName     = r_FileNames[thisFile];
+        theInput.serialNumber = GetImageSerialNumber(baseFileName, r_DefaultSerialNumber);
+        theInput.timeStampKey = GetImageTimeStampKey(baseFileName,
+            (baseFileName.compare(0, theInput.serialNumber.size(), theInput.serialNumber) == 0) ? theInput.serialNumber.size() + 1 : 0);
+
+        r_Inputs.push_back(theInput);
+    }
+
+    sort(r_Inputs.begin(), r_Inputs.end(), [](const ArchiveInput & r_Left, const ArchiveInput & r_Right)
+    {
+        if (r_Left.serialNumber != r_Right.serialNumber)
+        {
+            return r_Left.serialNumber < r_Right.serialNumber;
+        }
+
+        if (r_Left.timeStampKey != r_Right.timeStampKey)
+        {
+            return r_Left.timeStampKey < r_Right.timeStampKey;
+        }
+
+        return r_Left.fileName < r_Right.fileName;
+    });
+}
+
+/// <summary>
+/// Adds images to the archive, each device's oldest first, and reports how much of
+/// each had to be stored
+/// </summary>
+static int AddArchiveImages(const char * pch_Directory, const vector<string> & r_FileNames, const string & r_DefaultSerialNumber)
+{
+    vector<ArchiveInput>       theInputs;
+    map<string, ArchiveDevice> theDevices;
+    unsigned long long         imageOctets  = 0;
+    unsigned long long         storedOctets = 0;
+    ulong                      failedCount  = static_cast<ulong>(0);
+
+    SortArchiveInputs(r_FileNames, r_DefaultSerialNumber, theInputs);
+
+    (void)printf("Serial          Dump  Epoch  Address   Stored  Image\n");
+
+    for (size_t thisInput = 0; thisInput < theInputs.size(); thisInput++)
+    {
+        const ArchiveInput & r_Input = theInputs[thisInput];
+        MappedFlashImage     theImage;
+        ulong                thisStored = static_cast<ulong>(0);
+
+        if (theDevices.end() == theDevices.find(r_Input.serialNumber) &&
+            false == OpenArchiveDevice(pch_Directory, r_Input.serialNumber.c_str(), theDevices[r_Input.serialNumber]))
+        {
+            (void)printf("Error: I was unable to open the archive of device %s\n", r_Input.serialNumber.c_str());
+            theDevices.erase(r_Input.serialNumber);
+            failedCount++;
+            continue;
+        }
+
+        ArchiveDevice & r_Device = theDevices[r_Input.serialNumber];
+
+        if (false == MapFlashImageFile(r_Input.fileName.c_str(), theImage))
+        {
+            (void)printf("Error: I was unable to read %s\n", r_Input.fileName.c_str());
+            failedCount++;
+            continue;
+        }
+
+        bool wasAdded = AddArchiveImage(r_Device, GetBaseFileName(r_Input.fileName).c_str(), theImage.pImage, theImage.imageSize, thisStored);
+
+        if (true == wasAdded)
+        {
+            const ArchiveDump & r_Dump = r_Device.theDumps.back();
+
+            (void)printf("%-14s %5lu %6lu   %06lx %8lu  %s\n",
+                r_Device.serialNumber.c_str(),
+                static_cast<ulong>(r_Device.theDumps.size() - 1),
+                r_Dump.epoch,
+                r_Dump.flashAddress,
+                thisStored,
+                r_Input.fileName.c_str());
+
+            imageOctets  += theImage.imageSize;
+            storedOctets += thisStored;
+        }
+        else
+        {
+            (void)printf("Error: I was unable to archive %s\n", r_Input.fileName.c_str());
+            failedCount++;
+        }
+
+        UnmapFlashImageFile(theImage);
+    }
+
+    (void)printf("\nArchived %lu images, %llu octets of images in %llu octets stored\n",
+        static_cast<ulong>(theInputs.size()) - failedCount,
+        imageOctets,
+        storedOctets);
+
+    return (failedCount == static_cast<ulong>(0)) ? 0 : 1;
+}
+
+/// <summary>
+/// Lists every dump held in the archive
+/// </summary>
+static int ListArchive(const char * pch_Directory)
+{
+    vector<string>     indexFileNames;
+    size_t             suffixLength  = strlen(ARCHIVE_INDEX_FILE_NAME) + 1;
+    unsigned long long imageOctets   = 0;
+    unsigned long long storedOctets  = 0;
+    ulong              dumpCount     = static_cast<ulong>(0);
+
+    CollectInputFileNames(pch_Directory, "*." ARCHIVE_INDEX_FILE_NAME, indexFileNames);
+
+    (void)printf("Serial          Dump  Epoch  Parent  Address   Stored   Image  Name\n");
+
+    for (size_t thisFile = 0; thisFile < indexFileNames.size(); thisFile++)
+    {
+        ArchiveDevice theDevice;
+        string        baseFileName = GetBaseFileName(indexFileNames[thisFile]);
+
+        if (baseFileName.size() <= suffixLength ||
+            false == OpenArchiveDevice(pch_Directory, baseFileName.substr(0, baseFileName.size() - suffixLength).c_str(), theDevice))
+        {
+            continue;
+        }
+
+        for (size_t thisDump = 0; thisDump < theDevice.theDumps.size(); thisDump++)
+        {
+            const ArchiveDump & r_Dump = theDevice.theDumps[thisDump];
+
+            (void)printf("%-14s %5lu %6lu %7ld   %06lx %8lu %7lu  %s\n",
+                theDevice.serialNumber.c_str(),
+                static_cast<ulong>(thisDump),
+                r_Dump.epoch,
+                r_Dump.parentDump,
+                r_Dump.flashAddress,
+                r_Dump.segmentLength,
+                r_Dump.imageLength,
+                r_Dump.dumpName.c_str());
+
+            imageOctets  += r_Dump.imageLength;
+            storedOctets += r_Dump.segmentLength;
+            dumpCount++;
+        }
+    }
+
+    (void)printf("\n%lu images of %llu octets are held in %llu octets\n", dumpCount, imageOctets, storedOctets);
+
+    return 0;
+}
+
+/// <summary>
+/// Rebuilds an archived image, picked by its number or by its name, and writes it to
+/// the output directory under the name it was archived with
+/// </summary>
+static int RestoreArchiveDump(const char * pch_Directory, const char * pch_SerialNumber, const char * pch_Dump, const string & r_OutputDirectory)
+{
+    ArchiveDevice theDevice;
+    vector<uchar> theImage;
+    FILE *        pOutputFile            = nullptr;
+    char          temporaryFileName[301] = { 0 };
+    size_t        whichDump              = 0;
+    bool          wasWritten             = false;
+
+    if (false == OpenArchiveDevice(pch_Directory, pch_SerialNumber, theDevice))
+    {
+        (void)printf("Error: I was unable to open the archive of device %s\n", pch_SerialNumber);
+        return 1;
+    }
+
+    // A number picks the dump by its position, anything else by its name
+    if (strspn(pch_Dump, "0123456789") == strlen(pch_Dump))
+    {
+        whichDump = static_cast<size_t>(strtoul(pch_Dump, nullptr, 10));
+    }
+    else
+    {
+        while (whichDump < theDevice.theDumps.size() && theDevice.theDumps[whichDump].dumpName != pch_Dump)
+        {
+            whichDump++;
+        }
+    }
+
+    if (false == RestoreArchiveImage(theDevice, whichDump, theImage))
+    {
+        (void)printf("Error: I was unable to rebuild dump %s of device %s\n", pch_Dump, pch_SerialNumber);
+        return 1;
+    }
+
+    string outputFileName = r_OutputDirectory;
+
+    if (false == outputFileName.empty() && outputFileName.back() != PATH_SEPARATOR_CHARACTER && outputFileName.back() != '/')
+    {
+        outputFileName += PATH_SEPARATOR_CHARACTER;
+    }
+
+    outputFileName += theDevice.theDumps[whichDump].dumpName;
+
+    BuildTemporaryFileName(outputFileName.c_str(), temporaryFileName, sizeof(temporaryFileName));
+
+    if (0 == fopen_s(&pOutputFile, temporaryFileName, "wb"))
+    {
+        wasWritten = (theImage.empty() || 1 == fwrite(theImage.data(), theImage.size(), 1, pOutputFile));
+
+        wasWritten = (0 == fclose(pOutputFile)) && wasWritten;
+    }
+
+    if (false == wasWritten || false == CommitFileAtomically(temporaryFileName, outputFileName.c_str()))
+    {
+        (void)remove(temporaryFileName);
+        (void)printf("Error: I was unable to write %s\n", outputFileName.c_str());
+        return 1;
+    }
+
+    (void)printf("Rebuilt %s, %lu octets\n", outputFileName.c_str(), static_cast<ulong>(theImage.size()));
+
+    return 0;
+}
+
+/// <summary>
+/// Displays how the archive store is used
+/// </summary>
+static void DisplayArchiveUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -archive <archive directory> [-serial <serial>] <directory|pattern> [...]\n");
+    (void)printf("       ReadGeiger -archive <archive directory> -list\n");
+    (void)printf("       ReadGeiger -archive <archive directory> -restore <serial> <dump number|name> [-out <directory>]\n");
+    (void)printf("  Images are filed under the serial number their names start with, otherwise\n");
+    (void)printf("  under -serial, or under \"%s\" if there is neither.\n", ARCHIVE_UNKNOWN_SERIAL_NUMBER);
+}
+
+/// <summary>
+/// The entry point for the archive store. The first argument is the archive directory,
+/// followed by the images to add, or by what to list or restore.
+/// </summary>
+/// <param name="argc">The number of arguments following "-archive"</param>
+/// <param name="argv">The arguments following "-archive"</param>
+/// <returns>0 if everything asked for was done, otherwise 1</returns>
+int RunArchiveStore(int argc, char * argv[])
+{
+    vector<string> inputFileNames;
+    string         defaultSerialNumber = ARCHIVE_UNKNOWN_SERIAL_NUMBER;
+    string         outputDirectory;
+    const char *   pch_RestoreSerial   = nullptr;
+    const char *   pch_RestoreDump     = nullptr;
+    bool           wantList            = false;
+
+    if (argc < 2)
+    {
+        DisplayArchiveUsage();
+        return 1;
+    }
+
+    for (int thisArgument = 1; thisArgument < argc; thisArgument++)
+    {
+        if (0 == strcmp(argv[thisArgument], "-serial") && thisArgument + 1 < argc)
+        {
+            defaultSerialNumber = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-out") && thisArgument + 1 < argc)
+        {
+            outputDirectory = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-list"))
+        {
+            wantList = true;
+        }
+        else if (0 == strcmp(argv[thisArgument], "-restore") && thisArgument + 2 < argc)
+        {
+            pch_RestoreSerial = argv[++thisArgument];
+            pch_RestoreDump   = argv[++thisArgument];
+        }
+        else
+        {
+            CollectInputFileNames(argv[thisArgument], BATCH_INPUT_FILE_PATTERN, inputFileNames);
+        }
+    }
+
+    // Otherwise every image would fail to archive without saying why
+    if (false == IsDirectory(argv[0]))
+    {
+        (void)printf("Error: the archive directory %s does not exist\n", argv[0]);
+        return 1;
+    }
+
+    if (true == wantList)
+    {
+        return ListArchive(argv[0]);
+    }
+
+    if (nullptr != pch_RestoreSerial)
+    {
+        return RestoreArchiveDump(argv[0], pch_RestoreSerial, pch_RestoreDump, outputDirectory);
+    }
+
+    if (inputFileNames.empty())
+    {
+        DisplayArchiveUsage();
+        (void)printf("There were no FLASH images found to archive\n");
+        return 1;
+    }
+
+    return AddArchiveImages(argv[0], inputFileNames, defaultSerialNumber);
+}
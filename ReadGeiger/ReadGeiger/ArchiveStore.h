@@ -0,0 +1,80 @@
+// ----------------------------------------------------------------------
+// ArchiveStore.h
+//
+// A long-term archive of FLASH images which keeps only what is new in
+// each one. A device only ever appends to its history until the history
+// gets erased, so successive images of the same device start with the
+// same octets and end in erased FLASH. Each image added is compared with
+// the last one archived for that device, and only the octets from where
+// the two stop matching up to where the data ends are stored. Any image
+// ever added can be rebuilt from those stored octets.
+//
+// Each device has two files in the archive directory, named after its
+// serial number: an index of the images and the octets stored for them.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Portable.h"
+
+#define ARCHIVE_INDEX_FILE_NAME         "ReadGeiger.archive"
+#define ARCHIVE_SEGMENT_FILE_NAME       "ReadGeiger.segments"
+#define ARCHIVE_UNKNOWN_SERIAL_NUMBER   "unknown"
+
+// The serial number which fleet harvested file names start with, in hexadecimal
+#define ARCHIVE_SERIAL_NUMBER_LENGTH    static_cast<size_t>(14)
+
+/// <summary>
+/// One archived image. Its first flashAddress octets are the same as its parent's,
+/// then come the stored octets, and everything after them is erased FLASH.
+/// </summary>
+typedef struct archive_dump_t
+{
+    ulong       epoch;                      // Counts the erasures of the device's history seen so far
+    long        parentDump;                 // The dump this one starts the same as, or -1 for none
+    ulong       flashAddress;               // Where this dump stops matching its parent
+    ulong       segmentOffset;              // Where the stored octets are in the segment file
+    ulong       segmentLength;              // The number of octets stored
+    ulong       imageLength;                // The number of octets in the whole image
+    uint64_t    imageHash;                  // FNV-1a of the whole image, to check rebuilding it
+    std::string dumpName;                   // The image's file name without its directory
+} ArchiveDump;
+
+/// <summary>
+/// A file waiting to be processed, and what it is sorted by so that each device's
+/// files get processed oldest first
+/// </summary>
+typedef struct archive_input_t
+{
+    std::string        fileName;            // The image file
+    std::string        serialNumber;        // The device it came from
+    unsigned long long timeStampKey;        // When it was harvested, as a sortable number, or 0
+} ArchiveInput;
+
+typedef struct archive_device_t
+{
+    std::string              serialNumber;      // The device's serial number as hexadecimal text
+    std::string              indexFileName;     // The index of the device's dumps
+    std::string              segmentFileName;   // The octets stored for those dumps
+    std::vector<ArchiveDump> theDumps;          // Every dump archived, oldest first
+} ArchiveDevice;
+
+extern bool OpenArchiveDevice(const char * pch_Directory, const char * pch_SerialNumber, ArchiveDevice & r_Device);
+extern bool AddArchiveImage(ArchiveDevice & r_Device,
+    const char * pch_DumpName,
+    const uchar * pImage,
+    ulong imageLength,
+    ulong & r_StoredOctets);
+extern bool RestoreArchiveImage(const ArchiveDevice & r_Device, size_t whichDump, std::vector<uchar> & r_Image);
+
+extern std::string GetBaseFileName(const std::string & r_FileName);
+extern std::string GetImageSerialNumber(const std::string & r_BaseFileName, const std::string & r_DefaultSerialNumber);
+extern void SortArchiveInputs(const std::vector<std::string> & r_FileNames,
+    const std::string & r_DefaultSerialNumber,
+    std::vector<ArchiveInput> & r_Inputs);
+
+extern int RunArchiveStore(int argc, char * argv[]);
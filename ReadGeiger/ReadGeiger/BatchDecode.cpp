@@ -0,0 +1,430 @@
+// ----------------------------------------------------------------------
+// BatchDecode.cpp
+//
+// The field laptops bring back a great many FLASH images. This module
+// takes directories or wildcard patterns naming those images, maps each
+// one in to memory, and decodes them in parallel using one worker
+// thread per processor core. Each image gets its own comma-delimited
+// file and a line in a summary file, and the throughput is reported so
+// that ingest hardware may be sized.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BatchDecode.h"
+#include "FlashExport.h"
+#include "FlashImage.h"
+#include "FrameScanner.h"
+#include "SeriesFile.h"
+#include "ReadGeiger.h"
+
+#ifndef _WIN32
+#include <glob.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+typedef struct batch_image_result_t
+{
+    string inputFileName;           // The archived FLASH image
+    string csvFileName;             // The comma-delimited file created from it
+    string textFileName;            // The ASCII text dump created from it, or empty for none
+    string seriesFileName;          // The binary series file created from it, or empty for none
+    bool   wasSuccessful;           // true if the image was mapped and decoded
+    ulong  imageSize;               // The number of octets in the image
+    ulong  sampleCount;             // The number of CPS/CPM/CPH values found
+    ulong  lowestCount;             // The lowest CPS/CPM/CPH value found
+    ulong  highestCount;            // The highest CPS/CPM/CPH value found
+    ulong  averageCount;            // The average across all of the values
+} BatchImageResult;
+
+/// <summary>
+/// Determines whether the name passed by argument is an existing directory
+/// </summary>
+/// <param name="pch_Name">The NULL-terminated path to examine</param>
+/// <returns>true if it is a directory, otherwise false</returns>
+bool IsDirectory(const char * pch_Name)
+{
+#ifdef _WIN32
+    DWORD theAttributes = GetFileAttributes(pch_Name);
+
+    return (INVALID_FILE_ATTRIBUTES != theAttributes && 0 != (theAttributes & FILE_ATTRIBUTE_DIRECTORY));
+#else
+    struct stat fileStatus;
+
+    return (0 == stat(pch_Name, &fileStatus) && S_ISDIR(fileStatus.st_mode));
+#endif
+}
+
+/// <summary>
+/// The argument is either a directory, in which case every file within it which matches
+/// the directory pattern is selected, or it is a file name which may contain wildcard
+/// characters. The names of the files which were found are appended to the container.
+/// </summary>
+/// <param name="pch_DirectoryOrPattern">A directory or a file name pattern</param>
+/// <param name="pch_DirectoryPattern">What a directory selects, such as BATCH_INPUT_FILE_PATTERN</param>
+/// <param name="r_FileNames">The container the file names are appended to</param>
+void CollectInputFileNames(const char * pch_DirectoryOrPattern, const char * pch_DirectoryPattern, vector<string> & r_FileNames)
+{
+    string thePattern = pch_DirectoryOrPattern;
+
+    // A directory gets all of the files inside of it which match
+    if (true == IsDirectory(pch_DirectoryOrPattern))
+    {
+        if (thePattern.back() != PATH_SEPARATOR_CHARACTER && thePattern.back() != '/')
+        {
+            thePattern += PATH_SEPARATOR_CHARACTER;
+        }
+
+        thePattern += pch_DirectoryPattern;
+    }
+
+#ifdef _WIN32
+    WIN32_FIND_DATA findData;
+    string          theDirectory;
+    size_t          separatorOffset = thePattern.find_last_of("\\/:");
+
+    // FindFirstFile() only returns the file part of the name so keep the directory
+    if (string::npos != separatorOffset)
+    {
+        theDirectory = thePattern.substr(0, separatorOffset + 1);
+    }
+
+    HANDLE hFind = FindFirstFile(thePattern.c_str(), &findData);
+
+    if (INVALID_HANDLE_VALUE != hFind)
+    {
+        do
+        {
+            if (0 == (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            {
+                r_FileNames.push_back(theDirectory + findData.cFileName);
+            }
+        } while (FindNextFile(hFind, &findData));
+
+        (void)FindClose(hFind);
+    }
+#else
+    glob_t globResult;
+
+    if (0 == glob(thePattern.c_str(), 0, nullptr, &globResult))
+    {
+        for (size_t thisMatch = 0; thisMatch < globResult.gl_pathc; thisMatch++)
+        {
+            if (false == IsDirectory(globResult.gl_pathv[thisMatch]))
+            {
+                r_FileNames.push_back(globResult.gl_pathv[thisMatch]);
+            }
+        }
+    }
+
+    globfree(&globResult);
+#endif
+}
+
+/// <summary>
+/// Builds an output file name for an input FLASH image. The usual
+/// "DATE.ReadGeiger.bin" becomes "DATE.ReadReiger.csv" or "DATE.ReadGeiger.txt"
+/// so that the output pairs up with what the interactive program creates.
+/// </summary>
+/// <param name="r_InputFileName">The FLASH image file name</param>
+/// <param name="r_OutputDirectory">Where to put the output, or empty to put it beside the input</param>
+/// <param name="pch_OutputSuffix">The standard file name of the output, such as DATA_OUTPUT_CSV_FILE_NAME</param>
+/// <returns>The output file name</returns>
+string BuildOutputFileName(const string & r_InputFileName, const string & r_OutputDirectory, const char * pch_OutputSuffix)
+{
+    string theName         = r_InputFileName;
+    size_t separatorOffset = theName.find_last_of("\\/");
+    size_t suffixOffset    = theName.rfind(DATA_OUTPUT_FILE_NAME);
+
+    // Replace the binary suffix, or append the output one if there is none
+    if (string::npos != suffixOffset && suffixOffset + strlen(DATA_OUTPUT_FILE_NAME) == theName.size())
+    {
+        theName.replace(suffixOffset, strlen(DATA_OUTPUT_FILE_NAME), pch_OutputSuffix);
+    }
+    else
+    {
+        theName += ".";
+        theName += pch_OutputSuffix;
+    }
+
+    // Move it to the output directory if one was asked for
+    if (false == r_OutputDirectory.empty())
+    {
+        string baseName = (string::npos == separatorOffset) ? theName : theName.substr(separatorOffset + 1);
+
+        theName = r_OutputDirectory;
+
+        if (theName.back() != PATH_SEPARATOR_CHARACTER && theName.back() != '/')
+        {
+            theName += PATH_SEPARATOR_CHARACTER;
+        }
+
+        theName += baseName;
+    }
+
+    return theName;
+}
+
+/// <summary>
+/// Maps a single FLASH image, creates its comma-delimited file and computes its
+/// statistics, and creates its ASCII text dump and its series file if they were asked for. This is called from many worker threads at once so it only touches
+/// the result it is given.
+/// </summary>
+/// <param name="r_Result">The image to decode, updated with what was found</param>
+static void DecodeOneImage(BatchImageResult & r_Result)
+{
+    MappedFlashImage  theImage;
+    FlashImageSummary theSummary;
+    SampleStore       theStore;
+    bool              wantSeries = (false == r_Result.seriesFileName.empty());
+
+    r_Result.wasSuccessful = false;
+    r_Result.imageSize     = static_cast<ulong>(0);
+    r_Result.sampleCount   = static_cast<ulong>(0);
+    r_Result.lowestCount   = static_cast<ulong>(0);
+    r_Result.highestCount  = static_cast<ulong>(0);
+    r_Result.averageCount  = static_cast<ulong>(0);
+
+    if (false == MapFlashImageFile(r_Result.inputFileName.c_str(), theImage))
+    {
+        return;
+    }
+
+    r_Result.imageSize = theImage.imageSize;
+
+    // Create the comma-delimited file and gather the statistics in the same pass
+    if (true == DecodeFlashImage(theImage.pImage,
+        theImage.imageSize,
+        r_Result.csvFileName.c_str(),
+        (true == wantSeries) ? &theStore : nullptr,
+        theSummary))
+    {
+        r_Result.sampleCount   = theSummary.sampleCount;
+        r_Result.lowestCount   = theSummary.lowestCount;
+        r_Result.highestCount  = theSummary.highestCount;
+        r_Result.averageCount  = theSummary.averageCount;
+        r_Result.wasSuccessful = true;
+    }
+
+    // The text dump covers the same octets that the interactive program writes
+    if (true == r_Result.wasSuccessful && false == r_Result.textFileName.empty())
+    {
+        r_Result.wasSuccessful = WriteFlashImageTextFile(theImage.pImage,
+            (theImage.imageSize < MAX_FLASH_MEMORY) ? theImage.imageSize : MAX_FLASH_MEMORY,
+            r_Result.textFileName.c_str());
+    }
+
+    if (true == r_Result.wasSuccessful && true == wantSeries)
+    {
+        r_Result.wasSuccessful = WriteSeriesFile(theStore, r_Result.seriesFileName.c_str());
+    }
+
+    UnmapFlashImageFile(theImage);
+}
+
+/// <summary>
+/// Writes the per-image statistics to a comma-delimited summary file
+/// </summary>
+/// <param name="r_Results">The decoded images</param>
+/// <param name="pch_SummaryFileName">The summary file to create</param>
+static void WriteBatchSummaryFile(const vector<BatchImageResult> & r_Results, const char * pch_SummaryFileName)
+{
+    FILE * pSummaryFile = nullptr;
+
+    if (0 != fopen_s(&pSummaryFile, pch_SummaryFileName, "wb"))
+    {
+        (void)printf("Error: I was unable to create file: %s\n", pch_SummaryFileName);
+        return;
+    }
+
+    (void)fprintf(pSummaryFile, "Image,Decoded,Samples,Lowest,Highest,Average\n");
+
+    for (size_t thisResult = 0; thisResult < r_Results.size(); thisResult++)
+    {
+        (void)fprintf(pSummaryFile, "%s,%s,%lu,%lu,%lu,%lu\n",
+            r_Results[thisResult].inputFileName.c_str(),
+            r_Results[thisResult].wasSuccessful ? "Yes" : "No",
+            r_Results[thisResult].sampleCount,
+            r_Results[thisResult].lowestCount,
+            r_Results[thisResult].highestCount,
+            r_Results[thisResult].averageCount);
+    }
+
+    (void)fclose(pSummaryFile);
+}
+
+/// <summary>
+/// Displays how the batch decoder is used
+/// </summary>
+static void DisplayBatchUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -batch <directory|pattern> [...] [-out <directory>] [-threads <count>] [-text] [-series]\n");
+    (void)printf("  A directory selects every %s file within it.\n", BATCH_INPUT_FILE_PATTERN);
+    (void)printf("  -text also creates the decimal ASCII text dump of each image.\n");
+    (void)printf("  -series also creates the binary series file of each image.\n");
+}
+
+/// <summary>
+/// The entry point for the batch decoder. The arguments are the directories and
+/// file name patterns to decode, optionally followed by where the output goes, how
+/// many worker threads to use, and whether the ASCII text dumps and series files are wanted.
+/// </summary>
+/// <param name="argc">The number of arguments following "-batch"</param>
+/// <param name="argv">The arguments following "-batch"</param>
+/// <returns>0 if every image was decoded, otherwise 1</returns>
+int RunBatchDecode(int argc, char * argv[])
+{
+    vector<string>           inputFileNames;
+    vector<BatchImageResult> theResults;
+    string                   outputDirectory;
+    string                   summaryFileName;
+    ulong                    threadCount    = static_cast<ulong>(thread::hardware_concurrency());
+    ulong                    failedCount    = static_cast<ulong>(0);
+    bool                     wantTextDumps  = false;
+    bool                     wantSeries     = false;
+    unsigned long long       totalOctets    = 0;
+    atomic<size_t>           nextImage(0);
+    vector<thread>           workerThreads;
+
+    // Gather the options and the input files
+    for (int thisArgument = 0; thisArgument < argc; thisArgument++)
+    {
+        if (0 == strcmp(argv[thisArgument], "-out") && thisArgument + 1 < argc)
+        {
+            outputDirectory = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-threads") && thisArgument + 1 < argc)
+        {
+            threadCount = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-text"))
+        {
+            wantTextDumps = true;
+        }
+        else if (0 == strcmp(argv[thisArgument], "-series"))
+        {
+            wantSeries = true;
+        }
+        else
+        {
+            CollectInputFileNames(argv[thisArgument], BATCH_INPUT_FILE_PATTERN, inputFileNames);
+        }
+    }
+
+    if (inputFileNames.empty())
+    {
+        DisplayBatchUsage();
+        (void)printf("There were no FLASH images found to decode\n");
+        return 1;
+    }
+
+    // Otherwise every image would fail to decode without saying why
+    if (false == outputDirectory.empty() && false == IsDirectory(outputDirectory.c_str()))
+    {
+        (void)printf("Error: the output directory %s does not exist\n", outputDirectory.c_str());
+        return 1;
+    }
+
+    // There is no point in having more workers than there are images
+    if (threadCount == static_cast<ulong>(0))
+    {
+        threadCount = static_cast<ulong>(1);
+    }
+
+    if (threadCount > inputFileNames.size())
+    {
+        threadCount = static_cast<ulong>(inputFileNames.size());
+    }
+
+    theResults.resize(inputFileNames.size());
+
+    for (size_t thisImage = 0; thisImage < inputFileNames.size(); thisImage++)
+    {
+        theResults[thisImage].inputFileName = inputFileNames[thisImage];
+        theResults[thisImage].csvFileName   = BuildOutputFileName(inputFileNames[thisImage], outputDirectory, DATA_OUTPUT_CSV_FILE_NAME);
+
+        if (true == wantTextDumps)
+        {
+            theResults[thisImage].textFileName = BuildOutputFileName(inputFileNames[thisImage], outputDirectory, DATA_OUTPUT_ASCII_FILE_NAME);
+        }
+
+        if (true == wantSeries)
+        {
+            theResults[thisImage].seriesFileName = BuildOutputFileName(inputFileNames[thisImage], outputDirectory, DATA_OUTPUT_SERIES_FILE_NAME);
+        }
+    }
+
+    (void)printf("Decoding %lu FLASH images using %lu threads\n", static_cast<ulong>(theResults.size()), threadCount);
+
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    // Each worker takes the next image that nobody has claimed until there are none left
+    for (ulong thisThread = 0; thisThread < threadCount; thisThread++)
+    {
+        workerThreads.push_back(thread([&theResults, &nextImage]()
+        {
+            size_t thisImage;
+
+            while ((thisImage = nextImage++) < theResults.size())
+            {
+                DecodeOneImage(theResults[thisImage]);
+            }
+        }));
+    }
+
+    for (size_t thisThread = 0; thisThread < workerThreads.size(); thisThread++)
+    {
+        workerThreads[thisThread].join();
+    }
+
+    double elapsedSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    // Report on each image in the order they were given
+    for (size_t thisImage = 0; thisImage < theResults.size(); thisImage++)
+    {
+        if (false == theResults[thisImage].wasSuccessful)
+        {
+            (void)printf("FAILED  %s\n", theResults[thisImage].inputFileName.c_str());
+            failedCount++;
+            continue;
+        }
+
+        totalOctets += theResults[thisImage].imageSize;
+
+        (void)printf("%6lu samples, low %5lu, high %5lu, average %5lu  %s\n",
+            theResults[thisImage].sampleCount,
+            theResults[thisImage].lowestCount,
+            theResults[thisImage].highestCount,
+            theResults[thisImage].averageCount,
+            theResults[thisImage].csvFileName.c_str());
+    }
+
+    // Keep the summary with the comma-delimited files
+    summaryFileName = outputDirectory.empty() ? string(BATCH_SUMMARY_FILE_NAME) :
+        outputDirectory + PATH_SEPARATOR_CHARACTER + BATCH_SUMMARY_FILE_NAME;
+
+    WriteBatchSummaryFile(theResults, summaryFileName.c_str());
+
+    if (elapsedSeconds <= 0.0)
+    {
+        elapsedSeconds = 1e-9;
+    }
+
+    (void)printf("\nDecoded %lu of %lu images in %.3f seconds: %.1f images/sec, %.1f MB/sec (%s frame scanner)\n",
+        static_cast<ulong>(theResults.size()) - failedCount,
+        static_cast<ulong>(theResults.size()),
+        elapsedSeconds,
+        static_cast<double>(theResults.size() - failedCount) / elapsedSeconds,
+        static_cast<double>(totalOctets) / (1024.0 * 1024.0) / elapsedSeconds,
+        GetFrameScannerName());
+
+    return (failedCount == static_cast<ulong>(0)) ? 0 : 1;
+}
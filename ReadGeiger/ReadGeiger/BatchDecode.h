@@ -0,0 +1,21 @@
+// ----------------------------------------------------------------------
+// BatchDecode.h
+//
+// Non-interactive decoding of archived *.ReadGeiger.bin files in to
+// comma-delimited files and summary statistics, spread across all of
+// the processor cores. No serial device is needed.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#define BATCH_INPUT_FILE_PATTERN        "*.ReadGeiger.bin"
+#define BATCH_SUMMARY_FILE_NAME         "BatchSummary.csv"
+
+#include <string>
+#include <vector>
+
+extern bool IsDirectory(const char * pch_Name);
+extern std::string BuildOutputFileName(const std::string & r_InputFileName, const std::string & r_OutputDirectory, const char * pch_OutputSuffix);
+extern void CollectInputFileNames(const char * pch_DirectoryOrPattern, const char * pch_DirectoryPattern, std::vector<std::string> & r_FileNames);
+extern int RunBatchDecode(int argc, char * argv[]);
@@ -0,0 +1,865 @@
+// ----------------------------------------------------------------------
+// Benchmark.cpp
+//
+// The corpus is read in to memory once, and decoded once in to a sample
+// store for each image, before anything is timed, so that the passes
+// only measure the work itself. The exports write to scratch files
+// beside the results which are removed at the end.
+//
+// Before the text export is timed, its output for each image is checked
+// against the text dump checked in for the same day, so a benchmark of
+// an export which has gone wrong does not go unnoticed.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "Benchmark.h"
+#include "ArchiveStore.h"
+#include "BatchDecode.h"
+#include "DeviceSession.h"
+#include "EventExtractor.h"
+#include "FlashExport.h"
+#include "FlashImage.h"
+#include "FrameDecoder.h"
+#include "FrameScanner.h"
+#include "SampleStore.h"
+#include "SeriesFile.h"
+#include "SyncCursor.h"
+#include "ReadGeiger.h"
+
+using namespace std;
+
+#define BENCH_TEXT_INPUT_PATTERN    "*." DATA_OUTPUT_ASCII_FILE_NAME
+#define BENCH_CSV_INPUT_PATTERN     "*." DATA_OUTPUT_CSV_FILE_NAME
+
+typedef struct bench_corpus_t
+{
+    vector<vector<uchar>> theImages;        // The FLASH images
+    vector<ulong>         imageSamples;     // The CPS/CPM/CPH values in each image, zeros included
+    vector<ulong>         imageDataOctets;  // The octets of each image up to the end of its data
+    vector<SampleStore>   theStores;        // Each image decoded
+    vector<string>        imageNames;       // The FLASH image files
+    vector<string>        textNames;        // The text dump files
+    vector<string>        csvNames;         // The comma-delimited files
+    unsigned long long    imageOctets;      // The octets of every image
+    unsigned long long    dataOctets;       // The octets of every image up to the end of its data
+    unsigned long long    textOctets;       // The octets of every image the text dumps hold
+    unsigned long long    sampleTotal;      // The values of every image, zeros included
+    unsigned long long    csvOctets;        // The octets of every comma-delimited file
+    ulong                 textVerified;     // Text dumps which the text export reproduced
+    ulong                 textMismatched;   // Text dumps which it did not
+    vector<uchar>         tiledImages;      // The images copied end to end for the scale-up
+    vector<size_t>        tiledOffsets;     // Where each tiled image starts, and where the last ends
+    unsigned long long    tiledDataOctets;  // The octets of every tiled image up to the end of its data
+    ulong                 threadCount;      // The threads the scale-up uses
+    string                scratchCSVName;   // Where the comma-delimited export is written
+    string                scratchTextName;  // Where the text export is written
+} BenchCorpus;
+
+/// <summary>
+/// One pass of a benchmark over the corpus
+/// </summary>
+/// <param name="r_Corpus">The corpus</param>
+/// <param name="r_Octets">Returns the octets of input the pass read, which for a FLASH image is up to the end of its data</param>
+/// <returns>The CPS/CPM/CPH values the pass handled</returns>
+typedef unsigned long long (*BenchPassFunction)(BenchCorpus & r_Corpus, unsigned long long & r_Octets);
+
+/// <summary>
+/// The steady clock in seconds
+/// </summary>
+static double GetBenchSeconds(void)
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// <summary>
+/// Reads a whole file in to memory
+/// </summary>
+static bool ReadWholeFile(const char * pch_FileName, vector<uchar> & r_Contents)
+{
+    MappedFlashImage theFile;
+
+    r_Contents.clear();
+
+    if (false == MapFlashImageFile(pch_FileName, theFile))
+    {
+        return false;
+    }
+
+    r_Contents.assign(theFile.pImage, theFile.pImage + theFile.imageSize);
+
+    UnmapFlashImageFile(theFile);
+
+    return true;
+}
+
+/// <summary>
+/// Counts the CPS/CPM/CPH values in an image, zeros included
+/// </summary>
+static ulong CountImageSamples(const uchar * pImage, ulong imageSize)
+{
+    FrameDecoder theDecoder;
+    FrameEvent   theEvent;
+    ulong        sampleCount = static_cast<ulong>(0);
+
+    StartFrameDecoder(theDecoder, pImage, imageSize);
+
+    while (true == GetNextFrameEvent(theDecoder, theEvent))
+    {
+        if (FrameEventCountRun == theEvent.eventType)
+        {
+            sampleCount += theEvent.runLength;
+        }
+        else if (FrameEventDoubleCount == theEvent.eventType || FrameEventWideCount == theEvent.eventType)
+        {
+            sampleCount++;
+        }
+    }
+
+    return sampleCount;
+}
+
+/// <summary>
+/// The text dump covers the same octets that the interactive program writes
+/// </summary>
+static ulong GetTextDumpSize(const BenchCorpus & r_Corpus, size_t whichImage)
+{
+    ulong imageSize = static_cast<ulong>(r_Corpus.theImages[whichImage].size());
+
+    return (imageSize < MAX_FLASH_MEMORY) ? imageSize : MAX_FLASH_MEMORY;
+}
+
+/// <summary>
+/// The text dumps are named for when they were written, a few seconds after their
+/// images, so a dump is taken to be of the image at the same place in the sorted lists
+/// when both names start with the same day. Each is checked against the text export.
+/// </summary>
+static void VerifyTextExport(BenchCorpus & r_Corpus)
+{
+    vector<uchar> theDump;
+    vector<uchar> theExport;
+
+    r_Corpus.textVerified   = static_cast<ulong>(0);
+    r_Corpus.textMismatched = static_cast<ulong>(0);
+
+    if (r_Corpus.textNames.size() != r_Corpus.imageNames.size())
+    {
+        return;
+    }
+
+    for (size_t thisImage = 0; thisImage < r_Corpus.imageNames.size(); thisImage++)
+    {
+        string imageDay = GetBaseFileName(r_Corpus.imageNames[thisImage]).substr(0, 7);
+        string textDay  = GetBaseFileName(r_Corpus.textNames[thisImage]).substr(0, 7);
+
+        if (imageDay != textDay || false == ReadWholeFile(r_Corpus.textNames[thisImage].c_str(), theDump))
+        {
+            continue;
+        }
+
+        if (true == WriteFlashImageTextFile(r_Corpus.theImages[thisImage].data(), GetTextDumpSize(r_Corpus, thisImage), r_Corpus.scratchTextName.c_str()) &&
+            true == ReadWholeFile(r_Corpus.scratchTextName.c_str(), theExport) &&
+            theExport == theDump)
+        {
+            r_Corpus.textVerified++;
+        }
+        else
+        {
+            r_Corpus.textMismatched++;
+
+            (void)printf("Warning: the text export of %s does not match %s\n",
+                r_Corpus.imageNames[thisImage].c_str(),
+                r_Corpus.textNames[thisImage].c_str());
+        }
+    }
+}
+
+/// <summary>
+/// Reads the corpus in to memory, decodes each image in to its sample store and tiles
+/// the images for the scale-up
+/// </summary>
+static bool LoadBenchCorpus(const string & r_CorpusDirectory, ulong scaleImages, BenchCorpus & r_Corpus)
+{
+    CollectInputFileNames(r_CorpusDirectory.c_str(), BATCH_INPUT_FILE_PATTERN, r_Corpus.imageNames);
+    CollectInputFileNames(r_CorpusDirectory.c_str(), BENCH_TEXT_INPUT_PATTERN, r_Corpus.textNames);
+    CollectInputFileNames(r_CorpusDirectory.c_str(), BENCH_CSV_INPUT_PATTERN, r_Corpus.csvNames);
+
+    r_Corpus.imageOctets     = 0;
+    r_Corpus.dataOctets      = 0;
+    r_Corpus.textOctets      = 0;
+    r_Corpus.sampleTotal     = 0;
+    r_Corpus.csvOctets       = 0;
+    r_Corpus.tiledDataOctets = 0;
+
+    for (size_t thisImage = 0; thisImage < r_Corpus.imageNames.size(); thisImage++)
+    {
+        vector<uchar>     theImage;
+        FlashImageSummary theSummary;
+
+        if (false == ReadWholeFile(r_Corpus.imageNames[thisImage].c_str(), theImage))
+        {
+            (void)printf("Error: I was unable to read file: %s\n", r_Corpus.imageNames[thisImage].c_str());
+            return false;
+        }
+
+        r_Corpus.theStores.push_back(SampleStore());
+
+        (void)DecodeFlashImage(theImage.data(), static_cast<ulong>(theImage.size()), nullptr, &r_Corpus.theStores.back(), theSummary);
+
+        r_Corpus.imageSamples.push_back(CountImageSamples(theImage.data(), static_cast<ulong>(theImage.size())));
+        r_Corpus.imageDataOctets.push_back(FindEndOfHistoryData(theImage.data(), static_cast<ulong>(theImage.size())));
+        r_Corpus.imageOctets += theImage.size();
+        r_Corpus.dataOctets  += r_Corpus.imageDataOctets.back();
+        r_Corpus.sampleTotal += r_Corpus.imageSamples.back();
+        r_Corpus.theImages.push_back(move(theImage));
+    }
+
+    for (size_t thisFile = 0; thisFile < r_Corpus.csvNames.size(); thisFile++)
+    {
+        vector<uchar> theContents;
+
+        if (true == ReadWholeFile(r_Corpus.csvNames[thisFile].c_str(), theContents))
+        {
+            r_Corpus.csvOctets += theContents.size();
+        }
+    }
+
+    if (r_Corpus.theImages.empty())
+    {
+        return false;
+    }
+
+    // Copies rather than references, so the scale-up is read from memory and not from cache
+    r_Corpus.tiledOffsets.push_back(0);
+
+    for (ulong thisTile = 0; thisTile < scaleImages; thisTile++)
+    {
+        const vector<uchar> & r_Image = r_Corpus.theImages[thisTile % r_Corpus.theImages.size()];
+
+        r_Corpus.tiledImages.insert(r_Corpus.tiledImages.end(), r_Image.begin(), r_Image.end());
+        r_Corpus.tiledOffsets.push_back(r_Corpus.tiledImages.size());
+        r_Corpus.tiledDataOctets += r_Corpus.imageDataOctets[thisTile % r_Corpus.theImages.size()];
+    }
+
+    for (size_t thisImage = 0; thisImage < r_Corpus.theImages.size(); thisImage++)
+    {
+        r_Corpus.textOctets += GetTextDumpSize(r_Corpus, thisImage);
+    }
+
+    VerifyTextExport(r_Corpus);
+
+    return true;
+}
+
+/// <summary>
+/// Walks the frames of every image
+/// </summary>
+static unsigned long long BenchFrameDecode(BenchCorpus & r_Corpus, unsigned long long & r_Octets)
+{
+    unsigned long long sampleCount = 0;
+
+    for (size_t thisImage = 0; thisImage < r_Corpus.theImages.size(); thisImage++)
+    {
+        sampleCount += CountImageSamples(r_Corpus.theImages[thisImage].data(), static_cast<ulong>(r_Corpus.theImages[thisImage].size()));
+    }
+
+    r_Octets = r_Corpus.dataOctets;
+
+    return sampleCount;
+}
+
+/// <summary>
+/// Exports every image as a comma-delimited file
+/// </summary>
+static unsigned long long BenchCSVExport(BenchCorpus & r_Corpus, unsigned long long & r_Octets)
+{
+    FlashImageSummary theSummary;
+
+    for (size_t thisImage = 0; thisImage < r_Corpus.theImages.size(); thisImage++)
+    {
+        (void)DecodeFlashImage(r_Corpus.theImages[thisImage].data(),
+            static_cast<ulong>(r_Corpus.theImages[thisImage].size()),
+            r_Corpus.scratchCSVName.c_str(),
+            nullptr,
+            theSummary);
+    }
+
+    r_Octets = r_Corpus.dataOctets;
+
+    return r_Corpus.sampleTotal;
+}
+
+/// <summary>
+/// Exports every image as a text dump
+/// </summary>
+static unsigned long long BenchTextExport(BenchCorpus & r_Corpus, unsigned long long & r_Octets)
+{
+    for (size_t thisImage = 0; thisImage < r_Corpus.theImages.size(); thisImage++)
+    {
+        (void)WriteFlashImageTextFile(r_Corpus.theImages[thisImage].data(),
+            GetTextDumpSize(r_Corpus, thisImage),
+            r_Corpus.scratchTextName.c_str());
+    }
+
+    r_Octets = r_Corpus.textOctets;
+
+    return r_Corpus.sampleTotal;
+}
+
+/// <summary>
+/// The lowest, highest and average value of every decoded image
+/// </summary>
+static unsigned long long BenchMinimumMaximumAverage(BenchCorpus & r_Corpus, unsigned long long & r_Octets)
+{
+    unsigned long long sampleCount = 0;
+    unsigned long long theChecksum = 0;
+
+    for (size_t thisStore = 0; thisStore < r_Corpus.theStores.size(); thisStore++)
+    {
+        CountSpan theSpan = GetCountSpan(r_Corpus.theStores[thisStore]);
+
+        if (theSpan.length > static_cast<ulong>(0))
+        {
+            theChecksum += MinimumOfCountSpan(theSpan) + MaximumOfCountSpan(theSpan) + (SumCountSpan(theSpan) / theSpan.length);
+        }
+
+        sampleCount += theSpan.length;
+    }
+
+    // Keeps the compiler from deciding the results are not needed
+    if (theChecksum == 1)
+    {
+        (void)printf(" ");
+    }
+
+    r_Octets = r_Corpus.dataOctets;
+
+    return sampleCount;
+}
+
+/// <summary>
+/// The scan for high periods, which runs the anomaly detector over every decoded image
+/// and merges the super high alerts in to events
+/// </summary>
+static unsigned long long BenchHighPeriodScan(BenchCorpus & r_Corpus, unsigned long long & r_Octets)
+{
+    unsigned long long     sampleCount = 0;
+    vector<SuperHighEvent> theEvents;
+
+    for (size_t thisStore = 0; thisStore < r_Corpus.theStores.size(); thisStore++)
+    {
+        const SampleStore & r_Store = r_Corpus.theStores[thisStore];
+
+        (void)ExtractSuperHighEvents(r_Store.epochSeconds,
+            r_Store.counts,
+            ANOMALY_ALERT_SIGMA,
+            EVENT_CONTEXT_MINUTES * 60,
+            nullptr,
+            nullptr,
+            theEvents);
+
+        sampleCount += r_Store.counts.size();
+    }
+
+    r_Octets = r_Corpus.dataOctets;
+
+    return sampleCount;
+}
+
+/// <summary>
+/// Reads every comma-delimited file back in to a sample store
+/// </summary>
+static unsigned long long BenchCSVImport(BenchCorpus & r_Corpus, unsigned long long & r_Octets)
+{
+    unsigned long long sampleCount = 0;
+    SampleStore        theStore;
+
+    for (size_t thisFile = 0; thisFile < r_Corpus.csvNames.size(); thisFile++)
+    {
+        if (true == ReadCSVSampleFile(r_Corpus.csvNames[thisFile].c_str(), theStore))
+        {
+            sampleCount += theStore.counts.size();
+        }
+    }
+
+    r_Octets = r_Corpus.csvOctets;
+
+    return sampleCount;
+}
+
+/// <summary>
+/// Decodes every tiled image with its lowest, highest and average values, each thread
+/// taking the next image that nobody has claimed, as the batch decoder does
+/// </summary>
+static unsigned long long BenchScaleUp(BenchCorpus & r_Corpus, unsigned long long & r_Octets)
+{
+    size_t                     tileCount = r_Corpus.tiledOffsets.size() - 1;
+    atomic<size_t>             nextTile(0);
+    atomic<unsigned long long> sampleCount(0);
+    vector<thread>             workerThreads;
+
+    for (ulong thisThread = 0; thisThread < r_Corpus.threadCount; thisThread++)
+    {
+        workerThreads.push_back(thread([&r_Corpus, &nextTile, &sampleCount, tileCount]()
+        {
+            FlashImageSummary theSummary;
+            size_t            thisTile;
+
+            while ((thisTile = nextTile++) < tileCount)
+            {
+                (void)DecodeFlashImage(&r_Corpus.tiledImages[r_Corpus.tiledOffsets[thisTile]],
+                    static_cast<ulong>(r_Corpus.tiledOffsets[thisTile + 1] - r_Corpus.tiledOffsets[thisTile]),
+                    nullptr,
+                    nullptr,
+                    theSummary);
+
+                sampleCount += r_Corpus.imageSamples[thisTile % r_Corpus.theImages.size()];
+            }
+        }));
+    }
+
+    for (size_t thisThread = 0; thisThread < workerThreads.size(); thisThread++)
+    {
+        workerThreads[thisThread].join();
+    }
+
+    r_Octets = r_Corpus.tiledDataOctets;
+
+    return sampleCount.load();
+}
+
+/// <summary>
+/// Runs a benchmark over the corpus until it has taken at least the minimum time and
+/// the minimum number of passes
+/// </summary>
+static BenchResult TimeBenchmark(const char * pch_BenchName,
+    BenchPassFunction pPass,
+    BenchCorpus & r_Corpus,
+    double minimumSeconds)
+{
+    BenchResult theResult;
+    double      totalSeconds = 0.0;
+
+    theResult.benchName   = pch_BenchName;
+    theResult.passCount   = static_cast<ulong>(0);
+    theResult.passOctets  = 0;
+    theResult.passSamples = 0;
+    theResult.bestSeconds = 0.0;
+
+    while (theResult.passCount < BENCH_MINIMUM_PASSES || totalSeconds < minimumSeconds)
+    {
+        double startTime = GetBenchSeconds();
+
+        theResult.passSamples = pPass(r_Corpus, theResult.passOctets);
+
+        double passSeconds = GetBenchSeconds() - startTime;
+
+        if (theResult.passCount == static_cast<ulong>(0) || passSeconds < theResult.bestSeconds)
+        {
+            theResult.bestSeconds = passSeconds;
+        }
+
+        totalSeconds += passSeconds;
+        theResult.passCount++;
+    }
+
+    theResult.meanSeconds        = totalSeconds / static_cast<double>(theResult.passCount);
+    theResult.megabytesPerSecond = (theResult.bestSeconds > 0.0) ? static_cast<double>(theResult.passOctets) / theResult.bestSeconds / 1e6 : 0.0;
+    theResult.samplesPerSecond   = (theResult.bestSeconds > 0.0) ? static_cast<double>(theResult.passSamples) / theResult.bestSeconds : 0.0;
+
+    (void)printf("%-20s %7lu %12.6f %12.6f %12.1f %16.0f\n",
+        pch_BenchName,
+        theResult.passCount,
+        theResult.bestSeconds,
+        theResult.meanSeconds,
+        theResult.megabytesPerSecond,
+        theResult.samplesPerSecond);
+
+    return theResult;
+}
+
+/// <summary>
+/// Writes a string as JSON, quoted with its quotes and back slashes escaped
+/// </summary>
+static void WriteJSONString(FILE * pOutputFile, const string & r_Text)
+{
+    (void)fputc('"', pOutputFile);
+
+    for (size_t thisCharacter = 0; thisCharacter < r_Text.size(); thisCharacter++)
+    {
+        if (r_Text[thisCharacter] == '"' || r_Text[thisCharacter] == '\\')
+        {
+            (void)fputc('\\', pOutputFile);
+        }
+
+        (void)fputc(r_Text[thisCharacter], pOutputFile);
+    }
+
+    (void)fputc('"', pOutputFile);
+}
+
+/// <summary>
+/// Writes the results as JSON, under a temporary name which replaces the file only once
+/// it is complete
+/// </summary>
+static bool WriteBenchResults(const char * pch_FileName,
+    const string & r_CorpusDirectory,
+    const BenchCorpus & r_Corpus,
+    const vector<BenchResult> & r_Results)
+{
+    FILE * pOutputFile            = nullptr;
+    char   temporaryFileName[301] = { 0 };
+    char   timeStamp[31]          = { 0 };
+
+    FormatHarvestTimeStamp(timeStamp, sizeof(timeStamp));
+    BuildTemporaryFileName(pch_FileName, temporaryFileName, sizeof(temporaryFileName));
+
+    if (0 != fopen_s(&pOutputFile, temporaryFileName, "w"))
+    {
+        return false;
+    }
+
+    (void)fprintf(pOutputFile, "{\n  \"timeStamp\": \"%s\",\n  \"frameScanner\": ", timeStamp);
+    WriteJSONString(pOutputFile, GetFrameScannerName());
+    (void)fprintf(pOutputFile, ",\n  \"threads\": %lu,\n  \"corpus\": {\n    \"directory\": ", r_Corpus.threadCount);
+    WriteJSONString(pOutputFile, r_CorpusDirectory);
+    (void)fprintf(pOutputFile, ",\n    \"images\": %lu,\n    \"imageOctets\": %llu,\n    \"dataOctets\": %llu,\n    \"samples\": %llu,\n",
+        static_cast<ulong>(r_Corpus.theImages.size()), r_Corpus.imageOctets, r_Corpus.dataOctets, r_Corpus.sampleTotal);
+    (void)fprintf(pOutputFile, "    \"textFiles\": %lu,\n    \"textVerified\": %lu,\n    \"textMismatched\": %lu,\n",
+        static_cast<ulong>(r_Corpus.textNames.size()), r_Corpus.textVerified, r_Corpus.textMismatched);
+    (void)fprintf(pOutputFile, "    \"csvFiles\": %lu,\n    \"csvOctets\": %llu,\n    \"scaleImages\": %lu\n  },\n  \"benchmarks\": [\n",
+        static_cast<ulong>(r_Corpus.csvNames.size()), r_Corpus.csvOctets, static_cast<ulong>(r_Corpus.tiledOffsets.size() - 1));
+
+    for (size_t thisResult = 0; thisResult < r_Results.size(); thisResult++)
+    {
+        const BenchResult & r_Result = r_Results[thisResult];
+
+        (void)fputs("    { \"name\": ", pOutputFile);
+        WriteJSONString(pOutputFile, r_Result.benchName);
+        (void)fprintf(pOutputFile, ", \"passes\": %lu, \"octets\": %llu, \"samples\": %llu, \"bestSeconds\": %.9f, \"meanSeconds\": %.9f, "
+            "\"megabytesPerSecond\": %.3f, \"samplesPerSecond\": %.1f }%s\n",
+            r_Result.passCount,
+            r_Result.passOctets,
+            r_Result.passSamples,
+            r_Result.bestSeconds,
+            r_Result.meanSeconds,
+            r_Result.megabytesPerSecond,
+            r_Result.samplesPerSecond,
+            (thisResult + 1 < r_Results.size()) ? "," : "");
+    }
+
+    (void)fputs("  ]\n}\n", pOutputFile);
+
+    bool wasWritten = (0 == ferror(pOutputFile));
+
+    wasWritten = (0 == fclose(pOutputFile)) && wasWritten;
+
+    if (false == wasWritten || false == CommitFileAtomically(temporaryFileName, pch_FileName))
+    {
+        (void)remove(temporaryFileName);
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Finds a member of the JSON object which starts at the text passed by argument and
+/// returns its number. Only the results which WriteBenchResults() writes are expected,
+/// so this looks for the member's name rather than parsing JSON in general.
+/// </summary>
+static double GetJSONNumber(const char * pch_Object, const char * pch_ObjectEnd, const char * pch_MemberName)
+{
+    string       theKey  = string("\"") + pch_MemberName + "\":";
+    const char * pch_Key = strstr(pch_Object, theKey.c_str());
+
+    if (nullptr == pch_Key || pch_Key > pch_ObjectEnd)
+    {
+        return 0.0;
+    }
+
+    return strtod(pch_Key + theKey.size(), nullptr);
+}
+
+/// <summary>
+/// Reads the benchmarks back from a file written by a run of the benchmarks
+/// </summary>
+/// <param name="pch_FileName">The JSON results</param>
+/// <param name="r_Results">Returns each benchmark found</param>
+/// <returns>true if the file was read and held at least one benchmark, otherwise false</returns>
+bool ReadBenchResults(const char * pch_FileName, vector<BenchResult> & r_Results)
+{
+    vector<uchar> theContents;
+
+    r_Results.clear();
+
+    if (false == ReadWholeFile(pch_FileName, theContents))
+    {
+        return false;
+    }
+
+    theContents.push_back(0x00);
+
+    const char * pch_Next = reinterpret_cast<const char *>(theContents.data());
+
+    while (nullptr != (pch_Next = strstr(pch_Next, "{ \"name\": \"")))
+    {
+        const char * pch_Name      = pch_Next + strlen("{ \"name\": \"");
+        const char * pch_NameEnd   = strchr(pch_Name, '"');
+        const char * pch_ObjectEnd = strchr(pch_Name, '}');
+        BenchResult  theResult;
+
+        if (nullptr == pch_NameEnd || nullptr == pch_ObjectEnd)
+        {
+            break;
+        }
+
+        theResult.benchName          = string(pch_Name, pch_NameEnd);
+        theResult.passCount          = static_cast<ulong>(GetJSONNumber(pch_Name, pch_ObjectEnd, "passes"));
+        theResult.passOctets         = static_cast<unsigned long long>(GetJSONNumber(pch_Name, pch_ObjectEnd, "octets"));
+        theResult.passSamples        = static_cast<unsigned long long>(GetJSONNumber(pch_Name, pch_ObjectEnd, "samples"));
+        theResult.bestSeconds        = GetJSONNumber(pch_Name, pch_ObjectEnd, "bestSeconds");
+        theResult.meanSeconds        = GetJSONNumber(pch_Name, pch_ObjectEnd, "meanSeconds");
+        theResult.megabytesPerSecond = GetJSONNumber(pch_Name, pch_ObjectEnd, "megabytesPerSecond");
+        theResult.samplesPerSecond   = GetJSONNumber(pch_Name, pch_ObjectEnd, "samplesPerSecond");
+
+        r_Results.push_back(theResult);
+
+        pch_Next = pch_ObjectEnd;
+    }
+
+    return (false == r_Results.empty());
+}
+
+/// <summary>
+/// Displays how each benchmark of the baseline did in the current run. The throughput
+/// compared is megabytes per second, which for the same corpus goes with values per
+/// second, so a benchmark is a regression when that fell by more than the tolerance.
+/// A benchmark which is missing from the current run is counted as a regression too.
+/// </summary>
+/// <param name="r_Baseline">The results to compare against</param>
+/// <param name="r_Current">The results being judged</param>
+/// <param name="tolerancePercent">How much slower a benchmark may get</param>
+/// <returns>The number of regressions</returns>
+ulong CompareBenchResults(const vector<BenchResult> & r_Baseline,
+    const vector<BenchResult> & r_Current,
+    double tolerancePercent)
+{
+    ulong regressionCount = static_cast<ulong>(0);
+
+    (void)printf("\nBenchmark            Baseline MB/s  Current MB/s   Change\n");
+
+    for (size_t thisBaseline = 0; thisBaseline < r_Baseline.size(); thisBaseline++)
+    {
+        const BenchResult & r_Before = r_Baseline[thisBaseline];
+        const BenchResult * pAfter   = nullptr;
+
+        for (size_t thisCurrent = 0; thisCurrent < r_Current.size() && nullptr == pAfter; thisCurrent++)
+        {
+            if (r_Current[thisCurrent].benchName == r_Before.benchName)
+            {
+                pAfter = &r_Current[thisCurrent];
+            }
+        }
+
+        if (nullptr == pAfter)
+        {
+            (void)printf("%-20s %13.1f  %12s  %7s  REGRESSION, missing\n", r_Before.benchName.c_str(), r_Before.megabytesPerSecond, "-", "-");
+
+            regressionCount++;
+            continue;
+        }
+
+        double theChange = (r_Before.megabytesPerSecond > 0.0)
+            ? ((pAfter->megabytesPerSecond - r_Before.megabytesPerSecond) * 100.0 / r_Before.megabytesPerSecond)
+            : 0.0;
+
+        bool isRegression = (theChange < -tolerancePercent);
+
+        (void)printf("%-20s %13.1f  %12.1f  %+6.1f%%%s\n",
+            r_Before.benchName.c_str(),
+            r_Before.megabytesPerSecond,
+            pAfter->megabytesPerSecond,
+            theChange,
+            (true == isRegression) ? "  REGRESSION" : "");
+
+        if (true == isRegression)
+        {
+            regressionCount++;
+        }
+    }
+
+    (void)printf("%lu regressions beyond %.1f%%\n", regressionCount, tolerancePercent);
+
+    return regressionCount;
+}
+
+/// <summary>
+/// Displays how the benchmarks are used
+/// </summary>
+static void DisplayBenchUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -bench [corpus directory] [-seconds <minimum>] [-scale <images>] [-threads <count>]\n");
+    (void)printf("       [-json <file>] [-baseline <file>] [-tolerance <percent>]\n");
+    (void)printf("       ReadGeiger -bench -compare <baseline file> <current file> [-tolerance <percent>]\n");
+    (void)printf("  The corpus is the *.%s, *.%s and *.%s files in the directory,\n",
+        DATA_OUTPUT_FILE_NAME, DATA_OUTPUT_ASCII_FILE_NAME, DATA_OUTPUT_CSV_FILE_NAME);
+    (void)printf("  the current directory unless given. Results are written as JSON to <timestamp>.%s\n", DATA_OUTPUT_BENCH_FILE_NAME);
+    (void)printf("  unless -json is given, and compared with -baseline if it is given. A benchmark whose\n");
+    (void)printf("  megabytes per second fell by more than %.0f%%, or -tolerance, is a regression.\n", BENCH_DEFAULT_TOLERANCE_PERCENT);
+}
+
+/// <summary>
+/// The entry point for the benchmarks. Either the benchmarks are run over the corpus
+/// and the results written, and compared with a baseline if one is given, or two
+/// results files are compared.
+/// </summary>
+/// <param name="argc">The number of arguments following "-bench"</param>
+/// <param name="argv">The arguments following "-bench"</param>
+/// <returns>0 if there were no regressions, otherwise 1</returns>
+int RunBenchmark(int argc, char * argv[])
+{
+    BenchCorpus         theCorpus;
+    vector<BenchResult> theResults;
+    vector<BenchResult> baselineResults;
+    string              corpusDirectory  = ".";
+    string              jsonFileName;
+    string              baselineFileName;
+    string              currentFileName;
+    double              minimumSeconds   = BENCH_DEFAULT_MINIMUM_SECONDS;
+    double              tolerancePercent = BENCH_DEFAULT_TOLERANCE_PERCENT;
+    ulong               scaleImages      = BENCH_DEFAULT_SCALE_IMAGES;
+    bool                compareOnly      = false;
+
+    theCorpus.threadCount = static_cast<ulong>(thread::hardware_concurrency());
+
+    for (int thisArgument = 0; thisArgument < argc; thisArgument++)
+    {
+        if (0 == strcmp(argv[thisArgument], "-seconds") && thisArgument + 1 < argc)
+        {
+            minimumSeconds = strtod(argv[++thisArgument], nullptr);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-scale") && thisArgument + 1 < argc)
+        {
+            scaleImages = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-threads") && thisArgument + 1 < argc)
+        {
+            theCorpus.threadCount = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-json") && thisArgument + 1 < argc)
+        {
+            jsonFileName = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-baseline") && thisArgument + 1 < argc)
+        {
+            baselineFileName = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-tolerance") && thisArgument + 1 < argc)
+        {
+            tolerancePercent = strtod(argv[++thisArgument], nullptr);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-compare") && thisArgument + 2 < argc)
+        {
+            baselineFileName = argv[++thisArgument];
+            currentFileName  = argv[++thisArgument];
+            compareOnly      = true;
+        }
+        else
+        {
+            corpusDirectory = argv[thisArgument];
+        }
+    }
+
+    if (false == baselineFileName.empty() && false == ReadBenchResults(baselineFileName.c_str(), baselineResults))
+    {
+        DisplayBenchUsage();
+        (void)printf("Error: I was unable to read the results in file: %s\n", baselineFileName.c_str());
+        return 1;
+    }
+
+    if (true == compareOnly)
+    {
+        if (false == ReadBenchResults(currentFileName.c_str(), theResults))
+        {
+            (void)printf("Error: I was unable to read the results in file: %s\n", currentFileName.c_str());
+            return 1;
+        }
+
+        return (CompareBenchResults(baselineResults, theResults, tolerancePercent) == static_cast<ulong>(0)) ? 0 : 1;
+    }
+
+    if (theCorpus.threadCount == static_cast<ulong>(0))
+    {
+        theCorpus.threadCount = static_cast<ulong>(1);
+    }
+
+    if (jsonFileName.empty())
+    {
+        char timeStamp[31] = { 0 };
+
+        FormatHarvestTimeStamp(timeStamp, sizeof(timeStamp));
+
+        jsonFileName = string(timeStamp) + "." + DATA_OUTPUT_BENCH_FILE_NAME;
+    }
+
+    theCorpus.scratchCSVName  = jsonFileName + ".scratch." + DATA_OUTPUT_CSV_FILE_NAME;
+    theCorpus.scratchTextName = jsonFileName + ".scratch." + DATA_OUTPUT_ASCII_FILE_NAME;
+
+    if (false == LoadBenchCorpus(corpusDirectory, scaleImages, theCorpus))
+    {
+        DisplayBenchUsage();
+        (void)printf("There were no FLASH images found in: %s\n", corpusDirectory.c_str());
+        return 1;
+    }
+
+    (void)printf("Corpus: %lu images of %llu octets, %llu of them history data, and %llu values, %lu text dumps (%lu match the text export), %lu comma-delimited files\n",
+        static_cast<ulong>(theCorpus.theImages.size()),
+        theCorpus.imageOctets,
+        theCorpus.dataOctets,
+        theCorpus.sampleTotal,
+        static_cast<ulong>(theCorpus.textNames.size()),
+        theCorpus.textVerified,
+        static_cast<ulong>(theCorpus.csvNames.size()));
+
+    (void)printf("\nBenchmark             Passes    Best (s)     Mean (s)         MB/s         Values/s\n");
+
+    theResults.push_back(TimeBenchmark("frame_decode",     BenchFrameDecode,           theCorpus, minimumSeconds));
+    theResults.push_back(TimeBenchmark("csv_export",       BenchCSVExport,             theCorpus, minimumSeconds));
+    theResults.push_back(TimeBenchmark("text_export",      BenchTextExport,            theCorpus, minimumSeconds));
+    theResults.push_back(TimeBenchmark("min_max_average",  BenchMinimumMaximumAverage, theCorpus, minimumSeconds));
+    theResults.push_back(TimeBenchmark("high_period_scan", BenchHighPeriodScan,        theCorpus, minimumSeconds));
+
+    if (false == theCorpus.csvNames.empty())
+    {
+        theResults.push_back(TimeBenchmark("csv_import", BenchCSVImport, theCorpus, minimumSeconds));
+    }
+
+    if (scaleImages > static_cast<ulong>(0))
+    {
+        theResults.push_back(TimeBenchmark("scale_up", BenchScaleUp, theCorpus, minimumSeconds));
+    }
+
+    (void)remove(theCorpus.scratchCSVName.c_str());
+    (void)remove(theCorpus.scratchTextName.c_str());
+
+    if (false == WriteBenchResults(jsonFileName.c_str(), corpusDirectory, theCorpus, theResults))
+    {
+        (void)printf("Error: I was unable to create file: %s\n", jsonFileName.c_str());
+        return 1;
+    }
+
+    (void)printf("The results are in %s\n", jsonFileName.c_str());
+
+    if (false == baselineResults.empty())
+    {
+        return (CompareBenchResults(baselineResults, theResults, tolerancePercent) == static_cast<ulong>(0)) ? 0 : 1;
+    }
+
+    return (theCorpus.textMismatched == static_cast<ulong>(0)) ? 0 : 1;
+}
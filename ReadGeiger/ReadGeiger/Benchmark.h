@@ -0,0 +1,53 @@
+// ----------------------------------------------------------------------
+// Benchmark.h
+//
+// Measures what the program spends its time on using the FLASH images,
+// text dumps and comma-delimited files checked in beside it as a fixed
+// corpus: decoding the frames, exporting the comma-delimited and text
+// files, the lowest, highest and average values, the scan for high
+// periods and reading comma-delimited files back in. The corpus is
+// also tiled to thousands of images and decoded by every thread to see
+// how it scales.
+//
+// Each benchmark is run over the whole corpus again and again for at
+// least a minimum time and the quickest pass is reported, as megabytes
+// and values per second, in a JSON file. Two such files may be compared
+// and each benchmark which got slower by more than a tolerance is
+// flagged as a regression.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Portable.h"
+
+// Each benchmark runs for at least this many seconds and at least this many passes
+#define BENCH_DEFAULT_MINIMUM_SECONDS   0.5
+#define BENCH_MINIMUM_PASSES            static_cast<ulong>(3)
+
+// The images the corpus is tiled to for the scale-up
+#define BENCH_DEFAULT_SCALE_IMAGES      static_cast<ulong>(2000)
+
+// How much slower than the baseline a benchmark may get before it is a regression
+#define BENCH_DEFAULT_TOLERANCE_PERCENT 10.0
+
+typedef struct bench_result_t
+{
+    std::string        benchName;           // What was measured
+    ulong              passCount;           // The number of passes over the corpus
+    unsigned long long passOctets;          // The octets of input each pass reads
+    unsigned long long passSamples;         // The CPS/CPM/CPH values each pass handles
+    double             bestSeconds;         // The quickest pass
+    double             meanSeconds;         // The average pass
+    double             megabytesPerSecond;  // passOctets over the quickest pass, in millions of octets
+    double             samplesPerSecond;    // passSamples over the quickest pass
+} BenchResult;
+
+extern bool ReadBenchResults(const char * pch_FileName, std::vector<BenchResult> & r_Results);
+extern ulong CompareBenchResults(const std::vector<BenchResult> & r_Baseline,
+    const std::vector<BenchResult> & r_Current,
+    double tolerancePercent);
+
+extern int RunBenchmark(int argc, char * argv[]);
@@ -0,0 +1,944 @@
+// ----------------------------------------------------------------------
+// DailyStats.cpp
+//
+// The worker threads each take the next dump that nobody has claimed,
+// the same as the batch decoder does, and sketch it in to a set of
+// sketches of their own, so that no sketch is shared between threads.
+// Before a dump can be sketched it needs to know what the device's
+// earlier dumps covered, so each dump hands on what is covered once its
+// own spans are added as soon as it has been decoded; since the dumps
+// are claimed oldest first, the one being waited for has always been
+// claimed already. A dump's spans are those of its date/time stamped
+// segments, so a clock which was set wrong for one segment does not
+// make the dump look as if it covers everything in between.
+//
+// The store file is written as
+//
+//   STATS_FILE_MAGIC, the number of devices, then for each device its
+//   serial number, the spans of time it is covered over, the names of
+//   its dumps and its days, each day being the day number, the totals
+//   and the two arrays of counts
+//
+// with each string and array preceded by its length, all little endian.
+// A STATS_FILE_MAGIC_V1 store has the time it is covered to in place of
+// the spans, which is read as a single span from the start of its first
+// day.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "DailyStats.h"
+#include "ArchiveStore.h"
+#include "BatchDecode.h"
+#include "QueryEngine.h"
+#include "ReadGeiger.h"
+#include "SampleStore.h"
+#include "SeriesFile.h"
+
+using namespace std;
+
+// Earlier and later than any history which the device can hold
+#define STATS_EARLIEST_EPOCH    (-(1LL << 62))
+#define STATS_LATEST_EPOCH      (1LL << 62)
+
+typedef map<string, map<long long, StatsSketch>> StatsPartial;
+
+typedef struct stats_work_t
+{
+    ArchiveInput       theInput;        // The dump to take in
+    long               previousWork;    // The same device's dump before this one, or -1 for none
+    vector<StatsRange> startRanges;     // What the device's store covers, for the device's first dump
+    vector<StatsRange> coveredRanges;   // What the device's history covers once this dump is taken in
+    bool               isCovered;       // true once coveredRanges has been worked out
+    bool               wasSuccessful;   // true if the dump was decoded
+    unsigned long long addedCount;      // The number of values it added
+} StatsWork;
+
+/// <summary>
+/// Empties a sketch
+/// </summary>
+/// <param name="r_Sketch">The sketch to empty</param>
+void ResetStatsSketch(StatsSketch & r_Sketch)
+{
+    r_Sketch.sampleCount  = 0;
+    r_Sketch.countTotal   = 0;
+    r_Sketch.lowestCount  = 0;
+    r_Sketch.highestCount = 0;
+
+    r_Sketch.exactCounts.clear();
+    r_Sketch.tailCounts.clear();
+}
+
+/// <summary>
+/// Which tail bucket a value at or above STATS_EXACT_LIMIT is counted in. The buckets
+/// for each power of 2 split it in to STATS_TAIL_STEPS.
+/// </summary>
+static size_t GetStatsTailBucket(uint32_t countValue)
+{
+    ulong topBit = static_cast<ulong>(STATS_EXACT_BITS);
+
+    while (topBit < 31 && (countValue >> (topBit + 1)) != 0)
+    {
+        topBit++;
+    }
+
+    ulong theStep = (countValue >> (topBit - STATS_TAIL_BITS)) & (STATS_TAIL_STEPS - 1);
+
+    return static_cast<size_t>(((topBit - STATS_EXACT_BITS) * STATS_TAIL_STEPS) + theStep);
+}
+
+/// <summary>
+/// The middle of the values which a tail bucket counts
+/// </summary>
+static double GetStatsTailValue(size_t whichBucket)
+{
+    ulong  topBit    = static_cast<ulong>(whichBucket / STATS_TAIL_STEPS) + STATS_EXACT_BITS;
+    ulong  theStep   = static_cast<ulong>(whichBucket % STATS_TAIL_STEPS);
+    double theWidth  = static_cast<double>(1ULL << (topBit - STATS_TAIL_BITS));
+    double lowestOne = static_cast<double>(STATS_TAIL_STEPS + theStep) * theWidth;
+
+    return lowestOne + ((theWidth - 1.0) / 2.0);
+}
+
+/// <summary>
+/// Counts one value in to a sketch
+/// </summary>
+/// <param name="r_Sketch">The sketch</param>
+/// <param name="countValue">The CPS/CPM/CPH value</param>
+void AddStatsValue(StatsSketch & r_Sketch, uint32_t countValue)
+{
+    if (0 == r_Sketch.sampleCount || countValue < r_Sketch.lowestCount)
+    {
+        r_Sketch.lowestCount = countValue;
+    }
+
+    if (0 == r_Sketch.sampleCount || countValue > r_Sketch.highestCount)
+    {
+        r_Sketch.highestCount = countValue;
+    }
+
+    r_Sketch.sampleCount++;
+    r_Sketch.countTotal += countValue;
+
+    if (countValue < STATS_EXACT_LIMIT)
+    {
+        if (countValue >= r_Sketch.exactCounts.size())
+        {
+            r_Sketch.exactCounts.resize(static_cast<size_t>(countValue) + 1, 0);
+        }
+
+        r_Sketch.exactCounts[countValue]++;
+    }
+    else
+    {
+        size_t whichBucket = GetStatsTailBucket(countValue);
+
+        if (whichBucket >= r_Sketch.tailCounts.size())
+        {
+            r_Sketch.tailCounts.resize(whichBucket + 1, 0);
+        }
+
+        r_Sketch.tailCounts[whichBucket]++;
+    }
+}
+
+/// <summary>
+/// Adds one sketch in to another, which gives the same sketch as counting the values
+/// of both in to one
+/// </summary>
+/// <param name="r_Into">The sketch to add to</param>
+/// <param name="r_From">The sketch to add</param>
+void MergeStatsSketch(StatsSketch & r_Into, const StatsSketch & r_From)
+{
+    if (0 == r_From.sampleCount)
+    {
+        return;
+    }
+
+    if (0 == r_Into.sampleCount || r_From.lowestCount < r_Into.lowestCount)
+    {
+        r_Into.lowestCount = r_From.lowestCount;
+    }
+
+    if (0 == r_Into.sampleCount || r_From.highestCount > r_Into.highestCount)
+    {
+        r_Into.highestCount = r_From.highestCount;
+    }
+
+    r_Into.sampleCount += r_From.sampleCount;
+    r_Into.countTotal  += r_From.countTotal;
+
+    if (r_From.exactCounts.size() > r_Into.exactCounts.size())
+    {
+        r_Into.exactCounts.resize(r_From.exactCounts.size(), 0);
+    }
+
+    for (size_t thisValue = 0; thisValue < r_From.exactCounts.size(); thisValue++)
+    {
+        r_Into.exactCounts[thisValue] += r_From.exactCounts[thisValue];
+    }
+
+    if (r_From.tailCounts.size() > r_Into.tailCounts.size())
+    {
+        r_Into.tailCounts.resize(r_From.tailCounts.size(), 0);
+    }
+
+    for (size_t thisBucket = 0; thisBucket < r_From.tailCounts.size(); thisBucket++)
+    {
+        r_Into.tailCounts[thisBucket] += r_From.tailCounts[thisBucket];
+    }
+}
+
+/// <summary>
+/// Gets a percentile of the values in a sketch, as the value at that rank counting
+/// from the lowest
+/// </summary>
+/// <param name="r_Sketch">The sketch</param>
+/// <param name="thePercentile">From 0 to 100, such as 50 for the median</param>
+/// <returns>The value, exact below STATS_EXACT_LIMIT, or 0 for an empty sketch</returns>
+double GetStatsPercentile(const StatsSketch & r_Sketch, double thePercentile)
+{
+    if (0 == r_Sketch.sampleCount)
+    {
+        return 0.0;
+    }
+
+    // The rank of the value wanted, from 1 for the lowest
+    unsigned long long theRank   = static_cast<unsigned long long>((thePercentile / 100.0 * static_cast<double>(r_Sketch.sampleCount)) + 0.999999);
+    unsigned long long seenCount = 0;
+
+    // The ends are known exactly whichever bucket they fall in
+    if (theRank <= 1)
+    {
+        return static_cast<double>(r_Sketch.lowestCount);
+    }
+
+    if (theRank >= r_Sketch.sampleCount)
+    {
+        return static_cast<double>(r_Sketch.highestCount);
+    }
+
+    for (size_t thisValue = 0; thisValue < r_Sketch.exactCounts.size(); thisValue++)
+    {
+        seenCount += r_Sketch.exactCounts[thisValue];
+
+        if (seenCount >= theRank)
+        {
+            return static_cast<double>(thisValue);
+        }
+    }
+
+    for (size_t thisBucket = 0; thisBucket < r_Sketch.tailCounts.size(); thisBucket++)
+    {
+        seenCount += r_Sketch.tailCounts[thisBucket];
+
+        if (seenCount >= theRank)
+        {
+            double theValue = GetStatsTailValue(thisBucket);
+
+            // The bucket's middle may be beyond what was really seen
+            return (theValue > static_cast<double>(r_Sketch.highestCount)) ? static_cast<double>(r_Sketch.highestCount) : theValue;
+        }
+    }
+
+    return static_cast<double>(r_Sketch.highestCount);
+}
+
+/// <summary>
+/// Writes an item to the store file
+/// </summary>
+static bool WriteStatsItem(FILE * pStoreFile, const void * pItem, size_t itemLength)
+{
+    return (0 == itemLength) || (1 == fwrite(pItem, itemLength, 1, pStoreFile));
+}
+
+/// <summary>
+/// Reads an item from the store file
+/// </summary>
+static bool ReadStatsItem(FILE * pStoreFile, void * pItem, size_t itemLength)
+{
+    return (0 == itemLength) || (1 == fread(pItem, itemLength, 1, pStoreFile));
+}
+
+/// <summary>
+/// Writes a string to the store file, preceded by its length
+/// </summary>
+static bool WriteStatsString(FILE * pStoreFile, const string & r_Text)
+{
+    uint32_t textLength = static_cast<uint32_t>(r_Text.size());
+
+    return WriteStatsItem(pStoreFile, &textLength, sizeof(textLength))
+        && WriteStatsItem(pStoreFile, r_Text.data(), r_Text.size());
+}
+
+/// <summary>
+/// Reads a string written by WriteStatsString()
+/// </summary>
+static bool ReadStatsString(FILE * pStoreFile, string & r_Text)
+{
+    uint32_t textLength = 0;
+
+    if (false == ReadStatsItem(pStoreFile, &textLength, sizeof(textLength)) || textLength > 4096)
+    {
+        return false;
+    }
+
+    r_Text.resize(textLength);
+
+    return ReadStatsItem(pStoreFile, &r_Text[0], textLength);
+}
+
+/// <summary>
+/// Writes an array of counts to the store file, preceded by its length
+/// </summary>
+static bool WriteStatsCounts(FILE * pStoreFile, const vector<uint64_t> & r_Counts)
+{
+    uint32_t countLength = static_cast<uint32_t>(r_Counts.size());
+
+    return WriteStatsItem(pStoreFile, &countLength, sizeof(countLength))
+        && WriteStatsItem(pStoreFile, r_Counts.data(), r_Counts.size() * sizeof(uint64_t));
+}
+
+/// <summary>
+/// Reads an array of counts written by WriteStatsCounts()
+/// </summary>
+static bool ReadStatsCounts(FILE * pStoreFile, vector<uint64_t> & r_Counts, uint32_t largestLength)
+{
+    uint32_t countLength = 0;
+
+    if (false == ReadStatsItem(pStoreFile, &countLength, sizeof(countLength)) || countLength > largestLength)
+    {
+        return false;
+    }
+
+    r_Counts.resize(countLength);
+
+    return ReadStatsItem(pStoreFile, r_Counts.data(), static_cast<size_t>(countLength) * sizeof(uint64_t));
+}
+
+/// <summary>
+/// Reads the store file. A store file which does not exist yet is an empty store.
+/// </summary>
+/// <param name="pch_StoreFileName">The store file</param>
+/// <param name="r_Store">Returns what it holds</param>
+/// <returns>true if it was read or does not exist, false if it could not be read</returns>
+bool LoadStatsStore(const char * pch_StoreFileName, StatsStore & r_Store)
+{
+    FILE *   pStoreFile   = nullptr;
+    char     fileMagic[8] = { 0 };
+    uint32_t deviceCount  = 0;
+    bool     wasRead      = true;
+
+    r_Store.theDevices.clear();
+
+    if (0 != fopen_s(&pStoreFile, pch_StoreFileName, "rb"))
+    {
+        return true;
+    }
+
+    wasRead = ReadStatsItem(pStoreFile, fileMagic, sizeof(fileMagic))
+        && (0 == memcmp(fileMagic, STATS_FILE_MAGIC, sizeof(fileMagic)) || 0 == memcmp(fileMagic, STATS_FILE_MAGIC_V1, sizeof(fileMagic)))
+        && ReadStatsItem(pStoreFile, &deviceCount, sizeof(deviceCount));
+
+    bool isFirstVersion = (0 == memcmp(fileMagic, STATS_FILE_MAGIC_V1, sizeof(fileMagic)));
+
+    for (uint32_t thisDevice = 0; true == wasRead && thisDevice < deviceCount; thisDevice++)
+    {
+        StatsDevice theDevice;
+        int64_t     coveredEpoch = 0;
+        uint32_t    rangeCount   = 0;
+        uint32_t    fileCount    = 0;
+        uint32_t    dayCount     = 0;
+
+        wasRead = ReadStatsString(pStoreFile, theDevice.serialNumber);
+
+        if (true == isFirstVersion)
+        {
+            wasRead = wasRead && ReadStatsItem(pStoreFile, &coveredEpoch, sizeof(coveredEpoch));
+        }
+        else
+        {
+            wasRead = wasRead && ReadStatsItem(pStoreFile, &rangeCount, sizeof(rangeCount));
+
+            for (uint32_t thisRange = 0; true == wasRead && thisRange < rangeCount; thisRange++)
+            {
+                int64_t firstEpoch = 0;
+                int64_t lastEpoch  = 0;
+
+                wasRead = ReadStatsItem(pStoreFile, &firstEpoch, sizeof(firstEpoch))
+                    && ReadStatsItem(pStoreFile, &lastEpoch, sizeof(lastEpoch));
+
+                theDevice.coveredRanges.push_back(StatsRange{ firstEpoch, lastEpoch });
+            }
+        }
+
+        wasRead = wasRead && ReadStatsItem(pStoreFile, &fileCount, sizeof(fileCount));
+
+        for (uint32_t thisFile = 0; true == wasRead && thisFile < fileCount; thisFile++)
+        {
+            string fileName;
+
+            wasRead = ReadStatsString(pStoreFile, fileName);
+
+            theDevice.fileNames.push_back(fileName);
+        }
+
+        wasRead = wasRead && ReadStatsItem(pStoreFile, &dayCount, sizeof(dayCount));
+
+        for (uint32_t thisDay = 0; true == wasRead && thisDay < dayCount; thisDay++)
+        {
+            int64_t     dayNumber = 0;
+            StatsSketch theSketch;
+
+            wasRead = ReadStatsItem(pStoreFile, &dayNumber, sizeof(dayNumber))
+                && ReadStatsItem(pStoreFile, &theSketch.sampleCount, sizeof(theSketch.sampleCount))
+                && ReadStatsItem(pStoreFile, &theSketch.countTotal, sizeof(theSketch.countTotal))
+                && ReadStatsItem(pStoreFile, &theSketch.lowestCount, sizeof(theSketch.lowestCount))
+                && ReadStatsItem(pStoreFile, &theSketch.highestCount, sizeof(theSketch.highestCount))
+                && ReadStatsCounts(pStoreFile, theSketch.exactCounts, STATS_EXACT_LIMIT)
+                && ReadStatsCounts(pStoreFile, theSketch.tailCounts, (32 - STATS_EXACT_BITS) * STATS_TAIL_STEPS);
+
+            theDevice.theDays[dayNumber] = theSketch;
+        }
+
+        // All that is known is that the values run from the first day to where they stop
+        if (true == wasRead && true == isFirstVersion && false == theDevice.theDays.empty() && coveredEpoch > STATS_EARLIEST_EPOCH)
+        {
+            theDevice.coveredRanges.push_back(StatsRange{ theDevice.theDays.begin()->first * STATS_SECONDS_PER_DAY, coveredEpoch });
+        }
+
+        r_Store.theDevices.push_back(theDevice);
+    }
+
+    (void)fclose(pStoreFile);
+
+    return wasRead;
+}
+
+/// <summary>
+/// Writes the store file, replacing it only once the whole store has been written
+/// </summary>
+/// <param name="r_Store">The store</param>
+/// <param name="pch_StoreFileName">The store file</param>
+/// <returns>true if it was written, otherwise false</returns>
+bool SaveStatsStore(const StatsStore & r_Store, const char * pch_StoreFileName)
+{
+    FILE *   pStoreFile             = nullptr;
+    char     temporaryFileName[331] = { 0 };
+    uint32_t deviceCount            = static_cast<uint32_t>(r_Store.theDevices.size());
+    bool     wasWritten             = false;
+
+    BuildTemporaryFileName(pch_StoreFileName, temporaryFileName, sizeof(temporaryFileName));
+
+    if (0 != fopen_s(&pStoreFile, temporaryFileName, "wb"))
+    {
+        return false;
+    }
+
+    wasWritten = WriteStatsItem(pStoreFile, STATS_FILE_MAGIC, 8)
+        && WriteStatsItem(pStoreFile, &deviceCount, sizeof(deviceCount));
+
+    for (size_t thisDevice = 0; true == wasWritten && thisDevice < r_Store.theDevices.size(); thisDevice++)
+    {
+        const StatsDevice & r_Device   = r_Store.theDevices[thisDevice];
+        uint32_t            rangeCount = static_cast<uint32_t>(r_Device.coveredRanges.size());
+        uint32_t            fileCount  = static_cast<uint32_t>(r_Device.fileNames.size());
+        uint32_t            dayCount   = static_cast<uint32_t>(r_Device.theDays.size());
+
+        wasWritten = WriteStatsString(pStoreFile, r_Device.serialNumber)
+            && WriteStatsItem(pStoreFile, &rangeCount, sizeof(rangeCount));
+
+        for (size_t thisRange = 0; true == wasWritten && thisRange < r_Device.coveredRanges.size(); thisRange++)
+        {
+            int64_t firstEpoch = r_Device.coveredRanges[thisRange].firstEpoch;
+            int64_t lastEpoch  = r_Device.coveredRanges[thisRange].lastEpoch;
+
+            wasWritten = WriteStatsItem(pStoreFile, &firstEpoch, sizeof(firstEpoch))
+                && WriteStatsItem(pStoreFile, &lastEpoch, sizeof(lastEpoch));
+        }
+
+        wasWritten = wasWritten && WriteStatsItem(pStoreFile, &fileCount, sizeof(fileCount));
+
+        for (size_t thisFile = 0; true == wasWritten && thisFile < r_Device.fileNames.size(); thisFile++)
+        {
+            wasWritten = WriteStatsString(pStoreFile, r_Device.fileNames[thisFile]);
+        }
+
+        wasWritten = wasWritten && WriteStatsItem(pStoreFile, &dayCount, sizeof(dayCount));
+
+        for (map<long long, StatsSketch>::const_iterator thisDay = r_Device.theDays.begin();
+            true == wasWritten && thisDay != r_Device.theDays.end();
+            thisDay++)
+        {
+            int64_t             dayNumber = thisDay->first;
+            const StatsSketch & r_Sketch  = thisDay->second;
+
+            wasWritten = WriteStatsItem(pStoreFile, &dayNumber, sizeof(dayNumber))
+                && WriteStatsItem(pStoreFile, &r_Sketch.sampleCount, sizeof(r_Sketch.sampleCount))
+                && WriteStatsItem(pStoreFile, &r_Sketch.countTotal, sizeof(r_Sketch.countTotal))
+                && WriteStatsItem(pStoreFile, &r_Sketch.lowestCount, sizeof(r_Sketch.lowestCount))
+                && WriteStatsItem(pStoreFile, &r_Sketch.highestCount, sizeof(r_Sketch.highestCount))
+                && WriteStatsCounts(pStoreFile, r_Sketch.exactCounts)
+                && WriteStatsCounts(pStoreFile, r_Sketch.tailCounts);
+        }
+    }
+
+    wasWritten = (0 == fclose(pStoreFile)) && wasWritten;
+
+    if (false == wasWritten || false == CommitFileAtomically(temporaryFileName, pch_StoreFileName))
+    {
+        (void)remove(temporaryFileName);
+
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Finds a device in the store, adding it if it is not there yet
+/// </summary>
+static StatsDevice & FindStatsDevice(StatsStore & r_Store, const string & r_SerialNumber)
+{
+    for (size_t thisDevice = 0; thisDevice < r_Store.theDevices.size(); thisDevice++)
+    {
+        if (r_Store.theDevices[thisDevice].serialNumber == r_SerialNumber)
+        {
+            return r_Store.theDevices[thisDevice];
+        }
+    }
+
+    StatsDevice theDevice;
+
+    theDevice.serialNumber = r_SerialNumber;
+
+    r_Store.theDevices.push_back(theDevice);
+
+    return r_Store.theDevices.back();
+}
+
+/// <summary>
+/// The day a time falls on, as days since 1970
+/// </summary>
+static long long GetStatsDay(long long epochSeconds)
+{
+    long long dayNumber = epochSeconds / STATS_SECONDS_PER_DAY;
+
+    return (epochSeconds < 0 && dayNumber * STATS_SECONDS_PER_DAY != epochSeconds) ? dayNumber - 1 : dayNumber;
+}
+
+/// <summary>
+/// Adds a span of time to those covered, merging it with any it overlaps or touches so
+/// that the spans stay in time order and apart
+/// </summary>
+/// <param name="r_Ranges">The spans covered</param>
+/// <param name="firstEpoch">When the first value of the span was recorded</param>
+/// <param name="lastEpoch">When the last value of the span was recorded</param>
+static void AddStatsRange(vector<StatsRange> & r_Ranges, long long firstEpoch, long long lastEpoch)
+{
+    vector<StatsRange>::iterator thisRange = r_Ranges.begin();
+
+    // Skip the spans which end before this one starts
+    while (thisRange != r_Ranges.end() && thisRange->lastEpoch < firstEpoch)
+    {
+        thisRange++;
+    }
+
+    // Swallow the spans which start before this one ends
+    while (thisRange != r_Ranges.end() && thisRange->firstEpoch <= lastEpoch)
+    {
+        firstEpoch = (thisRange->firstEpoch < firstEpoch) ? thisRange->firstEpoch : firstEpoch;
+        lastEpoch  = (thisRange->lastEpoch > lastEpoch) ? thisRange->lastEpoch : lastEpoch;
+        thisRange  = r_Ranges.erase(thisRange);
+    }
+
+    (void)r_Ranges.insert(thisRange, StatsRange{ firstEpoch, lastEpoch });
+}
+
+/// <summary>
+/// Whether a time falls within one of the spans covered
+/// </summary>
+static bool IsStatsEpochCovered(const vector<StatsRange> & r_Ranges, long long theEpoch)
+{
+    // The first span which starts after the time, so the one before it is the only candidate
+    vector<StatsRange>::const_iterator theRange = upper_bound(r_Ranges.begin(), r_Ranges.end(), theEpoch,
+        [](long long thisEpoch, const StatsRange & r_Range) { return thisEpoch < r_Range.firstEpoch; });
+
+    return (theRange != r_Ranges.begin() && (theRange - 1)->lastEpoch >= theEpoch);
+}
+
+/// <summary>
+/// Decodes one dump, hands on what the device's history covers once it is taken in, and
+/// sketches the values which the device's earlier dumps and the store did not have. This
+/// is called from many worker threads at once; it only touches its own work, its own
+/// thread's partial sketches, and the hand on, which the lock protects.
+/// </summary>
+static void SketchOneDump(vector<StatsWork> & r_Work,
+    size_t thisWork,
+    StatsPartial & r_Partial,
+    mutex & r_Lock,
+    condition_variable & r_Covered)
+{
+    StatsWork &        r_ThisWork = r_Work[thisWork];
+    SampleStore        theStore;
+    vector<StatsRange> startRanges;
+
+    r_ThisWork.wasSuccessful = LoadSampleFile(r_ThisWork.theInput.fileName.c_str(), theStore);
+    r_ThisWork.addedCount    = 0;
+
+    {
+        unique_lock<mutex> theLock(r_Lock);
+
+        if (r_ThisWork.previousWork >= 0)
+        {
+            const StatsWork & r_Previous = r_Work[static_cast<size_t>(r_ThisWork.previousWork)];
+
+            r_Covered.wait(theLock, [&r_Previous]() { return r_Previous.isCovered; });
+
+            startRanges = r_Previous.coveredRanges;
+        }
+        else
+        {
+            startRanges = r_ThisWork.startRanges;
+        }
+    }
+
+    // What this dump covers is each of its segments from its earliest value to its latest.
+    // The date/time stamp the device writes each hour comes a little more than an interval
+    // after the value before it, so segments which are less than two intervals apart are
+    // taken as one; otherwise another dump's values could land in between.
+    vector<StatsRange> coveredRanges = startRanges;
+    StatsRange         dumpRange     = { STATS_LATEST_EPOCH, STATS_EARLIEST_EPOCH };
+
+    for (size_t thisSegment = 0; thisSegment < theStore.segments.size(); thisSegment++)
+    {
+        const SampleSegment & r_Segment       = theStore.segments[thisSegment];
+        long long             intervalSeconds = GetRecordRateSeconds(r_Segment.recordRate);
+        long long             firstEpoch      = STATS_LATEST_EPOCH;
+        long long             lastEpoch       = STATS_EARLIEST_EPOCH;
+
+        for (ulong thisSample = r_Segment.firstSample; thisSample < r_Segment.firstSample + r_Segment.sampleCount; thisSample++)
+        {
+            firstEpoch = (theStore.epochSeconds[thisSample] < firstEpoch) ? theStore.epochSeconds[thisSample] : firstEpoch;
+            lastEpoch  = (theStore.epochSeconds[thisSample] > lastEpoch) ? theStore.epochSeconds[thisSample] : lastEpoch;
+        }
+
+        if (firstEpoch > lastEpoch)
+        {
+            continue;
+        }
+
+        if (dumpRange.firstEpoch <= dumpRange.lastEpoch && firstEpoch >= dumpRange.firstEpoch && firstEpoch <= dumpRange.lastEpoch + (2 * intervalSeconds))
+        {
+            dumpRange.lastEpoch = (lastEpoch > dumpRange.lastEpoch) ? lastEpoch : dumpRange.lastEpoch;
+            continue;
+        }
+
+        if (dumpRange.firstEpoch <= dumpRange.lastEpoch)
+        {
+            AddStatsRange(coveredRanges, dumpRange.firstEpoch, dumpRange.lastEpoch);
+        }
+
+        dumpRange = StatsRange{ firstEpoch, lastEpoch };
+    }
+
+    if (dumpRange.firstEpoch <= dumpRange.lastEpoch)
+    {
+        AddStatsRange(coveredRanges, dumpRange.firstEpoch, dumpRange.lastEpoch);
+    }
+
+    {
+        unique_lock<mutex> theLock(r_Lock);
+
+        r_ThisWork.coveredRanges = move(coveredRanges);
+        r_ThisWork.isCovered     = true;
+    }
+
+    r_Covered.notify_all();
+
+    map<long long, StatsSketch> & r_Days  = r_Partial[r_ThisWork.theInput.serialNumber];
+    long long                     thisDay = STATS_EARLIEST_EPOCH;
+    StatsSketch *                 pSketch = nullptr;
+
+    for (size_t thisSample = 0; thisSample < theStore.counts.size(); thisSample++)
+    {
+        long long sampleEpoch = theStore.epochSeconds[thisSample];
+
+        if (true == IsStatsEpochCovered(startRanges, sampleEpoch))
+        {
+            continue;
+        }
+
+        // Values come in time order, so the day's sketch is only looked up when the day changes
+        if (nullptr == pSketch || GetStatsDay(sampleEpoch) != thisDay)
+        {
+            thisDay = GetStatsDay(sampleEpoch);
+            pSketch = &r_Days[thisDay];
+        }
+
+        AddStatsValue(*pSketch, theStore.counts[thisSample]);
+
+        r_ThisWork.addedCount++;
+    }
+}
+
+/// <summary>
+/// Displays how the daily statistics are used
+/// </summary>
+static void DisplayStatsUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -stats [<directory|pattern> ...] [-store <file>] [-serial <serial>] [-threads <count>]\n");
+    (void)printf("       [-device <serial>] [-from <time>] [-to <time>]\n");
+    (void)printf("  The dumps named which are not in the store yet (%s unless given) are\n", DATA_OUTPUT_STATS_FILE_NAME);
+    (void)printf("  decoded in parallel and taken in to it, then each device's statistics for each day are\n");
+    (void)printf("  listed. A directory selects every *.%s file within it; series and\n", DATA_OUTPUT_FILE_NAME);
+    (void)printf("  comma-delimited files may also be named.\n");
+}
+
+/// <summary>
+/// The entry point for the daily statistics. New dumps are decoded and sketched by a pool
+/// of worker threads, the workers' sketches are merged in to the store and the store is
+/// saved, and then the statistics of each device for each day are listed.
+/// </summary>
+/// <param name="argc">The number of arguments following "-stats"</param>
+/// <param name="argv">The arguments following "-stats"</param>
+/// <returns>0 if the store was read and saved and every new dump was decoded, otherwise 1</returns>
+int RunDailyStats(int argc, char * argv[])
+{
+    StatsStore           theStore;
+    vector<string>       inputFileNames;
+    vector<ArchiveInput> theInputs;
+    vector<StatsWork>    theWork;
+    string               storeFileName       = DATA_OUTPUT_STATS_FILE_NAME;
+    string               defaultSerialNumber = ARCHIVE_UNKNOWN_SERIAL_NUMBER;
+    const char *         pch_Filter          = nullptr;
+    long long            fromEpoch           = STATS_EARLIEST_EPOCH;
+    long long            toEpoch             = STATS_LATEST_EPOCH;
+    ulong                threadCount         = static_cast<ulong>(thread::hardware_concurrency());
+    ulong                failedCount         = static_cast<ulong>(0);
+    ulong                skippedCount        = static_cast<ulong>(0);
+    unsigned long long   addedCount          = 0;
+    atomic<size_t>       nextWork(0);
+    vector<thread>       workerThreads;
+    mutex                coveredLock;
+    condition_variable   coveredChanged;
+
+    for (int thisArgument = 0; thisArgument < argc; thisArgument++)
+    {
+        if (0 == strcmp(argv[thisArgument], "-store") && thisArgument + 1 < argc)
+        {
+            storeFileName = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-serial") && thisArgument + 1 < argc)
+        {
+            defaultSerialNumber = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-threads") && thisArgument + 1 < argc)
+        {
+            threadCount = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-device") && thisArgument + 1 < argc)
+        {
+            pch_Filter = argv[++thisArgument];
+        }
+        else if ((0 == strcmp(argv[thisArgument], "-from") || 0 == strcmp(argv[thisArgument], "-to")) && thisArgument + 1 < argc)
+        {
+            long long & r_Epoch = (0 == strcmp(argv[thisArgument], "-from")) ? fromEpoch : toEpoch;
+
+            if (false == ParseQueryTime(argv[++thisArgument], r_Epoch))
+            {
+                DisplayStatsUsage();
+                (void)printf("The time \"%s\" was not understood\n", argv[thisArgument]);
+                return 1;
+            }
+        }
+        else
+        {
+            CollectInputFileNames(argv[thisArgument], BATCH_INPUT_FILE_PATTERN, inputFileNames);
+        }
+    }
+
+    if (false == LoadStatsStore(storeFileName.c_str(), theStore))
+    {
+        DisplayStatsUsage();
+        (void)printf("The store %s could not be read\n", storeFileName.c_str());
+        return 1;
+    }
+
+    if (inputFileNames.empty() && theStore.theDevices.empty())
+    {
+        DisplayStatsUsage();
+        (void)printf("There were no files found to take in\n");
+        return 1;
+    }
+
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    // Each device's dumps oldest first, leaving out those already in the store
+    SortArchiveInputs(inputFileNames, defaultSerialNumber, theInputs);
+
+    for (size_t thisInput = 0; thisInput < theInputs.size(); thisInput++)
+    {
+        StatsDevice & r_Device     = FindStatsDevice(theStore, theInputs[thisInput].serialNumber);
+        string        baseFileName = GetBaseFileName(theInputs[thisInput].fileName);
+        StatsWork     newWork;
+
+        if (find(r_Device.fileNames.begin(), r_Device.fileNames.end(), baseFileName) != r_Device.fileNames.end())
+        {
+            skippedCount++;
+            continue;
+        }
+
+        newWork.theInput      = theInputs[thisInput];
+        newWork.previousWork  = -1;
+        newWork.startRanges   = r_Device.coveredRanges;
+        newWork.isCovered     = false;
+        newWork.wasSuccessful = false;
+        newWork.addedCount    = 0;
+
+        if (false == theWork.empty() && theWork.back().theInput.serialNumber == theInputs[thisInput].serialNumber)
+        {
+            newWork.previousWork = static_cast<long>(theWork.size()) - 1;
+        }
+
+        theWork.push_back(newWork);
+    }
+
+    if (threadCount == static_cast<ulong>(0))
+    {
+        threadCount = static_cast<ulong>(1);
+    }
+
+    if (threadCount > theWork.size())
+    {
+        threadCount = static_cast<ulong>(theWork.size());
+    }
+
+    vector<StatsPartial> thePartials(threadCount);
+
+    // Each worker takes the next dump that nobody has claimed until there are none left
+    for (ulong thisThread = 0; thisThread < threadCount; thisThread++)
+    {
+        StatsPartial & r_Partial = thePartials[thisThread];
+
+        workerThreads.push_back(thread([&theWork, &nextWork, &r_Partial, &coveredLock, &coveredChanged]()
+        {
+            size_t thisWork;
+
+            while ((thisWork = nextWork++) < theWork.size())
+            {
+                SketchOneDump(theWork, thisWork, r_Partial, coveredLock, coveredChanged);
+            }
+        }));
+    }
+
+    for (size_t thisThread = 0; thisThread < workerThreads.size(); thisThread++)
+    {
+        workerThreads[thisThread].join();
+    }
+
+    // Merge each worker's sketches in to the store
+    for (size_t thisPartial = 0; thisPartial < thePartials.size(); thisPartial++)
+    {
+        for (StatsPartial::const_iterator thisDevice = thePartials[thisPartial].begin(); thisDevice != thePartials[thisPartial].end(); thisDevice++)
+        {
+            StatsDevice & r_Device = FindStatsDevice(theStore, thisDevice->first);
+
+            for (map<long long, StatsSketch>::const_iterator thisDay = thisDevice->second.begin(); thisDay != thisDevice->second.end(); thisDay++)
+            {
+                map<long long, StatsSketch>::iterator theDay = r_Device.theDays.find(thisDay->first);
+
+                if (theDay == r_Device.theDays.end())
+                {
+                    r_Device.theDays[thisDay->first] = thisDay->second;
+                }
+                else
+                {
+                    MergeStatsSketch(theDay->second, thisDay->second);
+                }
+            }
+        }
+    }
+
+    // Record the dumps taken in and how far each device is now covered
+    for (size_t thisWork = 0; thisWork < theWork.size(); thisWork++)
+    {
+        StatsDevice & r_Device = FindStatsDevice(theStore, theWork[thisWork].theInput.serialNumber);
+
+        if (false == theWork[thisWork].wasSuccessful)
+        {
+            (void)fprintf(stderr, "FAILED  %s\n", theWork[thisWork].theInput.fileName.c_str());
+            failedCount++;
+            continue;
+        }
+
+        // Each dump's spans already hold those of the device's dumps before it
+        r_Device.fileNames.push_back(GetBaseFileName(theWork[thisWork].theInput.fileName));
+        r_Device.coveredRanges = theWork[thisWork].coveredRanges;
+
+        addedCount += theWork[thisWork].addedCount;
+    }
+
+    double elapsedSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    if (false == theWork.empty() && false == SaveStatsStore(theStore, storeFileName.c_str()))
+    {
+        (void)printf("Error: I was unable to write file: %s\n", storeFileName.c_str());
+        return 1;
+    }
+
+    (void)printf("Serial,Day,Samples,Lowest,Highest,Mean,Median,99th Percentile\n");
+
+    for (size_t thisDevice = 0; thisDevice < theStore.theDevices.size(); thisDevice++)
+    {
+        const StatsDevice & r_Device = theStore.theDevices[thisDevice];
+
+        if (nullptr != pch_Filter && 0 != strncmp(r_Device.serialNumber.c_str(), pch_Filter, strlen(pch_Filter)))
+        {
+            continue;
+        }
+
+        for (map<long long, StatsSketch>::const_iterator thisDay = r_Device.theDays.begin(); thisDay != r_Device.theDays.end(); thisDay++)
+        {
+            const StatsSketch & r_Sketch    = thisDay->second;
+            long long           dayEpoch    = thisDay->first * STATS_SECONDS_PER_DAY;
+            char                theDay[31]  = { 0 };
+
+            if (dayEpoch + STATS_SECONDS_PER_DAY <= fromEpoch || dayEpoch >= toEpoch || 0 == r_Sketch.sampleCount)
+            {
+                continue;
+            }
+
+            // Only the date is wanted
+            FormatQueryTime(dayEpoch, theDay, sizeof(theDay));
+            theDay[9] = 0;
+
+            (void)printf("%s,%s,%llu,%lu,%lu,%.2f,%.0f,%.0f\n",
+                r_Device.serialNumber.c_str(),
+                theDay,
+                r_Sketch.sampleCount,
+                static_cast<ulong>(r_Sketch.lowestCount),
+                static_cast<ulong>(r_Sketch.highestCount),
+                static_cast<double>(r_Sketch.countTotal) / static_cast<double>(r_Sketch.sampleCount),
+                GetStatsPercentile(r_Sketch, 50.0),
+                GetStatsPercentile(r_Sketch, 99.0));
+        }
+    }
+
+    // The totals go to the error stream so that the statistics may be redirected to a file
+    (void)fprintf(stderr, "%lu new dumps (%lu already in the store) added %llu values using %lu threads in %.3f seconds\n",
+        static_cast<ulong>(theWork.size()) - failedCount,
+        skippedCount,
+        addedCount,
+        threadCount,
+        elapsedSeconds);
+
+    return (failedCount == static_cast<ulong>(0)) ? 0 : 1;
+}
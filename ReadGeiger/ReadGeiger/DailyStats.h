@@ -0,0 +1,80 @@
+// ----------------------------------------------------------------------
+// DailyStats.h
+//
+// The lowest, highest, mean, median and 99th percentile CPS/CPM/CPH
+// value of each device for each day, across every dump ever harvested.
+// Each device's day is kept as a sketch which two partial results can
+// simply be added together in to, so dumps are decoded in parallel,
+// each worker thread sketches the dumps it decodes, and the workers'
+// sketches are merged at the end. The sketches are kept in a store file
+// along with the names of the dumps already taken in, so that later
+// runs only decode the dumps which are new.
+//
+// A sketch counts how many times each value below STATS_EXACT_LIMIT was
+// seen, which covers every value most devices ever record, so the
+// percentiles of those are exact. Higher values are counted in buckets
+// which each span 1/STATS_TAIL_STEPS of the value, so their percentiles
+// are within that of the true value.
+//
+// Successive harvests of a device repeat the history the earlier ones
+// held, so each device keeps the spans of time its dumps have covered
+// and each dump only adds the values recorded outside of those. A dump
+// older than those already taken in still adds whatever history it has
+// which the others do not, so dumps may be taken in in any order.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "Portable.h"
+
+#define STATS_FILE_MAGIC        "RGSTATS2"
+#define STATS_FILE_MAGIC_V1     "RGSTATS1"
+#define STATS_EXACT_LIMIT       static_cast<uint32_t>(4096)
+#define STATS_EXACT_BITS        12
+#define STATS_TAIL_STEPS        64
+#define STATS_TAIL_BITS         6
+#define STATS_SECONDS_PER_DAY   86400
+
+typedef struct stats_sketch_t
+{
+    unsigned long long    sampleCount;      // The number of values
+    unsigned long long    countTotal;       // The sum of the values
+    uint32_t              lowestCount;      // The lowest value
+    uint32_t              highestCount;     // The highest value
+    std::vector<uint64_t> exactCounts;      // How many of each value below STATS_EXACT_LIMIT, up to the highest
+    std::vector<uint64_t> tailCounts;       // How many in each bucket of higher values, up to the highest
+} StatsSketch;
+
+typedef struct stats_range_t
+{
+    long long firstEpoch;                   // When the first value of the span was recorded
+    long long lastEpoch;                    // When the last value of the span was recorded
+} StatsRange;
+
+typedef struct stats_device_t
+{
+    std::string                       serialNumber;     // The device's serial number, or what it was filed under
+    std::vector<StatsRange>           coveredRanges;    // When the values taken in were recorded, in time order
+    std::vector<std::string>          fileNames;        // The dumps taken in, without their directories
+    std::map<long long, StatsSketch>  theDays;          // A sketch for each day, by days since 1970
+} StatsDevice;
+
+typedef struct stats_store_t
+{
+    std::vector<StatsDevice> theDevices;    // Every device, in the order first seen
+} StatsStore;
+
+extern void ResetStatsSketch(StatsSketch & r_Sketch);
+extern void AddStatsValue(StatsSketch & r_Sketch, uint32_t countValue);
+extern void MergeStatsSketch(StatsSketch & r_Into, const StatsSketch & r_From);
+extern double GetStatsPercentile(const StatsSketch & r_Sketch, double thePercentile);
+
+extern bool LoadStatsStore(const char * pch_StoreFileName, StatsStore & r_Store);
+extern bool SaveStatsStore(const StatsStore & r_Store, const char * pch_StoreFileName);
+
+extern int RunDailyStats(int argc, char * argv[]);
@@ -0,0 +1,926 @@
+// ----------------------------------------------------------------------
+// DeviceEmulator.cpp
+//
+// The emulated GMC-300E. Each emulator runs a service thread which
+// gathers the octets the host sends in to whole commands, answers each
+// one the way the firmware does, and sends the heartbeat counts once a
+// second while the heartbeat is turned on.
+//
+// Every response goes through one place which applies the latency, the
+// injected faults and the pacing to the baud rate, so the host sees the
+// same timing for every command.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <string>
+#include "DeviceEmulator.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include "SyncCursor.h"
+
+using namespace std;
+
+typedef struct emulator_command_length_t
+{
+    const char * pch_CommandPrefix; // The start of a command which carries binary arguments
+    ulong        commandLength;     // The length of the whole command, "<" through ">>"
+} EmulatorCommandLength;
+
+/// <summary>
+/// The commands whose arguments are binary octets, which may look like the ">>" that
+/// ends a command, so they are recognized by their length rather than by their end.
+/// Consult GQ-RFC1201.
+/// </summary>
+static const EmulatorCommandLength binaryCommandTable[] =
+{
+    { "<SPIR",         static_cast<ulong>(12) },  // A2 A1 A0 L1 L0
+    { "<SETDATETIME",  static_cast<ulong>(20) },  // YY MM DD HH MM SS
+    { "<SETDATEY",     static_cast<ulong>(12) },  // YY
+    { "<SETDATEM",     static_cast<ulong>(12) },  // MM
+    { "<SETDATED",     static_cast<ulong>(12) },  // DD
+    { "<SETTIMEH",     static_cast<ulong>(12) },  // HH
+    { "<SETTIMEM",     static_cast<ulong>(12) },  // MM
+    { "<SETTIMES",     static_cast<ulong>(12) },  // SS
+    { "<KEY",          static_cast<ulong>(7)  },  // The key, 0 through 3
+    { "<WCFG",         static_cast<ulong>(9)  },  // The address and the data
+    { nullptr,         static_cast<ulong>(0)  }
+};
+
+// A text command longer than this is garbage so the octets get skipped
+#define EMULATOR_LONGEST_COMMAND        static_cast<size_t>(32)
+
+// Responses are written a piece at a time so the pacing stays smooth
+#define EMULATOR_PACING_CHUNK           static_cast<ulong>(64)
+
+// The firmware answers most of the setting commands with this octet
+static const uchar EmulatorAcknowledge = static_cast<uchar>(0xAA);
+
+/// <summary>
+/// Returns the next number from the emulator's generator, xorshift64*, which is all
+/// that fault injection needs and gives the same sequence for the same seed
+/// </summary>
+static uint64_t GetNextRandomNumber(DeviceEmulator & r_Emulator)
+{
+    r_Emulator.randomState ^= r_Emulator.randomState >> 12;
+    r_Emulator.randomState ^= r_Emulator.randomState << 25;
+    r_Emulator.randomState ^= r_Emulator.randomState >> 27;
+
+    return r_Emulator.randomState * 0x2545F4914F6CDD1DULL;
+}
+
+/// <summary>
+/// Returns true with the likelihood passed by argument, out of 1000
+/// </summary>
+static bool ChanceOfPerMille(DeviceEmulator & r_Emulator, ulong perMille)
+{
+    if (perMille == static_cast<ulong>(0))
+    {
+        return false;
+    }
+
+    return (GetNextRandomNumber(r_Emulator) % 1000) < perMille;
+}
+
+/// <summary>
+/// Draws a count from a Poisson distribution with the mean passed by argument, which
+/// is how a Geiger Counter's counts are distributed
+/// </summary>
+static ulong DrawPoissonCount(DeviceEmulator & r_Emulator, double theMean)
+{
+    double theLimit   = exp(-theMean);
+    double theProduct = 1.0;
+    ulong  theCount   = static_cast<ulong>(0);
+
+    do
+    {
+        theProduct *= static_cast<double>(GetNextRandomNumber(r_Emulator) >> 11) / 9007199254740992.0;
+        theCount++;
+    } while (theProduct > theLimit);
+
+    return theCount - 1;
+}
+
+/// <summary>
+/// Sets the defaults: a GMC-300E at 57600 baud which answers quickly, honours history
+/// retrievals of up to 4096 octets and never injects a fault
+/// </summary>
+/// <param name="r_Settings">Returns the settings</param>
+void InitializeEmulatorSettings(EmulatorSettings & r_Settings)
+{
+    r_Settings.baudRate              = EMULATOR_DEFAULT_BAUD_RATE;
+    r_Settings.latencyMilliseconds   = EMULATOR_DEFAULT_LATENCY;
+    r_Settings.maximumBlockLength    = EMULATOR_DEFAULT_BLOCK_LENGTH;
+    r_Settings.shortResponsePerMille = static_cast<ulong>(0);
+    r_Settings.droppedOctetPerMille  = static_cast<ulong>(0);
+    r_Settings.countsPerMinute       = EMULATOR_DEFAULT_COUNTS_PER_MINUTE;
+    r_Settings.randomSeed            = static_cast<ulong>(1);
+}
+
+/// <summary>
+/// Fills in the configuration that GETCFG answers with. The dataSaveAddress is taken
+/// from where the history data in the image ends, which is what the incremental
+/// retrieval compares between visits.
+/// </summary>
+static void BuildEmulatorConfiguration(DeviceEmulator & r_Emulator)
+{
+    ulong endOfData = FindEndOfHistoryData(r_Emulator.flashImage.data(), static_cast<ulong>(r_Emulator.flashImage.size()));
+
+    (void)memset(&r_Emulator.configuration, 0, sizeof(r_Emulator.configuration));
+
+    r_Emulator.configuration.powerOnOff       = static_cast<uchar>(0);
+    r_Emulator.configuration.saveDataType     = static_cast<uchar>(2);      // Counts per minute, once a minute
+    r_Emulator.configuration.dataSaveAddress2 = static_cast<uchar>((endOfData >> 16) & 0xFF);
+    r_Emulator.configuration.dataSaveAddress1 = static_cast<uchar>((endOfData >> 8) & 0xFF);
+    r_Emulator.configuration.dataSaveAddress0 = static_cast<uchar>(endOfData & 0xFF);
+    r_Emulator.configuration.maxBytes         = static_cast<uchar>(0xFF);
+}
+
+/// <summary>
+/// Loads the archived FLASH image which the emulator serves. The serial number is made
+/// up from the file's name so that different images look like different devices; see
+/// SetDeviceEmulatorSerialNumber() to make several images look like the same device.
+/// </summary>
+/// <param name="r_Emulator">The emulator to load</param>
+/// <param name="pch_FileName">An archived *.ReadGeiger.bin file</param>
+/// <returns>true if the image was loaded, otherwise false</returns>
+bool LoadDeviceEmulatorImage(DeviceEmulator & r_Emulator, const char * pch_FileName)
+{
+    FILE *   pInputFile = nullptr;
+    uint64_t theHash    = 0xCBF29CE484222325ULL;
+
+    if (0 != fopen_s(&pInputFile, pch_FileName, "rb"))
+    {
+        return false;
+    }
+
+    (void)fseek(pInputFile, 0, SEEK_END);
+    long fileSize = ftell(pInputFile);
+    (void)fseek(pInputFile, 0, SEEK_SET);
+
+    if (fileSize <= 0)
+    {
+        (void)fclose(pInputFile);
+        return false;
+    }
+
+    r_Emulator.flashImage.resize(static_cast<size_t>(fileSize));
+
+    bool wasRead = (1 == fread(r_Emulator.flashImage.data(), r_Emulator.flashImage.size(), 1, pInputFile));
+
+    (void)fclose(pInputFile);
+
+    if (false == wasRead)
+    {
+        return false;
+    }
+
+    // FNV-1a of the name, the low seven octets of which become the serial number
+    for (const char * pch_Name = pch_FileName; *pch_Name != 0x00; pch_Name++)
+    {
+        theHash = (theHash ^ static_cast<uchar>(*pch_Name)) * 0x100000001B3ULL;
+    }
+
+    for (int thisOctet = 0; thisOctet < 7; thisOctet++)
+    {
+        r_Emulator.serialNumber[thisOctet] = static_cast<uchar>(theHash >> (8 * thisOctet));
+    }
+
+    BuildEmulatorConfiguration(r_Emulator);
+
+    return true;
+}
+
+/// <summary>
+/// Sets the serial number that GETSERIAL answers with
+/// </summary>
+/// <param name="r_Emulator">The emulator</param>
+/// <param name="pch_SerialNumber">Fourteen hexadecimal digits as FormatDeviceSerialNumber() produces</param>
+/// <returns>true if the serial number was valid, otherwise false</returns>
+bool SetDeviceEmulatorSerialNumber(DeviceEmulator & r_Emulator, const char * pch_SerialNumber)
+{
+    if (strlen(pch_SerialNumber) != 14 || strspn(pch_SerialNumber, "0123456789abcdefABCDEF") != 14)
+    {
+        return false;
+    }
+
+    for (int thisOctet = 0; thisOctet < 7; thisOctet++)
+    {
+        char theDigits[3] = { pch_SerialNumber[thisOctet * 2], pch_SerialNumber[(thisOctet * 2) + 1], 0x00 };
+
+        r_Emulator.serialNumber[thisOctet] = static_cast<uchar>(strtoul(theDigits, nullptr, 16));
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Writes octets to the host, pacing them so that they arrive no faster than the
+/// baud rate allows, ten bits to the octet
+/// </summary>
+/// <returns>false if the host went away or the emulator is being stopped</returns>
+static bool WriteToHost(DeviceEmulator & r_Emulator, const uchar * pData, ulong dataLength)
+{
+    ulong sentLength = static_cast<ulong>(0);
+
+    while (sentLength < dataLength)
+    {
+        ulong chunkLength = dataLength - sentLength;
+
+        if (chunkLength > EMULATOR_PACING_CHUNK)
+        {
+            chunkLength = EMULATOR_PACING_CHUNK;
+        }
+
+        ssize_t writeResult = write(r_Emulator.deviceDescriptor, pData + sentLength, chunkLength);
+
+        if (writeResult < 0)
+        {
+            if (EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno)
+            {
+                return false;
+            }
+
+            // The host is not reading so wait for room, checking now and then for a stop
+            struct pollfd pollDescriptor = { r_Emulator.deviceDescriptor, POLLOUT, 0 };
+
+            (void)poll(&pollDescriptor, 1, 100);
+
+            if (true == r_Emulator.stopRequested.load())
+            {
+                return false;
+            }
+
+            continue;
+        }
+
+        sentLength += static_cast<ulong>(writeResult);
+
+        r_Emulator.statistics.octetsSent += static_cast<ulong>(writeResult);
+
+        // Hold the line for as long as those octets take at the baud rate
+        if (r_Emulator.settings.baudRate > static_cast<ulong>(0))
+        {
+            chrono::steady_clock::time_point timeNow = chrono::steady_clock::now();
+
+            if (r_Emulator.lineFreeTime < timeNow)
+            {
+                r_Emulator.lineFreeTime = timeNow;
+            }
+
+            r_Emulator.lineFreeTime += chrono::microseconds((static_cast<long long>(writeResult) * 10000000LL) /
+                static_cast<long long>(r_Emulator.settings.baudRate));
+
+            this_thread::sleep_until(r_Emulator.lineFreeTime);
+        }
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Sends a response to the host after the device's latency, cutting it short or
+/// losing octets from it when those faults are asked for
+/// </summary>
+/// <param name="r_Emulator">The emulator</param>
+/// <param name="pResponse">The response the firmware would send</param>
+/// <param name="responseLength">The number of octets in that response</param>
+/// <param name="applyLatency">false for the heartbeat, which is not an answer to a command</param>
+static void SendEmulatorResponse(DeviceEmulator & r_Emulator, const uchar * pResponse, ulong responseLength, bool applyLatency)
+{
+    vector<uchar> theResponse(pResponse, pResponse + responseLength);
+
+    if (true == applyLatency && r_Emulator.settings.latencyMilliseconds > static_cast<ulong>(0))
+    {
+        this_thread::sleep_for(chrono::milliseconds(r_Emulator.settings.latencyMilliseconds));
+    }
+
+    // A short response stops somewhere before its end, maybe before its start
+    if (responseLength > static_cast<ulong>(0) && true == ChanceOfPerMille(r_Emulator, r_Emulator.settings.shortResponsePerMille))
+    {
+        theResponse.resize(static_cast<size_t>(GetNextRandomNumber(r_Emulator) % responseLength));
+
+        r_Emulator.statistics.shortResponseCount++;
+    }
+
+    // Each octet may get lost on its own
+    if (r_Emulator.settings.droppedOctetPerMille > static_cast<ulong>(0))
+    {
+        size_t keptLength = 0;
+
+        for (size_t thisOctet = 0; thisOctet < theResponse.size(); thisOctet++)
+        {
+            if (true == ChanceOfPerMille(r_Emulator, r_Emulator.settings.droppedOctetPerMille))
+            {
+                r_Emulator.statistics.droppedOctetCount++;
+                continue;
+            }
+
+            theResponse[keptLength++] = theResponse[thisOctet];
+        }
+
+        theResponse.resize(keptLength);
+    }
+
+    (void)WriteToHost(r_Emulator, theResponse.data(), static_cast<ulong>(theResponse.size()));
+}
+
+/// <summary>
+/// Returns the device's clock broken down in to its parts
+/// </summary>
+static void GetEmulatorClock(const DeviceEmulator & r_Emulator, struct tm & r_Time)
+{
+    time_t theTime = time(nullptr) + static_cast<time_t>(r_Emulator.clockOffsetSeconds);
+
+    (void)gmtime_s(&r_Time, &theTime);
+}
+
+/// <summary>
+/// Moves the device's clock to the time passed by argument
+/// </summary>
+static void SetEmulatorClock(DeviceEmulator & r_Emulator, const struct tm & r_Time)
+{
+    struct tm theTime  = r_Time;
+    long long theEpoch = static_cast<long long>(timegm(&theTime));
+
+    r_Emulator.clockOffsetSeconds = theEpoch - static_cast<long long>(time(nullptr));
+}
+
+/// <summary>
+/// Answers a history retrieval, "<SPIR" A2 A1 A0 L1 L0 ">>". Retrievals longer than the
+/// firmware honours are cut to that length, and anything past the end of the image
+/// reads as erased FLASH.
+/// </summary>
+static void AnswerHistoryRetrieval(DeviceEmulator & r_Emulator, const uchar * pCommand)
+{
+    ulong theAddress = (static_cast<ulong>(pCommand[5]) << 16) | (static_cast<ulong>(pCommand[6]) << 8) | pCommand[7];
+    ulong theLength  = (static_cast<ulong>(pCommand[8]) << 8) | pCommand[9];
+    ulong imageSize  = static_cast<ulong>(r_Emulator.flashImage.size());
+
+    if (theLength > r_Emulator.settings.maximumBlockLength)
+    {
+        theLength = r_Emulator.settings.maximumBlockLength;
+    }
+
+    vector<uchar> theBlock(theLength, static_cast<uchar>(0xFF));
+
+    if (theAddress < imageSize)
+    {
+        ulong copyLength = (theLength > imageSize - theAddress) ? imageSize - theAddress : theLength;
+
+        (void)memcpy(theBlock.data(), &r_Emulator.flashImage[theAddress], copyLength);
+    }
+
+    SendEmulatorResponse(r_Emulator, theBlock.data(), theLength, true);
+}
+
+/// <summary>
+/// Answers one whole command the way the firmware does. While the device is turned
+/// off only POWERON is answered.
+/// </summary>
+/// <param name="r_Emulator">The emulator</param>
+/// <param name="pCommand">The command, "<" through ">>"</param>
+/// <param name="commandLength">The number of octets in the command</param>
+static void AnswerCommand(DeviceEmulator & r_Emulator, const uchar * pCommand, ulong commandLength)
+{
+    string    theCommand(reinterpret_cast<const char *>(pCommand), commandLength);
+    uchar     theResponse[8] = { 0 };
+    struct tm theTime;
+
+    r_Emulator.statistics.commandCount++;
+
+    if (theCommand == CommandTurnPowerOn)
+    {
+        r_Emulator.isPoweredOn = true;
+        return;
+    }
+
+    if (false == r_Emulator.isPoweredOn)
+    {
+        return;
+    }
+
+    if (theCommand == CommandGetModelAndVersion)
+    {
+        SendEmulatorResponse(r_Emulator, reinterpret_cast<const uchar *>(EMULATOR_MODEL_AND_VERSION), 14, true);
+    }
+    else if (theCommand == CommandGetSerialNumber)
+    {
+        SendEmulatorResponse(r_Emulator, r_Emulator.serialNumber, sizeof(r_Emulator.serialNumber), true);
+    }
+    else if (theCommand == CommandGetConfiguration)
+    {
+        SendEmulatorResponse(r_Emulator, reinterpret_cast<const uchar *>(&r_Emulator.configuration), sizeof(r_Emulator.configuration), true);
+    }
+    else if (theCommand == CommandGetBatteryVoltage)
+    {
+        theResponse[0] = static_cast<uchar>(42);                            // 4.2 volts
+        SendEmulatorResponse(r_Emulator, theResponse, 1, true);
+    }
+    else if (theCommand == CommandGetTemperature)
+    {
+        theResponse[0] = static_cast<uchar>(24);                            // +24.5 degrees
+        theResponse[1] = static_cast<uchar>(5);
+        theResponse[2] = static_cast<uchar>(0);
+        theResponse[3] = EmulatorAcknowledge;
+        SendEmulatorResponse(r_Emulator, theResponse, 4, true);
+    }
+    else if (theCommand == CommandSetDateAndTime)
+    {
+        GetEmulatorClock(r_Emulator, theTime);
+
+        theResponse[0] = static_cast<uchar>(theTime.tm_year - 100);
+        theResponse[1] = static_cast<uchar>(theTime.tm_mon + 1);
+        theResponse[2] = static_cast<uchar>(theTime.tm_mday);
+        theResponse[3] = static_cast<uchar>(theTime.tm_hour);
+        theResponse[4] = static_cast<uchar>(theTime.tm_min);
+        theResponse[5] = static_cast<uchar>(theTime.tm_sec);
+        theResponse[6] = EmulatorAcknowledge;
+        SendEmulatorResponse(r_Emulator, theResponse, 7, true);
+    }
+    else if (theCommand == CommandGetCountsPerMinute)
+    {
+        ulong theCount = DrawPoissonCount(r_Emulator, static_cast<double>(r_Emulator.settings.countsPerMinute));
+
+        theResponse[0] = static_cast<uchar>((theCount >> 8) & 0x3F);
+        theResponse[1] = static_cast<uchar>(theCount & 0xFF);
+        SendEmulatorResponse(r_Emulator, theResponse, 2, true);
+    }
+    else if (theCommand == CommandGetGyroscope)
+    {
+        theResponse[6] = EmulatorAcknowledge;
+        SendEmulatorResponse(r_Emulator, theResponse, 7, true);
+    }
+    else if (theCommand == CommandTurnOnHeartbeat)
+    {
+        r_Emulator.isHeartbeatOn     = true;
+        r_Emulator.nextHeartbeatTime = chrono::steady_clock::now() + chrono::seconds(1);
+    }
+    else if (theCommand == CommandTurnOffHeartbeat)
+    {
+        r_Emulator.isHeartbeatOn = false;
+    }
+    else if (theCommand == CommandTurnPowerOff)
+    {
+        r_Emulator.isPoweredOn   = false;
+        r_Emulator.isHeartbeatOn = false;
+    }
+    else if (0 == theCommand.compare(0, 5, "<SPIR"))
+    {
+        AnswerHistoryRetrieval(r_Emulator, pCommand);
+    }
+    else if (0 == theCommand.compare(0, 12, "<SETDATETIME"))
+    {
+        (void)memset(&theTime, 0, sizeof(theTime));
+
+        theTime.tm_year = pCommand[12] + 100;
+        theTime.tm_mon  = pCommand[13] - 1;
+        theTime.tm_mday = pCommand[14];
+        theTime.tm_hour = pCommand[15];
+        theTime.tm_min  = pCommand[16];
+        theTime.tm_sec  = pCommand[17];
+
+        SetEmulatorClock(r_Emulator, theTime);
+        SendEmulatorResponse(r_Emulator, &EmulatorAcknowledge, 1, true);
+    }
+    else if (0 == theCommand.compare(0, 8, "<SETDATE") || 0 == theCommand.compare(0, 8, "<SETTIME"))
+    {
+        GetEmulatorClock(r_Emulator, theTime);
+
+        // "<SETDATE" is followed by Y, M or D and "<SETTIME" by H, M or S
+        bool  isDate   = (pCommand[4] == 'D');
+        uchar theField = pCommand[8];
+
+        if (true == isDate && theField == 'Y')       theTime.tm_year = pCommand[9] + 100;
+        else if (true == isDate && theField == 'M')  theTime.tm_mon  = pCommand[9] - 1;
+        else if (true == isDate && theField == 'D')  theTime.tm_mday = pCommand[9];
+        else if (false == isDate && theField == 'H') theTime.tm_hour = pCommand[9];
+        else if (false == isDate && theField == 'M') theTime.tm_min  = pCommand[9];
+        else if (false == isDate && theField == 'S') theTime.tm_sec  = pCommand[9];
+
+        SetEmulatorClock(r_Emulator, theTime);
+        SendEmulatorResponse(r_Emulator, &EmulatorAcknowledge, 1, true);
+    }
+    else if (0 == theCommand.compare(0, 5, "<WCFG"))
+    {
+        reinterpret_cast<uchar *>(&r_Emulator.configuration)[pCommand[5]] = pCommand[6];
+
+        SendEmulatorResponse(r_Emulator, &EmulatorAcknowledge, 1, true);
+    }
+    else if (theCommand == CommandEraseConfiguration ||
+        theCommand == CommandReloadConfiguration ||
+        theCommand == CommandFactoryReset)
+    {
+        SendEmulatorResponse(r_Emulator, &EmulatorAcknowledge, 1, true);
+    }
+    else if (0 == theCommand.compare(0, 4, "<KEY") || theCommand == CommandReboot)
+    {
+        // Key presses and the reboot are not answered
+    }
+    else
+    {
+        r_Emulator.statistics.commandCount--;
+        r_Emulator.statistics.unknownCommandCount++;
+    }
+}
+
+/// <summary>
+/// Finds the first whole command in the octets received so far. Octets before a "<"
+/// are skipped, as are runs which grow too long to be a command, so the emulator gets
+/// back in step after the host sends garbage.
+/// </summary>
+/// <returns>The length of the command at the start of the buffer, or 0 if there is not a whole one yet</returns>
+static ulong FindWholeCommand(DeviceEmulator & r_Emulator)
+{
+    vector<uchar> & r_Buffer = r_Emulator.commandBuffer;
+
+    while (false == r_Buffer.empty())
+    {
+        // Commands start with "<"
+        if (r_Buffer[0] != '<')
+        {
+            r_Buffer.erase(r_Buffer.begin());
+            continue;
+        }
+
+        // Commands with binary arguments are known by their length
+        for (int thisEntry = 0; nullptr != binaryCommandTable[thisEntry].pch_CommandPrefix; thisEntry++)
+        {
+            size_t prefixLength = strlen(binaryCommandTable[thisEntry].pch_CommandPrefix);
+
+            if (r_Buffer.size() >= prefixLength &&
+                0 == memcmp(r_Buffer.data(), binaryCommandTable[thisEntry].pch_CommandPrefix, prefixLength))
+            {
+                if (r_Buffer.size() < binaryCommandTable[thisEntry].commandLength)
+                {
+                    return static_cast<ulong>(0);
+                }
+
+                return binaryCommandTable[thisEntry].commandLength;
+            }
+        }
+
+        // Every other command ends with ">>"
+        for (size_t thisOctet = 1; thisOctet + 1 < r_Buffer.size(); thisOctet++)
+        {
+            if (r_Buffer[thisOctet] == '>' && r_Buffer[thisOctet + 1] == '>')
+            {
+                return static_cast<ulong>(thisOctet + 2);
+            }
+        }
+
+        if (r_Buffer.size() <= EMULATOR_LONGEST_COMMAND)
+        {
+            return static_cast<ulong>(0);
+        }
+
+        // That is not a command so start looking again after its "<"
+        r_Buffer.erase(r_Buffer.begin());
+    }
+
+    return static_cast<ulong>(0);
+}
+
+/// <summary>
+/// Sends one heartbeat, the counts of the last second in two octets with the two
+/// most significant bits clear
+/// </summary>
+static void SendHeartbeat(DeviceEmulator & r_Emulator)
+{
+    uchar theCounts[2];
+    ulong theCount = DrawPoissonCount(r_Emulator, static_cast<double>(r_Emulator.settings.countsPerMinute) / 60.0);
+
+    theCounts[0] = static_cast<uchar>((theCount >> 8) & 0x3F);
+    theCounts[1] = static_cast<uchar>(theCount & 0xFF);
+
+    SendEmulatorResponse(r_Emulator, theCounts, 2, false);
+}
+
+/// <summary>
+/// The service thread: waits for octets from the host, answers each whole command, and
+/// keeps the heartbeat going, until the emulator is stopped or the host closes its end
+/// of a socket pair
+/// </summary>
+static void ServeDeviceEmulator(DeviceEmulator * pEmulator)
+{
+    DeviceEmulator & r_Emulator = *pEmulator;
+    uchar            readBuffer[256];
+
+    while (false == r_Emulator.stopRequested.load())
+    {
+        struct pollfd pollDescriptor = { r_Emulator.deviceDescriptor, POLLIN, 0 };
+        int           waitTime       = 100;
+
+        if (true == r_Emulator.isHeartbeatOn)
+        {
+            long long untilHeartbeat = chrono::duration_cast<chrono::milliseconds>(
+                r_Emulator.nextHeartbeatTime - chrono::steady_clock::now()).count();
+
+            waitTime = (untilHeartbeat < 0) ? 0 : (untilHeartbeat < waitTime) ? static_cast<int>(untilHeartbeat) : waitTime;
+        }
+
+        if (poll(&pollDescriptor, 1, waitTime) > 0)
+        {
+            ssize_t readResult = read(r_Emulator.deviceDescriptor, readBuffer, sizeof(readBuffer));
+
+            if (readResult == 0 && EmulatorLinkSocketPair == r_Emulator.theLink)
+            {
+                // The host closed its end
+                break;
+            }
+
+            if (readResult > 0)
+            {
+                r_Emulator.commandBuffer.insert(r_Emulator.commandBuffer.end(), readBuffer, readBuffer + readResult);
+            }
+            else if (readResult < 0 && EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno)
+            {
+                // Nobody has the terminal open, so do not spin
+                this_thread::sleep_for(chrono::milliseconds(20));
+            }
+        }
+
+        // Answer every whole command received so far
+        ulong commandLength;
+
+        while ((commandLength = FindWholeCommand(r_Emulator)) > static_cast<ulong>(0))
+        {
+            AnswerCommand(r_Emulator, r_Emulator.commandBuffer.data(), commandLength);
+
+            r_Emulator.commandBuffer.erase(r_Emulator.commandBuffer.begin(), r_Emulator.commandBuffer.begin() + commandLength);
+        }
+
+        if (true == r_Emulator.isHeartbeatOn && chrono::steady_clock::now() >= r_Emulator.nextHeartbeatTime)
+        {
+            SendHeartbeat(r_Emulator);
+
+            r_Emulator.nextHeartbeatTime += chrono::seconds(1);
+        }
+    }
+}
+
+/// <summary>
+/// Creates the link and starts the service thread. For a pseudo-terminal the host opens
+/// hostPortName with OpenSerialConnection(); for a socket pair the host hands
+/// hostDescriptor to AttachSerialConnection().
+/// </summary>
+/// <param name="r_Emulator">An emulator whose image has been loaded</param>
+/// <param name="theLink">Which sort of link to create</param>
+/// <returns>true if the emulator is running, otherwise false</returns>
+bool StartDeviceEmulator(DeviceEmulator & r_Emulator, EmulatorLink theLink)
+{
+    int socketDescriptors[2] = { -1, -1 };
+
+    r_Emulator.theLink            = theLink;
+    r_Emulator.hostPortName[0]    = 0x00;
+    r_Emulator.hostDescriptor     = -1;
+    r_Emulator.deviceDescriptor   = -1;
+    r_Emulator.terminalDescriptor = -1;
+    r_Emulator.clockOffsetSeconds = 0;
+    r_Emulator.isPoweredOn        = true;
+    r_Emulator.isHeartbeatOn      = false;
+    r_Emulator.randomState        = static_cast<uint64_t>(r_Emulator.settings.randomSeed) * 0x9E3779B97F4A7C15ULL + 1;
+    r_Emulator.lineFreeTime       = chrono::steady_clock::now();
+    r_Emulator.stopRequested      = false;
+
+    r_Emulator.statistics.commandCount        = static_cast<ulong>(0);
+    r_Emulator.statistics.unknownCommandCount = static_cast<ulong>(0);
+    r_Emulator.statistics.octetsSent          = static_cast<ulong>(0);
+    r_Emulator.statistics.shortResponseCount  = static_cast<ulong>(0);
+    r_Emulator.statistics.droppedOctetCount   = static_cast<ulong>(0);
+
+    r_Emulator.commandBuffer.clear();
+
+    if (EmulatorLinkSocketPair == theLink)
+    {
+        if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, socketDescriptors))
+        {
+            return false;
+        }
+
+        r_Emulator.deviceDescriptor = socketDescriptors[0];
+        r_Emulator.hostDescriptor   = socketDescriptors[1];
+    }
+    else
+    {
+        struct termios lineSettings;
+
+        r_Emulator.deviceDescriptor = posix_openpt(O_RDWR | O_NOCTTY);
+
+        if (r_Emulator.deviceDescriptor < 0 ||
+            0 != grantpt(r_Emulator.deviceDescriptor) ||
+            0 != unlockpt(r_Emulator.deviceDescriptor) ||
+            nullptr == ptsname(r_Emulator.deviceDescriptor))
+        {
+            if (r_Emulator.deviceDescriptor >= 0)
+            {
+                (void)close(r_Emulator.deviceDescriptor);
+            }
+
+            return false;
+        }
+
+        (void)strcpy_s(r_Emulator.hostPortName, ptsname(r_Emulator.deviceDescriptor));
+
+        // Holding the terminal open keeps it from hanging up between the host's visits,
+        // and making it raw keeps the commands from being echoed back
+        r_Emulator.terminalDescriptor = open(r_Emulator.hostPortName, O_RDWR | O_NOCTTY);
+
+        if (r_Emulator.terminalDescriptor >= 0 && 0 == tcgetattr(r_Emulator.terminalDescriptor, &lineSettings))
+        {
+            cfmakeraw(&lineSettings);
+            (void)tcsetattr(r_Emulator.terminalDescriptor, TCSANOW, &lineSettings);
+        }
+    }
+
+    (void)fcntl(r_Emulator.deviceDescriptor, F_SETFL, fcntl(r_Emulator.deviceDescriptor, F_GETFL, 0) | O_NONBLOCK);
+
+    r_Emulator.serviceThread = thread(ServeDeviceEmulator, &r_Emulator);
+
+    return true;
+}
+
+/// <summary>
+/// Stops the service thread and closes the emulator's end of the link. The host's end
+/// of a socket pair belongs to the host once it has been attached.
+/// </summary>
+void StopDeviceEmulator(DeviceEmulator & r_Emulator)
+{
+    r_Emulator.stopRequested = true;
+
+    if (true == r_Emulator.serviceThread.joinable())
+    {
+        r_Emulator.serviceThread.join();
+    }
+
+    if (r_Emulator.deviceDescriptor >= 0)
+    {
+        (void)close(r_Emulator.deviceDescriptor);
+        r_Emulator.deviceDescriptor = -1;
+    }
+
+    if (r_Emulator.terminalDescriptor >= 0)
+    {
+        (void)close(r_Emulator.terminalDescriptor);
+        r_Emulator.terminalDescriptor = -1;
+    }
+}
+#endif
+
+/// <summary>
+/// Displays how the emulator is used
+/// </summary>
+static void DisplayEmulatorUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -emulate <image.bin> [...] [-baud <rate>] [-latency <ms>] [-block <octets>]\n");
+    (void)printf("                  [-short <per mille>] [-drop <per mille>] [-cpm <counts>] [-seed <number>] [-serial <hex>]\n");
+    (void)printf("  Each image is served by its own emulated GMC-300E on its own pseudo-terminal.\n");
+    (void)printf("  -baud 0 turns off the throttling. Press Enter to stop.\n");
+}
+
+/// <summary>
+/// The entry point for the emulator. Each archived image named gets its own emulated
+/// device on its own pseudo-terminal, all with the same settings, and they run until
+/// the operator presses Enter. What each device did is then displayed.
+/// </summary>
+/// <param name="argc">The number of arguments following "-emulate"</param>
+/// <param name="argv">The arguments following "-emulate"</param>
+/// <returns>0 if every emulator ran, otherwise 1</returns>
+int RunDeviceEmulator(int argc, char * argv[])
+{
+#ifdef _WIN32
+    (void)argc;
+    (void)argv;
+
+    DisplayEmulatorUsage();
+    (void)printf("The emulator needs pseudo-terminals, which this system does not have\n");
+
+    return 1;
+#else
+    vector<unique_ptr<DeviceEmulator>> theEmulators;
+    vector<const char *>               imageFileNames;
+    EmulatorSettings                   theSettings;
+    const char *                       pch_SerialNumber = nullptr;
+    char                               theAnswer[11]    = { 0 };
+
+    InitializeEmulatorSettings(theSettings);
+
+    // Gather the options and the images
+    for (int thisArgument = 0; thisArgument < argc; thisArgument++)
+    {
+        bool haveValue = (thisArgument + 1 < argc);
+
+        if (0 == strcmp(argv[thisArgument], "-baud") && true == haveValue)
+        {
+            theSettings.baudRate = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-latency") && true == haveValue)
+        {
+            theSettings.latencyMilliseconds = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-block") && true == haveValue)
+        {
+            theSettings.maximumBlockLength = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-short") && true == haveValue)
+        {
+            theSettings.shortResponsePerMille = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-drop") && true == haveValue)
+        {
+            theSettings.droppedOctetPerMille = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-cpm") && true == haveValue)
+        {
+            theSettings.countsPerMinute = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-seed") && true == haveValue)
+        {
+            theSettings.randomSeed = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-serial") && true == haveValue)
+        {
+            pch_SerialNumber = argv[++thisArgument];
+        }
+        else
+        {
+            imageFileNames.push_back(argv[thisArgument]);
+        }
+    }
+
+    if (imageFileNames.empty())
+    {
+        DisplayEmulatorUsage();
+        return 1;
+    }
+
+    for (size_t thisImage = 0; thisImage < imageFileNames.size(); thisImage++)
+    {
+        unique_ptr<DeviceEmulator> pEmulator(new DeviceEmulator());
+        char                       serialNumberText[15] = { 0 };
+
+        pEmulator->settings = theSettings;
+
+        // Each device gets its own faults while still being repeatable
+        pEmulator->settings.randomSeed += static_cast<ulong>(thisImage);
+
+        if (false == LoadDeviceEmulatorImage(*pEmulator, imageFileNames[thisImage]))
+        {
+            (void)printf("Error: I was unable to load %s\n", imageFileNames[thisImage]);
+            continue;
+        }
+
+        if (nullptr != pch_SerialNumber && false == SetDeviceEmulatorSerialNumber(*pEmulator, pch_SerialNumber))
+        {
+            (void)printf("Error: %s is not fourteen hexadecimal digits\n", pch_SerialNumber);
+            return 1;
+        }
+
+        if (false == StartDeviceEmulator(*pEmulator, EmulatorLinkPseudoTerminal))
+        {
+            (void)printf("Error: I was unable to create a pseudo-terminal for %s\n", imageFileNames[thisImage]);
+            continue;
+        }
+
+        FormatDeviceSerialNumber(pEmulator->serialNumber, serialNumberText, sizeof(serialNumberText));
+
+        (void)printf("%s  serial %s  %s\n", pEmulator->hostPortName, serialNumberText, imageFileNames[thisImage]);
+
+        theEmulators.push_back(move(pEmulator));
+    }
+
+    (void)printf("%lu emulated devices at %lu baud, %lu ms latency. Press Enter to stop.\n",
+        static_cast<ulong>(theEmulators.size()), theSettings.baudRate, theSettings.latencyMilliseconds);
+
+    (void)fflush(stdout);
+    (void)fgets(theAnswer, sizeof(theAnswer), stdin);
+
+    (void)printf("\nTerminal        Commands   Unknown   Octets sent   Short   Dropped\n");
+
+    for (size_t thisEmulator = 0; thisEmulator < theEmulators.size(); thisEmulator++)
+    {
+        DeviceEmulator & r_Emulator = *theEmulators[thisEmulator];
+
+        StopDeviceEmulator(r_Emulator);
+
+        (void)printf("%-14s %9lu %9lu %13lu %7lu %9lu\n",
+            r_Emulator.hostPortName,
+            r_Emulator.statistics.commandCount.load(),
+            r_Emulator.statistics.unknownCommandCount.load(),
+            r_Emulator.statistics.octetsSent.load(),
+            r_Emulator.statistics.shortResponseCount.load(),
+            r_Emulator.statistics.droppedOctetCount.load());
+    }
+
+    return (theEmulators.size() == imageFileNames.size()) ? 0 : 1;
+#endif
+}
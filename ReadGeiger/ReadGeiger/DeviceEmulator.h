@@ -0,0 +1,97 @@
+// ----------------------------------------------------------------------
+// DeviceEmulator.h
+//
+// A software GMC-300E which answers the GQ-RFC1201 commands that this
+// program sends, serving the history data out of an archived FLASH
+// image. The emulator sits on the far end of a pseudo-terminal or a
+// socket pair so the program talks to it exactly as it would talk to a
+// Geiger Counter on a USB cable.
+//
+// The line speed is throttled to the baud rate, the device's response
+// latency may be set, and faults may be injected: responses which get
+// cut short and octets which get lost. The faults come from a seeded
+// generator so that a run may be repeated exactly.
+//
+// Pseudo-terminals and socket pairs are POSIX facilities so on Windows
+// only the command line operation exists, reporting that it is not
+// available.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include "Portable.h"
+
+#ifndef _WIN32
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "ReadGeiger.h"
+#include "Borrowed.h"
+
+#define EMULATOR_MODEL_AND_VERSION          "GMC-300Re 4.54"
+#define EMULATOR_DEFAULT_BAUD_RATE          static_cast<ulong>(57600)
+#define EMULATOR_DEFAULT_LATENCY            static_cast<ulong>(5)
+#define EMULATOR_DEFAULT_BLOCK_LENGTH       static_cast<ulong>(4096)
+#define EMULATOR_DEFAULT_COUNTS_PER_MINUTE  static_cast<ulong>(20)
+
+typedef enum emulator_link_t
+{
+    EmulatorLinkPseudoTerminal,     // The host opens the terminal named by hostPortName
+    EmulatorLinkSocketPair          // The host is handed hostDescriptor
+} EmulatorLink;
+
+typedef struct emulator_settings_t
+{
+    ulong baudRate;                 // Responses are paced to this rate, 0 for no throttling
+    ulong latencyMilliseconds;      // How long the device takes before it starts to answer
+    ulong maximumBlockLength;       // The longest history retrieval the firmware honours
+    ulong shortResponsePerMille;    // How often, out of 1000, a response gets cut short
+    ulong droppedOctetPerMille;     // How often, out of 1000, an octet gets lost
+    ulong countsPerMinute;          // The background rate behind GETCPM and the heartbeat
+    ulong randomSeed;               // Seeds the faults and the counts
+} EmulatorSettings;
+
+typedef struct emulator_statistics_t
+{
+    std::atomic<ulong> commandCount;        // Commands recognized and answered
+    std::atomic<ulong> unknownCommandCount; // Commands the emulator does not know
+    std::atomic<ulong> octetsSent;          // Octets written to the host after faults
+    std::atomic<ulong> shortResponseCount;  // Responses which were cut short on purpose
+    std::atomic<ulong> droppedOctetCount;   // Octets which were lost on purpose
+} EmulatorStatistics;
+
+typedef struct device_emulator_t
+{
+    EmulatorSettings   settings;            // How the emulated device behaves
+    EmulatorStatistics statistics;          // What the emulated device has done
+    std::vector<uchar> flashImage;          // The FLASH history image being served
+    uchar              serialNumber[7];     // What GETSERIAL answers with
+    CFG_Data           configuration;       // What GETCFG answers with
+    long long          clockOffsetSeconds;  // The device's clock less the host's clock
+    bool               isPoweredOn;         // false after POWEROFF until POWERON
+    bool               isHeartbeatOn;       // true after HEARTBEAT1 until HEARTBEAT0
+    EmulatorLink       theLink;             // What sort of link the host talks over
+    char               hostPortName[101];   // The terminal for the host to open, if any
+    int                hostDescriptor;      // The host's end of a socket pair, if any
+    int                deviceDescriptor;    // The emulator's end of the link
+    int                terminalDescriptor;  // Keeps the terminal open between host visits
+    std::vector<uchar> commandBuffer;       // Received octets not yet making a whole command
+    uint64_t           randomState;         // The fault generator's state
+    std::chrono::steady_clock::time_point lineFreeTime;      // When the last octet is off the wire
+    std::chrono::steady_clock::time_point nextHeartbeatTime; // When the next heartbeat is due
+    std::atomic<bool>  stopRequested;       // Set to make the service thread return
+    std::thread        serviceThread;       // Answers the commands
+} DeviceEmulator;
+
+extern void InitializeEmulatorSettings(EmulatorSettings & r_Settings);
+extern bool LoadDeviceEmulatorImage(DeviceEmulator & r_Emulator, const char * pch_FileName);
+extern bool SetDeviceEmulatorSerialNumber(DeviceEmulator & r_Emulator, const char * pch_SerialNumber);
+
+extern bool StartDeviceEmulator(DeviceEmulator & r_Emulator, EmulatorLink theLink);
+extern void StopDeviceEmulator(DeviceEmulator & r_Emulator);
+#endif
+
+extern int RunDeviceEmulator(int argc, char * argv[]);
@@ -0,0 +1,916 @@
+// ----------------------------------------------------------------------
+// DeviceSession.cpp
+//
+// The command layer and the history retrieval for one device. Nothing
+// in here touches anything but the session passed by argument, so any
+// number of sessions may run at the same time from different threads.
+//
+// Response times are taken with the standard steady clock rather than
+// the Windows performance counter so this module builds everywhere.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include "DeviceSession.h"
+#include "DownloadJournal.h"
+#include "FlashExport.h"
+#include "HistoryWriter.h"
+#include "SampleStore.h"
+#include "SyncCursor.h"
+
+using namespace std;
+
+/// <summary>
+/// The number of octets that each command responds with, consult GQ-GMC-ICD.odt.
+/// A length of 0 means that the length is carried in the command, as it is for
+/// the history retrieval. The last entry catches every other command, which is
+/// assumed to respond with as many octets as the caller's buffer holds.
+/// </summary>
+const CommandResponse commandResponseTable[COMMAND_RESPONSE_TABLE_SIZE] =
+{
+    { "<GETVER>>",      "GETVER",      static_cast<ulong>(14)  },
+    { "<GETSERIAL>>",   "GETSERIAL",   static_cast<ulong>(7)   },
+    { "<GETCFG>>",      "GETCFG",      static_cast<ulong>(256) },
+    { "<GETVOLT>>",     "GETVOLT",     static_cast<ulong>(1)   },
+    { "<GETTEMP>>",     "GETTEMP",     static_cast<ulong>(4)   },
+    { "<GETDATETIME>>", "GETDATETIME", static_cast<ulong>(7)   },
+    { "<GETCPM>>",      "GETCPM",      static_cast<ulong>(2)   },
+    { "<SPIR",          "SPIR",        RESPONSE_LENGTH_IN_COMMAND },
+    { nullptr,          "Other",       static_cast<ulong>(0)   }
+};
+
+/// <summary>
+/// Empties a session so that it holds nothing from any earlier device
+/// </summary>
+/// <param name="r_Session">The session to empty</param>
+void InitializeDeviceSession(DeviceSession & r_Session)
+{
+    (void)memset(&r_Session, 0, sizeof(r_Session));
+
+    r_Session.theConnection.isOpen = false;
+    r_Session.hasRawData           = false;
+    r_Session.displayProgress      = false;
+    r_Session.historyMismatched    = false;
+    r_Session.historyBlockLength   = MAX_DATA_READ_BLOCK_SIZE;
+    r_Session.historyBlockCeiling  = MAX_DATA_READ_BLOCK_SIZE;
+}
+
+/// <summary>
+/// Empties the session and opens the serial port passed by argument for it
+/// </summary>
+/// <param name="r_Session">The session to use</param>
+/// <param name="pch_PortName">"COM3" on Windows, "/dev/ttyUSB0" and the like elsewhere</param>
+/// <param name="baudRate">The bits per second, 57600 for the GQ GMC devices</param>
+/// <returns>true if the port was opened and configured, otherwise false</returns>
+bool OpenDeviceSession(DeviceSession & r_Session, const char * pch_PortName, ulong baudRate)
+{
+    InitializeDeviceSession(r_Session);
+
+    return OpenSerialConnection(pch_PortName, baudRate, r_Session.theConnection);
+}
+
+/// <summary>
+/// Closes the session's serial port
+/// </summary>
+void CloseDeviceSession(DeviceSession & r_Session)
+{
+    CloseSerialConnection(r_Session.theConnection);
+}
+
+/// <summary>
+/// Adds one command's response time to the statistics kept for that command
+/// </summary>
+/// <param name="r_Session">The session the command was sent on</param>
+/// <param name="whichResponse">The command's index in to the response table</param>
+/// <param name="theMilliseconds">How long it took for the response to be complete or the time allowed to run out</param>
+/// <param name="receivedLength">The number of octets received</param>
+/// <param name="expectedLength">The number of octets expected</param>
+static void RecordCommandLatency(DeviceSession & r_Session,
+    int whichResponse,
+    double theMilliseconds,
+    ulong receivedLength,
+    ulong expectedLength)
+{
+    CommandLatency & r_Latency = r_Session.commandLatency[whichResponse];
+
+    if (r_Latency.responseCount == static_cast<ulong>(0) || theMilliseconds < r_Latency.fastestMilliseconds)
+    {
+        r_Latency.fastestMilliseconds = theMilliseconds;
+    }
+
+    if (theMilliseconds > r_Latency.slowestMilliseconds)
+    {
+        r_Latency.slowestMilliseconds = theMilliseconds;
+    }
+
+    r_Latency.totalMilliseconds += theMilliseconds;
+    r_Latency.responseCount++;
+
+    // A response which did not fill the expected length waited for the whole time-out
+    if (receivedLength < expectedLength)
+    {
+        r_Latency.shortCount++;
+    }
+}
+
+/// <summary>
+/// Displays the response time statistics of each command which has been sent
+/// </summary>
+void DisplayCommandLatency(const DeviceSession & r_Session)
+{
+    (void)printf("\n\r\n\rCommand       Responses   Short   Fastest ms   Average ms   Slowest ms\n\r");
+
+    for (int thisEntry = static_cast<int>(0); thisEntry < COMMAND_RESPONSE_TABLE_SIZE; thisEntry++)
+    {
+        const CommandLatency & r_Latency = r_Session.commandLatency[thisEntry];
+
+        if (r_Latency.responseCount > static_cast<ulong>(0))
+        {
+            (void)printf("%-12s %10lu %7lu %12.1f %12.1f %12.1f\n\r",
+                commandResponseTable[thisEntry].pch_CommandName,
+                r_Latency.responseCount,
+                r_Latency.shortCount,
+                r_Latency.fastestMilliseconds,
+                r_Latency.totalMilliseconds / static_cast<double>(r_Latency.responseCount),
+                r_Latency.slowestMilliseconds);
+        }
+    }
+
+    (void)printf("\n\r");
+}
+
+/// <summary>
+/// Finds the entry of the response table describing the command passed by argument,
+/// or the catch-all entry at the end of the table if the command is not listed
+/// </summary>
+/// <param name="thisCommand">The command about to be sent</param>
+/// <returns>The index in to the response table</returns>
+static int FindCommandResponse(const char * thisCommand)
+{
+    int thisEntry = static_cast<int>(0);
+
+    while (nullptr != commandResponseTable[thisEntry].pch_CommandPrefix)
+    {
+        if (0 == strncmp(thisCommand,
+            commandResponseTable[thisEntry].pch_CommandPrefix,
+            strlen(commandResponseTable[thisEntry].pch_CommandPrefix)))
+        {
+            break;
+        }
+
+        thisEntry++;
+    }
+
+    return thisEntry;
+}
+
+/// <summary>
+/// Works out how long to wait for a response of the length passed by argument: the
+/// time the device may take before it starts answering plus twice the time that the
+/// octets take on the wire at the session's baud rate, ten bits to the octet.
+/// </summary>
+/// <param name="r_Session">The session the response comes in on</param>
+/// <param name="expectedLength">The number of octets expected</param>
+/// <returns>The number of milliseconds to wait</returns>
+static ulong ComputeResponseTimeout(const DeviceSession & r_Session, ulong expectedLength)
+{
+    ulong wireMilliseconds = ((expectedLength * static_cast<ulong>(10) * static_cast<ulong>(1000)) / r_Session.theConnection.baudRate) + 1;
+
+    return RESPONSE_TURNAROUND_MILLISECONDS + (wireMilliseconds * 2);
+}
+
+/// <summary>
+/// How long the line must be silent for before the device is considered to have
+/// finished sending, a few character times at the connection's baud rate
+/// </summary>
+static ulong ComputeLineIdleMilliseconds(const DeviceSession & r_Session)
+{
+    return ((LINE_IDLE_CHARACTER_TIMES * static_cast<ulong>(10) * static_cast<ulong>(1000)) / r_Session.theConnection.baudRate) + 1;
+}
+
+/// <summary>
+/// Works out how many octets the response to the command passed by argument has,
+/// consulting the response table, and never more than the receive buffer holds
+/// </summary>
+/// <param name="whichResponse">The command's index in to the response table</param>
+/// <param name="thisCommand">The command about to be sent</param>
+/// <param name="maxReceiveCount">The number of octets the receive buffer holds</param>
+/// <returns>The number of octets to wait for</returns>
+static ulong GetExpectedResponseLength(int whichResponse, const char * thisCommand, ulong maxReceiveCount)
+{
+    ulong expectedLength = commandResponseTable[whichResponse].expectedLength;
+
+    // History retrievals carry the length in the command itself
+    if (expectedLength == RESPONSE_LENGTH_IN_COMMAND)
+    {
+        expectedLength = (static_cast<ulong>((uchar)thisCommand[8]) << 8) | (uchar)thisCommand[9];
+    }
+
+    if (expectedLength == static_cast<ulong>(0) || expectedLength > maxReceiveCount)
+    {
+        expectedLength = maxReceiveCount;
+    }
+
+    return expectedLength;
+}
+
+/// <summary>
+/// Sends a command a single time and waits for as much of its response as arrives in
+/// the time allowed. Anything the device sent which nobody read, such as the 0xAA
+/// which some commands answer with, is discarded before the command is sent, and the
+/// time from sending the command to having the response is recorded.
+/// </summary>
+/// <param name="r_Session">The session to send the command on</param>
+/// <param name="whichResponse">The command's index in to the response table</param>
+/// <param name="thisCommand">The command to send to the device</param>
+/// <param name="numberOfBytesToSend">The number of bytes in the command</param>
+/// <param name="inToThisReceiveBuffer">A buffer which will contain the received response</param>
+/// <param name="expectedLength">The number of octets to wait for, 0 for no response</param>
+/// <param name="r_ReceivedLength">Returns the number of octets received</param>
+/// <returns>true if the command was sent, otherwise false</returns>
+static bool SendCommandOnce(DeviceSession & r_Session,
+    int whichResponse,
+    const char * thisCommand,
+    ulong numberOfBytesToSend,
+    char * inToThisReceiveBuffer,
+    ulong expectedLength,
+    ulong & r_ReceivedLength)
+{
+    r_ReceivedLength = static_cast<ulong>(0);
+
+    r_Session.commandCount++;
+
+    // Throw away anything left over from an earlier command
+    DiscardSerialInput(r_Session.theConnection);
+
+    chrono::steady_clock::time_point sendTime = chrono::steady_clock::now();
+
+    // Send the command
+    if (false == SendSerialData(r_Session.theConnection, thisCommand, numberOfBytesToSend))
+    {
+        return false;
+    }
+
+    // Are we expecting a response from the device?
+    if (expectedLength == static_cast<ulong>(0))
+    {
+        return true;
+    }
+
+    r_ReceivedLength = ReceiveSerialData(r_Session.theConnection,
+        inToThisReceiveBuffer,
+        expectedLength,
+        ComputeResponseTimeout(r_Session, expectedLength));
+
+    RecordCommandLatency(r_Session,
+        whichResponse,
+        chrono::duration<double, milli>(chrono::steady_clock::now() - sendTime).count(),
+        r_ReceivedLength,
+        expectedLength);
+
+    r_Session.octetsReceived += r_ReceivedLength;
+
+    return true;
+}
+
+/// <summary>
+/// This functon will send a command passed to it by argument and will read the
+/// response from the device, if one is expected. The number of octets to expect
+/// comes from the response table so the response is complete as soon as they have
+/// arrived.
+/// </summary>
+/// <param name="r_Session">The session to send the command on</param>
+/// <param name="thisCommand">The command to send to the device</param>
+/// <param name="numberOfBytesToSend">The number of bytes in the command</param>
+/// <param name="inToThisReceiveBuffer">A buffer which will contain the received response, if any</param>
+/// <param name="maxReceiveCount">The maximum number of bytes which the receive buffer may hold, 0 for no response</param>
+/// <returns>true if a response was received or none was expected, otherwise false</returns>
+bool SendCommandAndGetResponse(DeviceSession & r_Session,
+    const char * thisCommand,
+    ulong numberOfBytesToSend,
+    char * inToThisReceiveBuffer,
+    ulong maxReceiveCount)
+{
+    bool  theReturnResult = false;
+    ulong expectedLength  = static_cast<ulong>(0);
+    ulong receivedLength  = static_cast<ulong>(0);
+    int   whichResponse   = static_cast<int>(0);
+
+    // Make sure that we have a valid command to send
+    if (thisCommand == nullptr || numberOfBytesToSend == static_cast<ulong>(0))
+    {
+        return false;
+    }
+
+    whichResponse = FindCommandResponse(thisCommand);
+
+    // Are we expecting a response from the device, and how long is it?
+    if (inToThisReceiveBuffer != nullptr && maxReceiveCount > static_cast<ulong>(0))
+    {
+        expectedLength = GetExpectedResponseLength(whichResponse, thisCommand, maxReceiveCount);
+    }
+
+    // In the event we do not get a response and we expect one, we re-send and try again
+    for (int thisAttempt = static_cast<int>(0); thisAttempt < MAX_COMMAND_RETRIES; thisAttempt++)
+    {
+        if (thisAttempt > 0)
+        {
+            r_Session.retryCount++;
+        }
+
+        if (false == SendCommandOnce(r_Session,
+            whichResponse,
+            thisCommand,
+            numberOfBytesToSend,
+            inToThisReceiveBuffer,
+            expectedLength,
+            receivedLength))
+        {
+            continue;
+        }
+
+        // See if there was a response, or none was expected. Any response is considered acceptable
+        if (expectedLength == static_cast<ulong>(0) || receivedLength > static_cast<ulong>(0))
+        {
+            theReturnResult = true;
+            break;
+        }
+    }
+
+    if (false == theReturnResult)
+    {
+        r_Session.failureCount++;
+    }
+
+    // Report on whether a response was received or not
+    return theReturnResult;
+}
+
+/// <summary>
+/// Retrieves the device's model and version in to the session
+/// </summary>
+bool AcquireSessionModelAndVersion(DeviceSession & r_Session)
+{
+    (void)memset(r_Session.modelAndVersion, 0, sizeof(r_Session.modelAndVersion));
+
+    return SendCommandAndGetResponse(r_Session,
+        CommandGetModelAndVersion,
+        strlen(CommandGetModelAndVersion),
+        r_Session.modelAndVersion,
+        sizeof(r_Session.modelAndVersion) - 1);
+}
+
+/// <summary>
+/// Retrieves the device's serial number in to the session, both as the octets the
+/// device sent and as hexadecimal text. The text is left empty if the device did not
+/// answer so that an earlier device's serial number is never used for this one.
+/// </summary>
+bool AcquireSessionSerialNumber(DeviceSession & r_Session)
+{
+    r_Session.serialNumberText[0] = 0x00;
+
+    if (false == SendCommandAndGetResponse(r_Session,
+        CommandGetSerialNumber,
+        strlen(CommandGetSerialNumber),
+        r_Session.serialNumber,
+        sizeof(r_Session.serialNumber)))
+    {
+        return false;
+    }
+
+    FormatDeviceSerialNumber((const uchar *)r_Session.serialNumber, r_Session.serialNumberText, sizeof(r_Session.serialNumberText));
+
+    return true;
+}
+
+/// <summary>
+/// Turns the device's heartbeat on or off. While it is on the device sends the counts
+/// of each second as they happen, two octets a second, which would be mistaken for the
+/// response to any other command, so once it has been turned off this waits for a quiet
+/// time longer than a heartbeat apart to be sure that the last one has arrived.
+/// </summary>
+/// <param name="r_Session">The session</param>
+/// <param name="turnOn">true to start the heartbeat, false to stop it</param>
+/// <returns>true if the command was sent, otherwise false</returns>
+bool SetSessionHeartbeat(DeviceSession & r_Session, bool turnOn)
+{
+    const char * pch_Command = (true == turnOn) ? CommandTurnOnHeartbeat : CommandTurnOffHeartbeat;
+
+    if (false == SendCommandAndGetResponse(r_Session, pch_Command, strlen(pch_Command), nullptr, static_cast<ulong>(0)))
+    {
+        return false;
+    }
+
+    if (false == turnOn)
+    {
+        (void)WaitForSerialLineIdle(r_Session.theConnection, HEARTBEAT_QUIET_MILLISECONDS, HEARTBEAT_QUIET_PERIODS);
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Retrieves the device's configuration in to the session
+/// </summary>
+bool AcquireSessionConfiguration(DeviceSession & r_Session)
+{
+    return SendCommandAndGetResponse(r_Session,
+        CommandGetConfiguration,
+        strlen(CommandGetConfiguration),
+        (char *)&r_Session.configuration,
+        sizeof(r_Session.configuration));
+}
+
+/// <summary>
+/// Returns the dataSaveAddress from the configuration last retrieved
+/// </summary>
+ulong GetSessionSaveAddress(const DeviceSession & r_Session)
+{
+    return (static_cast<ulong>(r_Session.configuration.dataSaveAddress2) << 16) |
+        (static_cast<ulong>(r_Session.configuration.dataSaveAddress1) << 8) |
+        static_cast<ulong>(r_Session.configuration.dataSaveAddress0);
+}
+
+/// <summary>
+/// Asks the device for part of its history data once, and stores it at the same
+/// address in the session's copy of the FLASH image only if every octet asked for
+/// arrived. A short block cannot be trusted at all since an octet lost part way
+/// through moves everything after it.
+/// </summary>
+/// <param name="r_Session">The session to retrieve for</param>
+/// <param name="blockAddress">The FLASH address to start retrieving from</param>
+/// <param name="blockLength">The number of octets to retrieve, no more than MAX_DATA_READ_BLOCK_SIZE</param>
+/// <param name="r_ReceivedLength">Returns the number of octets which arrived</param>
+/// <returns>true if the whole block was retrieved, otherwise false</returns>
+bool RetrieveSessionHistoryBlock(DeviceSession & r_Session, ulong blockAddress, ulong blockLength, ulong & r_ReceivedLength)
+{
+    char thisCommandString[sizeof(COMMAND_GET_HISTORY) + 1] = { 0 };
+
+    r_ReceivedLength = static_cast<ulong>(0);
+
+    // Get the data retrieval command and make a copy that we may modify locally
+    (void)strcpy_s(thisCommandString, COMMAND_GET_HISTORY);
+
+    // Plug the address to retrieve
+    thisCommandString[5] = (uchar)((blockAddress >> 16) & 0x000000ff);
+    thisCommandString[6] = (uchar)((blockAddress >> 8)  & 0x000000ff);
+    thisCommandString[7] = (uchar)((blockAddress >> 0)  & 0x000000ff);
+
+    // Plug the length of the retrieval
+    thisCommandString[8] = (uchar)((blockLength >> 8) & 0x00ff);
+    thisCommandString[9] = (uchar)((blockLength >> 0) & 0x00ff);
+
+    // Send the command to the device and retrieve the block of data as a response
+    if (false == SendCommandOnce(r_Session,
+        FindCommandResponse(thisCommandString),
+        thisCommandString,
+        sizeof(COMMAND_GET_HISTORY),
+        r_Session.receivedData,
+        blockLength,
+        r_ReceivedLength) || r_ReceivedLength != blockLength)
+    {
+        return false;
+    }
+
+    // Never store past the end of the local FLASH image
+    if (blockAddress + blockLength > FLASH_IMAGE_SIZE)
+    {
+        blockLength = FLASH_IMAGE_SIZE - blockAddress;
+    }
+
+    (void)memcpy(&r_Session.flashImage[blockAddress], r_Session.receivedData, blockLength);
+
+    return true;
+}
+
+/// <summary>
+/// Retrieves a range of the device's history data a block at a time using the block
+/// length negotiated so far. Only a block which comes back short or not at all gets
+/// asked for again, and one which keeps on failing is split in to smaller blocks down
+/// to MIN_DATA_READ_BLOCK_SIZE, each of which is retried on its own.
+///
+/// The block length is negotiated along the way. Splitting a block lowers it for the
+/// rest of the session, and after enough good blocks in a row it is doubled again up
+/// to the largest block the device has been seen to deliver. A device which keeps on
+/// answering with the same shorter length, a multiple of MIN_DATA_READ_BLOCK_SIZE, is
+/// taken to be capping its responses there.
+/// </summary>
+/// <param name="r_Session">The session to retrieve for</param>
+/// <param name="rangeAddress">The FLASH address to start retrieving from</param>
+/// <param name="rangeLength">The number of octets to retrieve</param>
+/// <returns>true if the whole range was retrieved, otherwise false</returns>
+bool RetrieveSessionHistoryRange(DeviceSession & r_Session, ulong rangeAddress, ulong rangeLength)
+{
+    ulong rangeEnd        = rangeAddress + rangeLength;
+    ulong thisAddress     = rangeAddress;
+    ulong thisLength      = r_Session.historyBlockLength;
+    ulong failedAttempts  = static_cast<ulong>(0);
+    ulong lastShortLength = static_cast<ulong>(0);
+
+    while (thisAddress < rangeEnd)
+    {
+        ulong receivedLength = static_cast<ulong>(0);
+
+        if (thisLength > rangeEnd - thisAddress)
+        {
+            thisLength = rangeEnd - thisAddress;
+        }
+
+        if (true == RetrieveSessionHistoryBlock(r_Session, thisAddress, thisLength, receivedLength))
+        {
+            thisAddress    += thisLength;
+            failedAttempts  = static_cast<ulong>(0);
+            lastShortLength = static_cast<ulong>(0);
+
+            // Try for larger blocks again once the link has behaved for a while
+            if (++r_Session.goodBlockCount >= BLOCK_GROWTH_AFTER_SUCCESSES &&
+                r_Session.historyBlockLength < r_Session.historyBlockCeiling)
+            {
+                r_Session.historyBlockLength = r_Session.historyBlockLength * static_cast<ulong>(2);
+
+                if (r_Session.historyBlockLength > r_Session.historyBlockCeiling)
+                {
+                    r_Session.historyBlockLength = r_Session.historyBlockCeiling;
+                }
+
+                r_Session.goodBlockCount = static_cast<ulong>(0);
+            }
+
+            continue;
+        }
+
+        r_Session.badBlockCount++;
+        r_Session.retryCount++;
+        r_Session.goodBlockCount = static_cast<ulong>(0);
+
+        failedAttempts++;
+
+        // Let whatever the device was still sending finish before asking again
+        (void)WaitForSerialLineIdle(r_Session.theConnection, ComputeLineIdleMilliseconds(r_Session), LINE_IDLE_MAXIMUM_PERIODS);
+
+        if (receivedLength >= MIN_DATA_READ_BLOCK_SIZE && receivedLength < thisLength && receivedLength == lastShortLength &&
+            static_cast<ulong>(0) == receivedLength % MIN_DATA_READ_BLOCK_SIZE)
+        {
+            // The same whole number of small blocks twice running is the device's limit rather than noise
+            r_Session.historyBlockCeiling = receivedLength;
+            r_Session.historyBlockLength  = receivedLength;
+
+            thisLength     = receivedLength;
+            failedAttempts = static_cast<ulong>(0);
+
+            if (true == r_Session.displayProgress)
+            {
+                (void)printf("\n\rThe device delivers at most %lu octets at a time\n\r", receivedLength);
+            }
+        }
+        else if (failedAttempts >= BLOCK_ATTEMPTS_BEFORE_SPLITTING && thisLength > MIN_DATA_READ_BLOCK_SIZE)
+        {
+            // Ask for half as much at a time, from here on
+            thisLength = thisLength / static_cast<ulong>(2);
+
+            if (thisLength < MIN_DATA_READ_BLOCK_SIZE)
+            {
+                thisLength = MIN_DATA_READ_BLOCK_SIZE;
+            }
+
+            r_Session.historyBlockLength = thisLength;
+            r_Session.splitBlockCount++;
+
+            failedAttempts = static_cast<ulong>(0);
+
+            if (true == r_Session.displayProgress)
+            {
+                (void)printf("\n\rRetrieving %lu octets at a time from address %06lx\n\r", thisLength, thisAddress);
+            }
+        }
+        else if (failedAttempts >= BLOCK_ATTEMPTS_AT_MINIMUM && thisLength <= MIN_DATA_READ_BLOCK_SIZE)
+        {
+            // Even the smallest block could not be retrieved
+            r_Session.failureCount++;
+
+            return false;
+        }
+
+        lastShortLength = receivedLength;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Checks that the device still holds the history the local image was copied from, by
+/// retrieving the first octets of its FLASH and the octets just before where the data
+/// ended last time again and comparing them with the local image. A device which was
+/// erased and has since written past where it was, or another device answering with
+/// the same serial number, does not match.
+/// </summary>
+/// <param name="r_Session">The session, whose image holds the local image</param>
+/// <param name="fetchAddress">Where the retrieval would start, see GetSyncStartAddress()</param>
+/// <returns>true if both ranges match, false if either does not or could not be retrieved</returns>
+static bool IsSyncHistoryMatching(DeviceSession & r_Session, ulong fetchAddress)
+{
+    const ulong checkAddresses[2] = { static_cast<ulong>(0), fetchAddress };
+    uchar       localOctets[SYNC_OVERLAP_OCTETS];
+
+    for (ulong thisCheck = 0; thisCheck < 2; thisCheck++)
+    {
+        ulong checkAddress = checkAddresses[thisCheck];
+
+        (void)memcpy(localOctets, &r_Session.flashImage[checkAddress], SYNC_OVERLAP_OCTETS);
+
+        if (false == RetrieveSessionHistoryRange(r_Session, checkAddress, SYNC_OVERLAP_OCTETS))
+        {
+            return false;
+        }
+
+        if (0 != memcmp(localOctets, &r_Session.flashImage[checkAddress], SYNC_OVERLAP_OCTETS))
+        {
+            return false;
+        }
+
+        (void)WaitForSerialLineIdle(r_Session.theConnection, ComputeLineIdleMilliseconds(r_Session), LINE_IDLE_MAXIMUM_PERIODS);
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Retrieves only the history data that the device has written since it was last
+/// visited. The device's serial number selects a local copy of its FLASH image and a
+/// cursor recording where the history data ended last time, see SyncCursor.cpp.
+/// Retrieval starts there and continues a block at a time until the end of the data
+/// is seen, and the new data gets spliced in to the session's copy.
+///
+/// When there is no cursor, when the configuration could not be retrieved, when the
+/// device's dataSaveAddress has gone backwards since the last visit because the
+/// history was erased, or when the start of the FLASH or the octets before where the
+/// data ended last time are not what the local image holds, the cursor and any journal
+/// are discarded and everything is retrieved starting from address 0.
+///
+/// Each block is handed to a writer thread which stores it in the local image file
+/// while the next block is being retrieved, and the next retrieval command is sent
+/// as soon as the device has stopped sending rather than after a fixed pause, so the
+/// retrieval takes about as long as the octets take to cross the link.
+///
+/// The blocks go to a partial file with a journal of them, and only once the end of
+/// the data has been reached does the partial file become the local image. When an
+/// earlier visit was interrupted, retrieval resumes after the last of its blocks
+/// which can be shown to be whole, see DownloadJournal.cpp.
+///
+/// The serial number must have been retrieved first. Without one there is no telling
+/// which local image belongs to the device, so no cursor, journal or local image is
+/// read or written and everything is retrieved starting from address 0.
+/// </summary>
+/// <param name="r_Session">The session to retrieve for</param>
+/// <returns>true if the data retrieval was successful, otherwise false</returns>
+bool SyncSessionHistory(DeviceSession & r_Session)
+{
+    SyncCursor      theCursor;
+    DownloadJournal theJournal;
+    HistoryWriter   theWriter;
+    ulong           deviceSaveAddress = static_cast<ulong>(0);
+    ulong           fetchAddress      = static_cast<ulong>(0);
+    ulong           startAddress      = static_cast<ulong>(0);
+    ulong           endOfData         = static_cast<ulong>(0);
+    bool            haveSaveAddress   = false;
+    bool            haveSerialNumber  = (0x00 != r_Session.serialNumberText[0]);
+    bool            haveWriter        = false;
+    bool            imageStored       = false;
+
+    // The dataSaveAddress tells us whether the history has been erased since last time
+    haveSaveAddress = AcquireSessionConfiguration(r_Session);
+
+    if (true == haveSaveAddress)
+    {
+        deviceSaveAddress = GetSessionSaveAddress(r_Session);
+    }
+    else if (true == r_Session.displayProgress)
+    {
+        (void)printf("Unable to acquire the device's configuration, retrieving everything\n\r");
+    }
+
+    if (false == haveSerialNumber && true == r_Session.displayProgress)
+    {
+        (void)printf("The device's serial number is not known, retrieving everything\n\r");
+    }
+
+    // Load what we had from the last visit, if anything
+    if (true == haveSerialNumber)
+    {
+        (void)LoadSyncCursor(r_Session.serialNumberText, theCursor, r_Session.flashImage, FLASH_IMAGE_SIZE);
+    }
+
+    if (true == haveSaveAddress && true == haveSerialNumber)
+    {
+        fetchAddress = GetSyncStartAddress(theCursor, deviceSaveAddress);
+    }
+
+    if (fetchAddress > static_cast<ulong>(0) && false == IsSyncHistoryMatching(r_Session, fetchAddress))
+    {
+        if (true == r_Session.displayProgress)
+        {
+            (void)printf("Device %s history does not match the local copy, retrieving everything\n\r", r_Session.serialNumberText);
+        }
+
+        DiscardSyncCursor(r_Session.serialNumberText);
+
+        r_Session.historyMismatched = true;
+
+        fetchAddress = static_cast<ulong>(0);
+    }
+
+    if (fetchAddress == static_cast<ulong>(0))
+    {
+        // Starting over, so the local image looks like erased FLASH
+        (void)memset(r_Session.flashImage, 0xFF, FLASH_IMAGE_SIZE);
+    }
+
+    // An interrupted visit may have got further than that
+    if (true == haveSaveAddress && true == haveSerialNumber &&
+        true == LoadDownloadJournal(r_Session.serialNumberText, deviceSaveAddress, fetchAddress, theJournal, r_Session.flashImage, FLASH_IMAGE_SIZE))
+    {
+        fetchAddress = theJournal.resumeAddress;
+
+        if (true == r_Session.displayProgress)
+        {
+            (void)printf("Resuming an interrupted retrieval, %lu blocks were already retrieved\n\r", theJournal.blockCount);
+        }
+    }
+
+    if (true == r_Session.displayProgress && true == haveSerialNumber)
+    {
+        (void)printf("Device %s history starts at address %06lx this visit\n\r", r_Session.serialNumberText, fetchAddress);
+    }
+
+    if (true == haveSerialNumber)
+    {
+        haveWriter = StartHistoryWriter(theWriter, r_Session.serialNumberText, deviceSaveAddress, r_Session.flashImage, FLASH_IMAGE_SIZE);
+    }
+
+    // What we already had is written while the first block is being retrieved
+    if (true == haveWriter)
+    {
+        (void)QueueHistoryBlock(theWriter, static_cast<ulong>(0), fetchAddress);
+    }
+
+    startAddress = fetchAddress;
+
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    while (fetchAddress < FLASH_IMAGE_SIZE)
+    {
+        ulong fetchLength = r_Session.historyBlockLength;
+
+        if (fetchLength > FLASH_IMAGE_SIZE - fetchAddress)
+        {
+            fetchLength = FLASH_IMAGE_SIZE - fetchAddress;
+        }
+
+        if (true == r_Session.displayProgress)
+        {
+            (void)printf("Retrieving %lu octets at address %06lx\r", fetchLength, fetchAddress);
+        }
+
+        if (false == RetrieveSessionHistoryRange(r_Session, fetchAddress, fetchLength))
+        {
+            if (true == haveWriter)
+            {
+                (void)FinishHistoryWriter(theWriter, false);
+            }
+
+            return false;
+        }
+
+        if (true == haveWriter)
+        {
+            (void)QueueHistoryBlock(theWriter, fetchAddress, fetchLength);
+        }
+
+        fetchAddress += fetchLength;
+
+        // Stop once the end of the data is inside of what has been retrieved
+        endOfData = FindEndOfHistoryData(r_Session.flashImage, FLASH_IMAGE_SIZE);
+
+        if (endOfData < fetchAddress)
+        {
+            break;
+        }
+
+        // Before sending the next retrieval command, wait for the device to stop sending
+        (void)WaitForSerialLineIdle(r_Session.theConnection, ComputeLineIdleMilliseconds(r_Session), LINE_IDLE_MAXIMUM_PERIODS);
+    }
+
+    double elapsedSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    if (true == r_Session.displayProgress)
+    {
+        ulong retrievedOctets = fetchAddress - startAddress;
+
+        (void)printf("\n\rRetrieved %lu octets in %.2f seconds, the link alone needs %.2f seconds\n\r",
+            retrievedOctets,
+            elapsedSeconds,
+            static_cast<double>(retrievedOctets * static_cast<ulong>(10)) / static_cast<double>(r_Session.theConnection.baudRate));
+    }
+
+    // Remember where this visit ended for next time
+    theCursor.endOfDataAddress = FindEndOfHistoryData(r_Session.flashImage, FLASH_IMAGE_SIZE);
+    theCursor.saveAddress      = deviceSaveAddress;
+    theCursor.prefixHash       = HashJournalBlock(r_Session.flashImage, theCursor.endOfDataAddress);
+
+    // Whatever was not retrieved this visit is still part of the image, and the image
+    // must be in place before the cursor that describes it
+    if (true == haveWriter)
+    {
+        (void)QueueHistoryBlock(theWriter, fetchAddress, FLASH_IMAGE_SIZE - fetchAddress);
+
+        imageStored = FinishHistoryWriter(theWriter, true);
+    }
+
+    if (true == haveSerialNumber &&
+        (false == imageStored || false == SaveSyncCursorRecord(theCursor)) && true == r_Session.displayProgress)
+    {
+        (void)printf("\n\rError: I was unable to store the sync cursor for device %s\n\r", r_Session.serialNumberText);
+    }
+
+    r_Session.hasRawData = true;
+
+    return true;
+}
+
+/// <summary>
+/// Writes the session's FLASH image to the raw data file named by argument. The file
+/// is written under a temporary name and then put in place so that it is never seen
+/// half written.
+/// </summary>
+/// <param name="r_Session">The session whose image is written</param>
+/// <param name="pch_FileName">The *.ReadGeiger.bin file to create</param>
+/// <returns>true if the file was written, otherwise false</returns>
+bool WriteSessionImageFile(const DeviceSession & r_Session, const char * pch_FileName)
+{
+    FILE * pOutputFile            = nullptr;
+    char   temporaryFileName[301] = { 0 };
+    bool   wasWritten             = false;
+
+    BuildTemporaryFileName(pch_FileName, temporaryFileName, sizeof(temporaryFileName));
+
+    if (0 == fopen_s(&pOutputFile, temporaryFileName, "wb"))
+    {
+        wasWritten = (1 == fwrite(r_Session.flashImage, FLASH_IMAGE_SIZE, 1, pOutputFile));
+
+        wasWritten = (0 == fclose(pOutputFile)) && wasWritten;
+    }
+
+    if (false == wasWritten || false == CommitFileAtomically(temporaryFileName, pch_FileName))
+    {
+        (void)remove(temporaryFileName);
+
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Builds the local date and time text which the names of the output files start
+/// with, "04Jun23.08.24.55" for example
+/// </summary>
+/// <param name="pch_Buffer">Returns the NULL-terminated text</param>
+/// <param name="bufferSize">The size of that buffer, 31 octets is plenty</param>
+void FormatHarvestTimeStamp(char * pch_Buffer, size_t bufferSize)
+{
+    time_t    currentTime = time(NULL);
+    struct tm currentLocalTime;
+
+    (void)localtime_s(&currentLocalTime, &currentTime);
+
+    (void)sprintf_s(pch_Buffer, bufferSize, "%02u%s%02u.%02u.%02u.%02u",
+        currentLocalTime.tm_mday,
+        theMonths[currentLocalTime.tm_mon],
+        currentLocalTime.tm_year - 100,
+        currentLocalTime.tm_hour,
+        currentLocalTime.tm_min,
+        currentLocalTime.tm_sec);
+}
+
+/// <summary>
+/// The current local date and time as seconds since 1970, the same way the device's
+/// own date/time stamps are taken
+/// </summary>
+/// <returns>The local date and time, as if it were UTC</returns>
+long long GetLocalEpochSeconds(void)
+{
+    time_t    currentTime = time(NULL);
+    struct tm currentLocalTime;
+
+    (void)localtime_s(&currentLocalTime, &currentTime);
+
+    return EpochFromCivil(static_cast<ulong>(currentLocalTime.tm_year + 1900),
+        static_cast<ulong>(currentLocalTime.tm_mon + 1),
+        static_cast<ulong>(currentLocalTime.tm_mday),
+        static_cast<ulong>(currentLocalTime.tm_hour),
+        static_cast<ulong>(currentLocalTime.tm_min),
+        static_cast<ulong>(currentLocalTime.tm_sec));
+}
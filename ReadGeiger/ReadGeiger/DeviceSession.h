@@ -0,0 +1,98 @@
+// ----------------------------------------------------------------------
+// DeviceSession.h
+//
+// Everything that belongs to one conversation with one Geiger Counter:
+// the serial connection, what the device told us about itself, the
+// local copy of its FLASH history image and the response times of its
+// commands. The console program has a single session while the fleet
+// harvester has one per device, each driven from its own thread.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include "Portable.h"
+#include "ReadGeiger.h"
+#include "Borrowed.h"
+#include "SerialTransport.h"
+
+// The number of entries in the response table, the last being the catch-all
+#define COMMAND_RESPONSE_TABLE_SIZE     static_cast<int>(9)
+
+/// <summary>
+/// Describes the response to a command: the start of the command string which
+/// identifies it, the name to report it by, and how many octets it responds with
+/// </summary>
+typedef struct command_response_t
+{
+    const char * pch_CommandPrefix;         // The start of the command, nullptr for the catch-all
+    const char * pch_CommandName;           // The name used when reporting response times
+    ulong        expectedLength;            // The number of octets in the response
+} CommandResponse;
+
+/// <summary>
+/// How long the device has taken to respond to one of the commands
+/// </summary>
+typedef struct command_latency_t
+{
+    ulong  responseCount;                   // The number of times a response was waited for
+    ulong  shortCount;                      // How many of those ended with fewer octets than expected
+    double totalMilliseconds;               // The total time spent waiting
+    double fastestMilliseconds;             // The quickest response
+    double slowestMilliseconds;             // The slowest response
+} CommandLatency;
+
+typedef struct device_session_t
+{
+    SerialConnection theConnection;                                 // The communication channel to the device
+    char             modelAndVersion[21];                           // Usually 14 bytes
+    char             serialNumber[11];                              // Usually 7 bytes
+    char             serialNumberText[15];                          // The serial number as hexadecimal text
+    char             temperature[11];                               // Usually 4 bytes
+    char             batteryVoltage[11];                            // Usually 1 byte
+    char             dateAndTime[11];                               // Usually 7 bytes
+    CFG_Data         configuration;                                 // Documentation says to expect 256 bytes
+    char             receivedData[MAX_DATA_READ_BLOCK_SIZE + 0x100];// Maximum receive frame
+    uchar            flashImage[FLASH_IMAGE_SIZE];                  // Stores the entire FLASH data
+    bool             hasRawData;                                    // true once flashImage holds the device's history
+    bool             displayProgress;                               // true to report each block as it is retrieved
+    bool             historyMismatched;                             // true if the local image no longer matched the device's history
+    ulong            octetsReceived;                                // Every octet the device has sent
+    ulong            commandCount;                                  // Every command sent, retries included
+    ulong            retryCount;                                    // Commands which had to be sent again
+    ulong            failureCount;                                  // Commands which never got a response
+    ulong            historyBlockLength;                            // The history block length negotiated so far
+    ulong            historyBlockCeiling;                           // The largest history block the device delivers
+    ulong            goodBlockCount;                                // History blocks retrieved whole in a row
+    ulong            badBlockCount;                                 // History blocks which came back short or not at all
+    ulong            splitBlockCount;                               // Times the history block length had to be halved
+    CommandLatency   commandLatency[COMMAND_RESPONSE_TABLE_SIZE];   // How long each command took to respond
+} DeviceSession;
+
+extern const CommandResponse commandResponseTable[COMMAND_RESPONSE_TABLE_SIZE];
+
+extern void InitializeDeviceSession(DeviceSession & r_Session);
+extern bool OpenDeviceSession(DeviceSession & r_Session, const char * pch_PortName, ulong baudRate);
+extern void CloseDeviceSession(DeviceSession & r_Session);
+
+extern bool SendCommandAndGetResponse(DeviceSession & r_Session,
+    const char * thisCommand,
+    ulong numberOfBytesToSend,
+    char * inToThisReceiveBuffer,
+    ulong maxReceiveCount);
+extern void DisplayCommandLatency(const DeviceSession & r_Session);
+
+extern bool AcquireSessionModelAndVersion(DeviceSession & r_Session);
+extern bool AcquireSessionSerialNumber(DeviceSession & r_Session);
+extern bool AcquireSessionConfiguration(DeviceSession & r_Session);
+extern bool SetSessionHeartbeat(DeviceSession & r_Session, bool turnOn);
+extern ulong GetSessionSaveAddress(const DeviceSession & r_Session);
+
+extern bool RetrieveSessionHistoryBlock(DeviceSession & r_Session, ulong blockAddress, ulong blockLength, ulong & r_ReceivedLength);
+extern bool RetrieveSessionHistoryRange(DeviceSession & r_Session, ulong rangeAddress, ulong rangeLength);
+extern bool SyncSessionHistory(DeviceSession & r_Session);
+extern bool WriteSessionImageFile(const DeviceSession & r_Session, const char * pch_FileName);
+
+extern void FormatHarvestTimeStamp(char * pch_Buffer, size_t bufferSize);
+extern long long GetLocalEpochSeconds(void);
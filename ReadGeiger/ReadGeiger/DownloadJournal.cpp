@@ -0,0 +1,187 @@
+// ----------------------------------------------------------------------
+// DownloadJournal.cpp
+//
+// The journal is text, one line per record. The first line holds the
+// device's dataSaveAddress when the retrieval started and every line
+// after it is "address,length,hash" for a block which was written to
+// the partial file, the hash being FNV-1a over the block's octets. The
+// lines are written in the order the blocks were, so a line which was
+// torn by the interruption can only ever be the last one.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "DownloadJournal.h"
+#include "SyncCursor.h"
+
+using namespace std;
+
+/// <summary>
+/// Computes the 64 bit FNV-1a hash of a block of the image
+/// </summary>
+/// <param name="pBlock">The octets of the block</param>
+/// <param name="blockLength">The number of octets in the block</param>
+/// <returns>The hash</returns>
+uint64_t HashJournalBlock(const uchar * pBlock, ulong blockLength)
+{
+    uint64_t theHash = 0xCBF29CE484222325ULL;
+
+    for (ulong thisOctet = static_cast<ulong>(0); thisOctet < blockLength; thisOctet++)
+    {
+        theHash = (theHash ^ pBlock[thisOctet]) * 0x100000001B3ULL;
+    }
+
+    return theHash;
+}
+
+/// <summary>
+/// Starts a new journal, recording the device's dataSaveAddress
+/// </summary>
+/// <param name="pJournalFile">The journal file, just created</param>
+/// <param name="saveAddress">The device's dataSaveAddress now</param>
+/// <returns>true if the header was written, otherwise false</returns>
+bool WriteDownloadJournalHeader(FILE * pJournalFile, ulong saveAddress)
+{
+    return (fprintf(pJournalFile, "%lu\n", saveAddress) > 0) && (0 == fflush(pJournalFile));
+}
+
+/// <summary>
+/// Records a block which has been written to the partial file. The partial file must
+/// have been flushed first so the journal never describes octets which are not there.
+/// </summary>
+/// <param name="pJournalFile">The journal file</param>
+/// <param name="blockAddress">Where in the image the block starts</param>
+/// <param name="pBlock">The octets of the block</param>
+/// <param name="blockLength">The number of octets in the block</param>
+/// <returns>true if the record was written, otherwise false</returns>
+bool WriteDownloadJournalRecord(FILE * pJournalFile, ulong blockAddress, const uchar * pBlock, ulong blockLength)
+{
+    return (fprintf(pJournalFile, "%lu,%lu,%016llx\n",
+        blockAddress,
+        blockLength,
+        static_cast<unsigned long long>(HashJournalBlock(pBlock, blockLength))) > 0) &&
+        (0 == fflush(pJournalFile));
+}
+
+/// <summary>
+/// Looks for an interrupted retrieval from the device whose serial number is passed
+/// by argument. The blocks in the journal are checked against the partial file in
+/// order, and the retrieval may carry on from the end of the blocks found whole with
+/// nothing missing before them. That is only worth doing if it is further along than
+/// where the retrieval would start anyway.
+///
+/// Nothing is resumed if the device's history was erased since, which shows as its
+/// dataSaveAddress going backwards. Nor is anything trusted past where the device was
+/// writing when the retrieval started since that was erased FLASH at the time and the
+/// device may have written there since.
+/// </summary>
+/// <param name="pch_SerialNumber">The device's serial number as hexadecimal text</param>
+/// <param name="deviceSaveAddress">The dataSaveAddress the device reports now</param>
+/// <param name="startAddress">Where the retrieval would otherwise start</param>
+/// <param name="r_Journal">Returns what was found in the journal</param>
+/// <param name="pImage">Returns the partial image, only changed when resuming</param>
+/// <param name="imageSize">The number of octets in the image</param>
+/// <returns>true if the retrieval may resume at r_Journal.resumeAddress, otherwise false</returns>
+bool LoadDownloadJournal(const char * pch_SerialNumber,
+    ulong deviceSaveAddress,
+    ulong startAddress,
+    DownloadJournal & r_Journal,
+    uchar * pImage,
+    ulong imageSize)
+{
+    FILE *        pJournalFile          = nullptr;
+    FILE *        pPartialFile          = nullptr;
+    char          journalFileName[301]  = { 0 };
+    char          partialFileName[301]  = { 0 };
+    char          journalRecord[101]    = { 0 };
+    char *        pch_Field             = nullptr;
+    ulong         coveredEnd            = static_cast<ulong>(0);
+    vector<uchar> partialImage(imageSize);
+
+    r_Journal.saveAddress   = static_cast<ulong>(0);
+    r_Journal.blockCount    = static_cast<ulong>(0);
+    r_Journal.resumeAddress = static_cast<ulong>(0);
+
+    BuildSyncFileName(pch_SerialNumber, SYNC_JOURNAL_FILE_NAME, journalFileName, sizeof(journalFileName));
+    BuildSyncFileName(pch_SerialNumber, SYNC_PARTIAL_FILE_NAME, partialFileName, sizeof(partialFileName));
+
+    if (0 != fopen_s(&pJournalFile, journalFileName, "rb"))
+    {
+        return false;
+    }
+
+    if (nullptr == fgets(journalRecord, sizeof(journalRecord), pJournalFile) ||
+        0 != fopen_s(&pPartialFile, partialFileName, "rb"))
+    {
+        (void)fclose(pJournalFile);
+
+        return false;
+    }
+
+    r_Journal.saveAddress = strtoul(journalRecord, nullptr, 10);
+
+    // The partial file only reaches as far as the last block written to it
+    ulong partialLength = static_cast<ulong>(fread(partialImage.data(), 1, imageSize, pPartialFile));
+
+    (void)fclose(pPartialFile);
+
+    // Every block must start within what is already known to be whole
+    while (nullptr != fgets(journalRecord, sizeof(journalRecord), pJournalFile))
+    {
+        ulong blockAddress = strtoul(journalRecord, &pch_Field, 10);
+
+        if (',' != *pch_Field)
+        {
+            break;
+        }
+
+        ulong blockLength = strtoul(pch_Field + 1, &pch_Field, 10);
+
+        if (',' != *pch_Field)
+        {
+            break;
+        }
+
+        uint64_t blockHash = strtoull(pch_Field + 1, &pch_Field, 16);
+
+        if ('\n' != *pch_Field ||
+            blockLength == static_cast<ulong>(0) ||
+            blockAddress > coveredEnd ||
+            blockAddress >= partialLength ||
+            blockLength > partialLength - blockAddress ||
+            blockHash != HashJournalBlock(&partialImage[blockAddress], blockLength))
+        {
+            break;
+        }
+
+        if (blockAddress + blockLength > coveredEnd)
+        {
+            coveredEnd = blockAddress + blockLength;
+        }
+
+        r_Journal.blockCount++;
+    }
+
+    (void)fclose(pJournalFile);
+
+    if (deviceSaveAddress < r_Journal.saveAddress)
+    {
+        return false;
+    }
+
+    r_Journal.resumeAddress = (coveredEnd < r_Journal.saveAddress) ? coveredEnd : r_Journal.saveAddress;
+
+    if (r_Journal.resumeAddress <= startAddress)
+    {
+        return false;
+    }
+
+    // What has not been retrieved yet looks like erased FLASH, as it does when starting over
+    (void)memcpy(pImage, partialImage.data(), r_Journal.resumeAddress);
+    (void)memset(&pImage[r_Journal.resumeAddress], 0xFF, imageSize - r_Journal.resumeAddress);
+
+    return true;
+}
@@ -0,0 +1,39 @@
+// ----------------------------------------------------------------------
+// DownloadJournal.h
+//
+// Records each history block as it reaches the disk so that a retrieval
+// which gets interrupted can pick up where it stopped. The image being
+// retrieved is written to a partial file named after the device, and a
+// journal next to it lists every block written there with its address,
+// length and hash. Only when the retrieval finishes does the partial
+// file become the device's local image.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include "Portable.h"
+
+#define SYNC_PARTIAL_FILE_NAME  "ReadGeiger.partial"
+#define SYNC_JOURNAL_FILE_NAME  "ReadGeiger.journal"
+
+typedef struct download_journal_t
+{
+    ulong saveAddress;              // The device's dataSaveAddress when the retrieval started
+    ulong blockCount;               // The number of blocks found whole in the partial file
+    ulong resumeAddress;            // Where the retrieval should carry on from
+} DownloadJournal;
+
+extern uint64_t HashJournalBlock(const uchar * pBlock, ulong blockLength);
+
+extern bool WriteDownloadJournalHeader(FILE * pJournalFile, ulong saveAddress);
+extern bool WriteDownloadJournalRecord(FILE * pJournalFile, ulong blockAddress, const uchar * pBlock, ulong blockLength);
+
+extern bool LoadDownloadJournal(const char * pch_SerialNumber,
+    ulong deviceSaveAddress,
+    ulong startAddress,
+    DownloadJournal & r_Journal,
+    uchar * pImage,
+    ulong imageSize);
@@ -0,0 +1,602 @@
+// ----------------------------------------------------------------------
+// EventExtractor.cpp
+//
+// The detector tells of each alert once it has ended, and the alerts of
+// the different windows end in no particular order, so the super high
+// ones are kept until the timeline has been scanned and are then sorted
+// by where they start and merged. An alert's values run from its first
+// value to the last value for which its window was still over, less the
+// values at either end which are not clearly above the baseline.
+//
+// ----------------------------------------------------------------------
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "EventExtractor.h"
+#include "ArchiveStore.h"
+#include "BatchDecode.h"
+#include "FlashExport.h"
+#include "PoissonTable.h"
+#include "QueryEngine.h"
+#include "ReadGeiger.h"
+#include "SampleStore.h"
+#include "SeriesFile.h"
+
+using namespace std;
+
+// Earlier than any history which the device can hold
+#define EVENT_EARLIEST_EPOCH    (-(1LL << 62))
+
+typedef struct event_collector_t
+{
+    vector<AnomalyAlert> superHighAlerts;   // Every super high alert which has ended
+    AnomalyAlertHandler  pHandler;          // Also told of every alert, or nullptr
+    void *               pContext;          // Passed to that handler
+} EventCollector;
+
+/// <summary>
+/// Keeps each super high alert once it has ended and passes every alert on to the
+/// caller's own handler
+/// </summary>
+static void CollectSuperHighAlert(void * pContext, const AnomalyAlert & r_Alert)
+{
+    EventCollector * pCollector = static_cast<EventCollector *>(pContext);
+
+    if (nullptr != pCollector->pHandler)
+    {
+        pCollector->pHandler(pCollector->pContext, r_Alert);
+    }
+
+    if (false == r_Alert.isOpen && true == r_Alert.isSuperHigh)
+    {
+        pCollector->superHighAlerts.push_back(r_Alert);
+    }
+}
+
+/// <summary>
+/// Orders the alerts by the first value in them
+/// </summary>
+static bool IsEarlierAlert(const AnomalyAlert & r_First, const AnomalyAlert & r_Second)
+{
+    return r_First.startSample < r_Second.startSample;
+}
+
+/// <summary>
+/// Finds the run of values within an event which rises furthest above a limit for each
+/// value, which is the run whose running total, less the limit for each value, climbs
+/// the most from its lowest point. The running totals make it one pass.
+/// </summary>
+/// <returns>How far the best run rises above the limit, 0 or less if no value is over it</returns>
+static double FindHighestRun(const vector<unsigned long long> & r_PrefixSums,
+    const SuperHighEvent & r_Event,
+    double valueLimit,
+    ulong & r_FirstSample,
+    ulong & r_SampleCount)
+{
+    ulong  lowestSample = r_Event.firstSample;
+    double lowestTotal  = static_cast<double>(r_PrefixSums[lowestSample]) - (valueLimit * static_cast<double>(lowestSample));
+    double highestRise  = 0.0;
+    bool   hasRun       = false;
+
+    for (ulong thisSample = r_Event.firstSample; thisSample < r_Event.firstSample + r_Event.sampleCount; thisSample++)
+    {
+        double runningTotal = static_cast<double>(r_PrefixSums[thisSample + 1]) - (valueLimit * static_cast<double>(thisSample + 1));
+
+        if (false == hasRun || runningTotal - lowestTotal > highestRise)
+        {
+            highestRise   = runningTotal - lowestTotal;
+            r_FirstSample = lowestSample;
+            r_SampleCount = thisSample + 1 - lowestSample;
+            hasRun        = true;
+        }
+
+        if (runningTotal < lowestTotal)
+        {
+            lowestTotal  = runningTotal;
+            lowestSample = thisSample + 1;
+        }
+    }
+
+    return highestRise;
+}
+
+/// <summary>
+/// A window starts before and stays over after what raised it, so an event is cut down
+/// to the run of values within it which are clearly above the baseline, that is two
+/// standard deviations above it for a single value. An event which is only a long rise
+/// with no such values is cut down to its run of values above the baseline itself.
+/// </summary>
+static void TrimSuperHighEvent(const vector<unsigned long long> & r_PrefixSums, SuperHighEvent & r_Event)
+{
+    double typicalLimit = sqrt(r_Event.baselineMean) + 1.0;
+    ulong  firstSample  = r_Event.firstSample;
+    ulong  sampleCount  = r_Event.sampleCount;
+
+    typicalLimit *= typicalLimit;
+
+    if (FindHighestRun(r_PrefixSums, r_Event, typicalLimit, firstSample, sampleCount) <= 0.0
+        && FindHighestRun(r_PrefixSums, r_Event, r_Event.baselineMean, firstSample, sampleCount) <= 0.0)
+    {
+        return;
+    }
+
+    r_Event.firstSample = firstSample;
+    r_Event.sampleCount = sampleCount;
+}
+
+/// <summary>
+/// Widens an event to take in the values either side of it which were recorded within
+/// the context time, stopping where the clock goes backwards as it does when the device
+/// has been set again
+/// </summary>
+static void FindSuperHighEventContext(const vector<long long> & r_EpochSeconds,
+    SuperHighEvent & r_Event,
+    ulong contextSeconds)
+{
+    ulong firstSample = r_Event.firstSample;
+    ulong lastSample  = r_Event.firstSample + r_Event.sampleCount - 1;
+
+    while (firstSample > static_cast<ulong>(0)
+        && r_EpochSeconds[firstSample - 1] < r_EpochSeconds[firstSample]
+        && r_EpochSeconds[firstSample - 1] >= r_Event.startEpoch - static_cast<long long>(contextSeconds))
+    {
+        firstSample--;
+    }
+
+    while (static_cast<size_t>(lastSample) + 1 < r_EpochSeconds.size()
+        && r_EpochSeconds[lastSample + 1] > r_EpochSeconds[lastSample]
+        && r_EpochSeconds[lastSample + 1] <= r_Event.endEpoch + static_cast<long long>(contextSeconds))
+    {
+        lastSample++;
+    }
+
+    r_Event.contextFirstSample = firstSample;
+    r_Event.contextSampleCount = lastSample - firstSample + 1;
+}
+
+/// <summary>
+/// Runs the anomaly detector over a timeline and merges the super high alerts which
+/// overlap or touch in to events, each with the context around it
+/// </summary>
+/// <param name="r_EpochSeconds">When each value was recorded</param>
+/// <param name="r_Counts">The CPS/CPM/CPH values</param>
+/// <param name="alertSigma">The detector's threshold in standard deviations</param>
+/// <param name="contextSeconds">How far either side of each event its context reaches</param>
+/// <param name="pHandler">Also told of every alert as the detector raises and ends it, or nullptr</param>
+/// <param name="pContext">Passed to that handler</param>
+/// <param name="r_Events">Returns the events in the order they start</param>
+/// <returns>The number of alerts the detector raised, super high or not</returns>
+ulong ExtractSuperHighEvents(const vector<long long> & r_EpochSeconds,
+    const vector<uint32_t> & r_Counts,
+    double alertSigma,
+    ulong contextSeconds,
+    AnomalyAlertHandler pHandler,
+    void * pContext,
+    vector<SuperHighEvent> & r_Events)
+{
+    AnomalyDetector            theDetector;
+    EventCollector             theCollector;
+    vector<unsigned long long> prefixSums;
+
+    r_Events.clear();
+
+    theCollector.pHandler = pHandler;
+    theCollector.pContext = pContext;
+
+    StartAnomalyDetector(theDetector, CollectSuperHighAlert, &theCollector);
+
+    theDetector.alertSigma = alertSigma;
+
+    for (size_t thisSample = 0; thisSample < r_Counts.size(); thisSample++)
+    {
+        (void)FeedAnomalyDetector(theDetector, r_EpochSeconds[thisSample], r_Counts[thisSample]);
+    }
+
+    FinishAnomalyDetector(theDetector);
+
+    if (theCollector.superHighAlerts.empty())
+    {
+        return theDetector.alertCount;
+    }
+
+    stable_sort(theCollector.superHighAlerts.begin(), theCollector.superHighAlerts.end(), IsEarlierAlert);
+
+    for (size_t thisAlert = 0; thisAlert < theCollector.superHighAlerts.size(); thisAlert++)
+    {
+        const AnomalyAlert & r_Alert     = theCollector.superHighAlerts[thisAlert];
+        ulong                firstSample = static_cast<ulong>(r_Alert.startSample);
+        ulong                lastSample  = static_cast<ulong>(r_Alert.lastSample);
+
+        // An alert which starts within or just after the last event becomes part of it
+        if (false == r_Events.empty()
+            && firstSample <= r_Events.back().firstSample + r_Events.back().sampleCount)
+        {
+            SuperHighEvent & r_Event = r_Events.back();
+
+            if (lastSample >= r_Event.firstSample + r_Event.sampleCount)
+            {
+                r_Event.sampleCount = lastSample - r_Event.firstSample + 1;
+            }
+
+            if (r_Alert.peakSignificance <= r_Event.peakSignificance)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            SuperHighEvent theEvent;
+
+            theEvent.firstSample = firstSample;
+            theEvent.sampleCount = lastSample - firstSample + 1;
+
+            r_Events.push_back(theEvent);
+        }
+
+        SuperHighEvent & r_Event = r_Events.back();
+
+        r_Event.peakEpoch         = r_Alert.peakEpoch;
+        r_Event.peakWindowSeconds = r_Alert.windowSeconds;
+        r_Event.peakSum           = r_Alert.peakSum;
+        r_Event.expectedSum       = r_Alert.expectedSum;
+        r_Event.peakSignificance  = r_Alert.peakSignificance;
+        r_Event.baselineMean      = r_Alert.expectedSum / static_cast<double>(r_Alert.peakSamples);
+    }
+
+    // The sums over each event and its context come from the running totals
+    BuildCountPrefixSums(CountSpan{ r_Counts.data(), static_cast<ulong>(r_Counts.size()) }, prefixSums);
+
+    for (size_t thisEvent = 0; thisEvent < r_Events.size(); thisEvent++)
+    {
+        SuperHighEvent & r_Event = r_Events[thisEvent];
+
+        TrimSuperHighEvent(prefixSums, r_Event);
+
+        r_Event.startEpoch = r_EpochSeconds[r_Event.firstSample];
+        r_Event.endEpoch   = r_EpochSeconds[r_Event.firstSample + r_Event.sampleCount - 1];
+        r_Event.eventSum   = SumCountPrefixRange(prefixSums, r_Event.firstSample, r_Event.sampleCount);
+
+        FindSuperHighEventContext(r_EpochSeconds, r_Event, contextSeconds);
+
+        ulong              outsideCount = r_Event.contextSampleCount - r_Event.sampleCount;
+        unsigned long long outsideSum   = SumCountPrefixRange(prefixSums, r_Event.contextFirstSample, r_Event.contextSampleCount) - r_Event.eventSum;
+
+        r_Event.contextMean = (outsideCount > static_cast<ulong>(0))
+            ? static_cast<double>(outsideSum) / static_cast<double>(outsideCount)
+            : 0.0;
+    }
+
+    return theDetector.alertCount;
+}
+
+/// <summary>
+/// Finds how far apart the values of part of the timeline were recorded, which is the
+/// smallest step the clock takes from one value to the next
+/// </summary>
+/// <param name="r_EpochSeconds">When each value of the timeline was recorded</param>
+/// <param name="firstSample">The index of the first value to look at</param>
+/// <param name="sampleCount">The number of values to look at</param>
+/// <returns>The seconds between values, or 0 if there are not two values which are apart</returns>
+static long long FindSampleIntervalSeconds(const vector<long long> & r_EpochSeconds, ulong firstSample, ulong sampleCount)
+{
+    long long intervalSeconds = 0;
+
+    for (ulong thisSample = firstSample + 1; thisSample < firstSample + sampleCount; thisSample++)
+    {
+        long long theStep = r_EpochSeconds[thisSample] - r_EpochSeconds[thisSample - 1];
+
+        if (theStep > 0 && (0 == intervalSeconds || theStep < intervalSeconds))
+        {
+            intervalSeconds = theStep;
+        }
+    }
+
+    return intervalSeconds;
+}
+
+/// <summary>
+/// Writes the values of an event and of the context either side of it to a comma-delimited
+/// file, with a third column which is 1 for the values of the event itself. Values of 0 are
+/// left out of the timeline, so wherever the clock moves on by more than one interval but
+/// by a whole number of them a 0 row is written for each interval which is missing, and the
+/// file shows every minute of the context.
+/// </summary>
+/// <param name="r_EpochSeconds">When each value of the timeline was recorded</param>
+/// <param name="r_Counts">The CPS/CPM/CPH values of the timeline</param>
+/// <param name="r_Event">The event, from ExtractSuperHighEvents()</param>
+/// <param name="pch_EventFileName">The file to create or replace</param>
+/// <returns>true if the file was written, otherwise false</returns>
+bool WriteSuperHighEventFile(const vector<long long> & r_EpochSeconds,
+    const vector<uint32_t> & r_Counts,
+    const SuperHighEvent & r_Event,
+    const char * pch_EventFileName)
+{
+    FILE *    pEventFile             = nullptr;
+    char      temporaryFileName[331] = { 0 };
+    char      theTime[31]            = { 0 };
+    bool      wasWritten             = false;
+    ulong     lastContextSample      = r_Event.contextFirstSample + r_Event.contextSampleCount;
+    ulong     lastEventSample        = r_Event.firstSample + r_Event.sampleCount;
+    long long intervalSeconds        = FindSampleIntervalSeconds(r_EpochSeconds, r_Event.contextFirstSample, r_Event.contextSampleCount);
+
+    BuildTemporaryFileName(pch_EventFileName, temporaryFileName, sizeof(temporaryFileName));
+
+    if (0 != fopen_s(&pEventFile, temporaryFileName, "w"))
+    {
+        return false;
+    }
+
+    wasWritten = (fputs("Date/Time,Counts,Event\n", pEventFile) >= 0);
+
+    for (ulong thisSample = r_Event.contextFirstSample; true == wasWritten && thisSample < lastContextSample; thisSample++)
+    {
+        bool isInEvent = (thisSample >= r_Event.firstSample && thisSample < lastEventSample);
+
+        // The values of 0 between this value and the one before it
+        if (thisSample > r_Event.contextFirstSample && intervalSeconds > 0)
+        {
+            long long theStep       = r_EpochSeconds[thisSample] - r_EpochSeconds[thisSample - 1];
+            bool      isZeroInEvent = (thisSample > r_Event.firstSample && thisSample < lastEventSample);
+
+            for (long long zeroEpoch = r_EpochSeconds[thisSample - 1] + intervalSeconds;
+                true == wasWritten && 0 == (theStep % intervalSeconds) && zeroEpoch < r_EpochSeconds[thisSample];
+                zeroEpoch += intervalSeconds)
+            {
+                FormatQueryTime(zeroEpoch, theTime, sizeof(theTime));
+
+                wasWritten = (fprintf(pEventFile, "%s,0,%d\n", theTime, (true == isZeroInEvent) ? 1 : 0) > 0);
+            }
+        }
+
+        FormatQueryTime(r_EpochSeconds[thisSample], theTime, sizeof(theTime));
+
+        wasWritten = wasWritten && (fprintf(pEventFile, "%s,%lu,%d\n",
+            theTime,
+            static_cast<ulong>(r_Counts[thisSample]),
+            (true == isInEvent) ? 1 : 0) > 0);
+    }
+
+    wasWritten = (0 == fclose(pEventFile)) && wasWritten;
+
+    if (false == wasWritten || false == CommitFileAtomically(temporaryFileName, pch_EventFileName))
+    {
+        (void)remove(temporaryFileName);
+
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Builds the name of an event's comma-delimited file from a prefix, such as the device's
+/// serial number, and when the event started, as in
+/// "210.19Apr23.02.14.00.ReadGeiger.event.csv"
+/// </summary>
+/// <param name="r_OutputDirectory">Where the file goes, or empty for here</param>
+/// <param name="r_Prefix">What the name starts with</param>
+/// <param name="r_Event">The event</param>
+/// <returns>The file name</returns>
+string BuildSuperHighEventFileName(const string & r_OutputDirectory, const string & r_Prefix, const SuperHighEvent & r_Event)
+{
+    ulong  theYear, theMonth, theDay, theHour, theMinute, theSecond;
+    char   startTime[31] = { 0 };
+    string theName       = r_OutputDirectory;
+
+    CivilFromEpoch(r_Event.startEpoch, theYear, theMonth, theDay, theHour, theMinute, theSecond);
+
+    (void)sprintf_s(startTime, sizeof(startTime), "%02lu%s%02lu.%02lu.%02lu.%02lu",
+        theDay, theMonths[(theMonth - 1) % 12], theYear % 100, theHour, theMinute, theSecond);
+
+    if (false == theName.empty() && theName.back() != PATH_SEPARATOR_CHARACTER && theName.back() != '/')
+    {
+        theName += PATH_SEPARATOR_CHARACTER;
+    }
+
+    return theName + r_Prefix + "." + startTime + "." + DATA_OUTPUT_EVENT_FILE_NAME;
+}
+
+/// <summary>
+/// Displays how the event extractor is used
+/// </summary>
+static void DisplayEventUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -events <directory|pattern> [...] [-serial <serial>] [-device <serial|label>]\n");
+    (void)printf("       [-from <time>] [-context <minutes>] [-sigma <deviations>] [-out <directory>]\n");
+    (void)printf("  A directory selects every *.%s file within it; comma-delimited files\n", DATA_OUTPUT_SERIES_FILE_NAME);
+    (void)printf("  and FLASH images may also be named. Each super high event is written to a\n");
+    (void)printf("  *.%s file of its own with %lu minutes either side of it, and\n", DATA_OUTPUT_EVENT_FILE_NAME, EVENT_CONTEXT_MINUTES);
+    (void)printf("  %s lists the events of every device. -from only writes the\n", DATA_OUTPUT_EVENT_INDEX_NAME);
+    (void)printf("  events which start at or after that time, such as those since the last triage.\n");
+}
+
+/// <summary>
+/// The entry point for the event extractor. Each device's files are merged in to one
+/// timeline, its super high events are extracted and written to files of their own, and
+/// one index of the events of every device is written along side them.
+/// </summary>
+/// <param name="argc">The number of arguments following "-events"</param>
+/// <param name="argv">The arguments following "-events"</param>
+/// <returns>0 if every file was read and every event written, otherwise 1</returns>
+int RunEventExtractor(int argc, char * argv[])
+{
+    QueryEngine    theEngine;
+    vector<string> inputFileNames;
+    string         defaultSerialNumber    = ARCHIVE_UNKNOWN_SERIAL_NUMBER;
+    string         outputDirectory;
+    const char *   pch_Filter             = nullptr;
+    long long      fromEpoch              = EVENT_EARLIEST_EPOCH;
+    ulong          contextSeconds         = EVENT_CONTEXT_MINUTES * 60;
+    double         alertSigma             = ANOMALY_ALERT_SIGMA;
+    ulong          failedCount            = static_cast<ulong>(0);
+    ulong          eventCount             = static_cast<ulong>(0);
+    ulong          deviceCount            = static_cast<ulong>(0);
+    FILE *         pIndexFile             = nullptr;
+    char           temporaryFileName[331] = { 0 };
+    bool           wasWritten             = false;
+
+    for (int thisArgument = 0; thisArgument < argc; thisArgument++)
+    {
+        if (0 == strcmp(argv[thisArgument], "-serial") && thisArgument + 1 < argc)
+        {
+            defaultSerialNumber = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-device") && thisArgument + 1 < argc)
+        {
+            pch_Filter = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-from") && thisArgument + 1 < argc)
+        {
+            if (false == ParseQueryTime(argv[++thisArgument], fromEpoch))
+            {
+                DisplayEventUsage();
+                (void)printf("The time \"%s\" was not understood\n", argv[thisArgument]);
+                return 1;
+            }
+        }
+        else if (0 == strcmp(argv[thisArgument], "-context") && thisArgument + 1 < argc)
+        {
+            contextSeconds = strtoul(argv[++thisArgument], nullptr, 10) * 60;
+        }
+        else if (0 == strcmp(argv[thisArgument], "-sigma") && thisArgument + 1 < argc)
+        {
+            alertSigma = strtod(argv[++thisArgument], nullptr);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-out") && thisArgument + 1 < argc)
+        {
+            outputDirectory = argv[++thisArgument];
+        }
+        else
+        {
+            CollectInputFileNames(argv[thisArgument], SERIES_INPUT_FILE_PATTERN, inputFileNames);
+        }
+    }
+
+    if (alertSigma <= 0.0)
+    {
+        DisplayEventUsage();
+        (void)printf("The deviations given with -sigma must be more than 0\n");
+        return 1;
+    }
+
+    if (inputFileNames.empty())
+    {
+        DisplayEventUsage();
+        (void)printf("There were no files found to extract events from\n");
+        return 1;
+    }
+
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    for (size_t thisFile = 0; thisFile < inputFileNames.size(); thisFile++)
+    {
+        if (false == AddQueryFile(theEngine, inputFileNames[thisFile].c_str(), defaultSerialNumber.c_str()))
+        {
+            (void)fprintf(stderr, "FAILED  %s\n", inputFileNames[thisFile].c_str());
+            failedCount++;
+        }
+    }
+
+    BuildQueryIndex(theEngine);
+
+    string indexFileName = outputDirectory;
+
+    if (false == indexFileName.empty() && indexFileName.back() != PATH_SEPARATOR_CHARACTER && indexFileName.back() != '/')
+    {
+        indexFileName += PATH_SEPARATOR_CHARACTER;
+    }
+
+    indexFileName += DATA_OUTPUT_EVENT_INDEX_NAME;
+
+    BuildTemporaryFileName(indexFileName.c_str(), temporaryFileName, sizeof(temporaryFileName));
+
+    if (0 != fopen_s(&pIndexFile, temporaryFileName, "w"))
+    {
+        (void)printf("Error: I was unable to write file: %s\n", indexFileName.c_str());
+        return 1;
+    }
+
+    wasWritten = (fputs("Serial,Start,Peak,End,First Sample,Samples,Event Sum,Peak Window,Peak Sum,Expected,P Value,Context Mean,Event File\n", pIndexFile) >= 0);
+
+    for (size_t thisDevice = 0; thisDevice < theEngine.theDevices.size(); thisDevice++)
+    {
+        const QueryDevice &    r_Device = theEngine.theDevices[thisDevice];
+        vector<SuperHighEvent> theEvents;
+
+        if (false == IsQueryDeviceSelected(r_Device, pch_Filter))
+        {
+            continue;
+        }
+
+        (void)ExtractSuperHighEvents(r_Device.epochSeconds, r_Device.counts, alertSigma, contextSeconds, nullptr, nullptr, theEvents);
+
+        deviceCount++;
+
+        for (size_t thisEvent = 0; thisEvent < theEvents.size(); thisEvent++)
+        {
+            const SuperHighEvent & r_Event       = theEvents[thisEvent];
+            char                   startText[31] = { 0 };
+            char                   peakText[31]  = { 0 };
+            char                   endText[31]   = { 0 };
+
+            if (r_Event.startEpoch < fromEpoch)
+            {
+                continue;
+            }
+
+            string eventFileName = BuildSuperHighEventFileName(outputDirectory, r_Device.serialNumber, r_Event);
+
+            if (false == WriteSuperHighEventFile(r_Device.epochSeconds, r_Device.counts, r_Event, eventFileName.c_str()))
+            {
+                (void)fprintf(stderr, "FAILED  %s\n", eventFileName.c_str());
+                failedCount++;
+                continue;
+            }
+
+            FormatQueryTime(r_Event.startEpoch, startText, sizeof(startText));
+            FormatQueryTime(r_Event.peakEpoch, peakText, sizeof(peakText));
+            FormatQueryTime(r_Event.endEpoch, endText, sizeof(endText));
+
+            wasWritten = (fprintf(pIndexFile, "%s,%s,%s,%s,%lu,%lu,%llu,%lu,%lu,%.1f,%.2e,%.2f,%s\n",
+                r_Device.serialNumber.c_str(),
+                startText,
+                peakText,
+                endText,
+                r_Event.firstSample,
+                r_Event.sampleCount,
+                r_Event.eventSum,
+                r_Event.peakWindowSeconds / 60,
+                r_Event.peakSum,
+                r_Event.expectedSum,
+                GetPoissonPValue(r_Event.peakSignificance),
+                r_Event.contextMean,
+                eventFileName.c_str()) > 0) && wasWritten;
+
+            eventCount++;
+        }
+    }
+
+    wasWritten = (0 == fclose(pIndexFile)) && wasWritten;
+
+    if (false == wasWritten || false == CommitFileAtomically(temporaryFileName, indexFileName.c_str()))
+    {
+        (void)remove(temporaryFileName);
+        (void)printf("Error: I was unable to write file: %s\n", indexFileName.c_str());
+        return 1;
+    }
+
+    double elapsedSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    (void)printf("%lu super high events from %lu devices listed in %s in %.3f seconds\n",
+        eventCount,
+        deviceCount,
+        indexFileName.c_str(),
+        elapsedSeconds);
+
+    return (failedCount == static_cast<ulong>(0)) ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+// ----------------------------------------------------------------------
+// EventExtractor.h
+//
+// Pulls the super high events out of a timeline of CPS/CPM/CPH values
+// so that each one can be looked at on its own. The anomaly detector is
+// run over the timeline and the super high alerts of all of its windows
+// which overlap or touch are merged in to one event, which records the
+// index of its first and last value in the timeline and when they were
+// recorded.
+//
+// The running totals of the timeline are built once, so the sum over an
+// event and over the context around it are each a single subtraction
+// however long the event or the context is.
+//
+// Each event may be written to a comma-delimited file of its own which
+// holds the values from the context before it to the context after it,
+// and an index of the events of every device names those files.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Portable.h"
+#include "AnomalyDetector.h"
+
+// How far either side of an event its comma-delimited file reaches, in minutes
+#define EVENT_CONTEXT_MINUTES       static_cast<ulong>(60)
+
+typedef struct super_high_event_t
+{
+    ulong              firstSample;         // The index of the event's first value in the timeline
+    ulong              sampleCount;         // The number of values in the event
+    long long          startEpoch;          // When the event's first value was recorded
+    long long          endEpoch;            // When the event's last value was recorded
+    long long          peakEpoch;           // When the highest window of the event ended
+    ulong              peakWindowSeconds;   // The length of that window
+    ulong              peakSum;             // The sum over that window
+    double             expectedSum;         // What the baseline predicted for that sum
+    double             baselineMean;        // What the baseline predicted for a single value then
+    double             peakSignificance;    // -log10 of the p-value of that sum, see PoissonTable.h
+    unsigned long long eventSum;            // The sum of the values in the event
+    ulong              contextFirstSample;  // The index of the first value of the context before the event
+    ulong              contextSampleCount;  // The number of values from there to the end of the context after it
+    double             contextMean;         // The mean of the context values which are not in the event
+} SuperHighEvent;
+
+extern ulong ExtractSuperHighEvents(const std::vector<long long> & r_EpochSeconds,
+    const std::vector<uint32_t> & r_Counts,
+    double alertSigma,
+    ulong contextSeconds,
+    AnomalyAlertHandler pHandler,
+    void * pContext,
+    std::vector<SuperHighEvent> & r_Events);
+
+extern bool WriteSuperHighEventFile(const std::vector<long long> & r_EpochSeconds,
+    const std::vector<uint32_t> & r_Counts,
+    const SuperHighEvent & r_Event,
+    const char * pch_EventFileName);
+
+extern std::string BuildSuperHighEventFileName(const std::string & r_OutputDirectory,
+    const std::string & r_Prefix,
+    const SuperHighEvent & r_Event);
+
+extern int RunEventExtractor(int argc, char * argv[]);
@@ -0,0 +1,554 @@
+// ----------------------------------------------------------------------
+// FlashExport.cpp
+//
+// The consumers of the FLASH history image's frame events. Consult
+// FrameDecoder.cpp for how the frames themselves are parsed.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "FlashExport.h"
+#include "FrameDecoder.h"
+
+using namespace std;
+
+    const char * theMonths[12] =
+    {
+        "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+        "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+    } ;
+
+/// <summary>
+/// Each possible octet value as the text dump shows it: three decimal digits with
+/// leading zeros followed by a space. The table is built once, the first time that
+/// it is needed.
+/// </summary>
+typedef struct text_dump_table_t
+{
+    char octetText[256][4];         // "000 " through "255 ", not NULL-terminated
+} TextDumpTable;
+
+/// <summary>
+/// Fills in the table of octet values as text
+/// </summary>
+static TextDumpTable BuildTextDumpTable(void)
+{
+    TextDumpTable theTable;
+
+    for (ulong thisValue = 0; thisValue < 256; thisValue++)
+    {
+        theTable.octetText[thisValue][0] = static_cast<char>('0' + (thisValue / 100));
+        theTable.octetText[thisValue][1] = static_cast<char>('0' + ((thisValue / 10) % 10));
+        theTable.octetText[thisValue][2] = static_cast<char>('0' + (thisValue % 10));
+        theTable.octetText[thisValue][3] = ' ';
+    }
+
+    return theTable;
+}
+
+/// <summary>
+/// Writes the FLASH history image as decimal ASCII text, sixteen octets to a line, each
+/// one as three digits and a space, and every line ended by a new line including a
+/// final line which is short. The whole file is formatted in to one buffer using a
+/// table of the 256 possible octet values and then written with a single call.
+/// </summary>
+/// <param name="pImage">The FLASH history image to write</param>
+/// <param name="imageSize">The number of octets in the image</param>
+/// <param name="pch_TextFileName">The ASCII text file to create</param>
+/// <returns>true if the file was created and written, otherwise false</returns>
+bool WriteFlashImageTextFile(const uchar * pImage, ulong imageSize, const char * pch_TextFileName)
+{
+    static const TextDumpTable theTable = BuildTextDumpTable();
+
+    FILE * pOutputFile  = nullptr;
+    ulong  lineCount    = (imageSize + 15) / 16;
+    ulong  outputOffset = static_cast<ulong>(0);
+    bool   wasWritten   = false;
+
+    // Four characters for each octet plus a new line for each line
+    vector<char> outputBuffer((imageSize * 4) + lineCount);
+
+    for (ulong thisOctet = 0; thisOctet < imageSize; thisOctet++)
+    {
+        memcpy(&outputBuffer[outputOffset], theTable.octetText[pImage[thisOctet]], 4);
+        outputOffset += 4;
+
+        // Is it the end of the line, or the last octet of the final line?
+        if ((thisOctet & 15) == 15 || thisOctet + 1 == imageSize)
+        {
+            outputBuffer[outputOffset++] = '\n';
+        }
+    }
+
+    if (0 == fopen_s(&pOutputFile, pch_TextFileName, "wb"))
+    {
+        wasWritten = (outputOffset == 0 || 1 == fwrite(outputBuffer.data(), outputOffset, 1, pOutputFile));
+
+        wasWritten = (0 == fclose(pOutputFile)) && wasWritten;
+    }
+
+    return wasWritten;
+}
+
+/// <summary>
+/// The comma-delimited records are gathered in to a buffer of this size and written
+/// when it fills rather than with one write for each record
+/// </summary>
+#define CSV_OUTPUT_BUFFER_SIZE  (256 * 1024)
+
+/// <summary>
+/// The longest comma-delimited record; the buffer gets written before it gets this full
+/// </summary>
+#define CSV_LONGEST_RECORD      (101)
+
+/// <summary>
+/// The length of a date/time as the comma-delimited file shows it, "dd/Mon/yy hh:mm:ss"
+/// </summary>
+#define CSV_TIMESTAMP_LENGTH    (18)
+
+/// <summary>
+/// A date/time as text which is kept from one value to the next. The date is only
+/// rebuilt when the day changes and of the time only the fields which changed are
+/// rewritten, which for values a minute apart is usually just the minutes.
+/// </summary>
+typedef struct timestamp_text_t
+{
+    char      theText[CSV_TIMESTAMP_LENGTH + 1];    // "dd/Mon/yy hh:mm:ss", NULL-terminated
+    long long dayNumber;                            // The days since 1970 the date is for, or -1 for none yet
+    ulong     theHour;                              // The hour the text shows
+    ulong     theMinute;                            // The minute the text shows
+    ulong     theSecond;                            // The second the text shows
+} TimestampText;
+
+/// <summary>
+/// What DecodeFlashImage() keeps track of while the frame events go by
+/// </summary>
+typedef struct decode_state_t
+{
+    FILE *              pOutputFile;            // The comma-delimited file, or nullptr for none
+    vector<char>        outputBuffer;           // The comma-delimited records which are not yet written
+    ulong               outputLength;           // The number of octets used in that buffer
+    bool                writeFailed;            // true if a write to the comma-delimited file failed
+    SampleStore *       pSampleStore;           // The columnar store of values, or nullptr for none
+    FlashImageSummary * pSummary;               // The statistics being gathered
+    bool                hasTimestamp;           // true once a date/time stamp frame has been seen
+    long long           frameEpoch;             // The last date/time stamp in seconds since 1970
+    long long           sampleInterval;         // The seconds between values, from the stamp's record rate
+    ulong               sampleIndex;            // The values since the last date/time stamp, zeros included
+    TimestampText       theTimestamp;           // The date/time of the current value as text
+} DecodeState;
+
+/// <summary>
+/// Writes the buffered comma-delimited records to the file and empties the buffer
+/// </summary>
+static void FlushOutputBuffer(DecodeState & r_State)
+{
+    if (r_State.outputLength > static_cast<ulong>(0))
+    {
+        if (1 != fwrite(r_State.outputBuffer.data(), r_State.outputLength, 1, r_State.pOutputFile))
+        {
+            r_State.writeFailed = true;
+        }
+
+        r_State.outputLength = static_cast<ulong>(0);
+    }
+}
+
+/// <summary>
+/// Appends text to the buffer, writing the buffer out first if there is not room for it
+/// </summary>
+static void AppendOutputText(DecodeState & r_State, const char * pch_Text)
+{
+    ulong textLength = static_cast<ulong>(strlen(pch_Text));
+
+    if (r_State.outputLength + textLength > static_cast<ulong>(r_State.outputBuffer.size()))
+    {
+        FlushOutputBuffer(r_State);
+    }
+
+    memcpy(&r_State.outputBuffer[r_State.outputLength], pch_Text, textLength);
+
+    r_State.outputLength += textLength;
+}
+
+/// <summary>
+/// Writes a value from 0 through 99 as two digits
+/// </summary>
+static void PutTwoDigits(char * pch_Text, ulong theValue)
+{
+    pch_Text[0] = static_cast<char>('0' + (theValue / 10));
+    pch_Text[1] = static_cast<char>('0' + (theValue % 10));
+}
+
+/// <summary>
+/// Empties the date/time text so that the next date/time given to it is built whole
+/// </summary>
+static void ResetTimestampText(TimestampText & r_Timestamp)
+{
+    (void)memcpy(r_Timestamp.theText, "00/Jan/00 00:00:00", sizeof(r_Timestamp.theText));
+
+    r_Timestamp.dayNumber = -1;
+}
+
+/// <summary>
+/// Brings the date/time text up to the time passed by argument. The calendar date is
+/// only worked out when the day is not the one the text already shows.
+/// </summary>
+/// <param name="r_Timestamp">The date/time text</param>
+/// <param name="epochSeconds">The time to show, in seconds since 1970</param>
+static void UpdateTimestampText(TimestampText & r_Timestamp, long long epochSeconds)
+{
+    long long dayNumber   = (epochSeconds >= 0 ? epochSeconds : epochSeconds - 86399) / 86400;
+    ulong     secondOfDay = static_cast<ulong>(epochSeconds - (dayNumber * 86400));
+    ulong     theHour     = secondOfDay / 3600;
+    ulong     theMinute   = (secondOfDay / 60) % 60;
+    ulong     theSecond   = secondOfDay % 60;
+
+    if (dayNumber != r_Timestamp.dayNumber)
+    {
+        ulong theYear, theMonth, theDay, ignoredHour, ignoredMinute, ignoredSecond;
+
+        CivilFromEpoch(dayNumber * 86400, theYear, theMonth, theDay, ignoredHour, ignoredMinute, ignoredSecond);
+
+        PutTwoDigits(&r_Timestamp.theText[0], theDay);
+        (void)memcpy(&r_Timestamp.theText[3], theMonths[(theMonth - 1) % 12], 3);
+        PutTwoDigits(&r_Timestamp.theText[7], theYear % 100);
+        PutTwoDigits(&r_Timestamp.theText[10], theHour);
+        PutTwoDigits(&r_Timestamp.theText[13], theMinute);
+        PutTwoDigits(&r_Timestamp.theText[16], theSecond);
+
+        r_Timestamp.dayNumber = dayNumber;
+    }
+    else
+    {
+        if (theHour != r_Timestamp.theHour)
+        {
+            PutTwoDigits(&r_Timestamp.theText[10], theHour);
+        }
+
+        if (theMinute != r_Timestamp.theMinute)
+        {
+            PutTwoDigits(&r_Timestamp.theText[13], theMinute);
+        }
+
+        if (theSecond != r_Timestamp.theSecond)
+        {
+            PutTwoDigits(&r_Timestamp.theText[16], theSecond);
+        }
+    }
+
+    r_Timestamp.theHour   = theHour;
+    r_Timestamp.theMinute = theMinute;
+    r_Timestamp.theSecond = theSecond;
+}
+
+/// <summary>
+/// Appends a comma-delimited record to the buffer, writing the buffer out first if
+/// there may not be room for it. Values which come before the first date/time stamp
+/// frame have no date/time to show.
+/// </summary>
+static void AppendOutputRecord(DecodeState & r_State, ulong countValue)
+{
+    char   countDigits[21];
+    size_t digitCount = 0;
+
+    if (r_State.outputLength + CSV_LONGEST_RECORD > static_cast<ulong>(r_State.outputBuffer.size()))
+    {
+        FlushOutputBuffer(r_State);
+    }
+
+    char * pch_Record = &r_State.outputBuffer[r_State.outputLength];
+
+    if (true == r_State.hasTimestamp)
+    {
+        (void)memcpy(pch_Record, r_State.theTimestamp.theText, CSV_TIMESTAMP_LENGTH);
+
+        pch_Record += CSV_TIMESTAMP_LENGTH;
+    }
+
+    *pch_Record++ = ',';
+
+    // The digits come out least significant first
+    do
+    {
+        countDigits[digitCount++] = static_cast<char>('0' + (countValue % 10));
+        countValue /= 10;
+    } while (countValue > static_cast<ulong>(0));
+
+    while (digitCount > 0)
+    {
+        *pch_Record++ = countDigits[--digitCount];
+    }
+
+    *pch_Record++ = '\n';
+
+    r_State.outputLength = static_cast<ulong>(pch_Record - r_State.outputBuffer.data());
+}
+
+/// <summary>
+/// Copies a location frame's label, replacing commas with spaces since the label gets
+/// used as the name of the date/time column of the comma-delimited file
+/// </summary>
+/// <param name="r_Event">The location event</param>
+/// <param name="pch_LabelString">Returns the NULL-terminated label, 256 octets or more</param>
+static void CopyLocationLabel(const FrameEvent & r_Event, char * pch_LabelString)
+{
+    for (uchar thisOctet = 0; thisOctet < r_Event.labelLength; thisOctet++)
+    {
+        pch_LabelString[thisOctet] = static_cast<char>(r_Event.pLabel[thisOctet]);
+
+        // Since the llocation information will be used as the name of the
+        // date/tie column in the output file, if the octet is a comma,
+        // replace it with a space
+        if (pch_LabelString[thisOctet] == ',')
+        {
+            pch_LabelString[thisOctet] = ' ';
+        }
+    }
+
+    // Make sure to NULL terminate the string
+    pch_LabelString[r_Event.labelLength] = 0x00;
+}
+
+/// <summary>
+/// The comma-delimited header names the date/time column after the last location
+/// label in the image, so before the records get written the image is scanned for
+/// its location frames. Runs of values are skipped whole so this costs little more
+/// than a look at each frame.
+/// </summary>
+/// <param name="pImage">The FLASH history image to scan</param>
+/// <param name="imageSize">The number of octets in the image</param>
+/// <param name="pch_LabelString">Returns the last label, 256 octets or more</param>
+/// <returns>true if there was a location frame, otherwise false</returns>
+static bool FindLastLocationLabel(const uchar * pImage, ulong imageSize, char * pch_LabelString)
+{
+    FrameDecoder theDecoder;
+    FrameEvent   theEvent;
+    bool         foundLocationString = false;
+
+    StartFrameDecoder(theDecoder, pImage, imageSize);
+
+    while (true == GetNextFrameEvent(theDecoder, theEvent))
+    {
+        if (FrameEventLocation == theEvent.eventType)
+        {
+            CopyLocationLabel(theEvent, pch_LabelString);
+
+            foundLocationString = true;
+        }
+    }
+
+    return foundLocationString;
+}
+
+/// <summary>
+/// Offers a single CPS/CPM/CPH value to each of the consumers. Its time is the last
+/// date/time stamp plus the interval of the stamp's record rate for each value since
+/// the stamp, so a clock never gets carried along by hand. If the counts per minute is
+/// zero, that may be due to the device having lost power and then coming back, so
+/// zeros are filtered out of everything, though they still take up their interval.
+/// </summary>
+/// <param name="r_State">The decoding state</param>
+/// <param name="countValue">The CPS/CPM/CPH value</param>
+static void ConsumeCountValue(DecodeState & r_State, ulong countValue)
+{
+    FlashImageSummary & r_Summary    = *r_State.pSummary;
+    long long           epochSeconds = r_State.frameEpoch + (static_cast<long long>(r_State.sampleIndex++) * r_State.sampleInterval);
+
+    if (countValue > static_cast<ulong>(0))
+    {
+        if (nullptr != r_State.pOutputFile)
+        {
+            if (true == r_State.hasTimestamp)
+            {
+                UpdateTimestampText(r_State.theTimestamp, epochSeconds);
+            }
+
+            // It's a counts per minute data value so make an output record
+            AppendOutputRecord(r_State, countValue);
+        }
+
+        if (nullptr != r_State.pSampleStore)
+        {
+            AppendSample(*r_State.pSampleStore, epochSeconds, static_cast<uint32_t>(countValue));
+        }
+
+        // Keep track of the lowest and highest values
+        if (r_Summary.sampleCount == static_cast<ulong>(0) || countValue < r_Summary.lowestCount)
+        {
+            r_Summary.lowestCount = countValue;
+        }
+
+        if (countValue > r_Summary.highestCount)
+        {
+            r_Summary.highestCount = countValue;
+        }
+
+        r_Summary.countTotal += countValue;
+        r_Summary.sampleCount++;
+    }
+}
+
+/// <summary>
+/// This function examines the history data passed by argument in a single pass of the
+/// frame decoder. Every CPS/CPM/CPH value is offered to each of the consumers: the
+/// comma-delimited file if one is asked for, the columnar store if one is asked for,
+/// and the summary which holds the lowest, highest and average values.
+///
+/// The comma-delimited file is written under a temporary name with its header record
+/// first and is only put in place, replacing any older file, once it is complete.
+/// </summary>
+/// <param name="pImage">The FLASH history image to parse</param>
+/// <param name="imageSize">The number of octets in the image</param>
+/// <param name="pch_CSVFileName">The comma-delimited file to create, or nullptr for none</param>
+/// <param name="pSampleStore">The store to fill with the values, or nullptr for none</param>
+/// <param name="r_Summary">Returns the statistics of the values which were found</param>
+/// <returns>true if the comma-delimited file, when asked for, was created, otherwise false</returns>
+bool DecodeFlashImage(const uchar * pImage,
+    ulong imageSize,
+    const char * pch_CSVFileName,
+    SampleStore * pSampleStore,
+    FlashImageSummary & r_Summary)
+{
+    DecodeState  theState;
+    FrameDecoder theDecoder;
+    FrameEvent   theEvent;
+    char         temporaryFileName[301] = { 0 };
+
+    r_Summary.sampleCount         = static_cast<ulong>(0);
+    r_Summary.lowestCount         = static_cast<ulong>(0);
+    r_Summary.highestCount        = static_cast<ulong>(0);
+    r_Summary.countTotal          = 0;
+    r_Summary.averageCount        = static_cast<ulong>(0);
+    r_Summary.foundLocationString = false;
+    r_Summary.labelString[0]      = 0x00;
+
+    theState.pOutputFile      = nullptr;
+    theState.outputLength     = static_cast<ulong>(0);
+    theState.writeFailed      = false;
+    theState.pSampleStore     = pSampleStore;
+    theState.pSummary         = &r_Summary;
+    theState.hasTimestamp     = false;
+    theState.frameEpoch       = 0;
+    theState.sampleInterval   = GetRecordRateSeconds(0);
+    theState.sampleIndex      = static_cast<ulong>(0);
+
+    ResetTimestampText(theState.theTimestamp);
+
+    if (nullptr != pSampleStore)
+    {
+        ResetSampleStore(*pSampleStore, imageSize);
+    }
+
+    // Create the comma-delimited output file if one is wanted
+    if (nullptr != pch_CSVFileName)
+    {
+        BuildTemporaryFileName(pch_CSVFileName, temporaryFileName, sizeof(temporaryFileName));
+
+        if (0 != fopen_s(&theState.pOutputFile, temporaryFileName, "wb"))
+        {
+            return false;
+        }
+
+        theState.outputBuffer.resize(CSV_OUTPUT_BUFFER_SIZE);
+
+        // If there is location information, the header shows the location above the
+        // date/time column, otherwise the header simply labels the date/time column
+        if (true == FindLastLocationLabel(pImage, imageSize, r_Summary.labelString))
+        {
+            AppendOutputText(theState, r_Summary.labelString);
+        }
+        else
+        {
+            AppendOutputText(theState, "Date/Time");
+        }
+
+        AppendOutputText(theState, ",Counts\n");
+    }
+
+    StartFrameDecoder(theDecoder, pImage, imageSize);
+
+    while (true == GetNextFrameEvent(theDecoder, theEvent))
+    {
+        switch (theEvent.eventType)
+        {
+            case FrameEventTimestamp:
+            {
+                theState.hasTimestamp   = true;
+                theState.frameEpoch     = EpochFromCivil(2000 + theEvent.theYear, theEvent.theMonth, theEvent.theDay,
+                    theEvent.theHour, theEvent.theMinute, theEvent.theSecond);
+                theState.sampleInterval = GetRecordRateSeconds(theEvent.theRecordRate);
+                theState.sampleIndex    = static_cast<ulong>(0);
+
+                if (nullptr != pSampleStore)
+                {
+                    StartSampleSegment(*pSampleStore, theState.frameEpoch, theEvent.theRecordRate);
+                }
+                break;
+            }
+
+            case FrameEventLocation:
+            {
+                CopyLocationLabel(theEvent, r_Summary.labelString);
+
+                // Flag the fact that we have location information
+                r_Summary.foundLocationString = true;
+
+                if (nullptr != pSampleStore)
+                {
+                    SetSampleSegmentLabel(*pSampleStore, r_Summary.labelString);
+                }
+                break;
+            }
+
+            case FrameEventCountRun:
+            {
+                // A whole run of single octet values between frames
+                for (ulong thisValue = 0; thisValue < theEvent.runLength; thisValue++)
+                {
+                    ConsumeCountValue(theState, theEvent.pCounts[thisValue]);
+                }
+                break;
+            }
+
+            case FrameEventDoubleCount:
+            case FrameEventWideCount:
+            {
+                ConsumeCountValue(theState, theEvent.countValue);
+                break;
+            }
+
+            case FrameEventEndOfData:
+            {
+                break;
+            }
+        }
+    }
+
+    if (r_Summary.sampleCount > static_cast<ulong>(0))
+    {
+        r_Summary.averageCount = static_cast<ulong>(r_Summary.countTotal / r_Summary.sampleCount);
+    }
+
+    if (nullptr != theState.pOutputFile)
+    {
+        // We are finished so write what remains and put the file in place
+        FlushOutputBuffer(theState);
+
+        if (0 != fclose(theState.pOutputFile))
+        {
+            theState.writeFailed = true;
+        }
+
+        if (true == theState.writeFailed || false == CommitFileAtomically(temporaryFileName, pch_CSVFileName))
+        {
+            (void)remove(temporaryFileName);
+
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,36 @@
+// ----------------------------------------------------------------------
+// FlashExport.h
+//
+// Decoding of a FLASH history image in to comma-delimited output, a
+// columnar store of CPS/CPM/CPH values and summary statistics, all in one
+// pass, and the decimal ASCII text dump of the image. Nothing here talks
+// to the device so the image may come from a live download or from an
+// archived *.ReadGeiger.bin file.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include "Portable.h"
+#include "SampleStore.h"
+
+typedef struct flash_image_summary_t
+{
+    ulong              sampleCount;         // The number of CPS/CPM/CPH values found
+    ulong              lowestCount;         // The lowest value found
+    ulong              highestCount;        // The highest value found
+    unsigned long long countTotal;          // The sum of all of the values
+    ulong              averageCount;        // The average across all of the values
+    bool               foundLocationString; // true if there was a location frame
+    char               labelString[256];    // The last location found, commas made spaces
+} FlashImageSummary;
+
+extern const char * theMonths[12];
+
+extern bool WriteFlashImageTextFile(const uchar * pImage, ulong imageSize, const char * pch_TextFileName);
+
+extern bool DecodeFlashImage(const uchar * pImage,
+    ulong imageSize,
+    const char * pch_CSVFileName,
+    SampleStore * pSampleStore,
+    FlashImageSummary & r_Summary);
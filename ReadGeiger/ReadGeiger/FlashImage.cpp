@@ -0,0 +1,127 @@
+// ----------------------------------------------------------------------
+// FlashImage.cpp
+//
+// Read-only memory mapping of archived FLASH image files. Windows uses
+// a file mapping object, everything else uses mmap().
+//
+// ----------------------------------------------------------------------
+
+#include "FlashImage.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// The file whose name is passed by argument is opened and mapped in to memory
+/// read-only. An empty file is considered to be an error since there would be
+/// nothing to parse.
+/// </summary>
+/// <param name="pch_FileName">The NULL-terminated name of the file to map</param>
+/// <param name="r_Image">Returns the mapped octets and what is needed to unmap them</param>
+/// <returns>true if the file was mapped, otherwise false</returns>
+bool MapFlashImageFile(const char * pch_FileName, MappedFlashImage & r_Image)
+{
+    r_Image.pImage    = nullptr;
+    r_Image.imageSize = static_cast<ulong>(0);
+
+#ifdef _WIN32
+    LARGE_INTEGER fileSize;
+
+    r_Image.hFileMapping = NULL;
+
+    // Open the file for reading, allowing others to read it at the same time
+    r_Image.hFile = CreateFile(pch_FileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (INVALID_HANDLE_VALUE == r_Image.hFile)
+    {
+        return false;
+    }
+
+    // We need the size so that the parsers know where the image ends
+    if (! GetFileSizeEx(r_Image.hFile, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(r_Image.hFile);
+        return false;
+    }
+
+    r_Image.hFileMapping = CreateFileMapping(r_Image.hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (NULL == r_Image.hFileMapping)
+    {
+        CloseHandle(r_Image.hFile);
+        return false;
+    }
+
+    r_Image.pImage = static_cast<const uchar *>(MapViewOfFile(r_Image.hFileMapping, FILE_MAP_READ, 0, 0, 0));
+
+    if (nullptr == r_Image.pImage)
+    {
+        CloseHandle(r_Image.hFileMapping);
+        CloseHandle(r_Image.hFile);
+        return false;
+    }
+
+    r_Image.imageSize = static_cast<ulong>(fileSize.QuadPart);
+#else
+    struct stat fileStatus;
+
+    // Open the file for reading
+    r_Image.fileDescriptor = open(pch_FileName, O_RDONLY);
+
+    if (r_Image.fileDescriptor < 0)
+    {
+        return false;
+    }
+
+    // We need the size so that the parsers know where the image ends
+    if (fstat(r_Image.fileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0)
+    {
+        (void)close(r_Image.fileDescriptor);
+        return false;
+    }
+
+    void * pMapping = mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, r_Image.fileDescriptor, 0);
+
+    if (MAP_FAILED == pMapping)
+    {
+        (void)close(r_Image.fileDescriptor);
+        return false;
+    }
+
+    // The parsers walk the image from the start to the end exactly once
+    (void)madvise(pMapping, static_cast<size_t>(fileStatus.st_size), MADV_SEQUENTIAL);
+
+    r_Image.pImage    = static_cast<const uchar *>(pMapping);
+    r_Image.imageSize = static_cast<ulong>(fileStatus.st_size);
+#endif
+
+    return true;
+}
+
+/// <summary>
+/// A file which was mapped by MapFlashImageFile() gets unmapped and closed
+/// </summary>
+/// <param name="r_Image">The mapped image to release</param>
+void UnmapFlashImageFile(MappedFlashImage & r_Image)
+{
+    if (nullptr == r_Image.pImage)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    (void)UnmapViewOfFile(r_Image.pImage);
+    CloseHandle(r_Image.hFileMapping);
+    CloseHandle(r_Image.hFile);
+#else
+    (void)munmap(const_cast<uchar *>(r_Image.pImage), static_cast<size_t>(r_Image.imageSize));
+    (void)close(r_Image.fileDescriptor);
+#endif
+
+    r_Image.pImage    = nullptr;
+    r_Image.imageSize = static_cast<ulong>(0);
+}
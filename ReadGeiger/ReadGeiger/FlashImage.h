@@ -0,0 +1,29 @@
+// ----------------------------------------------------------------------
+// FlashImage.h
+//
+// An archived *.ReadGeiger.bin file is a byte-for-byte copy of the
+// device's FLASH history. Rather than reading the file in to a copy of
+// the global FLASH image array, these functions map the file read-only
+// in to memory so that the parsers can work on it directly and so that
+// many images may be processed at the same time.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include "Portable.h"
+
+typedef struct mapped_flash_image_t
+{
+    const uchar * pImage;           // The first octet of the mapped file, or nullptr
+    ulong         imageSize;        // The number of octets which are mapped
+#ifdef _WIN32
+    HANDLE        hFile;            // The file which was opened
+    HANDLE        hFileMapping;     // The file mapping object for that file
+#else
+    int           fileDescriptor;   // The file which was opened
+#endif
+} MappedFlashImage;
+
+extern bool MapFlashImageFile(const char * pch_FileName, MappedFlashImage & r_Image);
+extern void UnmapFlashImageFile(MappedFlashImage & r_Image);
@@ -0,0 +1,320 @@
+// ----------------------------------------------------------------------
+// FleetHarvest.cpp
+//
+// The headless fleet harvester. Ports are either named on the command
+// line or found the same way the console program finds them, and each
+// one is harvested from its own thread with its own DeviceSession so
+// that eight counters take about as long as one.
+//
+// The output files are named after the device's serial number as well
+// as the date and time so that devices harvested in the same second do
+// not collide, and they still match the *.ReadGeiger.bin pattern which
+// the batch decoder looks for.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FleetHarvest.h"
+#include "DeviceSession.h"
+#include "FlashExport.h"
+
+#ifndef _WIN32
+#include <glob.h>
+#endif
+
+using namespace std;
+
+typedef struct fleet_device_result_t
+{
+    string       portName;                  // The serial port the device is on
+    string       serialNumber;              // The device's serial number as hexadecimal text
+    string       modelAndVersion;           // What GETVER answered with
+    string       imageFileName;             // The raw data file created
+    bool         wasSuccessful;             // true if everything was retrieved and exported
+    const char * pch_FailureReason;         // What went wrong when it was not
+    double       elapsedSeconds;            // How long the device took from opening to exporting
+    ulong        octetsReceived;            // Every octet the device sent
+    ulong        commandCount;              // Every command sent, retries included
+    ulong        retryCount;                // Commands which had to be sent again
+    ulong        failureCount;              // Commands which never got a response
+    ulong        blockLength;               // The history block length the device settled on
+    ulong        sampleCount;               // The number of CPS/CPM/CPH values exported
+    bool         historyMismatched;         // true if the history no longer matched the last visit's
+} FleetDeviceResult;
+
+/// <summary>
+/// Finds the serial ports which may have a Geiger Counter on them. On Windows that is
+/// every COM port whose device is a serial device, as the console program looks for;
+/// elsewhere it is every USB serial adapter.
+/// </summary>
+/// <param name="r_PortNames">The container the port names are appended to</param>
+void FindSerialPorts(vector<string> & r_PortNames)
+{
+#ifdef _WIN32
+    TCHAR lpTargetPath[1000] = { 0 };
+    char  comName[101]       = { 0 };
+
+    for (int thisComNumber = static_cast<int>(0); thisComNumber < static_cast<int>(255); thisComNumber++)
+    {
+        (void)sprintf_s(comName, "COM%u", thisComNumber);
+
+        if (static_cast<DWORD>(0) != QueryDosDevice(comName, (LPSTR)lpTargetPath, sizeof(lpTargetPath)) &&
+            (char *)NULL != stristr(lpTargetPath, "serial"))
+        {
+            r_PortNames.push_back(comName);
+        }
+    }
+#else
+    static const char * portPatterns[] = { "/dev/ttyUSB*", "/dev/ttyACM*" };
+
+    for (size_t thisPattern = 0; thisPattern < sizeof(portPatterns) / sizeof(portPatterns[0]); thisPattern++)
+    {
+        glob_t globResult;
+
+        if (0 == glob(portPatterns[thisPattern], 0, nullptr, &globResult))
+        {
+            for (size_t thisMatch = 0; thisMatch < globResult.gl_pathc; thisMatch++)
+            {
+                r_PortNames.push_back(globResult.gl_pathv[thisMatch]);
+            }
+        }
+
+        globfree(&globResult);
+    }
+#endif
+}
+
+/// <summary>
+/// Builds the name of one of a device's output files in the output directory,
+/// "DIRECTORY/SERIAL.DATE.ReadGeiger.bin" for example
+/// </summary>
+static string BuildFleetFileName(const string & r_OutputDirectory, const string & r_Prefix, const char * pch_FileName)
+{
+    string theName = r_OutputDirectory;
+
+    if (false == theName.empty() && theName.back() != PATH_SEPARATOR_CHARACTER && theName.back() != '/')
+    {
+        theName += PATH_SEPARATOR_CHARACTER;
+    }
+
+    return theName + r_Prefix + "." + pch_FileName;
+}
+
+/// <summary>
+/// Harvests the device on one port: identifies it, retrieves its history since the
+/// last visit, and writes the raw data file, the comma-delimited file and, if asked
+/// for, the ASCII text dump. This is called from many threads at once so it only
+/// touches its own session and the result it is given.
+/// </summary>
+/// <param name="r_Result">The port to harvest, updated with what happened</param>
+/// <param name="baudRate">The bits per second to open the port at</param>
+/// <param name="r_OutputDirectory">Where the output files go, or empty for here</param>
+/// <param name="wantTextDump">true to also create the ASCII text dump</param>
+static void HarvestOneDevice(FleetDeviceResult & r_Result, ulong baudRate, const string & r_OutputDirectory, bool wantTextDump)
+{
+    unique_ptr<DeviceSession> pSession(new DeviceSession());
+    DeviceSession &           r_Session     = *pSession;
+    FlashImageSummary         theSummary;
+    char                      timeStamp[31] = { 0 };
+
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    r_Result.wasSuccessful     = false;
+    r_Result.pch_FailureReason = "";
+
+    if (false == OpenDeviceSession(r_Session, r_Result.portName.c_str(), baudRate))
+    {
+        r_Result.pch_FailureReason = "open";
+    }
+    else
+    {
+        // A port which does not answer GETVER does not have a Geiger Counter on it
+        if (false == AcquireSessionModelAndVersion(r_Session))
+        {
+            r_Result.pch_FailureReason = "no answer";
+        }
+        else if (false == AcquireSessionSerialNumber(r_Session))
+        {
+            r_Result.pch_FailureReason = "serial";
+        }
+        else if (false == SyncSessionHistory(r_Session))
+        {
+            r_Result.pch_FailureReason = "history";
+        }
+        else
+        {
+            FormatHarvestTimeStamp(timeStamp, sizeof(timeStamp));
+
+            string thePrefix = string(r_Session.serialNumberText) + "." + timeStamp;
+
+            r_Result.imageFileName = BuildFleetFileName(r_OutputDirectory, thePrefix, DATA_OUTPUT_FILE_NAME);
+
+            string csvFileName  = BuildFleetFileName(r_OutputDirectory, thePrefix, DATA_OUTPUT_CSV_FILE_NAME);
+            string textFileName = BuildFleetFileName(r_OutputDirectory, thePrefix, DATA_OUTPUT_ASCII_FILE_NAME);
+
+            if (false == WriteSessionImageFile(r_Session, r_Result.imageFileName.c_str()))
+            {
+                r_Result.pch_FailureReason = "write image";
+            }
+            else if (false == DecodeFlashImage(r_Session.flashImage, FLASH_IMAGE_SIZE, csvFileName.c_str(), nullptr, theSummary))
+            {
+                r_Result.pch_FailureReason = "write CSV";
+            }
+            else if (true == wantTextDump && false == WriteFlashImageTextFile(r_Session.flashImage, MAX_FLASH_MEMORY, textFileName.c_str()))
+            {
+                r_Result.pch_FailureReason = "write text";
+            }
+            else
+            {
+                r_Result.sampleCount   = theSummary.sampleCount;
+                r_Result.wasSuccessful = true;
+            }
+        }
+
+        CloseDeviceSession(r_Session);
+    }
+
+    r_Result.serialNumber    = r_Session.serialNumberText;
+    r_Result.modelAndVersion = r_Session.modelAndVersion;
+    r_Result.octetsReceived  = r_Session.octetsReceived;
+    r_Result.commandCount    = r_Session.commandCount;
+    r_Result.retryCount      = r_Session.retryCount;
+    r_Result.failureCount    = r_Session.failureCount;
+    r_Result.blockLength     = r_Session.historyBlockLength;
+    r_Result.historyMismatched = r_Session.historyMismatched;
+    r_Result.elapsedSeconds  = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+/// <summary>
+/// Displays how the fleet harvester is used
+/// </summary>
+static void DisplayFleetUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -fleet [port] [...] [-out <directory>] [-baud <rate>] [-text]\n");
+    (void)printf("  With no ports named, every serial port found is tried.\n");
+    (void)printf("  -text also creates the decimal ASCII text dump of each device.\n");
+}
+
+/// <summary>
+/// The entry point for the fleet harvester. Every port is harvested at the same time
+/// and a line for each device is displayed once they have all finished.
+/// </summary>
+/// <param name="argc">The number of arguments following "-fleet"</param>
+/// <param name="argv">The arguments following "-fleet"</param>
+/// <returns>0 if every device was harvested, otherwise 1</returns>
+int RunFleetHarvest(int argc, char * argv[])
+{
+    vector<string>            portNames;
+    vector<FleetDeviceResult> theResults;
+    vector<thread>            harvestThreads;
+    string                    outputDirectory;
+    ulong                     baudRate      = FLEET_DEFAULT_BAUD_RATE;
+    ulong                     failedCount   = static_cast<ulong>(0);
+    ulong                     totalOctets   = static_cast<ulong>(0);
+    bool                      wantTextDumps = false;
+
+    // Gather the options and the ports
+    for (int thisArgument = 0; thisArgument < argc; thisArgument++)
+    {
+        if (0 == strcmp(argv[thisArgument], "-out") && thisArgument + 1 < argc)
+        {
+            outputDirectory = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-baud") && thisArgument + 1 < argc)
+        {
+            baudRate = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-text"))
+        {
+            wantTextDumps = true;
+        }
+        else
+        {
+            portNames.push_back(argv[thisArgument]);
+        }
+    }
+
+    if (portNames.empty())
+    {
+        FindSerialPorts(portNames);
+    }
+
+    if (portNames.empty())
+    {
+        DisplayFleetUsage();
+        (void)printf("There were no serial ports found to harvest\n");
+        return 1;
+    }
+
+    if (baudRate == static_cast<ulong>(0))
+    {
+        baudRate = FLEET_DEFAULT_BAUD_RATE;
+    }
+
+    theResults.resize(portNames.size());
+
+    (void)printf("Harvesting %lu ports at %lu baud\n", static_cast<ulong>(portNames.size()), baudRate);
+
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    // Every device is talked to at the same time
+    for (size_t thisPort = 0; thisPort < portNames.size(); thisPort++)
+    {
+        theResults[thisPort].portName = portNames[thisPort];
+
+        harvestThreads.push_back(thread(HarvestOneDevice,
+            ref(theResults[thisPort]),
+            baudRate,
+            cref(outputDirectory),
+            wantTextDumps));
+    }
+
+    for (size_t thisThread = 0; thisThread < harvestThreads.size(); thisThread++)
+    {
+        harvestThreads[thisThread].join();
+    }
+
+    double elapsedSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    (void)printf("\nPort             Serial           Seconds    Octets  Commands  Retries  Failures  Block  Samples  Result\n");
+
+    for (size_t thisPort = 0; thisPort < theResults.size(); thisPort++)
+    {
+        const FleetDeviceResult & r_Result = theResults[thisPort];
+
+        (void)printf("%-16s %-14s %9.2f %9lu %9lu %8lu %9lu %6lu %8lu  %s%s\n",
+            r_Result.portName.c_str(),
+            r_Result.serialNumber.empty() ? "-" : r_Result.serialNumber.c_str(),
+            r_Result.elapsedSeconds,
+            r_Result.octetsReceived,
+            r_Result.commandCount,
+            r_Result.retryCount,
+            r_Result.failureCount,
+            r_Result.blockLength,
+            r_Result.sampleCount,
+            (true == r_Result.wasSuccessful) ? r_Result.imageFileName.c_str() : r_Result.pch_FailureReason,
+            (true == r_Result.historyMismatched) ? ", history did not match the last visit so all of it was retrieved" : "");
+
+        totalOctets += r_Result.octetsReceived;
+
+        if (false == r_Result.wasSuccessful)
+        {
+            failedCount++;
+        }
+    }
+
+    (void)printf("\nHarvested %lu of %lu devices in %.2f seconds, %lu octets received\n",
+        static_cast<ulong>(theResults.size()) - failedCount,
+        static_cast<ulong>(theResults.size()),
+        elapsedSeconds,
+        totalOctets);
+
+    return (failedCount == static_cast<ulong>(0)) ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+// ----------------------------------------------------------------------
+// FleetHarvest.h
+//
+// Harvests every Geiger Counter plugged in to a hub at the same time.
+// Each serial port found gets its own device session and its own
+// thread which retrieves the configuration and the history data and
+// exports them, and a summary of every device is displayed at the end.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#define FLEET_DEFAULT_BAUD_RATE         static_cast<ulong>(57600)
+
+extern void FindSerialPorts(std::vector<std::string> & r_PortNames);
+
+extern int RunFleetHarvest(int argc, char * argv[]);
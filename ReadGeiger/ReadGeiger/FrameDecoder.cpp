@@ -0,0 +1,197 @@
+// ----------------------------------------------------------------------
+// FrameDecoder.cpp
+//
+// The single parser of FLASH history images. Anything which is not
+// inside of a 0x55 0xAA frame is a CPS/CPM/CPH octet, and two octets of
+// 0xFF mark the end of the valid history data. Runs of CPS/CPM/CPH
+// octets are found with FrameScanner.cpp and reported as one event.
+//
+// ----------------------------------------------------------------------
+
+#include "FrameDecoder.h"
+#include "FrameScanner.h"
+#include "ReadGeiger.h"
+
+/// <summary>
+/// Prepares a decoder to walk the image passed by argument from its start
+/// </summary>
+/// <param name="r_Decoder">The decoder to prepare</param>
+/// <param name="pImage">The FLASH history image</param>
+/// <param name="imageSize">The number of octets in the image</param>
+void StartFrameDecoder(FrameDecoder & r_Decoder, const uchar * pImage, ulong imageSize)
+{
+    r_Decoder.pImage       = pImage;
+    r_Decoder.imageSize    = imageSize;
+    r_Decoder.currentIndex = static_cast<ulong>(0);
+    r_Decoder.endOfData    = (nullptr == pImage || imageSize == static_cast<ulong>(0));
+}
+
+/// <summary>
+/// Reports the end of the valid data, which is always the last event
+/// </summary>
+static bool ReportEndOfData(FrameDecoder & r_Decoder, FrameEvent & r_Event)
+{
+    r_Event.eventType   = FrameEventEndOfData;
+    r_Event.imageOffset = r_Decoder.currentIndex;
+
+    r_Decoder.endOfData    = true;
+    r_Decoder.currentIndex = r_Decoder.imageSize;
+
+    return true;
+}
+
+/// <summary>
+/// Decodes the next event from the image. Frames which carry nothing of interest,
+/// such as which tube is selected, are stepped over without producing an event.
+/// </summary>
+/// <param name="r_Decoder">The decoder which was prepared by StartFrameDecoder()</param>
+/// <param name="r_Event">Returns the event which was decoded</param>
+/// <returns>true if an event was returned, false once the end of data has been reported</returns>
+bool GetNextFrameEvent(FrameDecoder & r_Decoder, FrameEvent & r_Event)
+{
+    const uchar * pImage = r_Decoder.pImage;
+
+    if (true == r_Decoder.endOfData)
+    {
+        return false;
+    }
+
+    while (r_Decoder.currentIndex + 1 < r_Decoder.imageSize)
+    {
+        ulong theIndex = r_Decoder.currentIndex;
+
+        // Two end-of-data octets mean that there is no more history data
+        if (RawDataHeaderEndOfData == pImage[theIndex] && RawDataHeaderEndOfData == pImage[theIndex + 1])
+        {
+            return ReportEndOfData(r_Decoder, r_Event);
+        }
+
+        // Anything up to the next frame marker or end of data is CPS/CPM/CPH octets
+        if (RawDataTerm1 != pImage[theIndex] || RawDataTerm2 != pImage[theIndex + 1])
+        {
+            ulong boundaryIndex = FindNextFrameBoundary(pImage, theIndex, r_Decoder.imageSize);
+
+            r_Event.eventType   = FrameEventCountRun;
+            r_Event.imageOffset = theIndex;
+            r_Event.pCounts     = &pImage[theIndex];
+            r_Event.runLength   = boundaryIndex - theIndex;
+
+            r_Decoder.currentIndex = boundaryIndex;
+            return true;
+        }
+
+        // It is a frame. Step over the marker and look at the frame type
+        theIndex += 2;
+
+        if (theIndex >= r_Decoder.imageSize)
+        {
+            break;
+        }
+
+        uchar frameType = pImage[theIndex++];
+        ulong remaining = r_Decoder.imageSize - theIndex;
+
+        r_Event.imageOffset = theIndex;
+
+        switch (frameType)
+        {
+            case RawDataHeaderTimestamp:
+            {
+                // YY MM DD HH MM SS followed by a frame marker and the record rate
+                if (remaining < static_cast<ulong>(9))
+                {
+                    return ReportEndOfData(r_Decoder, r_Event);
+                }
+
+                r_Event.eventType     = FrameEventTimestamp;
+                r_Event.theYear       = pImage[theIndex + 0];
+                r_Event.theMonth      = pImage[theIndex + 1];
+                r_Event.theDay        = pImage[theIndex + 2];
+                r_Event.theHour       = pImage[theIndex + 3];
+                r_Event.theMinute     = pImage[theIndex + 4];
+                r_Event.theSecond     = pImage[theIndex + 5];
+                r_Event.theRecordRate = pImage[theIndex + 8];
+
+                r_Decoder.currentIndex = theIndex + 9;
+                return true;
+            }
+
+            case RawDataHeaderCPSIsDoubleByte:
+            {
+                // The next two bytes are the MSB and the LSB
+                if (remaining < static_cast<ulong>(2))
+                {
+                    return ReportEndOfData(r_Decoder, r_Event);
+                }
+
+                r_Event.eventType  = FrameEventDoubleCount;
+                r_Event.countValue = (static_cast<ulong>(pImage[theIndex]) << 8) + pImage[theIndex + 1];
+
+                r_Decoder.currentIndex = theIndex + 2;
+                return true;
+            }
+
+            case RawDataHeaderTripleByteCPS:
+            case RawDataHeader4ByteCPS:
+            {
+                // Three or four bytes, most significant first
+                ulong valueLength = (RawDataHeaderTripleByteCPS == frameType) ? 3 : 4;
+
+                if (remaining < valueLength)
+                {
+                    return ReportEndOfData(r_Decoder, r_Event);
+                }
+
+                r_Event.eventType  = FrameEventWideCount;
+                r_Event.countValue = 0;
+
+                for (ulong thisOctet = 0; thisOctet < valueLength; thisOctet++)
+                {
+                    r_Event.countValue = (r_Event.countValue << 8) + pImage[theIndex + thisOctet];
+                }
+
+                r_Decoder.currentIndex = theIndex + valueLength;
+                return true;
+            }
+
+            case RawDataHeaderCPSLocationData:
+            {
+                // The next byte is the length of the ASCII string which follows
+                if (remaining < static_cast<ulong>(1) || remaining - 1 < pImage[theIndex])
+                {
+                    return ReportEndOfData(r_Decoder, r_Event);
+                }
+
+                r_Event.eventType   = FrameEventLocation;
+                r_Event.labelLength = pImage[theIndex];
+                r_Event.pLabel      = &pImage[theIndex + 1];
+
+                r_Decoder.currentIndex = theIndex + 1 + r_Event.labelLength;
+                return true;
+            }
+
+            case RawDataHeaderWhichTubeIsSelected:
+            {
+                // One byte which we have no interest in
+                r_Decoder.currentIndex = theIndex + 1;
+                break;
+            }
+
+            case RawDataHeaderEndOfData:
+            {
+                // A frame marker in to erased FLASH
+                return ReportEndOfData(r_Decoder, r_Event);
+            }
+
+            default:
+            {
+                // An unknown frame type. Carry on with what follows it as count data
+                r_Decoder.currentIndex = theIndex;
+                break;
+            }
+        }
+    }
+
+    // We ran off of the end of the image without seeing the end-of-data octets
+    return ReportEndOfData(r_Decoder, r_Event);
+}
@@ -0,0 +1,55 @@
+// ----------------------------------------------------------------------
+// FrameDecoder.h
+//
+// Turns a FLASH history image in to a stream of typed events so that
+// every consumer of the history data (comma-delimited export, minimum
+// and maximum, averages, anomaly scanning) sees exactly the same parse
+// of the frames described in ReadGeiger.h and Borrowed.h.
+//
+// The decoder allocates nothing. Location events point in to the image
+// so the image must outlive the events.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include "Portable.h"
+
+typedef enum frame_event_type_t
+{
+    FrameEventTimestamp,            // A date/time stamp and the record rate which follows it
+    FrameEventCountRun,             // A run of single octet CPS/CPM/CPH values
+    FrameEventDoubleCount,          // A CPS/CPM/CPH value stored in a double byte frame
+    FrameEventWideCount,            // A CPS/CPM/CPH value stored in a triple or 4 byte frame
+    FrameEventLocation,             // A location a.k.a. label string
+    FrameEventEndOfData             // There is no more valid history data
+} FrameEventType;
+
+typedef struct frame_event_t
+{
+    FrameEventType eventType;       // What the event describes
+    ulong          imageOffset;     // Where in the image the event's data starts
+    ulong          countValue;      // For the double and wide count events, the CPS/CPM/CPH value
+    const uchar *  pCounts;         // For count runs, the first of the single octet values
+    ulong          runLength;       // ... and how many values there are in the run
+    uchar          theYear;         // For timestamp events, the two digit year
+    uchar          theMonth;        // ... the month as stored by the device
+    uchar          theDay;          // ... the day of the month
+    uchar          theHour;         // ... the hour
+    uchar          theMinute;       // ... the minute
+    uchar          theSecond;       // ... the second
+    uchar          theRecordRate;   // ... 0 = off, 1 = CPS, 2 = CPM, 3 = CPM once per hour
+    const uchar *  pLabel;          // For location events, the label octets (not NULL-terminated)
+    uchar          labelLength;     // ... and how many octets there are
+} FrameEvent;
+
+typedef struct frame_decoder_t
+{
+    const uchar * pImage;           // The image being decoded
+    ulong         imageSize;        // The number of octets in the image
+    ulong         currentIndex;     // The next octet to examine
+    bool          endOfData;        // true once the end of valid data has been reported
+} FrameDecoder;
+
+extern void StartFrameDecoder(FrameDecoder & r_Decoder, const uchar * pImage, ulong imageSize);
+extern bool GetNextFrameEvent(FrameDecoder & r_Decoder, FrameEvent & r_Event);
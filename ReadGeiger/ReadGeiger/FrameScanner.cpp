@@ -0,0 +1,236 @@
+// ----------------------------------------------------------------------
+// FrameScanner.cpp
+//
+// Locates the next 0x55 0xAA frame marker or 0xFF 0xFF end of data pair
+// in a FLASH history image. The widest instruction set that both the
+// compiler and the processor support is selected the first time the
+// scanner is used.
+//
+// Each vector step compares the octets at [i, i + width) against the
+// first octet of each pair and the octets at [i + 1, i + 1 + width)
+// against the second octet, so a pair which straddles two steps is
+// still found.
+//
+// ----------------------------------------------------------------------
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define FRAME_SCANNER_HAS_SSE2  1
+#include <emmintrin.h>
+#endif
+
+#if defined(FRAME_SCANNER_HAS_SSE2) && (defined(_MSC_VER) || defined(__GNUC__))
+#define FRAME_SCANNER_HAS_AVX2  1
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION           __attribute__((target("avx2")))
+#endif
+
+// The intrinsic headers come first since Portable.h defines ulong et al. as macros
+#include "FrameScanner.h"
+#include "ReadGeiger.h"
+
+typedef ulong (*FrameScannerFunction)(const uchar * pImage, ulong startIndex, ulong imageSize);
+
+/// <summary>
+/// Returns the position of the lowest bit which is set. The mask must not be zero.
+/// </summary>
+static inline ulong LowestSetBit(unsigned int theMask)
+{
+#ifdef _MSC_VER
+    unsigned long bitIndex;
+
+    (void)_BitScanForward(&bitIndex, theMask);
+    return static_cast<ulong>(bitIndex);
+#else
+    return static_cast<ulong>(__builtin_ctz(theMask));
+#endif
+}
+
+/// <summary>
+/// Examines one octet pair at a time. This is used on processors without SSE2
+/// and for the last few octets which are too few for a vector step.
+/// </summary>
+/// <param name="pImage">The FLASH history image</param>
+/// <param name="startIndex">The first octet to examine</param>
+/// <param name="imageSize">The number of octets in the image</param>
+/// <returns>The offset of the first octet of the pair, else imageSize - 1 if there is none</returns>
+static ulong ScanForFrameBoundaryScalar(const uchar * pImage, ulong startIndex, ulong imageSize)
+{
+    ulong thisIndex;
+
+    for (thisIndex = startIndex; thisIndex + 1 < imageSize; thisIndex++)
+    {
+        uchar testbyte1 = pImage[thisIndex];
+        uchar testbyte2 = pImage[thisIndex + 1];
+
+        if ((RawDataTerm1 == testbyte1 && RawDataTerm2 == testbyte2) ||
+            (RawDataHeaderEndOfData == testbyte1 && RawDataHeaderEndOfData == testbyte2))
+        {
+            return thisIndex;
+        }
+    }
+
+    return thisIndex;
+}
+
+#ifdef FRAME_SCANNER_HAS_SSE2
+/// <summary>
+/// Examines 16 octet pairs at a time using SSE2
+/// </summary>
+static ulong ScanForFrameBoundarySSE2(const uchar * pImage, ulong startIndex, ulong imageSize)
+{
+    const __m128i term1     = _mm_set1_epi8(static_cast<char>(RawDataTerm1));
+    const __m128i term2     = _mm_set1_epi8(static_cast<char>(RawDataTerm2));
+    const __m128i endOfData = _mm_set1_epi8(static_cast<char>(RawDataHeaderEndOfData));
+    ulong         thisIndex = startIndex;
+
+    // Each step reads up to 16 octets past thisIndex
+    while (thisIndex + 17 <= imageSize)
+    {
+        __m128i firstOctets  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&pImage[thisIndex]));
+        __m128i secondOctets = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&pImage[thisIndex + 1]));
+
+        __m128i isMarker = _mm_and_si128(_mm_cmpeq_epi8(firstOctets, term1), _mm_cmpeq_epi8(secondOctets, term2));
+        __m128i isEnd    = _mm_and_si128(_mm_cmpeq_epi8(firstOctets, endOfData), _mm_cmpeq_epi8(secondOctets, endOfData));
+
+        unsigned int theMask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_or_si128(isMarker, isEnd)));
+
+        if (theMask != 0)
+        {
+            return thisIndex + LowestSetBit(theMask);
+        }
+
+        thisIndex += 16;
+    }
+
+    return ScanForFrameBoundaryScalar(pImage, thisIndex, imageSize);
+}
+#endif
+
+#ifdef FRAME_SCANNER_HAS_AVX2
+/// <summary>
+/// Examines 32 octet pairs at a time using AVX2
+/// </summary>
+AVX2_FUNCTION static ulong ScanForFrameBoundaryAVX2(const uchar * pImage, ulong startIndex, ulong imageSize)
+{
+    const __m256i term1     = _mm256_set1_epi8(static_cast<char>(RawDataTerm1));
+    const __m256i term2     = _mm256_set1_epi8(static_cast<char>(RawDataTerm2));
+    const __m256i endOfData = _mm256_set1_epi8(static_cast<char>(RawDataHeaderEndOfData));
+    ulong         thisIndex = startIndex;
+
+    // Each step reads up to 32 octets past thisIndex
+    while (thisIndex + 33 <= imageSize)
+    {
+        __m256i firstOctets  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&pImage[thisIndex]));
+        __m256i secondOctets = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&pImage[thisIndex + 1]));
+
+        __m256i isMarker = _mm256_and_si256(_mm256_cmpeq_epi8(firstOctets, term1), _mm256_cmpeq_epi8(secondOctets, term2));
+        __m256i isEnd    = _mm256_and_si256(_mm256_cmpeq_epi8(firstOctets, endOfData), _mm256_cmpeq_epi8(secondOctets, endOfData));
+
+        unsigned int theMask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_or_si256(isMarker, isEnd)));
+
+        if (theMask != 0)
+        {
+            return thisIndex + LowestSetBit(theMask);
+        }
+
+        thisIndex += 32;
+    }
+
+    return ScanForFrameBoundarySSE2(pImage, thisIndex, imageSize);
+}
+
+/// <summary>
+/// Determines whether the processor and the operating system support AVX2
+/// </summary>
+static bool ProcessorHasAVX2(void)
+{
+#ifdef _MSC_VER
+    int cpuInformation[4];
+
+    __cpuid(cpuInformation, 0);
+
+    if (cpuInformation[0] < 7)
+    {
+        return false;
+    }
+
+    // The operating system must save the YMM registers (OSXSAVE and AVX, then XCR0)
+    __cpuid(cpuInformation, 1);
+
+    if ((cpuInformation[2] & (1 << 27)) == 0 || (cpuInformation[2] & (1 << 28)) == 0)
+    {
+        return false;
+    }
+
+    if ((_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+
+    __cpuidex(cpuInformation, 7, 0);
+
+    return (cpuInformation[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+/// <summary>
+/// Picks the widest scanner the processor supports
+/// </summary>
+static FrameScannerFunction SelectFrameScanner(const char ** ppch_ScannerName)
+{
+#ifdef FRAME_SCANNER_HAS_AVX2
+    if (true == ProcessorHasAVX2())
+    {
+        *ppch_ScannerName = "AVX2";
+        return ScanForFrameBoundaryAVX2;
+    }
+#endif
+
+#ifdef FRAME_SCANNER_HAS_SSE2
+    *ppch_ScannerName = "SSE2";
+    return ScanForFrameBoundarySSE2;
+#else
+    *ppch_ScannerName = "Scalar";
+    return ScanForFrameBoundaryScalar;
+#endif
+}
+
+static const char *         pch_SelectedScannerName = "Scalar";
+static FrameScannerFunction selectedFrameScanner    = SelectFrameScanner(&pch_SelectedScannerName);
+
+/// <summary>
+/// Finds the next frame marker or end of data octet pair at or after the start index
+/// </summary>
+/// <param name="pImage">The FLASH history image</param>
+/// <param name="startIndex">The first octet to examine</param>
+/// <param name="imageSize">The number of octets in the image</param>
+/// <returns>The offset of the first octet of the pair, else imageSize - 1 if there is none</returns>
+ulong FindNextFrameBoundary(const uchar * pImage, ulong startIndex, ulong imageSize)
+{
+    if (startIndex + 1 >= imageSize)
+    {
+        return (imageSize > static_cast<ulong>(0)) ? imageSize - 1 : static_cast<ulong>(0);
+    }
+
+    return selectedFrameScanner(pImage, startIndex, imageSize);
+}
+
+/// <summary>
+/// Reports which instruction set the scanner is using, for throughput reports
+/// </summary>
+/// <returns>"AVX2", "SSE2" or "Scalar"</returns>
+const char * GetFrameScannerName(void)
+{
+    return pch_SelectedScannerName;
+}
@@ -0,0 +1,16 @@
+// ----------------------------------------------------------------------
+// FrameScanner.h
+//
+// Most of a FLASH history image is plain CPS/CPM/CPH octets or erased
+// 0xFF octets. Rather than testing one octet pair at a time for a frame
+// marker or for the end of data, the scanner tests 16 or 32 octets at a
+// time using SSE2 or AVX2, falling back to a plain loop elsewhere.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include "Portable.h"
+
+extern ulong FindNextFrameBoundary(const uchar * pImage, ulong startIndex, ulong imageSize);
+extern const char * GetFrameScannerName(void);
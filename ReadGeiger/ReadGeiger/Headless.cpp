@@ -0,0 +1,149 @@
+// ----------------------------------------------------------------------
+// Headless.cpp
+//
+// Dispatches the command line operations which do not need the console
+// menu. Windows reaches this from main() in ReadGeiger.cpp when there
+// are arguments, other systems build this module with its own main().
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include "Headless.h"
+#include "AnomalyDetector.h"
+#include "ArchiveStore.h"
+#include "BatchDecode.h"
+#include "Benchmark.h"
+#include "DailyStats.h"
+#include "DeviceEmulator.h"
+#include "EventExtractor.h"
+#include "FleetHarvest.h"
+#include "LiveHeartbeat.h"
+#include "PollScheduler.h"
+#include "QueryEngine.h"
+#include "SeriesFile.h"
+
+/// <summary>
+/// Displays the operations which may be performed from the command line
+/// </summary>
+static void DisplayHeadlessUsage(void)
+{
+    (void)printf("Usage: ReadGeiger <operation> [arguments]\n\n");
+    (void)printf("  -batch <directory|pattern> [...] [-out <directory>] [-threads <count>] [-text] [-series]\n");
+    (void)printf("        Decode archived FLASH images in to comma-delimited files\n");
+    (void)printf("  -emulate <image.bin> [...] [-baud <rate>] [-latency <ms>] [-short <per mille>] [-drop <per mille>]\n");
+    (void)printf("        Serve archived FLASH images from emulated GMC-300E devices on pseudo-terminals\n");
+    (void)printf("  -fleet [port] [...] [-out <directory>] [-baud <rate>] [-text]\n");
+    (void)printf("        Harvest every Geiger Counter that is plugged in, all at the same time\n");
+    (void)printf("  -live <port> [-baud <rate>] [-seconds <count>] [-sigma <deviations>] [-out <directory>] [-nolog]\n");
+    (void)printf("        Watch a Geiger Counter's counts each second as they happen, alerting at once\n");
+    (void)printf("  -poll [port[@seconds]] [...] [-interval <seconds>] [-jitter <percent>] [-threads <count>] [-seconds <count>] [-out <directory>] [-quiet]\n");
+    (void)printf("        Keep the current readings of many Geiger Counters from a few threads\n");
+    (void)printf("  -bench [corpus directory] [-seconds <minimum>] [-scale <images>] [-json <file>] [-baseline <file>] | -compare <baseline> <current>\n");
+    (void)printf("        Time decoding, exporting and scanning over the archived images, as JSON, and flag regressions\n");
+    (void)printf("  -archive <archive directory> [-serial <serial>] <directory|pattern> [...] | -list | -restore <serial> <dump>\n");
+    (void)printf("        Keep FLASH images in an archive which stores only what each image adds\n");
+    (void)printf("  -series <directory|pattern> [...] [-out <directory>]\n");
+    (void)printf("        Convert FLASH images and comma-delimited files in to binary series files\n");
+    (void)printf("  -query <directory|pattern> [...] [-device <text>] [-from <time>] [-to <time>] [-list | -bucket <minutes> | -above <count>]\n");
+    (void)printf("        Ask about a time range across every device's decoded history\n");
+    (void)printf("  -anomaly <directory|pattern> [...] [-serial <serial>] [-sigma <deviations>]\n");
+    (void)printf("        Find periods of 1, 5, 10 and 60 minutes which are higher than counting statistics allow\n");
+    (void)printf("  -score <directory|pattern> [...] [-device <text>] [-window <minutes>] [-below <p-value>]\n");
+    (void)printf("        Give every value and window sum of every device its Poisson p-value\n");
+    (void)printf("  -events <directory|pattern> [...] [-device <text>] [-from <time>] [-context <minutes>] [-out <directory>]\n");
+    (void)printf("        Write each super high event with its context to a file of its own, and an index of them all\n");
+    (void)printf("  -stats <directory|pattern> [...] [-store <file>] [-serial <serial>] [-threads <count>] [-device <text>] [-from <time>] [-to <time>]\n");
+    (void)printf("        Keep each device's daily statistics across every dump, taking in only the new dumps\n");
+}
+
+/// <summary>
+/// Performs the operation named by the first command line argument
+/// </summary>
+/// <param name="argc">The number of command line arguments</param>
+/// <param name="argv">The command line arguments, the first being the program name</param>
+/// <returns>The ERRORLEVEL to exit with</returns>
+int RunHeadlessCommand(int argc, char * argv[])
+{
+    if (argc >= 2 && 0 == strcmp(argv[1], "-batch"))
+    {
+        return RunBatchDecode(argc - 2, &argv[2]);
+    }
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "-emulate"))
+    {
+        return RunDeviceEmulator(argc - 2, &argv[2]);
+    }
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "-fleet"))
+    {
+        return RunFleetHarvest(argc - 2, &argv[2]);
+    }
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "-live"))
+    {
+        return RunLiveHeartbeat(argc - 2, &argv[2]);
+    }
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "-poll"))
+    {
+        return RunPollScheduler(argc - 2, &argv[2]);
+    }
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "-bench"))
+    {
+        return RunBenchmark(argc - 2, &argv[2]);
+    }
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "-archive"))
+    {
+        return RunArchiveStore(argc - 2, &argv[2]);
+    }
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "-series"))
+    {
+        return RunSeriesConvert(argc - 2, &argv[2]);
+    }
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "-query"))
+    {
+        return RunQueryEngine(argc - 2, &argv[2]);
+    }
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "-anomaly"))
+    {
+        return RunAnomalyScan(argc - 2, &argv[2]);
+    }
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "-score"))
+    {
+        return RunSignificanceScore(argc - 2, &argv[2]);
+    }
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "-events"))
+    {
+        return RunEventExtractor(argc - 2, &argv[2]);
+    }
+
+    if (argc >= 2 && 0 == strcmp(argv[1], "-stats"))
+    {
+        return RunDailyStats(argc - 2, &argv[2]);
+    }
+
+    DisplayHeadlessUsage();
+
+    return 1;
+}
+
+#ifndef _WIN32
+/// <summary>
+/// The main entry point of the program on systems which have no console menu
+/// </summary>
+/// <param name="argc">The number of command line arguments</param>
+/// <param name="argv">The command line arguments</param>
+/// <returns>The ERRORLEVEL to exit with</returns>
+int main(int argc, char * argv[])
+{
+    return RunHeadlessCommand(argc, argv);
+}
+#endif
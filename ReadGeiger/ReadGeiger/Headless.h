@@ -0,0 +1,13 @@
+// ----------------------------------------------------------------------
+// Headless.h
+//
+// When the program is given command line arguments it runs without the
+// console menu and without a serial device, performing the operation
+// that the first argument names. On systems other than Windows this is
+// the only way the program runs.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+extern int RunHeadlessCommand(int argc, char * argv[]);
@@ -0,0 +1,238 @@
+// ----------------------------------------------------------------------
+// HistoryWriter.cpp
+//
+// The writer thread and the bounded queue which feeds it. The image is
+// written to the device's partial file a block at a time, at each
+// block's own address, and each block is journaled once it is on the
+// disk. The partial file only becomes the device's local image once the
+// retrieval has finished and every block made it to the disk; if the
+// retrieval fails the partial file and its journal are left for the
+// next visit to resume from.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include "HistoryWriter.h"
+#include "DownloadJournal.h"
+#include "SyncCursor.h"
+
+using namespace std;
+
+/// <summary>
+/// The writer thread. Blocks are written in the order they were queued until the
+/// queue is empty and no more blocks are coming. After a failed write the remaining
+/// blocks are still taken off the queue so that the reader never waits forever.
+/// </summary>
+/// <param name="p_Writer">The writer being serviced</param>
+static void WriteHistoryBlocks(HistoryWriter * p_Writer)
+{
+    HistoryWriter & r_Writer = *p_Writer;
+
+    for (;;)
+    {
+        HistoryWriterBlock thisBlock;
+
+        {
+            unique_lock<mutex> queueGuard(r_Writer.queueLock);
+
+            r_Writer.queueChanged.wait(queueGuard, [&r_Writer]
+            {
+                return false == r_Writer.pendingBlocks.empty() || true == r_Writer.isFinishing;
+            });
+
+            if (r_Writer.pendingBlocks.empty())
+            {
+                return;
+            }
+
+            thisBlock = r_Writer.pendingBlocks.front();
+
+            r_Writer.pendingBlocks.pop_front();
+        }
+
+        // There is room in the queue again
+        r_Writer.queueChanged.notify_all();
+
+        const uchar * pBlock = &r_Writer.pImage[thisBlock.blockAddress];
+
+        // The block must be in the partial file before the journal says that it is
+        bool wasWritten = (0 == fseek(r_Writer.pImageFile, static_cast<long>(thisBlock.blockAddress), SEEK_SET)) &&
+            (1 == fwrite(pBlock, thisBlock.blockLength, 1, r_Writer.pImageFile)) &&
+            (0 == fflush(r_Writer.pImageFile)) &&
+            (true == WriteDownloadJournalRecord(r_Writer.pJournalFile, thisBlock.blockAddress, pBlock, thisBlock.blockLength));
+
+        lock_guard<mutex> queueGuard(r_Writer.queueLock);
+
+        if (true == wasWritten)
+        {
+            r_Writer.blocksWritten++;
+            r_Writer.octetsWritten += thisBlock.blockLength;
+        }
+        else
+        {
+            r_Writer.hasFailed = true;
+        }
+    }
+}
+
+/// <summary>
+/// Creates the device's partial file and a new journal, replacing any left from an
+/// earlier retrieval, and starts the writer thread. When resuming, the image passed
+/// by argument already holds what the earlier retrieval got and the caller queues it
+/// again as the first block.
+/// </summary>
+/// <param name="r_Writer">The writer to start</param>
+/// <param name="pch_SerialNumber">The device's serial number as hexadecimal text</param>
+/// <param name="saveAddress">The device's dataSaveAddress, recorded in the journal</param>
+/// <param name="pImage">The image which the queued blocks are taken from</param>
+/// <param name="imageSize">The number of octets in the image</param>
+/// <returns>true if the writer was started, otherwise false</returns>
+bool StartHistoryWriter(HistoryWriter & r_Writer,
+    const char * pch_SerialNumber,
+    ulong saveAddress,
+    const uchar * pImage,
+    ulong imageSize)
+{
+    r_Writer.pImage         = pImage;
+    r_Writer.imageSize      = imageSize;
+    r_Writer.pImageFile     = nullptr;
+    r_Writer.pJournalFile   = nullptr;
+    r_Writer.isFinishing    = false;
+    r_Writer.hasFailed      = false;
+    r_Writer.blocksWritten  = static_cast<ulong>(0);
+    r_Writer.octetsWritten  = static_cast<ulong>(0);
+    r_Writer.queueFullCount = static_cast<ulong>(0);
+
+    r_Writer.pendingBlocks.clear();
+
+    BuildSyncImageFileName(pch_SerialNumber, r_Writer.imageFileName, sizeof(r_Writer.imageFileName));
+    BuildSyncFileName(pch_SerialNumber, SYNC_PARTIAL_FILE_NAME, r_Writer.partialFileName, sizeof(r_Writer.partialFileName));
+    BuildSyncFileName(pch_SerialNumber, SYNC_JOURNAL_FILE_NAME, r_Writer.journalFileName, sizeof(r_Writer.journalFileName));
+
+    if (0 != fopen_s(&r_Writer.pJournalFile, r_Writer.journalFileName, "wb"))
+    {
+        r_Writer.pJournalFile = nullptr;
+
+        return false;
+    }
+
+    if (false == WriteDownloadJournalHeader(r_Writer.pJournalFile, saveAddress) ||
+        0 != fopen_s(&r_Writer.pImageFile, r_Writer.partialFileName, "wb"))
+    {
+        (void)fclose(r_Writer.pJournalFile);
+        (void)remove(r_Writer.journalFileName);
+
+        r_Writer.pJournalFile = nullptr;
+        r_Writer.pImageFile   = nullptr;
+
+        return false;
+    }
+
+    r_Writer.writerThread = thread(WriteHistoryBlocks, &r_Writer);
+
+    return true;
+}
+
+/// <summary>
+/// Hands a part of the image to the writer thread. The reader must not change those
+/// octets afterwards. If the queue is full this waits until the writer makes room.
+/// </summary>
+/// <param name="r_Writer">The started writer</param>
+/// <param name="blockAddress">Where in the image the block starts</param>
+/// <param name="blockLength">The number of octets in the block</param>
+/// <returns>true if the block was queued, false if an earlier write has already failed</returns>
+bool QueueHistoryBlock(HistoryWriter & r_Writer, ulong blockAddress, ulong blockLength)
+{
+    if (blockLength == static_cast<ulong>(0) || blockAddress >= r_Writer.imageSize)
+    {
+        return true;
+    }
+
+    if (blockLength > r_Writer.imageSize - blockAddress)
+    {
+        blockLength = r_Writer.imageSize - blockAddress;
+    }
+
+    {
+        unique_lock<mutex> queueGuard(r_Writer.queueLock);
+
+        if (r_Writer.pendingBlocks.size() >= HISTORY_WRITER_QUEUE_DEPTH)
+        {
+            r_Writer.queueFullCount++;
+
+            r_Writer.queueChanged.wait(queueGuard, [&r_Writer]
+            {
+                return r_Writer.pendingBlocks.size() < HISTORY_WRITER_QUEUE_DEPTH;
+            });
+        }
+
+        if (true == r_Writer.hasFailed)
+        {
+            return false;
+        }
+
+        HistoryWriterBlock thisBlock = { blockAddress, blockLength };
+
+        r_Writer.pendingBlocks.push_back(thisBlock);
+    }
+
+    r_Writer.queueChanged.notify_all();
+
+    return true;
+}
+
+/// <summary>
+/// Waits for every queued block to be written and stops the writer thread. If asked
+/// to and if every write succeeded, the partial file is then put in place of the
+/// local image and the journal is thrown away. A retrieval which did not finish
+/// leaves both for the next visit, while a failed write throws both away; either way
+/// whatever local image was there before is left alone.
+/// </summary>
+/// <param name="r_Writer">The started writer</param>
+/// <param name="shouldCommit">true to put the file in place, false to leave it to be resumed</param>
+/// <returns>true if the file was put in place, otherwise false</returns>
+bool FinishHistoryWriter(HistoryWriter & r_Writer, bool shouldCommit)
+{
+    {
+        lock_guard<mutex> queueGuard(r_Writer.queueLock);
+
+        r_Writer.isFinishing = true;
+    }
+
+    r_Writer.queueChanged.notify_all();
+
+    if (r_Writer.writerThread.joinable())
+    {
+        r_Writer.writerThread.join();
+    }
+
+    if (nullptr == r_Writer.pImageFile)
+    {
+        return false;
+    }
+
+    bool wasWritten = (0 == fclose(r_Writer.pImageFile)) && false == r_Writer.hasFailed;
+
+    wasWritten = (0 == fclose(r_Writer.pJournalFile)) && wasWritten;
+
+    r_Writer.pImageFile   = nullptr;
+    r_Writer.pJournalFile = nullptr;
+
+    if (false == wasWritten)
+    {
+        (void)remove(r_Writer.journalFileName);
+        (void)remove(r_Writer.partialFileName);
+
+        return false;
+    }
+
+    if (false == shouldCommit || false == CommitFileAtomically(r_Writer.partialFileName, r_Writer.imageFileName))
+    {
+        return false;
+    }
+
+    (void)remove(r_Writer.journalFileName);
+
+    return true;
+}
@@ -0,0 +1,63 @@
+// ----------------------------------------------------------------------
+// HistoryWriter.h
+//
+// Persists the blocks of a history retrieval from a thread of its own
+// so that the next block can be read from the device while the last
+// one is being written. The blocks are handed over through a short
+// bounded queue; when the disk falls behind the reader simply waits
+// for room rather than the queue growing without limit.
+//
+// Every block written is also recorded in the device's download journal
+// so that an interrupted retrieval can be resumed, see DownloadJournal.h.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "Portable.h"
+
+// How many retrieved blocks may be waiting to be written at the same time
+#define HISTORY_WRITER_QUEUE_DEPTH      static_cast<size_t>(4)
+
+/// <summary>
+/// A part of the image which is ready to be written. The octets are not copied, they
+/// are taken from the image itself which the reader no longer changes at that address.
+/// </summary>
+typedef struct history_writer_block_t
+{
+    ulong blockAddress;                     // Where in the image the block starts
+    ulong blockLength;                      // The number of octets in the block
+} HistoryWriterBlock;
+
+typedef struct history_writer_t
+{
+    const uchar *                  pImage;                  // The image the blocks are taken from
+    ulong                          imageSize;               // The number of octets in the image
+    FILE *                         pImageFile;              // The partial file being written
+    FILE *                         pJournalFile;            // The journal of the blocks in the partial file
+    char                           imageFileName[301];      // The file that is put in place at the end
+    char                           partialFileName[301];    // The file written until then
+    char                           journalFileName[301];    // The journal file
+    std::mutex                     queueLock;               // Protects everything below
+    std::condition_variable        queueChanged;            // Signalled whenever a block is added or removed
+    std::deque<HistoryWriterBlock> pendingBlocks;           // Blocks not yet written
+    bool                           isFinishing;             // Set once the last block has been queued
+    bool                           hasFailed;               // Set if any write failed
+    ulong                          blocksWritten;           // The number of blocks written
+    ulong                          octetsWritten;           // The number of octets written
+    ulong                          queueFullCount;          // How often the reader had to wait for room
+    std::thread                    writerThread;            // Writes the blocks
+} HistoryWriter;
+
+extern bool StartHistoryWriter(HistoryWriter & r_Writer,
+    const char * pch_SerialNumber,
+    ulong saveAddress,
+    const uchar * pImage,
+    ulong imageSize);
+extern bool QueueHistoryBlock(HistoryWriter & r_Writer, ulong blockAddress, ulong blockLength);
+extern bool FinishHistoryWriter(HistoryWriter & r_Writer, bool shouldCommit);
@@ -0,0 +1,634 @@
+// ----------------------------------------------------------------------
+// LiveHeartbeat.cpp
+//
+// The reader thread reads at most the rest of one heartbeat word at a
+// time, so ReceiveSerialData() returns the moment the word is whole and
+// the heartbeat is in every ring within a millisecond or so of its last
+// octet arriving. A word is only started on an octet whose two most
+// significant bits are clear, and half of a word which waits too long
+// for its other half is thrown away, so the reader falls back in to
+// step after a lost octet.
+//
+// While watching, the anomaly detector and the log file each take their
+// heartbeats from their own thread, and the display takes its own from
+// the thread which started watching.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include "LiveHeartbeat.h"
+#include "AnomalyDetector.h"
+#include "PoissonTable.h"
+#include "QueryEngine.h"
+
+#ifdef _WIN32
+#include <conio.h>
+#else
+#include <poll.h>
+#endif
+
+using namespace std;
+
+// The rings of the consumers while watching
+#define LIVE_DETECTOR_RING          static_cast<ulong>(0)
+#define LIVE_DISPLAY_RING           static_cast<ulong>(1)
+#define LIVE_LOG_RING               static_cast<ulong>(2)
+
+// How long a consumer sleeps when its ring is empty
+#define LIVE_CONSUMER_MILLISECONDS  10
+
+typedef struct live_watch_t
+{
+    LiveHeartbeat *    pLive;               // The heartbeat being watched
+    std::atomic<bool>  stopRequested;       // Set to make the consumer threads return
+    AnomalyDetector    theDetector;         // Looks for high periods in the heartbeats
+    long long          arrivalMilliseconds; // When the heartbeat being fed to the detector arrived
+    double             slowestMilliseconds; // The longest from a heartbeat arriving to the detector having judged it
+    ulong              alertCount;          // Alerts raised while watching
+    FILE *             pLogFile;            // Where every heartbeat is logged, or nullptr
+    unsigned long long loggedCount;         // Heartbeats written to the log
+} LiveWatch;
+
+/// <summary>
+/// Empties a ring. This may only be done while neither the reader nor the consumer is
+/// using it.
+/// </summary>
+/// <param name="r_Ring">The ring to empty</param>
+void ResetHeartbeatRing(HeartbeatRing & r_Ring)
+{
+    r_Ring.writeIndex   = 0;
+    r_Ring.readIndex    = 0;
+    r_Ring.droppedCount = 0;
+}
+
+/// <summary>
+/// Adds a heartbeat to a ring. Only the reader thread may call this. It never waits:
+/// when the consumer has not made room, the heartbeat is counted as dropped instead.
+/// </summary>
+/// <param name="r_Ring">The ring</param>
+/// <param name="r_Sample">The heartbeat</param>
+/// <returns>true if it was added, false if the ring was full</returns>
+bool PushHeartbeatSample(HeartbeatRing & r_Ring, const HeartbeatSample & r_Sample)
+{
+    unsigned long long writeIndex = r_Ring.writeIndex.load(memory_order_relaxed);
+
+    if (writeIndex - r_Ring.readIndex.load(memory_order_acquire) >= HEARTBEAT_RING_CAPACITY)
+    {
+        r_Ring.droppedCount.fetch_add(1, memory_order_relaxed);
+
+        return false;
+    }
+
+    r_Ring.theSamples[writeIndex & (HEARTBEAT_RING_CAPACITY - 1)] = r_Sample;
+
+    // The heartbeat must be in place before the consumer can see the new index
+    r_Ring.writeIndex.store(writeIndex + 1, memory_order_release);
+
+    return true;
+}
+
+/// <summary>
+/// Takes the oldest heartbeat from a ring. Only the ring's consumer may call this.
+/// </summary>
+/// <param name="r_Ring">The ring</param>
+/// <param name="r_Sample">Returns the heartbeat</param>
+/// <returns>true if there was one, false if the ring was empty</returns>
+bool PopHeartbeatSample(HeartbeatRing & r_Ring, HeartbeatSample & r_Sample)
+{
+    unsigned long long readIndex = r_Ring.readIndex.load(memory_order_relaxed);
+
+    if (readIndex == r_Ring.writeIndex.load(memory_order_acquire))
+    {
+        return false;
+    }
+
+    r_Sample = r_Ring.theSamples[readIndex & (HEARTBEAT_RING_CAPACITY - 1)];
+
+    // The heartbeat must be copied out before the reader may write over it
+    r_Ring.readIndex.store(readIndex + 1, memory_order_release);
+
+    return true;
+}
+
+/// <summary>
+/// The steady clock in milliseconds
+/// </summary>
+static long long GetSteadyMilliseconds(void)
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// <summary>
+/// The reader thread: takes heartbeat words off the serial port and adds each one to
+/// every consumer's ring, until it is asked to stop
+/// </summary>
+static void ReadHeartbeats(LiveHeartbeat * pLive)
+{
+    LiveHeartbeat &    r_Live         = *pLive;
+    SerialConnection & r_Connection   = r_Live.pSession->theConnection;
+    uchar              theWord[2]     = { 0 };
+    ulong              wordLength     = static_cast<ulong>(0);
+    long long          wordStartTime  = 0;
+    long long          lastEpoch      = 0;
+
+    while (false == r_Live.stopRequested.load())
+    {
+        ulong     receivedLength = ReceiveSerialData(r_Connection,
+            reinterpret_cast<char *>(&theWord[wordLength]),
+            sizeof(theWord) - wordLength,
+            HEARTBEAT_READ_MILLISECONDS);
+        long long arrivalTime    = GetSteadyMilliseconds();
+
+        if (receivedLength == static_cast<ulong>(0))
+        {
+            // Half of a word whose other half never came
+            if (wordLength > static_cast<ulong>(0) && arrivalTime - wordStartTime > HEARTBEAT_WORD_GAP_MILLISECONDS)
+            {
+                r_Live.discardedOctets += wordLength;
+                wordLength = static_cast<ulong>(0);
+            }
+
+            continue;
+        }
+
+        if (wordLength == static_cast<ulong>(0))
+        {
+            wordStartTime = arrivalTime;
+        }
+
+        wordLength += receivedLength;
+        r_Live.pSession->octetsReceived += receivedLength;
+
+        // A word cannot start with a reserved bit set, so the first octet is the second
+        // half of a word which was missed
+        if (0 != (theWord[0] & HEARTBEAT_RESERVED_BITS))
+        {
+            theWord[0] = theWord[1];
+            wordLength--;
+            wordStartTime = arrivalTime;
+            r_Live.discardedOctets++;
+            continue;
+        }
+
+        if (wordLength < sizeof(theWord))
+        {
+            continue;
+        }
+
+        HeartbeatSample theSample;
+
+        // Each heartbeat is for the second after the one before, even when two arrive
+        // close together
+        theSample.epochSeconds        = GetLocalEpochSeconds();
+        theSample.arrivalMilliseconds = arrivalTime;
+        theSample.sequenceNumber      = r_Live.heartbeatCount.load();
+        theSample.countValue          = (static_cast<uint32_t>(theWord[0]) << 8) | static_cast<uint32_t>(theWord[1]);
+
+        if (theSample.sequenceNumber > 0 && theSample.epochSeconds <= lastEpoch)
+        {
+            theSample.epochSeconds = lastEpoch + 1;
+        }
+
+        lastEpoch  = theSample.epochSeconds;
+        wordLength = static_cast<ulong>(0);
+
+        for (ulong thisRing = 0; thisRing < r_Live.ringCount; thisRing++)
+        {
+            (void)PushHeartbeatSample(r_Live.theRings[thisRing], theSample);
+        }
+
+        r_Live.heartbeatCount++;
+    }
+}
+
+/// <summary>
+/// Turns the device's heartbeat on and starts the reader thread
+/// </summary>
+/// <param name="r_Live">The heartbeat to start</param>
+/// <param name="r_Session">The open session with the device</param>
+/// <param name="ringCount">The number of consumers, each of which gets a ring of its own</param>
+/// <returns>true if the reader is running, otherwise false</returns>
+bool StartLiveHeartbeat(LiveHeartbeat & r_Live, DeviceSession & r_Session, ulong ringCount)
+{
+    if (ringCount == static_cast<ulong>(0) || ringCount > HEARTBEAT_MAXIMUM_CONSUMERS)
+    {
+        return false;
+    }
+
+    r_Live.pSession        = &r_Session;
+    r_Live.ringCount       = ringCount;
+    r_Live.stopRequested   = false;
+    r_Live.heartbeatCount  = 0;
+    r_Live.discardedOctets = 0;
+
+    for (ulong thisRing = 0; thisRing < HEARTBEAT_MAXIMUM_CONSUMERS; thisRing++)
+    {
+        ResetHeartbeatRing(r_Live.theRings[thisRing]);
+    }
+
+    if (false == SetSessionHeartbeat(r_Session, true))
+    {
+        return false;
+    }
+
+    r_Live.readerThread = thread(ReadHeartbeats, &r_Live);
+
+    return true;
+}
+
+/// <summary>
+/// Stops the reader thread and turns the device's heartbeat off, leaving the line
+/// quiet for the next command
+/// </summary>
+/// <param name="r_Live">The started heartbeat</param>
+void StopLiveHeartbeat(LiveHeartbeat & r_Live)
+{
+    r_Live.stopRequested = true;
+
+    if (true == r_Live.readerThread.joinable())
+    {
+        r_Live.readerThread.join();
+    }
+
+    (void)SetSessionHeartbeat(*r_Live.pSession, false);
+}
+
+/// <summary>
+/// Tells of each alert the moment it is raised and again when it ends, along with how
+/// long after the heartbeat which raised it arrived
+/// </summary>
+static void ReportLiveAlert(void * pContext, const AnomalyAlert & r_Alert)
+{
+    LiveWatch & r_Watch      = *static_cast<LiveWatch *>(pContext);
+    char        theTime[31]  = { 0 };
+    long long   theLatency   = GetSteadyMilliseconds() - r_Watch.arrivalMilliseconds;
+
+    if (true == r_Alert.isOpen)
+    {
+        r_Watch.alertCount++;
+
+        FormatQueryTime(r_Alert.endEpoch, theTime, sizeof(theTime));
+
+        (void)printf("%s  ALERT %lu second window: %lu counts where %.1f expected, p-value %.2e%s (%lld ms)\n",
+            theTime,
+            r_Alert.windowSeconds,
+            r_Alert.peakSum,
+            r_Alert.expectedSum,
+            GetPoissonPValue(r_Alert.peakSignificance),
+            (true == r_Alert.isSuperHigh) ? ", SUPER HIGH" : "",
+            theLatency);
+    }
+    else
+    {
+        FormatQueryTime(r_Alert.endEpoch, theTime, sizeof(theTime));
+
+        (void)printf("%s  ended %lu second window alert, peak %lu counts, p-value %.2e\n",
+            theTime,
+            r_Alert.windowSeconds,
+            r_Alert.peakSum,
+            GetPoissonPValue(r_Alert.peakSignificance));
+    }
+}
+
+/// <summary>
+/// The detector's consumer thread: feeds every heartbeat to the anomaly detector
+/// </summary>
+static void DetectLiveAnomalies(LiveWatch * pWatch)
+{
+    LiveWatch &     r_Watch = *pWatch;
+    HeartbeatRing & r_Ring  = r_Watch.pLive->theRings[LIVE_DETECTOR_RING];
+    HeartbeatSample theSample;
+
+    while (false == r_Watch.stopRequested.load())
+    {
+        if (false == PopHeartbeatSample(r_Ring, theSample))
+        {
+            this_thread::sleep_for(chrono::milliseconds(LIVE_CONSUMER_MILLISECONDS));
+            continue;
+        }
+
+        r_Watch.arrivalMilliseconds = theSample.arrivalMilliseconds;
+
+        (void)FeedAnomalyDetector(r_Watch.theDetector, theSample.epochSeconds, theSample.countValue);
+
+        double theLatency = static_cast<double>(GetSteadyMilliseconds() - theSample.arrivalMilliseconds);
+
+        if (theLatency > r_Watch.slowestMilliseconds)
+        {
+            r_Watch.slowestMilliseconds = theLatency;
+        }
+    }
+
+    FinishAnomalyDetector(r_Watch.theDetector);
+}
+
+/// <summary>
+/// The log's consumer thread: writes every heartbeat to the log file, flushing it
+/// whenever it has caught up
+/// </summary>
+static void LogLiveHeartbeats(LiveWatch * pWatch)
+{
+    LiveWatch &     r_Watch = *pWatch;
+    HeartbeatRing & r_Ring  = r_Watch.pLive->theRings[LIVE_LOG_RING];
+    HeartbeatSample theSample;
+    char            theTime[31];
+
+    (void)fputs("Date/Time,Counts\n", r_Watch.pLogFile);
+
+    while (false == r_Watch.stopRequested.load() || r_Ring.readIndex.load() != r_Ring.writeIndex.load())
+    {
+        if (false == PopHeartbeatSample(r_Ring, theSample))
+        {
+            (void)fflush(r_Watch.pLogFile);
+
+            this_thread::sleep_for(chrono::milliseconds(LIVE_CONSUMER_MILLISECONDS));
+            continue;
+        }
+
+        FormatQueryTime(theSample.epochSeconds, theTime, sizeof(theTime));
+
+        (void)fprintf(r_Watch.pLogFile, "%s,%lu\n", theTime, static_cast<ulong>(theSample.countValue));
+
+        r_Watch.loggedCount++;
+    }
+}
+
+/// <summary>
+/// Returns true once the operator has pressed a key, or Enter away from Windows,
+/// taking the key so that it is not seen again
+/// </summary>
+static bool HasOperatorPressedKey(void)
+{
+#ifdef _WIN32
+    if (0 == _kbhit())
+    {
+        return false;
+    }
+
+    (void)_getch();
+#else
+    struct pollfd pollDescriptor = { 0, POLLIN, 0 };
+    char          theLine[101];
+
+    if (poll(&pollDescriptor, 1, 0) <= 0)
+    {
+        return false;
+    }
+
+    (void)fgets(theLine, sizeof(theLine), stdin);
+#endif
+
+    return true;
+}
+
+/// <summary>
+/// Watches the device's counts as they happen: each second's clicks are displayed with
+/// the total of the last minute, the anomaly detector judges each one as it arrives and
+/// tells of its alerts at once, and every heartbeat may be logged to a comma-delimited
+/// file. Each of those has a ring of its own so none of them holds up the reader.
+/// </summary>
+/// <param name="r_Session">The open session with the device</param>
+/// <param name="pch_LogFileName">The comma-delimited file to log to, or nullptr for none</param>
+/// <param name="alertSigma">How rare a window must be to raise an alert, see AnomalyDetector.h</param>
+/// <param name="runSeconds">How long to watch for, or 0 until a key is pressed</param>
+/// <returns>true if the heartbeat was watched, false if it could not be started or the log created</returns>
+bool WatchLiveHeartbeat(DeviceSession & r_Session, const char * pch_LogFileName, double alertSigma, ulong runSeconds)
+{
+    unique_ptr<LiveHeartbeat> pLive(new LiveHeartbeat());
+    unique_ptr<LiveWatch>     pWatch(new LiveWatch());
+    LiveWatch &               r_Watch         = *pWatch;
+    HeartbeatSample           theSample;
+    uint32_t                  lastMinute[60]  = { 0 };
+    unsigned long long        minuteTotal     = 0;
+    unsigned long long        displayedCount  = 0;
+    thread                    detectorThread;
+    thread                    logThread;
+
+    r_Watch.pLive               = pLive.get();
+    r_Watch.stopRequested       = false;
+    r_Watch.arrivalMilliseconds = 0;
+    r_Watch.slowestMilliseconds = 0.0;
+    r_Watch.alertCount          = static_cast<ulong>(0);
+    r_Watch.pLogFile            = nullptr;
+    r_Watch.loggedCount         = 0;
+
+    const ulong windowSeconds[ANOMALY_WINDOW_COUNT] = LIVE_WINDOW_SECONDS;
+
+    StartAnomalyDetector(r_Watch.theDetector, ReportLiveAlert, &r_Watch);
+
+    r_Watch.theDetector.alertSigma = alertSigma;
+
+    for (size_t thisWindow = 0; thisWindow < ANOMALY_WINDOW_COUNT; thisWindow++)
+    {
+        r_Watch.theDetector.theWindows[thisWindow].windowSeconds = windowSeconds[thisWindow];
+    }
+
+    // Build the p-value tables now rather than when the first heartbeat is judged
+    (void)GetPoissonTable();
+
+    if (nullptr != pch_LogFileName && 0 != fopen_s(&r_Watch.pLogFile, pch_LogFileName, "w"))
+    {
+        (void)printf("Error: I was unable to create file: %s\n", pch_LogFileName);
+        return false;
+    }
+
+    if (false == StartLiveHeartbeat(*pLive, r_Session, (nullptr == r_Watch.pLogFile) ? LIVE_LOG_RING : LIVE_LOG_RING + 1))
+    {
+        (void)printf("Error: The device did not take the heartbeat command\n");
+
+        if (nullptr != r_Watch.pLogFile)
+        {
+            (void)fclose(r_Watch.pLogFile);
+        }
+
+        return false;
+    }
+
+    detectorThread = thread(DetectLiveAnomalies, &r_Watch);
+
+    if (nullptr != r_Watch.pLogFile)
+    {
+        logThread = thread(LogLiveHeartbeats, &r_Watch);
+    }
+
+    (void)printf("Watching the heartbeat of %s, %s\n",
+        r_Session.theConnection.portName,
+        (runSeconds == static_cast<ulong>(0)) ? "press a key to stop" : "for a while");
+    (void)printf("Date/Time                CPS     CPM\n");
+
+    chrono::steady_clock::time_point stopTime = chrono::steady_clock::now() + chrono::seconds(runSeconds);
+
+    // The display is this thread's consumer
+    while (true)
+    {
+        if (runSeconds > static_cast<ulong>(0) ? chrono::steady_clock::now() >= stopTime : true == HasOperatorPressedKey())
+        {
+            break;
+        }
+
+        if (false == PopHeartbeatSample(pLive->theRings[LIVE_DISPLAY_RING], theSample))
+        {
+            this_thread::sleep_for(chrono::milliseconds(LIVE_CONSUMER_MILLISECONDS));
+            continue;
+        }
+
+        char theTime[31] = { 0 };
+
+        // The counts per minute are the total of the last 60 heartbeats
+        minuteTotal -= lastMinute[displayedCount % 60];
+        minuteTotal += theSample.countValue;
+        lastMinute[displayedCount % 60] = theSample.countValue;
+        displayedCount++;
+
+        FormatQueryTime(theSample.epochSeconds, theTime, sizeof(theTime));
+
+        (void)printf("%s  %5lu  %6llu%s\n",
+            theTime,
+            static_cast<ulong>(theSample.countValue),
+            minuteTotal,
+            (displayedCount < 60) ? " so far" : "");
+    }
+
+    StopLiveHeartbeat(*pLive);
+
+    r_Watch.stopRequested = true;
+
+    detectorThread.join();
+
+    if (true == logThread.joinable())
+    {
+        logThread.join();
+
+        if (0 != fclose(r_Watch.pLogFile))
+        {
+            (void)printf("Error: I was unable to write file: %s\n", pch_LogFileName);
+        }
+    }
+
+    (void)printf("\n%llu heartbeats, %llu octets discarded, %lu alerts, slowest judgement %.0f ms after arrival\n",
+        pLive->heartbeatCount.load(),
+        pLive->discardedOctets.load(),
+        r_Watch.alertCount,
+        r_Watch.slowestMilliseconds);
+    (void)printf("Heartbeats missed because a consumer fell behind: detector %llu, display %llu, log %llu\n",
+        pLive->theRings[LIVE_DETECTOR_RING].droppedCount.load(),
+        pLive->theRings[LIVE_DISPLAY_RING].droppedCount.load(),
+        pLive->theRings[LIVE_LOG_RING].droppedCount.load());
+
+    if (nullptr != pch_LogFileName)
+    {
+        (void)printf("%llu heartbeats logged to %s\n", r_Watch.loggedCount, pch_LogFileName);
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Displays how the live heartbeat is used
+/// </summary>
+static void DisplayLiveUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -live <port> [-baud <rate>] [-seconds <count>] [-sigma <deviations>] [-out <directory>] [-nolog]\n");
+    (void)printf("  Turns the device's heartbeat on and watches each second's counts as they happen.\n");
+    (void)printf("  Every heartbeat is logged to <serial>.<date and time>.%s unless -nolog is given.\n", DATA_OUTPUT_LIVE_FILE_NAME);
+    (void)printf("  With no -seconds it watches until Enter is pressed.\n");
+}
+
+/// <summary>
+/// The entry point for the live heartbeat
+/// </summary>
+/// <param name="argc">The number of arguments following "-live"</param>
+/// <param name="argv">The arguments following "-live"</param>
+/// <returns>0 if the heartbeat was watched, otherwise 1</returns>
+int RunLiveHeartbeat(int argc, char * argv[])
+{
+    unique_ptr<DeviceSession> pSession(new DeviceSession());
+    DeviceSession &           r_Session     = *pSession;
+    const char *              pch_PortName  = nullptr;
+    string                    outputDirectory;
+    string                    logFileName;
+    ulong                     baudRate      = LIVE_DEFAULT_BAUD_RATE;
+    ulong                     runSeconds    = static_cast<ulong>(0);
+    double                    alertSigma    = ANOMALY_ALERT_SIGMA;
+    bool                      wantLog       = true;
+    bool                      wasWatched    = false;
+    char                      timeStamp[31] = { 0 };
+
+    for (int thisArgument = 0; thisArgument < argc; thisArgument++)
+    {
+        if (0 == strcmp(argv[thisArgument], "-baud") && thisArgument + 1 < argc)
+        {
+            baudRate = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-seconds") && thisArgument + 1 < argc)
+        {
+            runSeconds = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-sigma") && thisArgument + 1 < argc)
+        {
+            alertSigma = strtod(argv[++thisArgument], nullptr);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-out") && thisArgument + 1 < argc)
+        {
+            outputDirectory = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-nolog"))
+        {
+            wantLog = false;
+        }
+        else
+        {
+            pch_PortName = argv[thisArgument];
+        }
+    }
+
+    if (nullptr == pch_PortName || alertSigma <= 0.0)
+    {
+        DisplayLiveUsage();
+        return 1;
+    }
+
+    if (baudRate == static_cast<ulong>(0))
+    {
+        baudRate = LIVE_DEFAULT_BAUD_RATE;
+    }
+
+    if (false == OpenDeviceSession(r_Session, pch_PortName, baudRate))
+    {
+        (void)printf("Error: I was unable to open %s\n", pch_PortName);
+        return 1;
+    }
+
+    if (false == AcquireSessionModelAndVersion(r_Session) || false == AcquireSessionSerialNumber(r_Session))
+    {
+        (void)printf("Error: There was no Geiger Counter answering on %s\n", pch_PortName);
+        CloseDeviceSession(r_Session);
+        return 1;
+    }
+
+    if (true == wantLog)
+    {
+        FormatHarvestTimeStamp(timeStamp, sizeof(timeStamp));
+
+        if (false == outputDirectory.empty() && outputDirectory.back() != PATH_SEPARATOR_CHARACTER && outputDirectory.back() != '/')
+        {
+            outputDirectory += PATH_SEPARATOR_CHARACTER;
+        }
+
+        logFileName = outputDirectory + r_Session.serialNumberText + "." + timeStamp + "." + DATA_OUTPUT_LIVE_FILE_NAME;
+    }
+
+    (void)printf("%s  serial %s\n", r_Session.modelAndVersion, r_Session.serialNumberText);
+
+    wasWatched = WatchLiveHeartbeat(r_Session, (true == wantLog) ? logFileName.c_str() : nullptr, alertSigma, runSeconds);
+
+    CloseDeviceSession(r_Session);
+
+    return (true == wasWatched) ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+// ----------------------------------------------------------------------
+// LiveHeartbeat.h
+//
+// Watches a Geiger Counter's counts as they happen rather than after
+// they have been stored to FLASH. The device's heartbeat is turned on,
+// which has it send the clicks of each second as a two octet word, and
+// a reader thread of its own does nothing but take those words off the
+// serial port and hand them on.
+//
+// Each consumer (the anomaly detector, the display, the log file) gets
+// its own single producer, single consumer ring of heartbeats, which
+// the reader adds to and the consumer takes from with nothing more than
+// an atomic index each, so neither ever waits for the other. A consumer
+// which falls so far behind that its ring is full misses heartbeats,
+// which are counted, rather than holding up the reader or the other
+// consumers.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include "Portable.h"
+#include "DeviceSession.h"
+
+// The GQ GMC devices talk at 57600 baud
+#define LIVE_DEFAULT_BAUD_RATE          static_cast<ulong>(57600)
+
+// The heartbeats each ring holds, a power of 2; over an hour of them
+#define HEARTBEAT_RING_CAPACITY         static_cast<unsigned long long>(4096)
+
+// The most consumers which may be given rings
+#define HEARTBEAT_MAXIMUM_CONSUMERS     static_cast<ulong>(4)
+
+// How long the reader waits for octets before looking to see whether it should stop,
+// and how long half of a word may wait for the other half before it is thrown away
+#define HEARTBEAT_READ_MILLISECONDS     static_cast<ulong>(100)
+#define HEARTBEAT_WORD_GAP_MILLISECONDS 500LL
+
+// The detector's sliding windows while watching, in seconds. A source carried past a
+// roadside counter is only in range for a few seconds, which the archive's windows of a
+// minute and longer would dilute
+#define LIVE_WINDOW_SECONDS             { 5, 15, 60, 5 * 60 }
+
+// The two most significant bits of a heartbeat word are always clear
+#define HEARTBEAT_RESERVED_BITS         static_cast<uchar>(0xC0)
+
+typedef struct heartbeat_sample_t
+{
+    long long          epochSeconds;            // The second the clicks are for, seconds since 1970 as local time
+    long long          arrivalMilliseconds;     // When the word arrived, on the steady clock
+    unsigned long long sequenceNumber;          // The number of the heartbeat, counting from 0
+    uint32_t           countValue;              // The clicks in that second
+} HeartbeatSample;
+
+typedef struct heartbeat_ring_t
+{
+    HeartbeatSample                 theSamples[HEARTBEAT_RING_CAPACITY];   // The heartbeats, by index modulo the capacity
+    std::atomic<unsigned long long> writeIndex;         // Heartbeats added, written only by the reader
+    char                            writePadding[64];   // Keeps the two indexes off each other's cache line
+    std::atomic<unsigned long long> readIndex;          // Heartbeats taken, written only by the consumer
+    char                            readPadding[64];    // Keeps the read index off the dropped count's cache line
+    std::atomic<unsigned long long> droppedCount;       // Heartbeats missed because the ring was full
+} HeartbeatRing;
+
+typedef struct live_heartbeat_t
+{
+    DeviceSession *                 pSession;           // The device, whose heartbeat is on while the reader runs
+    HeartbeatRing                   theRings[HEARTBEAT_MAXIMUM_CONSUMERS];  // One for each consumer
+    ulong                           ringCount;          // The number of rings in use
+    std::atomic<bool>               stopRequested;      // Set to make the reader thread return
+    std::atomic<unsigned long long> heartbeatCount;     // Heartbeats received
+    std::atomic<unsigned long long> discardedOctets;    // Octets which were not part of a whole heartbeat
+    std::thread                     readerThread;       // Takes the heartbeats off the serial port
+} LiveHeartbeat;
+
+extern void ResetHeartbeatRing(HeartbeatRing & r_Ring);
+extern bool PushHeartbeatSample(HeartbeatRing & r_Ring, const HeartbeatSample & r_Sample);
+extern bool PopHeartbeatSample(HeartbeatRing & r_Ring, HeartbeatSample & r_Sample);
+
+extern bool StartLiveHeartbeat(LiveHeartbeat & r_Live, DeviceSession & r_Session, ulong ringCount);
+extern void StopLiveHeartbeat(LiveHeartbeat & r_Live);
+
+extern bool WatchLiveHeartbeat(DeviceSession & r_Session, const char * pch_LogFileName, double alertSigma, ulong runSeconds);
+
+extern int RunLiveHeartbeat(int argc, char * argv[]);
@@ -0,0 +1,286 @@
+// ----------------------------------------------------------------------
+// PoissonTable.cpp
+//
+// Each row is worked out from the top down. With p(k) the chance of
+// exactly k and R(k) the tail from k divided by p(k),
+//
+//   R(k) = 1 + R(k + 1) * mean / (k + 1)
+//
+// which only ever adds positive numbers, so the tail keeps its precision
+// far beyond where it would underflow as a plain double. The logarithm
+// of p(k) comes from a table of the logarithms of the factorials, so
+// the only logarithms taken are for the entries which are kept.
+//
+// ----------------------------------------------------------------------
+
+#include <math.h>
+#include <vector>
+#include "PoissonTable.h"
+
+using namespace std;
+
+// Rows stop once the tail is this rare; beyond that the normal tail is close enough
+#define POISSON_TABLE_DEPTH         40.0
+
+// How many standard deviations below the mean each row starts
+#define POISSON_ROW_SIGMA_BELOW     2.0
+
+// The normal tail table, in 1/64ths of a standard deviation from -8 to +40
+#define NORMAL_STEPS_PER_SIGMA      64
+#define NORMAL_LOWEST_SIGMA         -8
+#define NORMAL_HIGHEST_SIGMA        40
+
+/// <summary>
+/// -log10 of the chance that a normal value is theSigma standard deviations above its
+/// mean or more
+/// </summary>
+static double ComputeNormalSignificance(double theSigma)
+{
+    // erfc() underflows in to denormals beyond about 37 sigma, so use its expansion there
+    if (theSigma < 30.0)
+    {
+        return -log10(0.5 * erfc(theSigma / sqrt(2.0)));
+    }
+
+    double inverseSquare = 1.0 / (theSigma * theSigma);
+    double naturalLog    = (-0.5 * theSigma * theSigma)
+        - log(theSigma * sqrt(2.0 * 3.14159265358979323846))
+        + log(1.0 - inverseSquare + (3.0 * inverseSquare * inverseSquare));
+
+    return -naturalLog / log(10.0);
+}
+
+/// <summary>
+/// Works out one row of the table and appends its entries
+/// </summary>
+static void BuildPoissonRow(PoissonTable & r_Table, const vector<double> & r_LogFactorials, ulong whichRow)
+{
+    PoissonRow theRow;
+    double     rootMean = static_cast<double>(whichRow) / static_cast<double>(POISSON_ROOT_STEPS);
+    double     theMean  = rootMean * rootMean;
+    double     logMean  = log(theMean);
+    double     lowest   = theMean - (POISSON_ROW_SIGMA_BELOW * rootMean);
+
+    theRow.firstCount = (lowest > 0.0) ? static_cast<uint32_t>(lowest) : 0;
+    theRow.countStep  = static_cast<uint32_t>(rootMean / static_cast<double>(POISSON_COUNTS_PER_SIGMA));
+    theRow.firstEntry = static_cast<uint32_t>(r_Table.tailSignificance.size());
+
+    if (theRow.countStep < 1)
+    {
+        theRow.countStep = 1;
+    }
+
+    // Far enough up that the tail is well beyond POISSON_TABLE_DEPTH at any mean
+    uint32_t       topCount  = static_cast<uint32_t>(theMean + (16.0 * rootMean) + 48.0);
+    vector<double> tailRatios(topCount - theRow.firstCount + 1);
+    double         tailRatio = 1.0;
+
+    for (uint32_t thisCount = topCount; thisCount > theRow.firstCount; thisCount--)
+    {
+        tailRatios[thisCount - theRow.firstCount] = tailRatio;
+
+        tailRatio = 1.0 + (tailRatio * theMean / static_cast<double>(thisCount));
+    }
+
+    tailRatios[0] = tailRatio;
+
+    for (uint32_t thisCount = theRow.firstCount; thisCount <= topCount; thisCount += theRow.countStep)
+    {
+        double logChance    = -theMean + (static_cast<double>(thisCount) * logMean) - r_LogFactorials[thisCount];
+        double significance = -(logChance + log(tailRatios[thisCount - theRow.firstCount])) / log(10.0);
+
+        // The tail from the lowest counts is 1 less a little
+        if (significance < 0.0)
+        {
+            significance = 0.0;
+        }
+
+        r_Table.tailSignificance.push_back(static_cast<float>(significance));
+
+        if (significance >= POISSON_TABLE_DEPTH)
+        {
+            break;
+        }
+    }
+
+    theRow.entryCount = static_cast<uint32_t>(r_Table.tailSignificance.size()) - theRow.firstEntry;
+
+    r_Table.theRows.push_back(theRow);
+}
+
+/// <summary>
+/// Works out the whole table
+/// </summary>
+static void BuildPoissonTable(PoissonTable & r_Table)
+{
+    ulong          rowCount = static_cast<ulong>(sqrt(POISSON_LARGEST_MEAN) * POISSON_ROOT_STEPS) + 1;
+    double         topMean  = POISSON_LARGEST_MEAN + (16.0 * sqrt(POISSON_LARGEST_MEAN)) + 48.0;
+    vector<double> logFactorials(static_cast<size_t>(topMean) + 2);
+
+    logFactorials[0] = 0.0;
+
+    for (size_t thisCount = 1; thisCount < logFactorials.size(); thisCount++)
+    {
+        logFactorials[thisCount] = logFactorials[thisCount - 1] + log(static_cast<double>(thisCount));
+    }
+
+    // A mean of 0 can only ever count 0
+    PoissonRow zeroRow = { 0, 1, 0, 2 };
+
+    r_Table.theRows.push_back(zeroRow);
+    r_Table.tailSignificance.push_back(0.0f);
+    r_Table.tailSignificance.push_back(static_cast<float>(POISSON_MOST_SIGNIFICANT));
+
+    for (ulong whichRow = 1; whichRow < rowCount; whichRow++)
+    {
+        BuildPoissonRow(r_Table, logFactorials, whichRow);
+    }
+
+    for (long thisStep = NORMAL_LOWEST_SIGMA * NORMAL_STEPS_PER_SIGMA; thisStep <= NORMAL_HIGHEST_SIGMA * NORMAL_STEPS_PER_SIGMA; thisStep++)
+    {
+        double significance = ComputeNormalSignificance(static_cast<double>(thisStep) / static_cast<double>(NORMAL_STEPS_PER_SIGMA));
+
+        r_Table.normalSignificance.push_back(static_cast<float>(significance));
+    }
+}
+
+/// <summary>
+/// Gets the tables, building them the first time
+/// </summary>
+/// <returns>The tables</returns>
+const PoissonTable & GetPoissonTable(void)
+{
+    static PoissonTable theTable;
+    static bool         isBuilt = (BuildPoissonTable(theTable), true);
+
+    (void)isBuilt;
+
+    return theTable;
+}
+
+/// <summary>
+/// Looks up the normal tail, interpolating between its entries
+/// </summary>
+static double LookUpNormalSignificance(const PoissonTable & r_Table, double theSigma)
+{
+    double thePosition = (theSigma - static_cast<double>(NORMAL_LOWEST_SIGMA)) * static_cast<double>(NORMAL_STEPS_PER_SIGMA);
+
+    if (thePosition <= 0.0)
+    {
+        return 0.0;
+    }
+
+    size_t theEntry = static_cast<size_t>(thePosition);
+
+    if (theEntry + 1 >= r_Table.normalSignificance.size())
+    {
+        return POISSON_MOST_SIGNIFICANT;
+    }
+
+    double theFraction = thePosition - static_cast<double>(theEntry);
+
+    return r_Table.normalSignificance[theEntry]
+        + (theFraction * (r_Table.normalSignificance[theEntry + 1] - r_Table.normalSignificance[theEntry]));
+}
+
+/// <summary>
+/// The significance of a count from the square root of a Poisson count being close to
+/// normal, with a standard deviation of one half
+/// </summary>
+static double ApproximatePoissonSignificance(const PoissonTable & r_Table, uint64_t theCount, double theMean)
+{
+    double theSigma = 2.0 * (sqrt(static_cast<double>(theCount)) - sqrt(theMean));
+
+    return LookUpNormalSignificance(r_Table, theSigma);
+}
+
+/// <summary>
+/// Looks up a count in one row, interpolating between its entries
+/// </summary>
+static double LookUpPoissonRow(const PoissonTable & r_Table, size_t whichRow, uint64_t theCount, double theMean)
+{
+    const PoissonRow & r_Row = r_Table.theRows[whichRow];
+
+    // Counts below the start of the row are at least as likely as not
+    if (theCount < r_Row.firstCount)
+    {
+        return 0.0;
+    }
+
+    uint64_t countOffset = theCount - r_Row.firstCount;
+    uint64_t theEntry    = countOffset / r_Row.countStep;
+
+    if (theEntry + 1 >= r_Row.entryCount)
+    {
+        double lastSignificance = r_Table.tailSignificance[r_Row.firstEntry + r_Row.entryCount - 1];
+        double approximation    = ApproximatePoissonSignificance(r_Table, theCount, theMean);
+
+        return (approximation > lastSignificance) ? approximation : lastSignificance;
+    }
+
+    const float * pEntries    = &r_Table.tailSignificance[r_Row.firstEntry + static_cast<size_t>(theEntry)];
+    double        theFraction = static_cast<double>(countOffset - (theEntry * r_Row.countStep)) / static_cast<double>(r_Row.countStep);
+
+    return pEntries[0] + (theFraction * (pEntries[1] - pEntries[0]));
+}
+
+/// <summary>
+/// Gets the significance of a Poisson count: -log10 of the chance that a count with
+/// the given mean comes out at theCount or higher
+/// </summary>
+/// <param name="theCount">The count, such as a minute's clicks or a window's sum</param>
+/// <param name="theMean">What the count is expected to be</param>
+/// <returns>The significance, 0 for counts which are not above the mean, up to
+/// POISSON_MOST_SIGNIFICANT</returns>
+double GetPoissonSignificance(uint64_t theCount, double theMean)
+{
+    const PoissonTable & r_Table = GetPoissonTable();
+
+    if (theMean <= 0.0)
+    {
+        return (theCount == 0) ? 0.0 : POISSON_MOST_SIGNIFICANT;
+    }
+
+    double rowPosition = sqrt(theMean) * static_cast<double>(POISSON_ROOT_STEPS);
+
+    // Means too small for the first row are taken to be its mean, which understates how
+    // rare a count above 0 is; they only come from a baseline of all but nothing
+    if (rowPosition < 1.0)
+    {
+        rowPosition = 1.0;
+    }
+
+    if (rowPosition + 1.0 >= static_cast<double>(r_Table.theRows.size()))
+    {
+        return ApproximatePoissonSignificance(r_Table, theCount, theMean);
+    }
+
+    size_t whichRow    = static_cast<size_t>(rowPosition);
+    double theFraction = rowPosition - static_cast<double>(whichRow);
+    double belowRow    = LookUpPoissonRow(r_Table, whichRow, theCount, theMean);
+    double aboveRow    = LookUpPoissonRow(r_Table, whichRow + 1, theCount, theMean);
+
+    return belowRow + (theFraction * (aboveRow - belowRow));
+}
+
+/// <summary>
+/// Gets the significance of a value which is theSigma standard deviations above the
+/// mean of a normal distribution, so that a threshold given in standard deviations can
+/// be compared with GetPoissonSignificance()
+/// </summary>
+/// <param name="theSigma">How many standard deviations above the mean</param>
+/// <returns>The significance</returns>
+double GetSigmaSignificance(double theSigma)
+{
+    return LookUpNormalSignificance(GetPoissonTable(), theSigma);
+}
+
+/// <summary>
+/// Turns a significance back in to a p-value, for display
+/// </summary>
+/// <param name="theSignificance">From GetPoissonSignificance()</param>
+/// <returns>The p-value</returns>
+double GetPoissonPValue(double theSignificance)
+{
+    return pow(10.0, -theSignificance);
+}
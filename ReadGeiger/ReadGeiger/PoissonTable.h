@@ -0,0 +1,67 @@
+// ----------------------------------------------------------------------
+// PoissonTable.h
+//
+// The chance that a Poisson count with a given mean comes out at a
+// given value or higher, looked up rather than worked out. A minute's
+// clicks, or the sum over a window of minutes, is a Poisson count whose
+// mean is what the baseline predicts, so this chance (the p-value) says
+// how remarkable the count is: at 20 CPM a single minute of 30 has a
+// p-value of about 1 in 46, while a 10 minute sum of 260 has a p-value
+// of about 1 in 36,000.
+//
+// The tables are built once, the first time they are used. There is a
+// row for each mean whose square root is a multiple of 1/8 up to a mean
+// of 65535, which places neighbouring rows a quarter of a standard
+// deviation apart whatever the mean, and each row holds the tail for
+// the counts from two standard deviations below the mean to where the
+// chance is too small to matter. Rows for large means hold every n-th
+// count. A lookup interpolates between the two rows either side of the
+// mean and the two counts either side of the count, so it costs one
+// square root and four reads of the table.
+//
+// Means and counts beyond the rows use the square root of the count,
+// which is close to normal, and a table of the normal distribution's
+// tail.
+//
+// Everything is given as the significance, -log10 of the p-value, so
+// that 6 means a p-value of 1 in a million and larger is rarer.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "Portable.h"
+
+// Rows per unit of the square root of the mean, and the largest mean with a row
+#define POISSON_ROOT_STEPS          8
+#define POISSON_LARGEST_MEAN        65535.0
+
+// Rows for means with more than this many counts per standard deviation hold every
+// n-th count, keeping this many per standard deviation
+#define POISSON_COUNTS_PER_SIGMA    8
+
+// The significance given to anything rarer than the tables reach
+#define POISSON_MOST_SIGNIFICANT    300.0
+
+typedef struct poisson_row_t
+{
+    uint32_t firstCount;            // The count of the row's first entry
+    uint32_t countStep;             // The counts between entries
+    uint32_t firstEntry;            // Where the row's entries start in tailSignificance
+    uint32_t entryCount;            // The number of entries in the row
+} PoissonRow;
+
+typedef struct poisson_table_t
+{
+    std::vector<PoissonRow> theRows;            // Row n is for a mean of (n / POISSON_ROOT_STEPS) squared
+    std::vector<float>      tailSignificance;   // -log10 of the chance of each count or higher
+    std::vector<float>      normalSignificance; // -log10 of the normal tail at each 1/64 of a standard deviation
+} PoissonTable;
+
+extern const PoissonTable & GetPoissonTable(void);
+
+extern double GetPoissonSignificance(uint64_t theCount, double theMean);
+extern double GetSigmaSignificance(double theSigma);
+extern double GetPoissonPValue(double theSignificance);
@@ -0,0 +1,596 @@
+// ----------------------------------------------------------------------
+// PollScheduler.cpp
+//
+// The queue is a binary heap kept with std::push_heap() and
+// std::pop_heap(), so taking the soonest device and putting it back
+// cost a logarithm of the number of devices. Workers with nothing due
+// sleep on the condition variable until the soonest device is due or
+// the queue changes.
+//
+// A device which does not answer has its connection closed and opened
+// again at its next time, so a counter which is unplugged and plugged
+// back in carries on without the gateway being restarted.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include "PollScheduler.h"
+#include "FleetHarvest.h"
+#include "QueryEngine.h"
+
+using namespace std;
+
+// A poll which starts more than this long after it was due is counted as late
+#define POLL_LATE_MILLISECONDS      1000LL
+
+/// <summary>
+/// The steady clock in milliseconds
+/// </summary>
+static long long GetSteadyMilliseconds(void)
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// <summary>
+/// Orders the queue so that the device due soonest is at the front of the heap
+/// </summary>
+static bool IsPollEntryLater(const PollEntry & r_First, const PollEntry & r_Second)
+{
+    return r_First.dueMilliseconds > r_Second.dueMilliseconds;
+}
+
+/// <summary>
+/// A random number from 0 up to but not including the limit. The queue lock must be held.
+/// </summary>
+static long long DrawPollRandom(PollScheduler & r_Scheduler, long long theLimit)
+{
+    // xorshift64*
+    r_Scheduler.randomState ^= r_Scheduler.randomState >> 12;
+    r_Scheduler.randomState ^= r_Scheduler.randomState << 25;
+    r_Scheduler.randomState ^= r_Scheduler.randomState >> 27;
+
+    uint64_t theValue = r_Scheduler.randomState * 0x2545F4914F6CDD1DULL;
+
+    return (theLimit <= 0) ? 0 : static_cast<long long>(theValue % static_cast<uint64_t>(theLimit));
+}
+
+/// <summary>
+/// Puts a device on the queue for the time passed by argument, moved by the jitter.
+/// The queue lock must be held.
+/// </summary>
+static void QueuePollDevice(PollScheduler & r_Scheduler, size_t whichDevice, long long dueMilliseconds)
+{
+    const PollDevice & r_Device   = r_Scheduler.theDevices[whichDevice];
+    long long          jitterSpan = static_cast<long long>(r_Device.intervalMilliseconds) * static_cast<long long>(r_Scheduler.jitterPercent) / 100;
+    PollEntry          theEntry;
+
+    theEntry.dueMilliseconds = dueMilliseconds + DrawPollRandom(r_Scheduler, (2 * jitterSpan) + 1) - jitterSpan;
+    theEntry.whichDevice     = whichDevice;
+
+    r_Scheduler.dueQueue.push_back(theEntry);
+
+    push_heap(r_Scheduler.dueQueue.begin(), r_Scheduler.dueQueue.end(), IsPollEntryLater);
+}
+
+/// <summary>
+/// Empties a scheduler
+/// </summary>
+/// <param name="r_Scheduler">The scheduler to empty</param>
+void InitializePollScheduler(PollScheduler & r_Scheduler)
+{
+    r_Scheduler.theDevices.clear();
+    r_Scheduler.dueQueue.clear();
+    r_Scheduler.workerThreads.clear();
+
+    r_Scheduler.stopRequested   = false;
+    r_Scheduler.randomState     = static_cast<uint64_t>(GetSteadyMilliseconds()) * 0x9E3779B97F4A7C15ULL + 1;
+    r_Scheduler.jitterPercent   = POLL_DEFAULT_JITTER_PERCENT;
+    r_Scheduler.baudRate        = POLL_DEFAULT_BAUD_RATE;
+    r_Scheduler.displayReadings = true;
+
+    r_Scheduler.outputDirectory.clear();
+}
+
+/// <summary>
+/// Adds a device to be polled. Devices may only be added before the scheduler is started.
+/// </summary>
+/// <param name="r_Scheduler">The scheduler</param>
+/// <param name="pch_PortName">The serial port the device is on</param>
+/// <param name="intervalSeconds">How often it is polled</param>
+void AddPollDevice(PollScheduler & r_Scheduler, const char * pch_PortName, ulong intervalSeconds)
+{
+    PollDevice theDevice;
+
+    theDevice.portName              = pch_PortName;
+    theDevice.intervalMilliseconds  = ((intervalSeconds == static_cast<ulong>(0)) ? POLL_DEFAULT_INTERVAL_SECONDS : intervalSeconds) * static_cast<ulong>(1000);
+    theDevice.pSession              = unique_ptr<DeviceSession>(new DeviceSession());
+    theDevice.isOpen                = false;
+    theDevice.pSeriesFile           = nullptr;
+    theDevice.pollCount             = static_cast<ulong>(0);
+    theDevice.failureCount          = static_cast<ulong>(0);
+    theDevice.lateCount             = static_cast<ulong>(0);
+    theDevice.latestMilliseconds    = 0;
+    theDevice.totalPollMilliseconds = 0.0;
+
+    (void)memset(&theDevice.lastReading, 0, sizeof(theDevice.lastReading));
+
+    InitializeDeviceSession(*theDevice.pSession);
+
+    r_Scheduler.theDevices.push_back(move(theDevice));
+}
+
+/// <summary>
+/// Opens the device's connection and, the first time, its time series. The time series
+/// is named after the device's serial number and is appended to, so a gateway which is
+/// restarted carries on the same series.
+/// </summary>
+static bool OpenPollDevice(PollScheduler & r_Scheduler, PollDevice & r_Device)
+{
+    DeviceSession & r_Session = *r_Device.pSession;
+
+    if (false == OpenDeviceSession(r_Session, r_Device.portName.c_str(), r_Scheduler.baudRate))
+    {
+        return false;
+    }
+
+    if (false == AcquireSessionSerialNumber(r_Session))
+    {
+        CloseDeviceSession(r_Session);
+        return false;
+    }
+
+    if (nullptr == r_Device.pSeriesFile)
+    {
+        r_Device.seriesFileName = r_Scheduler.outputDirectory + r_Session.serialNumberText + "." + DATA_OUTPUT_POLL_FILE_NAME;
+
+        if (0 != fopen_s(&r_Device.pSeriesFile, r_Device.seriesFileName.c_str(), "a"))
+        {
+            r_Device.pSeriesFile = nullptr;
+
+            (void)printf("Error: I was unable to open file: %s\n", r_Device.seriesFileName.c_str());
+        }
+        else if (0 == fseek(r_Device.pSeriesFile, 0, SEEK_END) && 0 == ftell(r_Device.pSeriesFile))
+        {
+            (void)fputs("Date/Time,Counts,Volts,Temperature\n", r_Device.pSeriesFile);
+        }
+    }
+
+    r_Device.isOpen = true;
+
+    return true;
+}
+
+/// <summary>
+/// Asks a device for its counts per minute, battery voltage and temperature, opening
+/// its connection first if need be. A device which does not answer with its counts
+/// per minute has its connection closed so that it is opened again next time.
+/// </summary>
+static bool PollOneDevice(PollScheduler & r_Scheduler, PollDevice & r_Device, PollReading & r_Reading)
+{
+    DeviceSession & r_Session = *r_Device.pSession;
+    uchar           countsPerMinute[2] = { 0 };
+
+    if (false == r_Device.isOpen && false == OpenPollDevice(r_Scheduler, r_Device))
+    {
+        return false;
+    }
+
+    r_Reading.epochSeconds = GetLocalEpochSeconds();
+
+    if (false == SendCommandAndGetResponse(r_Session,
+        CommandGetCountsPerMinute,
+        strlen(CommandGetCountsPerMinute),
+        reinterpret_cast<char *>(countsPerMinute),
+        sizeof(countsPerMinute)))
+    {
+        CloseDeviceSession(r_Session);
+
+        r_Device.isOpen = false;
+
+        return false;
+    }
+
+    // The two most significant bits are reserved, as they are in the heartbeat
+    r_Reading.countsPerMinute = (static_cast<ulong>(countsPerMinute[0] & 0x3F) << 8) | static_cast<ulong>(countsPerMinute[1]);
+
+    r_Reading.hasBatteryVolts = SendCommandAndGetResponse(r_Session,
+        CommandGetBatteryVoltage,
+        strlen(CommandGetBatteryVoltage),
+        r_Session.batteryVoltage,
+        sizeof(r_Session.batteryVoltage));
+
+    r_Reading.batteryVolts = static_cast<double>(static_cast<uchar>(r_Session.batteryVoltage[0])) / 10.0;
+
+    r_Reading.hasTemperature = SendCommandAndGetResponse(r_Session,
+        CommandGetTemperature,
+        strlen(CommandGetTemperature),
+        r_Session.temperature,
+        sizeof(r_Session.temperature));
+
+    // Whole degrees, tenths of a degree, then the sign, not 0 for below zero
+    r_Reading.temperatureCelsius = static_cast<double>(static_cast<uchar>(r_Session.temperature[0]))
+        + (static_cast<double>(static_cast<uchar>(r_Session.temperature[1])) / 10.0);
+
+    if (0 != r_Session.temperature[2])
+    {
+        r_Reading.temperatureCelsius = -r_Reading.temperatureCelsius;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Appends a reading to the device's time series and displays it if asked to
+/// </summary>
+static void RecordPollReading(const PollScheduler & r_Scheduler, PollDevice & r_Device, const PollReading & r_Reading)
+{
+    char theTime[31]        = { 0 };
+    char batteryVolts[21]   = { 0 };
+    char temperature[21]    = { 0 };
+
+    FormatQueryTime(r_Reading.epochSeconds, theTime, sizeof(theTime));
+
+    if (true == r_Reading.hasBatteryVolts)
+    {
+        (void)sprintf_s(batteryVolts, sizeof(batteryVolts), "%.1f", r_Reading.batteryVolts);
+    }
+
+    if (true == r_Reading.hasTemperature)
+    {
+        (void)sprintf_s(temperature, sizeof(temperature), "%.1f", r_Reading.temperatureCelsius);
+    }
+
+    if (nullptr != r_Device.pSeriesFile)
+    {
+        (void)fprintf(r_Device.pSeriesFile, "%s,%lu,%s,%s\n", theTime, r_Reading.countsPerMinute, batteryVolts, temperature);
+        (void)fflush(r_Device.pSeriesFile);
+    }
+
+    if (true == r_Scheduler.displayReadings)
+    {
+        (void)printf("%s  %-16s %-14s %6lu CPM %5s V %6s C\n",
+            theTime,
+            r_Device.portName.c_str(),
+            r_Device.pSession->serialNumberText,
+            r_Reading.countsPerMinute,
+            batteryVolts,
+            temperature);
+    }
+}
+
+/// <summary>
+/// A worker thread: takes the device due soonest, waits until it is due, polls it and
+/// puts it back on the queue for its next time, until the scheduler is stopped
+/// </summary>
+static void RunPollWorker(PollScheduler * pScheduler)
+{
+    PollScheduler &    r_Scheduler = *pScheduler;
+    unique_lock<mutex> theLock(r_Scheduler.queueLock);
+
+    while (false == r_Scheduler.stopRequested.load())
+    {
+        if (r_Scheduler.dueQueue.empty())
+        {
+            r_Scheduler.queueChanged.wait(theLock);
+            continue;
+        }
+
+        long long dueMilliseconds = r_Scheduler.dueQueue.front().dueMilliseconds;
+        long long untilDue        = dueMilliseconds - GetSteadyMilliseconds();
+
+        if (untilDue > 0)
+        {
+            (void)r_Scheduler.queueChanged.wait_for(theLock, chrono::milliseconds(untilDue));
+            continue;
+        }
+
+        pop_heap(r_Scheduler.dueQueue.begin(), r_Scheduler.dueQueue.end(), IsPollEntryLater);
+
+        size_t       whichDevice = r_Scheduler.dueQueue.back().whichDevice;
+        PollDevice & r_Device    = r_Scheduler.theDevices[whichDevice];
+        PollReading  theReading;
+        long long    startTime   = GetSteadyMilliseconds();
+
+        r_Scheduler.dueQueue.pop_back();
+
+        // Nobody else can take this device while it is off the queue
+        theLock.unlock();
+
+        if (startTime - dueMilliseconds > POLL_LATE_MILLISECONDS)
+        {
+            r_Device.lateCount++;
+        }
+
+        if (startTime - dueMilliseconds > r_Device.latestMilliseconds)
+        {
+            r_Device.latestMilliseconds = startTime - dueMilliseconds;
+        }
+
+        if (true == PollOneDevice(r_Scheduler, r_Device, theReading))
+        {
+            r_Device.lastReading = theReading;
+            r_Device.pollCount++;
+
+            RecordPollReading(r_Scheduler, r_Device, theReading);
+        }
+        else
+        {
+            r_Device.failureCount++;
+        }
+
+        long long finishTime = GetSteadyMilliseconds();
+
+        r_Device.totalPollMilliseconds += static_cast<double>(finishTime - startTime);
+
+        // The next time follows on from when this one was due so that the interval does not
+        // creep, unless the device has fallen so far behind that it is already past
+        long long nextDue = dueMilliseconds + static_cast<long long>(r_Device.intervalMilliseconds);
+
+        theLock.lock();
+
+        QueuePollDevice(r_Scheduler, whichDevice, (nextDue > finishTime) ? nextDue : finishTime);
+
+        r_Scheduler.queueChanged.notify_one();
+    }
+}
+
+/// <summary>
+/// Starts the worker threads. Each device's first poll is spread across its first interval
+/// so that they do not all fall due at once.
+/// </summary>
+/// <param name="r_Scheduler">The scheduler, with its devices added</param>
+/// <param name="threadCount">The number of worker threads</param>
+/// <returns>true if it was started, false if there were no devices</returns>
+bool StartPollScheduler(PollScheduler & r_Scheduler, ulong threadCount)
+{
+    long long startTime = GetSteadyMilliseconds();
+
+    if (r_Scheduler.theDevices.empty())
+    {
+        return false;
+    }
+
+    if (threadCount == static_cast<ulong>(0))
+    {
+        threadCount = POLL_DEFAULT_THREAD_COUNT;
+    }
+
+    if (threadCount > r_Scheduler.theDevices.size())
+    {
+        threadCount = static_cast<ulong>(r_Scheduler.theDevices.size());
+    }
+
+    r_Scheduler.stopRequested = false;
+
+    {
+        lock_guard<mutex> theLock(r_Scheduler.queueLock);
+
+        r_Scheduler.dueQueue.clear();
+
+        for (size_t thisDevice = 0; thisDevice < r_Scheduler.theDevices.size(); thisDevice++)
+        {
+            long long intervalMilliseconds = static_cast<long long>(r_Scheduler.theDevices[thisDevice].intervalMilliseconds);
+
+            QueuePollDevice(r_Scheduler, thisDevice, startTime + DrawPollRandom(r_Scheduler, intervalMilliseconds));
+        }
+    }
+
+    for (ulong thisThread = 0; thisThread < threadCount; thisThread++)
+    {
+        r_Scheduler.workerThreads.push_back(thread(RunPollWorker, &r_Scheduler));
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Stops the worker threads once they have finished the polls they are in, then closes
+/// every connection and time series
+/// </summary>
+/// <param name="r_Scheduler">The started scheduler</param>
+void StopPollScheduler(PollScheduler & r_Scheduler)
+{
+    {
+        lock_guard<mutex> theLock(r_Scheduler.queueLock);
+
+        r_Scheduler.stopRequested = true;
+    }
+
+    r_Scheduler.queueChanged.notify_all();
+
+    for (size_t thisThread = 0; thisThread < r_Scheduler.workerThreads.size(); thisThread++)
+    {
+        r_Scheduler.workerThreads[thisThread].join();
+    }
+
+    r_Scheduler.workerThreads.clear();
+
+    for (size_t thisDevice = 0; thisDevice < r_Scheduler.theDevices.size(); thisDevice++)
+    {
+        PollDevice & r_Device = r_Scheduler.theDevices[thisDevice];
+
+        if (true == r_Device.isOpen)
+        {
+            CloseDeviceSession(*r_Device.pSession);
+
+            r_Device.isOpen = false;
+        }
+
+        if (nullptr != r_Device.pSeriesFile)
+        {
+            (void)fclose(r_Device.pSeriesFile);
+
+            r_Device.pSeriesFile = nullptr;
+        }
+    }
+}
+
+/// <summary>
+/// Displays how the poll scheduler is used
+/// </summary>
+static void DisplayPollUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -poll [port[@seconds]] [...] [-interval <seconds>] [-jitter <percent>] [-threads <count>]\n");
+    (void)printf("       [-seconds <count>] [-out <directory>] [-baud <rate>] [-quiet]\n");
+    (void)printf("  Each device is asked for its CPM, battery voltage and temperature every -interval seconds\n");
+    (void)printf("  (%lu unless given), or as often as given after its port, and each reading is appended to\n", POLL_DEFAULT_INTERVAL_SECONDS);
+    (void)printf("  <serial>.%s. With no ports named, every serial port found is polled.\n", DATA_OUTPUT_POLL_FILE_NAME);
+    (void)printf("  With no -seconds it polls until Enter is pressed.\n");
+}
+
+/// <summary>
+/// The entry point for the poll scheduler. The devices are polled until the time given
+/// runs out or Enter is pressed, then a line for each device is displayed.
+/// </summary>
+/// <param name="argc">The number of arguments following "-poll"</param>
+/// <param name="argv">The arguments following "-poll"</param>
+/// <returns>0 if every device was polled at least once, otherwise 1</returns>
+int RunPollScheduler(int argc, char * argv[])
+{
+    unique_ptr<PollScheduler> pScheduler(new PollScheduler());
+    PollScheduler &           r_Scheduler     = *pScheduler;
+    vector<string>            portNames;
+    ulong                     defaultInterval = POLL_DEFAULT_INTERVAL_SECONDS;
+    ulong                     threadCount     = POLL_DEFAULT_THREAD_COUNT;
+    ulong                     runSeconds      = static_cast<ulong>(0);
+    ulong                     silentCount     = static_cast<ulong>(0);
+
+    InitializePollScheduler(r_Scheduler);
+
+    for (int thisArgument = 0; thisArgument < argc; thisArgument++)
+    {
+        if (0 == strcmp(argv[thisArgument], "-interval") && thisArgument + 1 < argc)
+        {
+            defaultInterval = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-jitter") && thisArgument + 1 < argc)
+        {
+            r_Scheduler.jitterPercent = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-threads") && thisArgument + 1 < argc)
+        {
+            threadCount = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-seconds") && thisArgument + 1 < argc)
+        {
+            runSeconds = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-out") && thisArgument + 1 < argc)
+        {
+            r_Scheduler.outputDirectory = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-baud") && thisArgument + 1 < argc)
+        {
+            r_Scheduler.baudRate = strtoul(argv[++thisArgument], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[thisArgument], "-quiet"))
+        {
+            r_Scheduler.displayReadings = false;
+        }
+        else if ('-' == argv[thisArgument][0])
+        {
+            // An option we do not know, or one missing its value, is not a port
+            DisplayPollUsage();
+            (void)printf("%s is not an option of -poll, or is missing its value\n", argv[thisArgument]);
+            return 1;
+        }
+        else
+        {
+            portNames.push_back(argv[thisArgument]);
+        }
+    }
+
+    if (r_Scheduler.jitterPercent > static_cast<ulong>(50))
+    {
+        r_Scheduler.jitterPercent = static_cast<ulong>(50);
+    }
+
+    if (r_Scheduler.baudRate == static_cast<ulong>(0))
+    {
+        r_Scheduler.baudRate = POLL_DEFAULT_BAUD_RATE;
+    }
+
+    if (false == r_Scheduler.outputDirectory.empty() &&
+        r_Scheduler.outputDirectory.back() != PATH_SEPARATOR_CHARACTER && r_Scheduler.outputDirectory.back() != '/')
+    {
+        r_Scheduler.outputDirectory += PATH_SEPARATOR_CHARACTER;
+    }
+
+    if (portNames.empty())
+    {
+        FindSerialPorts(portNames);
+    }
+
+    // A port may carry its own interval, "/dev/ttyUSB0@30" or "COM3@30"
+    for (size_t thisPort = 0; thisPort < portNames.size(); thisPort++)
+    {
+        size_t intervalOffset = portNames[thisPort].rfind('@');
+        ulong  theInterval    = defaultInterval;
+
+        if (string::npos != intervalOffset)
+        {
+            theInterval = strtoul(portNames[thisPort].c_str() + intervalOffset + 1, nullptr, 10);
+
+            portNames[thisPort].erase(intervalOffset);
+        }
+
+        AddPollDevice(r_Scheduler, portNames[thisPort].c_str(), theInterval);
+    }
+
+    if (false == StartPollScheduler(r_Scheduler, threadCount))
+    {
+        DisplayPollUsage();
+        (void)printf("There were no serial ports found to poll\n");
+        return 1;
+    }
+
+    (void)printf("Polling %lu devices from %lu threads. %s\n",
+        static_cast<ulong>(r_Scheduler.theDevices.size()),
+        static_cast<ulong>(r_Scheduler.workerThreads.size()),
+        (runSeconds == static_cast<ulong>(0)) ? "Press Enter to stop." : "");
+
+    if (runSeconds > static_cast<ulong>(0))
+    {
+        this_thread::sleep_for(chrono::seconds(runSeconds));
+    }
+    else
+    {
+        char theAnswer[101];
+
+        (void)fgets(theAnswer, sizeof(theAnswer), stdin);
+    }
+
+    StopPollScheduler(r_Scheduler);
+
+    (void)printf("\nPort             Serial          Interval  Polls  Failures  Late  Latest ms  Mean ms     CPM  Volts  Temp\n");
+
+    for (size_t thisDevice = 0; thisDevice < r_Scheduler.theDevices.size(); thisDevice++)
+    {
+        const PollDevice & r_Device = r_Scheduler.theDevices[thisDevice];
+        ulong              tryCount = r_Device.pollCount + r_Device.failureCount;
+
+        (void)printf("%-16s %-14s %9lu %6lu %9lu %5lu %10lld %8.1f %7lu %6.1f %5.1f\n",
+            r_Device.portName.c_str(),
+            (0 == r_Device.pSession->serialNumberText[0]) ? "-" : r_Device.pSession->serialNumberText,
+            r_Device.intervalMilliseconds / 1000,
+            r_Device.pollCount,
+            r_Device.failureCount,
+            r_Device.lateCount,
+            r_Device.latestMilliseconds,
+            (tryCount == static_cast<ulong>(0)) ? 0.0 : r_Device.totalPollMilliseconds / static_cast<double>(tryCount),
+            r_Device.lastReading.countsPerMinute,
+            r_Device.lastReading.batteryVolts,
+            r_Device.lastReading.temperatureCelsius);
+
+        if (r_Device.pollCount == static_cast<ulong>(0))
+        {
+            silentCount++;
+        }
+    }
+
+    return (silentCount == static_cast<ulong>(0)) ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+// ----------------------------------------------------------------------
+// PollScheduler.h
+//
+// Keeps the current readings of Geiger Counters left plugged in at
+// permanent sites without retrieving their history. Each device is
+// asked for its counts per minute, its battery voltage and its
+// temperature every so often, each at an interval of its own, and each
+// reading is appended to the device's own comma-delimited time series.
+//
+// The devices are not given a thread each. A small fixed pool of worker
+// threads shares one queue of when each device is next due, soonest
+// first, and each worker takes the device which is due soonest, waits
+// for its time, polls it and puts it back on the queue for its next
+// time. A device is on the queue at most once so only one worker ever
+// talks to it at a time. Each next time is moved by a random jitter so
+// that devices which were started together drift apart rather than all
+// falling due in the same moment.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Portable.h"
+#include "DeviceSession.h"
+
+#define POLL_DEFAULT_BAUD_RATE          static_cast<ulong>(57600)
+#define POLL_DEFAULT_INTERVAL_SECONDS   static_cast<ulong>(60)
+#define POLL_DEFAULT_JITTER_PERCENT     static_cast<ulong>(5)
+#define POLL_DEFAULT_THREAD_COUNT       static_cast<ulong>(4)
+
+typedef struct poll_reading_t
+{
+    long long epochSeconds;                 // When the reading was taken, seconds since 1970 as local time
+    ulong     countsPerMinute;              // What GETCPM answered with
+    double    batteryVolts;                 // What GETVOLT answered with
+    double    temperatureCelsius;           // What GETTEMP answered with
+    bool      hasBatteryVolts;              // false if GETVOLT went unanswered
+    bool      hasTemperature;               // false if GETTEMP went unanswered
+} PollReading;
+
+typedef struct poll_device_t
+{
+    std::string                    portName;            // The serial port the device is on
+    ulong                          intervalMilliseconds; // How often the device is polled
+    std::unique_ptr<DeviceSession> pSession;            // The connection, opened at the first poll
+    bool                           isOpen;              // true once the device has answered GETSERIAL
+    FILE *                         pSeriesFile;         // The time series the readings are appended to
+    std::string                    seriesFileName;      // The name of that file
+    PollReading                    lastReading;         // The latest reading, if pollCount is not 0
+    ulong                          pollCount;           // Readings taken
+    ulong                          failureCount;        // Polls which got no counts per minute
+    ulong                          lateCount;           // Polls which started more than a second late
+    long long                      latestMilliseconds;  // The most that a poll started after it was due
+    double                         totalPollMilliseconds; // The time spent polling
+} PollDevice;
+
+typedef struct poll_entry_t
+{
+    long long dueMilliseconds;              // When the device is next due, on the steady clock
+    size_t    whichDevice;                  // Index in to theDevices
+} PollEntry;
+
+typedef struct poll_scheduler_t
+{
+    std::vector<PollDevice>  theDevices;        // Every device, in the order added
+    std::vector<PollEntry>   dueQueue;          // A heap of when each device is next due, soonest at the front
+    std::mutex               queueLock;         // Protects dueQueue and randomState
+    std::condition_variable  queueChanged;      // Told when the queue changes or a stop is requested
+    std::atomic<bool>        stopRequested;     // Set to make the worker threads return
+    std::vector<std::thread> workerThreads;     // The pool which polls the devices
+    uint64_t                 randomState;       // The jitter's generator state
+    ulong                    jitterPercent;     // How far each next time may move, as a percentage of the interval
+    ulong                    baudRate;          // The bits per second of every port
+    std::string              outputDirectory;   // Where the time series go, empty for the current directory
+    bool                     displayReadings;   // true to display each reading as it is taken
+} PollScheduler;
+
+extern void InitializePollScheduler(PollScheduler & r_Scheduler);
+extern void AddPollDevice(PollScheduler & r_Scheduler, const char * pch_PortName, ulong intervalSeconds);
+extern bool StartPollScheduler(PollScheduler & r_Scheduler, ulong threadCount);
+extern void StopPollScheduler(PollScheduler & r_Scheduler);
+
+extern int RunPollScheduler(int argc, char * argv[]);
@@ -0,0 +1,156 @@
+// ----------------------------------------------------------------------
+// Portable.h
+//
+// The device-facing parts of this program are Windows console code, but
+// the modules which only work on downloaded FLASH images are expected to
+// also build on our Linux ingest machines. This header provides the few
+// Microsoft "secure" run-time functions those modules use so that the
+// same source builds with either Visual Studio or GCC.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <stdio.h>
+#else
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// The C library declares its own ulong and ushort in here, which must be
+// seen before the macros below rather than after them
+#include <sys/types.h>
+
+/// <summary>
+/// Formats in to a sized buffer the way the Microsoft run-time library does
+/// </summary>
+inline int sprintf_s(char * pch_Buffer, size_t bufferSize, const char * pch_Format, ...)
+{
+    va_list argumentList;
+
+    va_start(argumentList, pch_Format);
+    int theResult = vsnprintf(pch_Buffer, bufferSize, pch_Format, argumentList);
+    va_end(argumentList);
+
+    return theResult;
+}
+
+/// <summary>
+/// Formats in to a character array whose size the compiler knows
+/// </summary>
+template <size_t bufferSize>
+inline int sprintf_s(char (&ach_Buffer)[bufferSize], const char * pch_Format, ...)
+{
+    va_list argumentList;
+
+    va_start(argumentList, pch_Format);
+    int theResult = vsnprintf(ach_Buffer, bufferSize, pch_Format, argumentList);
+    va_end(argumentList);
+
+    return theResult;
+}
+
+/// <summary>
+/// Copies a NULL-terminated string in to a sized buffer, truncating if needed
+/// </summary>
+inline int strcpy_s(char * pch_Buffer, size_t bufferSize, const char * pch_Source)
+{
+    (void)snprintf(pch_Buffer, bufferSize, "%s", pch_Source);
+    return 0;
+}
+
+/// <summary>
+/// Copies a NULL-terminated string in to a character array whose size the compiler knows
+/// </summary>
+template <size_t bufferSize>
+inline int strcpy_s(char (&ach_Buffer)[bufferSize], const char * pch_Source)
+{
+    return strcpy_s(ach_Buffer, bufferSize, pch_Source);
+}
+
+/// <summary>
+/// Opens a file, returning 0 on success as the Microsoft run-time library does
+/// </summary>
+inline int fopen_s(FILE ** ppFile, const char * pch_FileName, const char * pch_Mode)
+{
+    *ppFile = fopen(pch_FileName, pch_Mode);
+    return (nullptr == *ppFile) ? 1 : 0;
+}
+
+/// <summary>
+/// Converts a time to local time. Note that the argument order differs from POSIX.
+/// </summary>
+inline int localtime_s(struct tm * pTime, const time_t * pTimeValue)
+{
+    return (nullptr == localtime_r(pTimeValue, pTime)) ? 1 : 0;
+}
+
+/// <summary>
+/// Converts a time to Universal Time. Note that the argument order differs from POSIX.
+/// </summary>
+inline int gmtime_s(struct tm * pTime, const time_t * pTimeValue)
+{
+    return (nullptr == gmtime_r(pTimeValue, pTime)) ? 1 : 0;
+}
+#endif
+
+#ifndef uchar
+#define uchar   unsigned char
+#endif
+#ifndef ushort
+#define ushort  unsigned short
+#endif
+#ifndef ulong
+#define ulong   unsigned long
+#endif
+
+#ifdef _WIN32
+#define PATH_SEPARATOR_CHARACTER    '\\'
+#else
+#define PATH_SEPARATOR_CHARACTER    '/'
+#endif
+
+/// <summary>
+/// Builds the name of a temporary file beside the file passed by argument. The name
+/// carries the process identifier and a count so that no other thread or process
+/// writing the same file at the same time will pick it.
+/// </summary>
+/// <param name="pch_FileName">The file which the temporary file will become</param>
+/// <param name="pch_Buffer">Returns the temporary file name</param>
+/// <param name="bufferSize">The size of that buffer</param>
+inline void BuildTemporaryFileName(const char * pch_FileName, char * pch_Buffer, size_t bufferSize)
+{
+    static std::atomic<unsigned long> temporaryFileCount(0);
+
+#ifdef _WIN32
+    unsigned long processIdentifier = static_cast<unsigned long>(GetCurrentProcessId());
+#else
+    unsigned long processIdentifier = static_cast<unsigned long>(getpid());
+#endif
+
+    (void)sprintf_s(pch_Buffer, bufferSize, "%s.%lu.%lu.tmp", pch_FileName, processIdentifier, temporaryFileCount++);
+}
+
+/// <summary>
+/// Puts a completely written temporary file in place of the file passed by argument,
+/// replacing it if it exists. Readers see either the old file or the new one, never
+/// a file which is partly written.
+/// </summary>
+/// <param name="pch_TemporaryFileName">The completed temporary file</param>
+/// <param name="pch_FileName">The file to create or replace</param>
+/// <returns>true if the file is in place, otherwise false</returns>
+inline bool CommitFileAtomically(const char * pch_TemporaryFileName, const char * pch_FileName)
+{
+#ifdef _WIN32
+    return (FALSE != MoveFileEx(pch_TemporaryFileName, pch_FileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH));
+#else
+    return (0 == rename(pch_TemporaryFileName, pch_FileName));
+#endif
+}
@@ -0,0 +1,702 @@
+// ----------------------------------------------------------------------
+// QueryEngine.cpp
+//
+// Loading the decoded history of many devices, indexing it, and the
+// range, bucket and threshold queries over it. Finding where a time
+// range starts and ends is a binary search of the timeline; buckets and
+// thresholds then work a block at a time, only looking at the values of
+// a block when its summary cannot answer for it.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "QueryEngine.h"
+#include "ArchiveStore.h"
+#include "BatchDecode.h"
+#include "FlashExport.h"
+#include "ReadGeiger.h"
+#include "SeriesFile.h"
+
+using namespace std;
+
+// The earliest and latest times a query may ask about
+#define QUERY_EARLIEST_EPOCH    (-(1LL << 62))
+#define QUERY_LATEST_EPOCH      (1LL << 62)
+
+/// <summary>
+/// Returns the device which a serial number is filed under, adding it if it is new
+/// </summary>
+static QueryDevice & FindQueryDevice(QueryEngine & r_Engine, const string & r_SerialNumber)
+{
+    for (size_t thisDevice = 0; thisDevice < r_Engine.theDevices.size(); thisDevice++)
+    {
+        if (r_Engine.theDevices[thisDevice].serialNumber == r_SerialNumber)
+        {
+            return r_Engine.theDevices[thisDevice];
+        }
+    }
+
+    r_Engine.theDevices.push_back(QueryDevice());
+    r_Engine.theDevices.back().serialNumber = r_SerialNumber;
+
+    return r_Engine.theDevices.back();
+}
+
+/// <summary>
+/// Adds the values of a series file, comma-delimited file or FLASH image to the device
+/// it came from. Fleet harvested files are named after the device's serial number; any
+/// other file belongs to the device named by argument. The device's timeline is not
+/// usable until BuildQueryIndex() is called.
+/// </summary>
+/// <param name="r_Engine">The engine to add to</param>
+/// <param name="pch_FileName">The file to read</param>
+/// <param name="pch_DefaultSerialNumber">The device for files not named after one</param>
+/// <returns>true if the file was read, otherwise false</returns>
+bool AddQueryFile(QueryEngine & r_Engine, const char * pch_FileName, const char * pch_DefaultSerialNumber)
+{
+    SampleStore theStore;
+
+    if (false == LoadSampleFile(pch_FileName, theStore))
+    {
+        return false;
+    }
+
+    string baseFileName = GetBaseFileName(pch_FileName);
+
+    QueryDevice & r_Device = FindQueryDevice(r_Engine, GetImageSerialNumber(baseFileName, pch_DefaultSerialNumber));
+
+    for (size_t thisLabel = 0; thisLabel < theStore.labels.size(); thisLabel++)
+    {
+        if (find(r_Device.labels.begin(), r_Device.labels.end(), theStore.labels[thisLabel]) == r_Device.labels.end())
+        {
+            r_Device.labels.push_back(theStore.labels[thisLabel]);
+        }
+    }
+
+    r_Device.fileNames.push_back(pch_FileName);
+    r_Device.epochSeconds.insert(r_Device.epochSeconds.end(), theStore.epochSeconds.begin(), theStore.epochSeconds.end());
+    r_Device.counts.insert(r_Device.counts.end(), theStore.counts.begin(), theStore.counts.end());
+
+    return true;
+}
+
+/// <summary>
+/// Puts a device's values in time order, keeping only the first value added for any
+/// one time since successive harvests of a device repeat most of what came before,
+/// and then builds the summary of each block
+/// </summary>
+static void BuildQueryDeviceIndex(QueryDevice & r_Device)
+{
+    vector<ulong>     sampleOrder(r_Device.counts.size());
+    vector<long long> sortedEpochs;
+    vector<uint32_t>  sortedCounts;
+
+    for (ulong thisSample = 0; thisSample < sampleOrder.size(); thisSample++)
+    {
+        sampleOrder[thisSample] = thisSample;
+    }
+
+    const vector<long long> & r_Epochs = r_Device.epochSeconds;
+
+    stable_sort(sampleOrder.begin(), sampleOrder.end(), [&r_Epochs](ulong firstSample, ulong secondSample)
+    {
+        return r_Epochs[firstSample] < r_Epochs[secondSample];
+    });
+
+    sortedEpochs.reserve(sampleOrder.size());
+    sortedCounts.reserve(sampleOrder.size());
+
+    for (size_t thisSample = 0; thisSample < sampleOrder.size(); thisSample++)
+    {
+        if (false == sortedEpochs.empty() && sortedEpochs.back() == r_Epochs[sampleOrder[thisSample]])
+        {
+            continue;
+        }
+
+        sortedEpochs.push_back(r_Epochs[sampleOrder[thisSample]]);
+        sortedCounts.push_back(r_Device.counts[sampleOrder[thisSample]]);
+    }
+
+    r_Device.epochSeconds.swap(sortedEpochs);
+    r_Device.counts.swap(sortedCounts);
+    r_Device.theBlocks.clear();
+
+    for (ulong firstSample = 0; firstSample < r_Device.counts.size(); firstSample += QUERY_BLOCK_SAMPLES)
+    {
+        QueryBlock theBlock;
+        ulong      sampleCount = static_cast<ulong>(r_Device.counts.size()) - firstSample;
+        CountSpan  theSpan;
+
+        if (sampleCount > QUERY_BLOCK_SAMPLES)
+        {
+            sampleCount = QUERY_BLOCK_SAMPLES;
+        }
+
+        theSpan.pCounts = &r_Device.counts[firstSample];
+        theSpan.length  = sampleCount;
+
+        theBlock.firstSample  = firstSample;
+        theBlock.sampleCount  = sampleCount;
+        theBlock.firstEpoch   = r_Device.epochSeconds[firstSample];
+        theBlock.lastEpoch    = r_Device.epochSeconds[firstSample + sampleCount - 1];
+        theBlock.lowestCount  = MinimumOfCountSpan(theSpan);
+        theBlock.highestCount = MaximumOfCountSpan(theSpan);
+        theBlock.countTotal   = SumCountSpan(theSpan);
+
+        r_Device.theBlocks.push_back(theBlock);
+    }
+}
+
+/// <summary>
+/// Merges and indexes the timeline of every device once all of the files are added
+/// </summary>
+/// <param name="r_Engine">The engine which the files were added to</param>
+void BuildQueryIndex(QueryEngine & r_Engine)
+{
+    for (size_t thisDevice = 0; thisDevice < r_Engine.theDevices.size(); thisDevice++)
+    {
+        BuildQueryDeviceIndex(r_Engine.theDevices[thisDevice]);
+    }
+}
+
+/// <summary>
+/// Decides whether a device is one that a query asks about: its serial number starts
+/// with the filter, or one of its location labels contains it
+/// </summary>
+/// <param name="r_Device">The device</param>
+/// <param name="pch_Filter">The text to look for, or nullptr or empty for every device</param>
+/// <returns>true if the device is selected, otherwise false</returns>
+bool IsQueryDeviceSelected(const QueryDevice & r_Device, const char * pch_Filter)
+{
+    if (nullptr == pch_Filter || 0 == pch_Filter[0])
+    {
+        return true;
+    }
+
+    if (0 == r_Device.serialNumber.compare(0, strlen(pch_Filter), pch_Filter))
+    {
+        return true;
+    }
+
+    for (size_t thisLabel = 0; thisLabel < r_Device.labels.size(); thisLabel++)
+    {
+        if (string::npos != r_Device.labels[thisLabel].find(pch_Filter))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// <summary>
+/// Finds the values of a device which were recorded from one time up to, but not
+/// including, another
+/// </summary>
+/// <param name="r_Device">The indexed device</param>
+/// <param name="fromEpoch">The start of the range in seconds since 1970</param>
+/// <param name="toEpoch">The end of the range, which is not part of it</param>
+/// <param name="r_FirstSample">Returns the index of the first value in the range</param>
+/// <param name="r_SampleCount">Returns the number of values in the range</param>
+void FindQueryRange(const QueryDevice & r_Device,
+    long long fromEpoch,
+    long long toEpoch,
+    ulong & r_FirstSample,
+    ulong & r_SampleCount)
+{
+    vector<long long>::const_iterator pFirst = lower_bound(r_Device.epochSeconds.begin(), r_Device.epochSeconds.end(), fromEpoch);
+    vector<long long>::const_iterator pEnd   = lower_bound(pFirst, r_Device.epochSeconds.end(), toEpoch);
+
+    r_FirstSample = static_cast<ulong>(pFirst - r_Device.epochSeconds.begin());
+    r_SampleCount = static_cast<ulong>(pEnd - pFirst);
+}
+
+/// <summary>
+/// Returns when the bucket holding a time starts
+/// </summary>
+static long long GetQueryBucketEpoch(long long theEpoch, long long bucketSeconds)
+{
+    long long bucketNumber = (theEpoch >= 0) ? theEpoch / bucketSeconds : ((theEpoch + 1) / bucketSeconds) - 1;
+
+    return bucketNumber * bucketSeconds;
+}
+
+/// <summary>
+/// Adds some values, summarized, to the bucket which starts at the time passed by
+/// argument. Buckets are filled in time order so it is either the last one or a new one.
+/// </summary>
+static void AddToQueryBucket(vector<QueryBucket> & r_Buckets,
+    long long bucketEpoch,
+    ulong sampleCount,
+    uint32_t lowestCount,
+    uint32_t highestCount,
+    unsigned long long countTotal)
+{
+    if (true == r_Buckets.empty() || r_Buckets.back().bucketEpoch != bucketEpoch)
+    {
+        QueryBucket theBucket = { bucketEpoch, sampleCount, lowestCount, highestCount, countTotal };
+
+        r_Buckets.push_back(theBucket);
+        return;
+    }
+
+    QueryBucket & r_Bucket = r_Buckets.back();
+
+    r_Bucket.sampleCount += sampleCount;
+    r_Bucket.countTotal  += countTotal;
+
+    if (lowestCount < r_Bucket.lowestCount)
+    {
+        r_Bucket.lowestCount = lowestCount;
+    }
+
+    if (highestCount > r_Bucket.highestCount)
+    {
+        r_Bucket.highestCount = highestCount;
+    }
+}
+
+/// <summary>
+/// Summarizes the values of a device in a time range in to buckets of a fixed length,
+/// each starting at a whole multiple of that length since 1970. A block which lies
+/// wholly inside the range and inside one bucket is added from its summary; only the
+/// blocks at the edges of the range and of the buckets are looked at value by value.
+/// Buckets with no values are left out.
+/// </summary>
+/// <param name="r_Device">The indexed device</param>
+/// <param name="fromEpoch">The start of the range in seconds since 1970</param>
+/// <param name="toEpoch">The end of the range, which is not part of it</param>
+/// <param name="bucketSeconds">The length of each bucket in seconds</param>
+/// <param name="r_Buckets">Returns the buckets in time order</param>
+void AggregateQueryRange(const QueryDevice & r_Device,
+    long long fromEpoch,
+    long long toEpoch,
+    long long bucketSeconds,
+    vector<QueryBucket> & r_Buckets)
+{
+    ulong thisSample;
+    ulong sampleCount;
+
+    r_Buckets.clear();
+
+    if (bucketSeconds <= 0)
+    {
+        return;
+    }
+
+    FindQueryRange(r_Device, fromEpoch, toEpoch, thisSample, sampleCount);
+
+    ulong endSample = thisSample + sampleCount;
+
+    while (thisSample < endSample)
+    {
+        const QueryBlock & r_Block     = r_Device.theBlocks[thisSample / QUERY_BLOCK_SAMPLES];
+        long long          bucketEpoch = GetQueryBucketEpoch(r_Device.epochSeconds[thisSample], bucketSeconds);
+
+        if (thisSample == r_Block.firstSample &&
+            r_Block.firstSample + r_Block.sampleCount <= endSample &&
+            bucketEpoch == GetQueryBucketEpoch(r_Block.lastEpoch, bucketSeconds))
+        {
+            AddToQueryBucket(r_Buckets, bucketEpoch, r_Block.sampleCount, r_Block.lowestCount, r_Block.highestCount, r_Block.countTotal);
+
+            thisSample += r_Block.sampleCount;
+            continue;
+        }
+
+        uint32_t countValue = r_Device.counts[thisSample];
+
+        AddToQueryBucket(r_Buckets, bucketEpoch, 1, countValue, countValue, countValue);
+
+        thisSample++;
+    }
+}
+
+/// <summary>
+/// Finds the values of a device in a time range which are at or above a threshold.
+/// Blocks whose highest value is below the threshold are skipped without looking at
+/// their values.
+/// </summary>
+/// <param name="r_Device">The indexed device</param>
+/// <param name="fromEpoch">The start of the range in seconds since 1970</param>
+/// <param name="toEpoch">The end of the range, which is not part of it</param>
+/// <param name="thresholdCount">The lowest value to report</param>
+/// <param name="r_Samples">Returns the index in to the timeline of each value found</param>
+void FindQueryThreshold(const QueryDevice & r_Device,
+    long long fromEpoch,
+    long long toEpoch,
+    uint32_t thresholdCount,
+    vector<ulong> & r_Samples)
+{
+    ulong firstSample;
+    ulong sampleCount;
+
+    r_Samples.clear();
+
+    FindQueryRange(r_Device, fromEpoch, toEpoch, firstSample, sampleCount);
+
+    ulong endSample = firstSample + sampleCount;
+
+    for (ulong thisBlock = firstSample / QUERY_BLOCK_SAMPLES; sampleCount > 0 && thisBlock < r_Device.theBlocks.size(); thisBlock++)
+    {
+        const QueryBlock & r_Block = r_Device.theBlocks[thisBlock];
+
+        if (r_Block.firstSample >= endSample)
+        {
+            break;
+        }
+
+        if (r_Block.highestCount < thresholdCount)
+        {
+            continue;
+        }
+
+        ulong thisSample = (r_Block.firstSample > firstSample) ? r_Block.firstSample : firstSample;
+        ulong lastSample = r_Block.firstSample + r_Block.sampleCount;
+
+        if (lastSample > endSample)
+        {
+            lastSample = endSample;
+        }
+
+        for (; thisSample < lastSample; thisSample++)
+        {
+            if (r_Device.counts[thisSample] >= thresholdCount)
+            {
+                r_Samples.push_back(thisSample);
+            }
+        }
+    }
+}
+
+/// <summary>
+/// Reads a time in the form the comma-delimited files use, "19/Apr/23 02:00:00", or as
+/// "2023-04-19 02:00:00". The time of day may be left out, as may the seconds, and a
+/// 'T' may be used in place of the space.
+/// </summary>
+/// <param name="pch_Text">The time</param>
+/// <param name="r_Epoch">Returns the time in seconds since 1970</param>
+/// <returns>true if the time was understood, otherwise false</returns>
+bool ParseQueryTime(const char * pch_Text, long long & r_Epoch)
+{
+    char * pch_Next  = nullptr;
+    ulong  theYear   = static_cast<ulong>(0);
+    ulong  theMonth  = static_cast<ulong>(0);
+    ulong  theDay    = strtoul(pch_Text, &pch_Next, 10);
+    ulong  theHour   = static_cast<ulong>(0);
+    ulong  theMinute = static_cast<ulong>(0);
+    ulong  theSecond = static_cast<ulong>(0);
+
+    if (pch_Next == pch_Text)
+    {
+        return false;
+    }
+
+    if ('/' == *pch_Next)
+    {
+        pch_Next++;
+
+        while (theMonth < 12 && 0 != strncmp(pch_Next, theMonths[theMonth], 3))
+        {
+            theMonth++;
+        }
+
+        if (theMonth == 12 || '/' != pch_Next[3])
+        {
+            return false;
+        }
+
+        theMonth++;
+        theYear = 2000 + strtoul(&pch_Next[4], &pch_Next, 10);
+    }
+    else if ('-' == *pch_Next)
+    {
+        theYear  = theDay;
+        theMonth = strtoul(pch_Next + 1, &pch_Next, 10);
+
+        if ('-' != *pch_Next)
+        {
+            return false;
+        }
+
+        theDay = strtoul(pch_Next + 1, &pch_Next, 10);
+    }
+    else
+    {
+        return false;
+    }
+
+    if (' ' == *pch_Next || 'T' == *pch_Next)
+    {
+        theHour = strtoul(pch_Next + 1, &pch_Next, 10);
+
+        if (':' == *pch_Next)
+        {
+            theMinute = strtoul(pch_Next + 1, &pch_Next, 10);
+        }
+
+        if (':' == *pch_Next)
+        {
+            theSecond = strtoul(pch_Next + 1, &pch_Next, 10);
+        }
+    }
+
+    if (0 != *pch_Next || theMonth < 1 || theMonth > 12 || theDay < 1 || theDay > 31 || theHour > 23 || theMinute > 59 || theSecond > 59)
+    {
+        return false;
+    }
+
+    r_Epoch = EpochFromCivil(theYear, theMonth, theDay, theHour, theMinute, theSecond);
+
+    return true;
+}
+
+/// <summary>
+/// Formats a time the way the comma-delimited files do, "19/Apr/23 02:00:00"
+/// </summary>
+/// <param name="epochSeconds">The time in seconds since 1970</param>
+/// <param name="pch_Buffer">Returns the NULL-terminated text</param>
+/// <param name="bufferSize">The size of that buffer</param>
+void FormatQueryTime(long long epochSeconds, char * pch_Buffer, size_t bufferSize)
+{
+    ulong theYear, theMonth, theDay, theHour, theMinute, theSecond;
+
+    CivilFromEpoch(epochSeconds, theYear, theMonth, theDay, theHour, theMinute, theSecond);
+
+    (void)sprintf_s(pch_Buffer, bufferSize, "%02lu/%s/%02lu %02lu:%02lu:%02lu",
+        theDay, theMonths[(theMonth - 1) % 12], theYear % 100, theHour, theMinute, theSecond);
+}
+
+/// <summary>
+/// Lists each device with how much of its history is indexed
+/// </summary>
+static void ListQueryDevices(const QueryEngine & r_Engine, const char * pch_Filter)
+{
+    (void)printf("Serial          Files  Samples  Blocks  First               Last                Labels\n");
+
+    for (size_t thisDevice = 0; thisDevice < r_Engine.theDevices.size(); thisDevice++)
+    {
+        const QueryDevice & r_Device       = r_Engine.theDevices[thisDevice];
+        char                firstTime[31]  = { 0 };
+        char                lastTime[31]   = { 0 };
+        string              allLabels;
+
+        if (false == IsQueryDeviceSelected(r_Device, pch_Filter))
+        {
+            continue;
+        }
+
+        if (false == r_Device.epochSeconds.empty())
+        {
+            FormatQueryTime(r_Device.epochSeconds.front(), firstTime, sizeof(firstTime));
+            FormatQueryTime(r_Device.epochSeconds.back(), lastTime, sizeof(lastTime));
+        }
+
+        for (size_t thisLabel = 0; thisLabel < r_Device.labels.size(); thisLabel++)
+        {
+            allLabels += (thisLabel > 0) ? "; " : "";
+            allLabels += r_Device.labels[thisLabel];
+        }
+
+        (void)printf("%-14s %6lu %8lu %7lu  %-18s  %-18s  %s\n",
+            r_Device.serialNumber.c_str(),
+            static_cast<ulong>(r_Device.fileNames.size()),
+            static_cast<ulong>(r_Device.counts.size()),
+            static_cast<ulong>(r_Device.theBlocks.size()),
+            firstTime,
+            lastTime,
+            allLabels.c_str());
+    }
+}
+
+/// <summary>
+/// Displays how the query engine is used
+/// </summary>
+static void DisplayQueryUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -query <directory|pattern> [...] [-serial <serial>] [-device <text>]\n");
+    (void)printf("                  [-from <time>] [-to <time>] [-list | -bucket <minutes> | -above <count>]\n");
+    (void)printf("  A directory selects every *.%s file within it; comma-delimited files\n", DATA_OUTPUT_SERIES_FILE_NAME);
+    (void)printf("  and FLASH images may also be named. -device picks the devices whose serial\n");
+    (void)printf("  number starts with, or whose location label contains, the text given.\n");
+    (void)printf("  Times are \"19/Apr/23 02:00\" or \"2023-04-19 02:00\"; -to is not included.\n");
+    (void)printf("  With no -list, -bucket or -above every value in the range is listed.\n");
+}
+
+/// <summary>
+/// The entry point for the query engine. The arguments are the files to load followed
+/// by what to ask of them. Results are written as comma-delimited text.
+/// </summary>
+/// <param name="argc">The number of arguments following "-query"</param>
+/// <param name="argv">The arguments following "-query"</param>
+/// <returns>0 if the query was answered, otherwise 1</returns>
+int RunQueryEngine(int argc, char * argv[])
+{
+    QueryEngine    theEngine;
+    vector<string> inputFileNames;
+    string         defaultSerialNumber = ARCHIVE_UNKNOWN_SERIAL_NUMBER;
+    const char *   pch_Filter          = nullptr;
+    long long      fromEpoch           = QUERY_EARLIEST_EPOCH;
+    long long      toEpoch             = QUERY_LATEST_EPOCH;
+    long long      bucketSeconds       = 0;
+    ulong          thresholdCount      = static_cast<ulong>(0);
+    bool           wantList            = false;
+    bool           wantThreshold       = false;
+    ulong          failedCount         = static_cast<ulong>(0);
+    ulong          resultCount         = static_cast<ulong>(0);
+
+    for (int thisArgument = 0; thisArgument < argc; thisArgument++)
+    {
+        if (0 == strcmp(argv[thisArgument], "-serial") && thisArgument + 1 < argc)
+        {
+            defaultSerialNumber = argv[++thisArgument];
+        }
+        else if (0 == strcmp(argv[thisArgument], "-device") && thisArgument + 1 < argc)
+        {
+            pch_Filter = argv[++thisArgument];
+        }
+        else if ((0 == strcmp(argv[thisArgument], "-from") || 0 == strcmp(argv[thisArgument], "-to")) && thisArgument + 1 < argc)
+        {
+            long long & r_Epoch = (0 == strcmp(argv[thisArgument], "-from")) ? fromEpoch : toEpoch;
+
+            if (false == ParseQueryTime(argv[++thisArgument], r_Epoch))
+            {
+                DisplayQueryUsage();
+                (void)printf("The time \"%s\" was not understood\n", argv[thisArgument]);
+                return 1;
+            }
+        }
+        else if (0 == strcmp(argv[thisArgument], "-list"))
+        {
+            wantList = true;
+        }
+        else if (0 == strcmp(argv[thisArgument], "-bucket") && thisArgument + 1 < argc)
+        {
+            bucketSeconds = static_cast<long long>(strtoul(argv[++thisArgument], nullptr, 10)) * 60;
+        }
+        else if (0 == strcmp(argv[thisArgument], "-above") && thisArgument + 1 < argc)
+        {
+            thresholdCount = strtoul(argv[++thisArgument], nullptr, 10);
+            wantThreshold  = true;
+        }
+        else
+        {
+            CollectInputFileNames(argv[thisArgument], SERIES_INPUT_FILE_PATTERN, inputFileNames);
+        }
+    }
+
+    if (inputFileNames.empty())
+    {
+        DisplayQueryUsage();
+        (void)printf("There were no files found to query\n");
+        return 1;
+    }
+
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    for (size_t thisFile = 0; thisFile < inputFileNames.size(); thisFile++)
+    {
+        if (false == AddQueryFile(theEngine, inputFileNames[thisFile].c_str(), defaultSerialNumber.c_str()))
+        {
+            (void)fprintf(stderr, "FAILED  %s\n", inputFileNames[thisFile].c_str());
+            failedCount++;
+        }
+    }
+
+    BuildQueryIndex(theEngine);
+
+    chrono::steady_clock::time_point queryTime = chrono::steady_clock::now();
+
+    if (true == wantList)
+    {
+        ListQueryDevices(theEngine, pch_Filter);
+        return (failedCount == static_cast<ulong>(0)) ? 0 : 1;
+    }
+
+    if (bucketSeconds > 0)
+    {
+        (void)printf("Serial,Bucket,Samples,Low,High,Mean\n");
+    }
+    else
+    {
+        (void)printf("Serial,Date/Time,Counts\n");
+    }
+
+    for (size_t thisDevice = 0; thisDevice < theEngine.theDevices.size(); thisDevice++)
+    {
+        const QueryDevice & r_Device     = theEngine.theDevices[thisDevice];
+        char                theTime[31]  = { 0 };
+
+        if (false == IsQueryDeviceSelected(r_Device, pch_Filter))
+        {
+            continue;
+        }
+
+        if (bucketSeconds > 0)
+        {
+            vector<QueryBucket> theBuckets;
+
+            AggregateQueryRange(r_Device, fromEpoch, toEpoch, bucketSeconds, theBuckets);
+
+            for (size_t thisBucket = 0; thisBucket < theBuckets.size(); thisBucket++)
+            {
+                const QueryBucket & r_Bucket = theBuckets[thisBucket];
+
+                FormatQueryTime(r_Bucket.bucketEpoch, theTime, sizeof(theTime));
+
+                (void)printf("%s,%s,%lu,%lu,%lu,%.2f\n",
+                    r_Device.serialNumber.c_str(),
+                    theTime,
+                    r_Bucket.sampleCount,
+                    static_cast<ulong>(r_Bucket.lowestCount),
+                    static_cast<ulong>(r_Bucket.highestCount),
+                    static_cast<double>(r_Bucket.countTotal) / static_cast<double>(r_Bucket.sampleCount));
+            }
+
+            resultCount += static_cast<ulong>(theBuckets.size());
+            continue;
+        }
+
+        vector<ulong> theSamples;
+        ulong         firstSample = static_cast<ulong>(0);
+        ulong         sampleCount = static_cast<ulong>(0);
+
+        if (true == wantThreshold)
+        {
+            FindQueryThreshold(r_Device, fromEpoch, toEpoch, static_cast<uint32_t>(thresholdCount), theSamples);
+
+            sampleCount = static_cast<ulong>(theSamples.size());
+        }
+        else
+        {
+            FindQueryRange(r_Device, fromEpoch, toEpoch, firstSample, sampleCount);
+        }
+
+        for (ulong thisResult = 0; thisResult < sampleCount; thisResult++)
+        {
+            ulong thisSample = (true == wantThreshold) ? theSamples[thisResult] : firstSample + thisResult;
+
+            FormatQueryTime(r_Device.epochSeconds[thisSample], theTime, sizeof(theTime));
+
+            (void)printf("%s,%s,%lu\n", r_Device.serialNumber.c_str(), theTime, static_cast<ulong>(r_Device.counts[thisSample]));
+        }
+
+        resultCount += sampleCount;
+    }
+
+    chrono::steady_clock::time_point endTime = chrono::steady_clock::now();
+
+    // The timing goes to the error stream so that the results may be redirected to a file
+    (void)fprintf(stderr, "%lu results from %lu files, loaded in %.3f ms, answered in %.3f ms\n",
+        resultCount,
+        static_cast<ulong>(inputFileNames.size()) - failedCount,
+        chrono::duration<double>(queryTime - startTime).count() * 1000.0,
+        chrono::duration<double>(endTime - queryTime).count() * 1000.0);
+
+    return (failedCount == static_cast<ulong>(0)) ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+// ----------------------------------------------------------------------
+// QueryEngine.h
+//
+// Answers questions about a time range across many devices' decoded
+// history without going back to the FLASH images. Every file given is
+// filed under the device it came from, and each device's values from
+// all of its files are merged in to one timeline in time order with the
+// values that successive harvests have in common kept only once.
+//
+// The timeline is cut in to blocks of QUERY_BLOCK_SAMPLES values and
+// each block keeps its time range, lowest, highest and total value, so
+// that a query can skip or summarize a whole block without looking at
+// its values.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Portable.h"
+
+// The number of values summarized by each block of a device's timeline
+#define QUERY_BLOCK_SAMPLES     static_cast<ulong>(256)
+
+typedef struct query_block_t
+{
+    ulong              firstSample;         // The index of the block's first value in the timeline
+    ulong              sampleCount;         // The number of values in the block
+    long long          firstEpoch;          // When the block's first value was recorded
+    long long          lastEpoch;           // When the block's last value was recorded
+    uint32_t           lowestCount;         // The lowest value in the block
+    uint32_t           highestCount;        // The highest value in the block
+    unsigned long long countTotal;          // The sum of the values in the block
+} QueryBlock;
+
+typedef struct query_device_t
+{
+    std::string              serialNumber;  // The device's serial number, or what it was filed under
+    std::vector<std::string> labels;        // Every location label found in its files
+    std::vector<std::string> fileNames;     // The files its values came from
+    std::vector<long long>   epochSeconds;  // When each value was recorded, in time order
+    std::vector<uint32_t>    counts;        // The CPS/CPM/CPH values
+    std::vector<QueryBlock>  theBlocks;     // The summary of each block of the timeline
+} QueryDevice;
+
+typedef struct query_engine_t
+{
+    std::vector<QueryDevice> theDevices;    // Every device, in the order first seen
+} QueryEngine;
+
+typedef struct query_bucket_t
+{
+    long long          bucketEpoch;         // When the bucket starts
+    ulong              sampleCount;         // The number of values in the bucket
+    uint32_t           lowestCount;         // The lowest value in the bucket
+    uint32_t           highestCount;        // The highest value in the bucket
+    unsigned long long countTotal;          // The sum of the values in the bucket
+} QueryBucket;
+
+extern bool AddQueryFile(QueryEngine & r_Engine, const char * pch_FileName, const char * pch_DefaultSerialNumber);
+extern void BuildQueryIndex(QueryEngine & r_Engine);
+
+extern bool IsQueryDeviceSelected(const QueryDevice & r_Device, const char * pch_Filter);
+extern void FindQueryRange(const QueryDevice & r_Device,
+    long long fromEpoch,
+    long long toEpoch,
+    ulong & r_FirstSample,
+    ulong & r_SampleCount);
+extern void AggregateQueryRange(const QueryDevice & r_Device,
+    long long fromEpoch,
+    long long toEpoch,
+    long long bucketSeconds,
+    std::vector<QueryBucket> & r_Buckets);
+extern void FindQueryThreshold(const QueryDevice & r_Device,
+    long long fromEpoch,
+    long long toEpoch,
+    uint32_t thresholdCount,
+    std::vector<ulong> & r_Samples);
+
+extern bool ParseQueryTime(const char * pch_Text, long long & r_Epoch);
+extern void FormatQueryTime(long long epochSeconds, char * pch_Buffer, size_t bufferSize);
+
+extern int RunQueryEngine(int argc, char * argv[]);
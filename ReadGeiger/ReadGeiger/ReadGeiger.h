@@ -97,10 +97,28 @@
 #define DATA_OUTPUT_FILE_NAME           "ReadGeiger.bin"
 #define DATA_OUTPUT_ASCII_FILE_NAME     "ReadGeiger.txt"
 #define DATA_OUTPUT_CSV_FILE_NAME       "ReadReiger.csv"
+#define DATA_OUTPUT_SERIES_FILE_NAME    "ReadGeiger.series"
+#define DATA_OUTPUT_EVENT_FILE_NAME     "ReadGeiger.event.csv"
+#define DATA_OUTPUT_EVENT_INDEX_NAME    "ReadGeiger.events.csv"
+#define DATA_OUTPUT_STATS_FILE_NAME     "ReadGeiger.stats"
+#define DATA_OUTPUT_LIVE_FILE_NAME      "ReadGeiger.live.csv"
+#define DATA_OUTPUT_POLL_FILE_NAME      "ReadGeiger.poll.csv"
+#define DATA_OUTPUT_BENCH_FILE_NAME     "ReadGeiger.bench.json"
 #define MAX_COMMAND_RETRIES             static_cast<int>(3)
 #define MAX_FLASH_MEMORY                0xFFFF
-#define MAX_DATA_READ_BLOCK_SIZE        2048
+#define FLASH_IMAGE_SIZE                (MAX_FLASH_MEMORY + 1)  // Every address up to MAX_FLASH_MEMORY
+#define MAX_DATA_READ_BLOCK_SIZE        4096
+#define MIN_DATA_READ_BLOCK_SIZE        256
+#define BLOCK_ATTEMPTS_BEFORE_SPLITTING static_cast<ulong>(2)
+#define BLOCK_ATTEMPTS_AT_MINIMUM       static_cast<ulong>(8)
+#define BLOCK_GROWTH_AFTER_SUCCESSES    static_cast<ulong>(8)
 #define NO_RESPONSE_EXPECTED            static_cast<DWORD>(0)
+#define RESPONSE_LENGTH_IN_COMMAND      static_cast<ulong>(0xFFFFFFFF)
+#define RESPONSE_TURNAROUND_MILLISECONDS static_cast<ulong>(250)
+#define LINE_IDLE_CHARACTER_TIMES       static_cast<ulong>(4)
+#define LINE_IDLE_MAXIMUM_PERIODS       static_cast<ulong>(100)
+#define HEARTBEAT_QUIET_MILLISECONDS    static_cast<ulong>(1200)
+#define HEARTBEAT_QUIET_PERIODS         static_cast<ulong>(3)
 
 // ----------------------------------------------------------------------
 // The Geiger Counter's commands
@@ -161,6 +179,8 @@ static const uchar MenuItemSetDateAndTime       = static_cast<uchar>('3');
 static const uchar MenuItemTurnPowerOn          = static_cast<uchar>('4');
 static const uchar MenuItemTurnPowerOff         = static_cast<uchar>('5');
 static const uchar MenuItemDisplayConfiguration = static_cast<uchar>('6');
+static const uchar MenuItemDisplayLatency       = static_cast<uchar>('7');
+static const uchar MenuItemWatchHeartbeat       = static_cast<uchar>('8');
 static const uchar MenuItemEraseRawData         = static_cast<uchar>('E');
 static const uchar MenuItemFactoryReset         = static_cast<uchar>('F');
 static const uchar MenuItemExitTheProgram       = static_cast<uchar>('X');
@@ -0,0 +1,303 @@
+// ----------------------------------------------------------------------
+// SampleStore.cpp
+//
+// Filling and examining the columnar store of CPS/CPM/CPH values. The
+// kernels at the bottom are written as simple loops over contiguous
+// arrays with no branches on the data that the compiler cannot turn in
+// to compare-and-select, so they vectorize.
+//
+// ----------------------------------------------------------------------
+
+#include "SampleStore.h"
+
+using namespace std;
+
+/// <summary>
+/// Converts a calendar date and time to seconds since midnight January 1st 1970 UTC.
+/// The number of days is computed by counting March-based years so that the leap day
+/// falls at the end of the year; no tables or loops are needed.
+/// </summary>
+/// <param name="theYear">The full year, such as 2023</param>
+/// <param name="theMonth">The month, 1 through 12</param>
+/// <param name="theDay">The day of the month, 1 through 31</param>
+/// <param name="theHour">The hour, 0 through 23</param>
+/// <param name="theMinute">The minute, 0 through 59</param>
+/// <param name="theSecond">The second, 0 through 59</param>
+/// <returns>The number of seconds since 1970</returns>
+long long EpochFromCivil(ulong theYear, ulong theMonth, ulong theDay,
+    ulong theHour, ulong theMinute, ulong theSecond)
+{
+    long long marchYear   = static_cast<long long>(theYear) - ((theMonth <= 2) ? 1 : 0);
+    long long theEra      = (marchYear >= 0 ? marchYear : marchYear - 399) / 400;
+    long long yearOfEra   = marchYear - (theEra * 400);
+    long long marchMonth  = (theMonth > 2) ? static_cast<long long>(theMonth) - 3 : static_cast<long long>(theMonth) + 9;
+    long long dayOfYear   = ((153 * marchMonth) + 2) / 5 + static_cast<long long>(theDay) - 1;
+    long long dayOfEra    = (yearOfEra * 365) + (yearOfEra / 4) - (yearOfEra / 100) + dayOfYear;
+    long long daysSince70 = (theEra * 146097) + dayOfEra - 719468;
+
+    return (daysSince70 * 86400) + (theHour * 3600) + (theMinute * 60) + theSecond;
+}
+
+/// <summary>
+/// Converts seconds since midnight January 1st 1970 UTC back to a calendar date and
+/// time, the reverse of EpochFromCivil()
+/// </summary>
+/// <param name="epochSeconds">The number of seconds since 1970</param>
+/// <param name="r_Year">Returns the full year</param>
+/// <param name="r_Month">Returns the month, 1 through 12</param>
+/// <param name="r_Day">Returns the day of the month, 1 through 31</param>
+/// <param name="r_Hour">Returns the hour, 0 through 23</param>
+/// <param name="r_Minute">Returns the minute, 0 through 59</param>
+/// <param name="r_Second">Returns the second, 0 through 59</param>
+void CivilFromEpoch(long long epochSeconds, ulong & r_Year, ulong & r_Month, ulong & r_Day,
+    ulong & r_Hour, ulong & r_Minute, ulong & r_Second)
+{
+    long long daysSince70  = (epochSeconds >= 0 ? epochSeconds : epochSeconds - 86399) / 86400;
+    long long secondOfDay  = epochSeconds - (daysSince70 * 86400);
+    long long dayOfEra     = daysSince70 + 719468;
+    long long theEra       = (dayOfEra >= 0 ? dayOfEra : dayOfEra - 146096) / 146097;
+    dayOfEra              -= theEra * 146097;
+    long long yearOfEra    = (dayOfEra - (dayOfEra / 1460) + (dayOfEra / 36524) - (dayOfEra / 146096)) / 365;
+    long long dayOfYear    = dayOfEra - ((yearOfEra * 365) + (yearOfEra / 4) - (yearOfEra / 100));
+    long long marchMonth   = ((5 * dayOfYear) + 2) / 153;
+
+    r_Day    = static_cast<ulong>(dayOfYear - (((153 * marchMonth) + 2) / 5) + 1);
+    r_Month  = static_cast<ulong>((marchMonth < 10) ? marchMonth + 3 : marchMonth - 9);
+    r_Year   = static_cast<ulong>(yearOfEra + (theEra * 400) + ((r_Month <= 2) ? 1 : 0));
+    r_Hour   = static_cast<ulong>(secondOfDay / 3600);
+    r_Minute = static_cast<ulong>((secondOfDay / 60) % 60);
+    r_Second = static_cast<ulong>(secondOfDay % 60);
+}
+
+/// <summary>
+/// The seconds between the values which follow a date/time stamp frame, from the frame's
+/// record rate. A record rate which is off or unknown is taken to be a minute, which is
+/// how the values have always been reported.
+/// </summary>
+/// <param name="recordRate">0 = off, 1 = CPS, 2 = CPM, 3 = CPM once per hour</param>
+/// <returns>1, 60 or 3600</returns>
+long long GetRecordRateSeconds(uchar recordRate)
+{
+    switch (recordRate)
+    {
+        case 1:  return 1;
+        case 3:  return 3600;
+        default: return 60;
+    }
+}
+
+/// <summary>
+/// Empties the store and reserves room for the largest number of values that the
+/// image could hold, which is one value per octet, so that no column gets moved
+/// while the image is decoded.
+/// </summary>
+/// <param name="r_Store">The store to empty</param>
+/// <param name="imageSize">The number of octets in the FLASH history image</param>
+void ResetSampleStore(SampleStore & r_Store, ulong imageSize)
+{
+    r_Store.epochSeconds.clear();
+    r_Store.counts.clear();
+    r_Store.segments.clear();
+    r_Store.labels.clear();
+
+    r_Store.epochSeconds.reserve(imageSize);
+    r_Store.counts.reserve(imageSize);
+}
+
+/// <summary>
+/// Starts a new segment at a date/time stamp frame. A segment which never received a
+/// value is re-used rather than being left in the table. The location label carries
+/// over from the segment before.
+/// </summary>
+/// <param name="r_Store">The store being filled</param>
+/// <param name="startEpoch">The date/time stamp in seconds since 1970</param>
+/// <param name="recordRate">The record rate which followed the date/time stamp</param>
+void StartSampleSegment(SampleStore & r_Store, long long startEpoch, uchar recordRate)
+{
+    ulong labelIndex = SAMPLE_STORE_NO_LABEL;
+
+    if (false == r_Store.segments.empty())
+    {
+        labelIndex = r_Store.segments.back().labelIndex;
+
+        if (r_Store.segments.back().sampleCount == static_cast<ulong>(0))
+        {
+            r_Store.segments.pop_back();
+        }
+    }
+
+    SampleSegment theSegment;
+
+    theSegment.firstSample = static_cast<ulong>(r_Store.counts.size());
+    theSegment.sampleCount = static_cast<ulong>(0);
+    theSegment.startEpoch  = startEpoch;
+    theSegment.recordRate  = recordRate;
+    theSegment.labelIndex  = labelIndex;
+
+    r_Store.segments.push_back(theSegment);
+}
+
+/// <summary>
+/// Assigns a location label to the current segment and the segments which follow it.
+/// Each distinct label is kept in the label table only once.
+/// </summary>
+/// <param name="r_Store">The store being filled</param>
+/// <param name="pch_Label">The NULL-terminated location string</param>
+void SetSampleSegmentLabel(SampleStore & r_Store, const char * pch_Label)
+{
+    ulong labelIndex = static_cast<ulong>(0);
+
+    // Devices usually carry the same label for years so look for it first
+    while (labelIndex < r_Store.labels.size() && r_Store.labels[labelIndex] != pch_Label)
+    {
+        labelIndex++;
+    }
+
+    if (labelIndex == r_Store.labels.size())
+    {
+        r_Store.labels.push_back(pch_Label);
+    }
+
+    // Values which come before any date/time stamp still need a segment
+    if (true == r_Store.segments.empty())
+    {
+        StartSampleSegment(r_Store, 0, 0);
+    }
+
+    r_Store.segments.back().labelIndex = labelIndex;
+}
+
+/// <summary>
+/// Appends one value and its timestamp to the end of the columns
+/// </summary>
+/// <param name="r_Store">The store being filled</param>
+/// <param name="epochSeconds">When the value was recorded, in seconds since 1970</param>
+/// <param name="countValue">The CPS/CPM/CPH value</param>
+void AppendSample(SampleStore & r_Store, long long epochSeconds, uint32_t countValue)
+{
+    if (true == r_Store.segments.empty())
+    {
+        StartSampleSegment(r_Store, 0, 0);
+    }
+
+    r_Store.epochSeconds.push_back(epochSeconds);
+    r_Store.counts.push_back(countValue);
+
+    r_Store.segments.back().sampleCount++;
+}
+
+/// <summary>
+/// Returns a span over every value in the store
+/// </summary>
+CountSpan GetCountSpan(const SampleStore & r_Store)
+{
+    return GetCountSpan(r_Store, static_cast<ulong>(0), static_cast<ulong>(r_Store.counts.size()));
+}
+
+/// <summary>
+/// Returns a span over part of the values in the store. The span gets clipped to the
+/// values which are actually there.
+/// </summary>
+/// <param name="r_Store">The store to look at</param>
+/// <param name="firstSample">The index of the first value</param>
+/// <param name="sampleCount">The number of values wanted</param>
+CountSpan GetCountSpan(const SampleStore & r_Store, ulong firstSample, ulong sampleCount)
+{
+    CountSpan theSpan;
+    ulong     storeSize = static_cast<ulong>(r_Store.counts.size());
+
+    if (firstSample >= storeSize)
+    {
+        theSpan.pCounts = nullptr;
+        theSpan.length  = static_cast<ulong>(0);
+    }
+    else
+    {
+        theSpan.pCounts = r_Store.counts.data() + firstSample;
+        theSpan.length  = (sampleCount > storeSize - firstSample) ? storeSize - firstSample : sampleCount;
+    }
+
+    return theSpan;
+}
+
+/// <summary>
+/// Returns the sum of the values in the span
+/// </summary>
+unsigned long long SumCountSpan(CountSpan theSpan)
+{
+    unsigned long long theSum = 0;
+
+    for (ulong thisValue = 0; thisValue < theSpan.length; thisValue++)
+    {
+        theSum += theSpan.pCounts[thisValue];
+    }
+
+    return theSum;
+}
+
+/// <summary>
+/// Returns the lowest value in the span, or 0 for an empty span
+/// </summary>
+uint32_t MinimumOfCountSpan(CountSpan theSpan)
+{
+    uint32_t theMinimum = (theSpan.length > static_cast<ulong>(0)) ? 0xFFFFFFFF : 0;
+
+    for (ulong thisValue = 0; thisValue < theSpan.length; thisValue++)
+    {
+        theMinimum = (theSpan.pCounts[thisValue] < theMinimum) ? theSpan.pCounts[thisValue] : theMinimum;
+    }
+
+    return theMinimum;
+}
+
+/// <summary>
+/// Returns the highest value in the span, or 0 for an empty span
+/// </summary>
+uint32_t MaximumOfCountSpan(CountSpan theSpan)
+{
+    uint32_t theMaximum = 0;
+
+    for (ulong thisValue = 0; thisValue < theSpan.length; thisValue++)
+    {
+        theMaximum = (theSpan.pCounts[thisValue] > theMaximum) ? theSpan.pCounts[thisValue] : theMaximum;
+    }
+
+    return theMaximum;
+}
+
+/// <summary>
+/// Builds the running totals of the values in the span, so that the sum of any range
+/// of them is then a single subtraction however long the range is. The first total is
+/// 0 and there is one more total than there are values.
+/// </summary>
+/// <param name="theSpan">The values to total</param>
+/// <param name="r_PrefixSums">Returns the sum of the values before each index</param>
+void BuildCountPrefixSums(CountSpan theSpan, vector<unsigned long long> & r_PrefixSums)
+{
+    unsigned long long runningSum = 0;
+
+    r_PrefixSums.resize(static_cast<size_t>(theSpan.length) + 1);
+
+    r_PrefixSums[0] = 0;
+
+    for (ulong thisValue = 0; thisValue < theSpan.length; thisValue++)
+    {
+        runningSum += theSpan.pCounts[thisValue];
+
+        r_PrefixSums[static_cast<size_t>(thisValue) + 1] = runningSum;
+    }
+}
+
+/// <summary>
+/// Sums a range of the values from their running totals
+/// </summary>
+/// <param name="r_PrefixSums">Built by BuildCountPrefixSums()</param>
+/// <param name="firstSample">The index of the first value in the range</param>
+/// <param name="sampleCount">The number of values in the range</param>
+/// <returns>The sum of the values in the range</returns>
+unsigned long long SumCountPrefixRange(const vector<unsigned long long> & r_PrefixSums,
+    ulong firstSample,
+    ulong sampleCount)
+{
+    return r_PrefixSums[static_cast<size_t>(firstSample) + sampleCount] - r_PrefixSums[firstSample];
+}
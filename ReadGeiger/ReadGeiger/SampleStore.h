@@ -0,0 +1,66 @@
+// ----------------------------------------------------------------------
+// SampleStore.h
+//
+// The CPS/CPM/CPH values of a FLASH history image held as columns: one
+// contiguous array of epoch timestamps, one contiguous array of 32-bit
+// counts, and a table of segments (one per date/time stamp frame) which
+// says where each segment starts, when, and under which location label.
+//
+// The analysis functions take a CountSpan, a pointer and a length in to
+// the count column, so that the loops are over plain arrays.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Portable.h"
+
+#define SAMPLE_STORE_NO_LABEL   static_cast<ulong>(0xFFFFFFFF)
+
+typedef struct sample_segment_t
+{
+    ulong     firstSample;      // The index of the segment's first value in the columns
+    ulong     sampleCount;      // The number of values in the segment
+    long long startEpoch;       // The date/time stamp of the segment in seconds since 1970
+    uchar     recordRate;       // 0 = off, 1 = CPS, 2 = CPM, 3 = CPM once per hour
+    ulong     labelIndex;       // Index in to the label table, or SAMPLE_STORE_NO_LABEL
+} SampleSegment;
+
+typedef struct sample_store_t
+{
+    std::vector<long long>     epochSeconds;    // When each value was recorded, seconds since 1970
+    std::vector<uint32_t>      counts;          // The CPS/CPM/CPH values
+    std::vector<SampleSegment> segments;        // The date/time stamped sections of the values
+    std::vector<std::string>   labels;          // The location strings, each stored once
+} SampleStore;
+
+typedef struct count_span_t
+{
+    const uint32_t * pCounts;   // The first value of the span
+    ulong            length;    // The number of values in the span
+} CountSpan;
+
+extern long long EpochFromCivil(ulong theYear, ulong theMonth, ulong theDay,
+    ulong theHour, ulong theMinute, ulong theSecond);
+extern void CivilFromEpoch(long long epochSeconds, ulong & r_Year, ulong & r_Month, ulong & r_Day,
+    ulong & r_Hour, ulong & r_Minute, ulong & r_Second);
+extern long long GetRecordRateSeconds(uchar recordRate);
+
+extern void ResetSampleStore(SampleStore & r_Store, ulong imageSize);
+extern void StartSampleSegment(SampleStore & r_Store, long long startEpoch, uchar recordRate);
+extern void SetSampleSegmentLabel(SampleStore & r_Store, const char * pch_Label);
+extern void AppendSample(SampleStore & r_Store, long long epochSeconds, uint32_t countValue);
+
+extern CountSpan GetCountSpan(const SampleStore & r_Store);
+extern CountSpan GetCountSpan(const SampleStore & r_Store, ulong firstSample, ulong sampleCount);
+
+extern unsigned long long SumCountSpan(CountSpan theSpan);
+extern uint32_t MinimumOfCountSpan(CountSpan theSpan);
+extern uint32_t MaximumOfCountSpan(CountSpan theSpan);
+extern void BuildCountPrefixSums(CountSpan theSpan, std::vector<unsigned long long> & r_PrefixSums);
+extern unsigned long long SumCountPrefixRange(const std::vector<unsigned long long> & r_PrefixSums,
+    ulong firstSample,
+    ulong sampleCount);
@@ -0,0 +1,395 @@
+// ----------------------------------------------------------------------
+// SerialTransport.cpp
+//
+// The Win32 and termios implementations of the serial interface. Both
+// read with a single deadline for the whole response so that a receive
+// returns as soon as the expected number of octets has arrived.
+//
+// A POSIX connection may also be a pseudo-terminal or a socket, as used
+// for testing, in which case the line settings are simply skipped.
+//
+// ----------------------------------------------------------------------
+
+#include "SerialTransport.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+/// <summary>
+/// Converts a baud rate in to the termios speed constant, defaulting to 57600 which
+/// is what the GQ GMC devices use
+/// </summary>
+static speed_t GetTermiosSpeed(ulong baudRate)
+{
+    switch (baudRate)
+    {
+        case 1200:   return B1200;
+        case 2400:   return B2400;
+        case 4800:   return B4800;
+        case 9600:   return B9600;
+        case 19200:  return B19200;
+        case 38400:  return B38400;
+        case 115200: return B115200;
+        default:     return B57600;
+    }
+}
+
+/// <summary>
+/// Returns a monotonic clock reading in milliseconds for working out deadlines
+/// </summary>
+static long long GetMonotonicMilliseconds(void)
+{
+    struct timespec theTime;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &theTime);
+
+    return (static_cast<long long>(theTime.tv_sec) * 1000) + (theTime.tv_nsec / 1000000);
+}
+#endif
+
+/// <summary>
+/// Opens the serial port passed by argument and configures it for 8 data bits, no
+/// parity and one stop bit at the baud rate passed by argument
+/// </summary>
+/// <param name="pch_PortName">"COM3" on Windows, "/dev/ttyUSB0" and the like elsewhere</param>
+/// <param name="baudRate">The bits per second, 57600 for the GQ GMC devices</param>
+/// <param name="r_Connection">Returns the open connection</param>
+/// <returns>true if the port was opened and configured, otherwise false</returns>
+bool OpenSerialConnection(const char * pch_PortName, ulong baudRate, SerialConnection & r_Connection)
+{
+    (void)strcpy_s(r_Connection.portName, sizeof(r_Connection.portName), pch_PortName);
+
+    r_Connection.baudRate = baudRate;
+    r_Connection.isOpen   = false;
+
+#ifdef _WIN32
+    char         devicePath[121] = { 0 };
+    DCB          dcbSerialParams{};
+    COMMTIMEOUTS timeouts        = { 0 };
+
+    // Build a COM port name to open
+    (void)sprintf_s(devicePath, "\\\\.\\%s", pch_PortName);
+
+    r_Connection.hComm = CreateFile(devicePath, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+
+    if (INVALID_HANDLE_VALUE == r_Connection.hComm)
+    {
+        return false;
+    }
+
+    // Set the line configuration
+    dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
+
+    if (FALSE == GetCommState(r_Connection.hComm, &dcbSerialParams))
+    {
+        CloseHandle(r_Connection.hComm);
+        return false;
+    }
+
+    dcbSerialParams.BaudRate = static_cast<DWORD>(baudRate);
+    dcbSerialParams.ByteSize = static_cast<BYTE>(8);
+    dcbSerialParams.StopBits = ONESTOPBIT;
+    dcbSerialParams.Parity   = NOPARITY;
+
+    if (FALSE == SetCommState(r_Connection.hComm, &dcbSerialParams))
+    {
+        CloseHandle(r_Connection.hComm);
+        return false;
+    }
+
+    // The read time-outs get set for each receive
+    timeouts.ReadIntervalTimeout         = static_cast<DWORD>(50);
+    timeouts.ReadTotalTimeoutConstant    = static_cast<DWORD>(50);
+    timeouts.ReadTotalTimeoutMultiplier  = static_cast<DWORD>(2);
+    timeouts.WriteTotalTimeoutConstant   = static_cast<DWORD>(50);
+    timeouts.WriteTotalTimeoutMultiplier = static_cast<DWORD>(2);
+
+    if (FALSE == SetCommTimeouts(r_Connection.hComm, &timeouts))
+    {
+        CloseHandle(r_Connection.hComm);
+        return false;
+    }
+#else
+    struct termios lineSettings;
+
+    r_Connection.fileDescriptor = open(pch_PortName, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (r_Connection.fileDescriptor < 0)
+    {
+        return false;
+    }
+
+    r_Connection.isTerminal = (0 != isatty(r_Connection.fileDescriptor));
+
+    // Only a tty has line settings
+    if (true == r_Connection.isTerminal)
+    {
+        if (0 != tcgetattr(r_Connection.fileDescriptor, &lineSettings))
+        {
+            (void)close(r_Connection.fileDescriptor);
+            return false;
+        }
+
+        // Raw octets, 8N1, no flow control, ignore the modem control lines
+        cfmakeraw(&lineSettings);
+
+        lineSettings.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+        lineSettings.c_cflag |= (CS8 | CLOCAL | CREAD);
+        lineSettings.c_cc[VMIN]  = 0;
+        lineSettings.c_cc[VTIME] = 0;
+
+        (void)cfsetispeed(&lineSettings, GetTermiosSpeed(baudRate));
+        (void)cfsetospeed(&lineSettings, GetTermiosSpeed(baudRate));
+
+        if (0 != tcsetattr(r_Connection.fileDescriptor, TCSANOW, &lineSettings))
+        {
+            (void)close(r_Connection.fileDescriptor);
+            return false;
+        }
+    }
+#endif
+
+    r_Connection.isOpen = true;
+
+    return true;
+}
+
+#ifndef _WIN32
+/// <summary>
+/// Makes a connection out of a descriptor which is already open, such as one end of
+/// a socket pair connected to the device emulator. The connection takes ownership of
+/// the descriptor and closes it when the connection is closed.
+/// </summary>
+/// <param name="fileDescriptor">The open descriptor</param>
+/// <param name="pch_Name">What to call the connection in messages</param>
+/// <param name="r_Connection">Returns the connection</param>
+/// <returns>true if the descriptor could be made non-blocking, otherwise false</returns>
+bool AttachSerialConnection(int fileDescriptor, const char * pch_Name, SerialConnection & r_Connection)
+{
+    (void)strcpy_s(r_Connection.portName, sizeof(r_Connection.portName), pch_Name);
+
+    r_Connection.baudRate       = static_cast<ulong>(57600);
+    r_Connection.fileDescriptor = fileDescriptor;
+    r_Connection.isTerminal     = (0 != isatty(fileDescriptor));
+    r_Connection.isOpen         = false;
+
+    int theFlags = fcntl(fileDescriptor, F_GETFL, 0);
+
+    if (theFlags < 0 || 0 != fcntl(fileDescriptor, F_SETFL, theFlags | O_NONBLOCK))
+    {
+        return false;
+    }
+
+    r_Connection.isOpen = true;
+
+    return true;
+}
+#endif
+
+/// <summary>
+/// Closes the connection if it is open
+/// </summary>
+void CloseSerialConnection(SerialConnection & r_Connection)
+{
+    if (true == r_Connection.isOpen)
+    {
+#ifdef _WIN32
+        CloseHandle(r_Connection.hComm);
+#else
+        (void)close(r_Connection.fileDescriptor);
+#endif
+        r_Connection.isOpen = false;
+    }
+}
+
+/// <summary>
+/// Sends data to the device, waiting until all of it has been handed to the port
+/// </summary>
+/// <param name="r_Connection">The open connection</param>
+/// <param name="pch_Data">The octets to send</param>
+/// <param name="dataLength">The number of octets to send</param>
+/// <returns>true if everything was sent, otherwise false</returns>
+bool SendSerialData(SerialConnection & r_Connection, const char * pch_Data, ulong dataLength)
+{
+#ifdef _WIN32
+    DWORD byteCountWritten = static_cast<DWORD>(0);
+
+    if (! WriteFile(r_Connection.hComm, pch_Data, static_cast<DWORD>(dataLength), &byteCountWritten, NULL))
+    {
+        return false;
+    }
+
+    return (byteCountWritten == static_cast<DWORD>(dataLength));
+#else
+    ulong sentLength = static_cast<ulong>(0);
+
+    while (sentLength < dataLength)
+    {
+        ssize_t writeResult = write(r_Connection.fileDescriptor, pch_Data + sentLength, dataLength - sentLength);
+
+        if (writeResult > 0)
+        {
+            sentLength += static_cast<ulong>(writeResult);
+        }
+        else if (writeResult < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+        {
+            struct pollfd pollDescriptor = { r_Connection.fileDescriptor, POLLOUT, 0 };
+
+            // The output queue is full so wait for room, but not forever
+            if (poll(&pollDescriptor, 1, 1000) <= 0)
+            {
+                return false;
+            }
+        }
+        else if (writeResult < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+#endif
+}
+
+/// <summary>
+/// Receives up to the number of octets passed by argument, returning the moment they
+/// have all arrived or when the time allowed for them runs out, whichever is first
+/// </summary>
+/// <param name="r_Connection">The open connection</param>
+/// <param name="pch_Buffer">Returns the received octets</param>
+/// <param name="expectedLength">The number of octets expected, no more than the buffer holds</param>
+/// <param name="timeoutMilliseconds">How long to wait for all of them</param>
+/// <returns>The number of octets received, or 0 if nothing was received</returns>
+ulong ReceiveSerialData(SerialConnection & r_Connection, char * pch_Buffer, ulong expectedLength, ulong timeoutMilliseconds)
+{
+    ulong receivedLength = static_cast<ulong>(0);
+
+#ifdef _WIN32
+    DWORD        resultByteCount = static_cast<DWORD>(0);
+    COMMTIMEOUTS timeouts        = { 0 };
+
+    // A total time-out only, so the read completes the moment the last octet arrives
+    timeouts.ReadIntervalTimeout         = static_cast<DWORD>(0);
+    timeouts.ReadTotalTimeoutMultiplier  = static_cast<DWORD>(0);
+    timeouts.ReadTotalTimeoutConstant    = static_cast<DWORD>(timeoutMilliseconds);
+    timeouts.WriteTotalTimeoutConstant   = static_cast<DWORD>(50);
+    timeouts.WriteTotalTimeoutMultiplier = static_cast<DWORD>(2);
+
+    (void)SetCommTimeouts(r_Connection.hComm, &timeouts);
+
+    while (receivedLength < expectedLength)
+    {
+        if (! ReadFile(r_Connection.hComm, &pch_Buffer[receivedLength],
+            static_cast<DWORD>(expectedLength - receivedLength), &resultByteCount, NULL))
+        {
+            // That failed so make sure that the returning byte count indicates no response
+            return static_cast<ulong>(0);
+        }
+
+        if (resultByteCount == static_cast<DWORD>(0))
+        {
+            // It timed out so there are no more bytes
+            break;
+        }
+
+        receivedLength += static_cast<ulong>(resultByteCount);
+    }
+#else
+    long long deadline = GetMonotonicMilliseconds() + static_cast<long long>(timeoutMilliseconds);
+
+    while (receivedLength < expectedLength)
+    {
+        ssize_t readResult = read(r_Connection.fileDescriptor, &pch_Buffer[receivedLength], expectedLength - receivedLength);
+
+        if (readResult > 0)
+        {
+            receivedLength += static_cast<ulong>(readResult);
+            continue;
+        }
+
+        if (readResult == 0 && false == r_Connection.isTerminal)
+        {
+            // The other end of the socket went away
+            break;
+        }
+
+        if (readResult < 0 && EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno)
+        {
+            // The read failed
+            break;
+        }
+
+        long long remainingTime = deadline - GetMonotonicMilliseconds();
+
+        if (remainingTime <= 0)
+        {
+            break;
+        }
+
+        // Sleep until more octets arrive or the time allowed runs out
+        struct pollfd pollDescriptor = { r_Connection.fileDescriptor, POLLIN, 0 };
+
+        (void)poll(&pollDescriptor, 1, static_cast<int>(remainingTime));
+    }
+#endif
+
+    return receivedLength;
+}
+
+/// <summary>
+/// Throws away anything that the device sent which nobody read
+/// </summary>
+void DiscardSerialInput(SerialConnection & r_Connection)
+{
+#ifdef _WIN32
+    (void)PurgeComm(r_Connection.hComm, PURGE_RXCLEAR);
+#else
+    char discardBuffer[256];
+
+    if (true == r_Connection.isTerminal)
+    {
+        (void)tcflush(r_Connection.fileDescriptor, TCIFLUSH);
+    }
+
+    // A pseudo-terminal or socket has no flush so read until there is nothing left
+    while (read(r_Connection.fileDescriptor, discardBuffer, sizeof(discardBuffer)) > 0)
+    {
+    }
+#endif
+}
+
+/// <summary>
+/// Waits for the device to stop sending. The line is idle once nothing at all has
+/// arrived for the quiet time passed by argument, which the caller bases on a few
+/// character times at the connection's baud rate. Anything that does arrive is
+/// thrown away.
+/// </summary>
+/// <param name="r_Connection">The open connection</param>
+/// <param name="quietMilliseconds">How long nothing must arrive for</param>
+/// <param name="maximumQuietPeriods">How many quiet times to try before giving up</param>
+/// <returns>true if the line went idle, false if the device kept on sending</returns>
+bool WaitForSerialLineIdle(SerialConnection & r_Connection, ulong quietMilliseconds, ulong maximumQuietPeriods)
+{
+    char discardBuffer[256];
+
+    for (ulong thisPeriod = static_cast<ulong>(0); thisPeriod < maximumQuietPeriods; thisPeriod++)
+    {
+        if (static_cast<ulong>(0) == ReceiveSerialData(r_Connection, discardBuffer, sizeof(discardBuffer), quietMilliseconds))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,39 @@
+// ----------------------------------------------------------------------
+// SerialTransport.h
+//
+// The serial interface to a Geiger Counter. Windows talks to a COM port
+// through the Win32 communications functions, everything else talks to
+// a tty device through termios, non-blocking reads and poll(). Each
+// connection carries its own handle so that many devices may be talked
+// to at the same time.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include "Portable.h"
+
+typedef struct serial_connection_t
+{
+    char   portName[101];           // The port as the operator named it, "COM3" or "/dev/ttyUSB0"
+    ulong  baudRate;                // The bits per second the port was configured for
+    bool   isOpen;                  // true between opening and closing the connection
+#ifdef _WIN32
+    HANDLE hComm;                   // The communications handle
+#else
+    int    fileDescriptor;          // The tty, pseudo-terminal or socket
+    bool   isTerminal;              // true for a tty or pseudo-terminal, false for a socket
+#endif
+} SerialConnection;
+
+extern bool OpenSerialConnection(const char * pch_PortName, ulong baudRate, SerialConnection & r_Connection);
+extern void CloseSerialConnection(SerialConnection & r_Connection);
+
+#ifndef _WIN32
+extern bool AttachSerialConnection(int fileDescriptor, const char * pch_Name, SerialConnection & r_Connection);
+#endif
+
+extern bool SendSerialData(SerialConnection & r_Connection, const char * pch_Data, ulong dataLength);
+extern ulong ReceiveSerialData(SerialConnection & r_Connection, char * pch_Buffer, ulong expectedLength, ulong timeoutMilliseconds);
+extern void DiscardSerialInput(SerialConnection & r_Connection);
+extern bool WaitForSerialLineIdle(SerialConnection & r_Connection, ulong quietMilliseconds, ulong maximumQuietPeriods);
@@ -0,0 +1,854 @@
+// ----------------------------------------------------------------------
+// SeriesFile.cpp
+//
+// Writing, mapping and decoding of the binary series file described in
+// SeriesFile.h, and the conversion of comma-delimited files and FLASH
+// images in to it.
+//
+// Within a segment the values are packed least significant bit first
+// with each segment's values starting on an octet boundary. The count
+// column ends with 8 octets of 0 so that a value can always be picked
+// up with a single unaligned 8 octet load.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "SeriesFile.h"
+#include "BatchDecode.h"
+#include "DownloadJournal.h"
+#include "FlashExport.h"
+#include "ReadGeiger.h"
+
+using namespace std;
+
+// The padding which follows the count column
+#define SERIES_COUNT_PADDING    static_cast<size_t>(8)
+
+static_assert(sizeof(SeriesFileHeader) == 72, "The series file header must not be padded");
+static_assert(sizeof(SeriesSegment)    == 48, "The series segment must not be padded");
+static_assert(sizeof(SeriesFileFooter) == 80, "The series file footer must not be padded");
+
+/// <summary>
+/// Appends octets of 0 until the file is a multiple of 8 octets long
+/// </summary>
+static void AlignSeriesSection(vector<uchar> & r_File)
+{
+    while ((r_File.size() % 8) != 0)
+    {
+        r_File.push_back(0);
+    }
+}
+
+/// <summary>
+/// Appends a structure to the file as it is laid out in memory
+/// </summary>
+static void AppendSeriesOctets(vector<uchar> & r_File, const void * pOctets, size_t octetCount)
+{
+    const uchar * pFirst = static_cast<const uchar *>(pOctets);
+
+    r_File.insert(r_File.end(), pFirst, pFirst + octetCount);
+}
+
+/// <summary>
+/// Appends a signed gap as a zig-zag variable length integer, 7 bits per octet with
+/// the top bit set on every octet but the last
+/// </summary>
+static void AppendSeriesVarint(vector<uchar> & r_Column, long long theGap)
+{
+    uint64_t zigZag = (static_cast<uint64_t>(theGap) << 1) ^ static_cast<uint64_t>(theGap >> 63);
+
+    while (zigZag >= 0x80)
+    {
+        r_Column.push_back(static_cast<uchar>(zigZag | 0x80));
+        zigZag >>= 7;
+    }
+
+    r_Column.push_back(static_cast<uchar>(zigZag));
+}
+
+/// <summary>
+/// Returns the number of bits needed to hold a value
+/// </summary>
+static uint8_t GetSeriesCountBits(uint32_t theValue)
+{
+    uint8_t theBits = 0;
+
+    while (theValue > 0)
+    {
+        theBits++;
+        theValue >>= 1;
+    }
+
+    return theBits;
+}
+
+/// <summary>
+/// Creates a series file from the values in a sample store. The file is written
+/// under a temporary name and only put in place once it is complete.
+/// </summary>
+/// <param name="r_Store">The decoded values</param>
+/// <param name="pch_SeriesFileName">The series file to create or replace</param>
+/// <returns>true if the file was created, otherwise false</returns>
+bool WriteSeriesFile(const SampleStore & r_Store, const char * pch_SeriesFileName)
+{
+    SeriesFileHeader      theHeader;
+    SeriesFileFooter      theFooter;
+    vector<SeriesSegment> theSegments;
+    vector<uchar>         timeColumn;
+    vector<uchar>         countColumn;
+    vector<uchar>         theFile;
+    FILE *                pSeriesFile            = nullptr;
+    char                  temporaryFileName[301] = { 0 };
+    bool                  wasWritten             = false;
+
+    (void)memset(&theHeader, 0, sizeof(theHeader));
+    (void)memset(&theFooter, 0, sizeof(theFooter));
+    (void)memcpy(theHeader.fileMagic, SERIES_FILE_MAGIC, sizeof(theHeader.fileMagic));
+    (void)memcpy(theFooter.footerMagic, SERIES_FOOTER_MAGIC, sizeof(theFooter.footerMagic));
+
+    theHeader.formatVersion = SERIES_FILE_VERSION;
+    theHeader.headerLength  = static_cast<uint32_t>(sizeof(SeriesFileHeader));
+    theHeader.sampleCount   = static_cast<uint64_t>(r_Store.counts.size());
+    theHeader.labelCount    = static_cast<uint32_t>(r_Store.labels.size());
+
+    timeColumn.reserve(r_Store.counts.size());
+    countColumn.reserve(r_Store.counts.size() * 2 + SERIES_COUNT_PADDING);
+
+    for (size_t thisSegment = 0; thisSegment < r_Store.segments.size(); thisSegment++)
+    {
+        const SampleSegment & r_Segment = r_Store.segments[thisSegment];
+        SeriesSegment         theSegment;
+        long long             lastEpoch = r_Segment.startEpoch;
+        uint32_t              highValue = 0;
+
+        // A segment which never received a value has nothing to store
+        if (r_Segment.sampleCount == static_cast<ulong>(0))
+        {
+            continue;
+        }
+
+        (void)memset(&theSegment, 0, sizeof(theSegment));
+
+        theSegment.firstSample = r_Segment.firstSample;
+        theSegment.sampleCount = static_cast<uint32_t>(r_Segment.sampleCount);
+        theSegment.labelIndex  = (r_Segment.labelIndex == SAMPLE_STORE_NO_LABEL) ? SERIES_NO_LABEL : static_cast<uint32_t>(r_Segment.labelIndex);
+        theSegment.startEpoch  = r_Segment.startEpoch;
+        theSegment.timeOffset  = timeColumn.size();
+        theSegment.countOffset = countColumn.size();
+        theSegment.recordRate  = r_Segment.recordRate;
+
+        // Each timestamp is stored as the gap since the one before it
+        for (ulong thisSample = r_Segment.firstSample; thisSample < r_Segment.firstSample + r_Segment.sampleCount; thisSample++)
+        {
+            AppendSeriesVarint(timeColumn, r_Store.epochSeconds[thisSample] - lastEpoch);
+
+            lastEpoch = r_Store.epochSeconds[thisSample];
+
+            if (r_Store.counts[thisSample] > highValue)
+            {
+                highValue = r_Store.counts[thisSample];
+            }
+        }
+
+        theSegment.countBits = GetSeriesCountBits(highValue);
+
+        // Pack the values, spilling whole octets out of the bottom of the accumulator
+        uint64_t bitBuffer = 0;
+        ulong    bitCount  = static_cast<ulong>(0);
+
+        for (ulong thisSample = r_Segment.firstSample; thisSample < r_Segment.firstSample + r_Segment.sampleCount; thisSample++)
+        {
+            bitBuffer |= static_cast<uint64_t>(r_Store.counts[thisSample]) << bitCount;
+            bitCount  += theSegment.countBits;
+
+            while (bitCount >= 8)
+            {
+                countColumn.push_back(static_cast<uchar>(bitBuffer));
+                bitBuffer >>= 8;
+                bitCount   -= 8;
+            }
+        }
+
+        if (bitCount > static_cast<ulong>(0))
+        {
+            countColumn.push_back(static_cast<uchar>(bitBuffer));
+        }
+
+        theSegments.push_back(theSegment);
+    }
+
+    countColumn.insert(countColumn.end(), SERIES_COUNT_PADDING, 0);
+
+    theHeader.segmentCount = static_cast<uint32_t>(theSegments.size());
+
+    if (false == r_Store.counts.empty())
+    {
+        CountSpan theSpan = GetCountSpan(r_Store);
+
+        theHeader.firstEpoch   = r_Store.epochSeconds.front();
+        theHeader.lastEpoch    = r_Store.epochSeconds.back();
+        theHeader.lowestCount  = MinimumOfCountSpan(theSpan);
+        theHeader.highestCount = MaximumOfCountSpan(theSpan);
+        theHeader.countTotal   = SumCountSpan(theSpan);
+    }
+
+    // Lay the sections out one after the other, the header being filled in last
+    AppendSeriesOctets(theFile, &theHeader, sizeof(theHeader));
+    AlignSeriesSection(theFile);
+
+    theFooter.segmentTable.sectionOffset = theFile.size();
+    theFooter.segmentTable.sectionLength = theSegments.size() * sizeof(SeriesSegment);
+
+    if (false == theSegments.empty())
+    {
+        AppendSeriesOctets(theFile, theSegments.data(), theSegments.size() * sizeof(SeriesSegment));
+    }
+
+    AlignSeriesSection(theFile);
+
+    theFooter.timeColumn.sectionOffset = theFile.size();
+    theFooter.timeColumn.sectionLength = timeColumn.size();
+
+    theFile.insert(theFile.end(), timeColumn.begin(), timeColumn.end());
+    AlignSeriesSection(theFile);
+
+    theFooter.countColumn.sectionOffset = theFile.size();
+    theFooter.countColumn.sectionLength = countColumn.size();
+
+    theFile.insert(theFile.end(), countColumn.begin(), countColumn.end());
+    AlignSeriesSection(theFile);
+
+    // The label offsets are relative to the end of the offsets themselves
+    uint32_t labelOffset = 0;
+
+    theFooter.labelTable.sectionOffset = theFile.size();
+
+    for (size_t thisLabel = 0; thisLabel <= r_Store.labels.size(); thisLabel++)
+    {
+        AppendSeriesOctets(theFile, &labelOffset, sizeof(labelOffset));
+
+        if (thisLabel < r_Store.labels.size())
+        {
+            labelOffset += static_cast<uint32_t>(r_Store.labels[thisLabel].size());
+        }
+    }
+
+    for (size_t thisLabel = 0; thisLabel < r_Store.labels.size(); thisLabel++)
+    {
+        AppendSeriesOctets(theFile, r_Store.labels[thisLabel].data(), r_Store.labels[thisLabel].size());
+    }
+
+    theFooter.labelTable.sectionLength = theFile.size() - theFooter.labelTable.sectionOffset;
+
+    AlignSeriesSection(theFile);
+
+    theHeader.footerOffset = theFile.size();
+
+    (void)memcpy(theFile.data(), &theHeader, sizeof(theHeader));
+
+    theFooter.contentHash = HashJournalBlock(theFile.data(), static_cast<ulong>(theFile.size()));
+
+    AppendSeriesOctets(theFile, &theFooter, sizeof(theFooter));
+
+    BuildTemporaryFileName(pch_SeriesFileName, temporaryFileName, sizeof(temporaryFileName));
+
+    if (0 == fopen_s(&pSeriesFile, temporaryFileName, "wb"))
+    {
+        wasWritten = (1 == fwrite(theFile.data(), theFile.size(), 1, pSeriesFile));
+
+        wasWritten = (0 == fclose(pSeriesFile)) && wasWritten;
+    }
+
+    if (false == wasWritten || false == CommitFileAtomically(temporaryFileName, pch_SeriesFileName))
+    {
+        (void)remove(temporaryFileName);
+
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Returns true if a section lies wholly between the header and the footer
+/// </summary>
+static bool IsSeriesSectionInside(const SeriesSection & r_Section, const SeriesFileHeader & r_Header)
+{
+    return r_Section.sectionOffset >= r_Header.headerLength &&
+        r_Section.sectionOffset <= r_Header.footerOffset &&
+        r_Section.sectionLength <= r_Header.footerOffset - r_Section.sectionOffset &&
+        (r_Section.sectionOffset % 8) == 0;
+}
+
+/// <summary>
+/// Maps a series file in to memory and checks that its header, footer, segment table
+/// and label table describe a file of its size, so that the decoding functions never
+/// look outside of the mapping. The values themselves are not checked, see
+/// VerifySeriesFile() for that.
+/// </summary>
+/// <param name="pch_SeriesFileName">The series file</param>
+/// <param name="r_Reader">Returns the mapped file</param>
+/// <returns>true if the file was mapped and looks whole, otherwise false</returns>
+bool OpenSeriesFile(const char * pch_SeriesFileName, SeriesFileReader & r_Reader)
+{
+    (void)memset(&r_Reader, 0, sizeof(r_Reader));
+
+    if (false == MapFlashImageFile(pch_SeriesFileName, r_Reader.theMapping))
+    {
+        return false;
+    }
+
+    const uchar * pFile    = r_Reader.theMapping.pImage;
+    ulong         fileSize = r_Reader.theMapping.imageSize;
+
+    r_Reader.pHeader = reinterpret_cast<const SeriesFileHeader *>(pFile);
+
+    const SeriesFileHeader & r_Header = *r_Reader.pHeader;
+
+    bool isWhole = fileSize >= sizeof(SeriesFileHeader) + sizeof(SeriesFileFooter) &&
+        0 == memcmp(r_Header.fileMagic, SERIES_FILE_MAGIC, sizeof(r_Header.fileMagic)) &&
+        r_Header.formatVersion == SERIES_FILE_VERSION &&
+        r_Header.headerLength == sizeof(SeriesFileHeader) &&
+        r_Header.footerOffset == static_cast<uint64_t>(fileSize) - sizeof(SeriesFileFooter) &&
+        (r_Header.footerOffset % 8) == 0;
+
+    if (true == isWhole)
+    {
+        r_Reader.pFooter = reinterpret_cast<const SeriesFileFooter *>(pFile + r_Header.footerOffset);
+
+        const SeriesFileFooter & r_Footer = *r_Reader.pFooter;
+
+        isWhole = 0 == memcmp(r_Footer.footerMagic, SERIES_FOOTER_MAGIC, sizeof(r_Footer.footerMagic)) &&
+            true == IsSeriesSectionInside(r_Footer.segmentTable, r_Header) &&
+            true == IsSeriesSectionInside(r_Footer.timeColumn, r_Header) &&
+            true == IsSeriesSectionInside(r_Footer.countColumn, r_Header) &&
+            true == IsSeriesSectionInside(r_Footer.labelTable, r_Header) &&
+            r_Footer.segmentTable.sectionLength == static_cast<uint64_t>(r_Header.segmentCount) * sizeof(SeriesSegment) &&
+            r_Footer.countColumn.sectionLength >= SERIES_COUNT_PADDING &&
+            r_Footer.labelTable.sectionLength >= (static_cast<uint64_t>(r_Header.labelCount) + 1) * sizeof(uint32_t);
+    }
+
+    if (true == isWhole)
+    {
+        const SeriesFileFooter & r_Footer = *r_Reader.pFooter;
+
+        r_Reader.pSegments     = reinterpret_cast<const SeriesSegment *>(pFile + r_Footer.segmentTable.sectionOffset);
+        r_Reader.pTimes        = pFile + r_Footer.timeColumn.sectionOffset;
+        r_Reader.pCounts       = pFile + r_Footer.countColumn.sectionOffset;
+        r_Reader.pLabelOffsets = reinterpret_cast<const uint32_t *>(pFile + r_Footer.labelTable.sectionOffset);
+        r_Reader.pLabelText    = reinterpret_cast<const char *>(r_Reader.pLabelOffsets + r_Header.labelCount + 1);
+
+        uint64_t textLength = r_Footer.labelTable.sectionLength - (static_cast<uint64_t>(r_Header.labelCount) + 1) * sizeof(uint32_t);
+        uint64_t nextSample = 0;
+
+        // The segments must follow on from each other and stay inside their columns
+        for (uint32_t thisSegment = 0; true == isWhole && thisSegment < r_Header.segmentCount; thisSegment++)
+        {
+            const SeriesSegment & r_Segment   = r_Reader.pSegments[thisSegment];
+            uint64_t              countLength = (static_cast<uint64_t>(r_Segment.sampleCount) * r_Segment.countBits + 7) / 8;
+
+            isWhole = r_Segment.firstSample == nextSample &&
+                r_Segment.countBits <= 32 &&
+                r_Segment.timeOffset <= r_Footer.timeColumn.sectionLength &&
+                r_Segment.countOffset <= r_Footer.countColumn.sectionLength - SERIES_COUNT_PADDING &&
+                countLength <= r_Footer.countColumn.sectionLength - SERIES_COUNT_PADDING - r_Segment.countOffset &&
+                (r_Segment.labelIndex == SERIES_NO_LABEL || r_Segment.labelIndex < r_Header.labelCount);
+
+            nextSample += r_Segment.sampleCount;
+        }
+
+        isWhole = isWhole && nextSample == r_Header.sampleCount;
+
+        for (uint32_t thisLabel = 0; true == isWhole && thisLabel < r_Header.labelCount; thisLabel++)
+        {
+            isWhole = r_Reader.pLabelOffsets[thisLabel] <= r_Reader.pLabelOffsets[thisLabel + 1] &&
+                r_Reader.pLabelOffsets[thisLabel + 1] <= textLength;
+        }
+    }
+
+    if (false == isWhole)
+    {
+        CloseSeriesFile(r_Reader);
+
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Unmaps a series file
+/// </summary>
+/// <param name="r_Reader">The reader of the file</param>
+void CloseSeriesFile(SeriesFileReader & r_Reader)
+{
+    UnmapFlashImageFile(r_Reader.theMapping);
+
+    r_Reader.pHeader       = nullptr;
+    r_Reader.pFooter       = nullptr;
+    r_Reader.pSegments     = nullptr;
+    r_Reader.pTimes        = nullptr;
+    r_Reader.pCounts       = nullptr;
+    r_Reader.pLabelOffsets = nullptr;
+    r_Reader.pLabelText    = nullptr;
+}
+
+/// <summary>
+/// Checks the hash of every octet before the footer. This reads the whole file so
+/// it is left to the caller to decide when it is worth doing.
+/// </summary>
+/// <param name="r_Reader">The reader of an opened file</param>
+/// <returns>true if the hash matches, otherwise false</returns>
+bool VerifySeriesFile(const SeriesFileReader & r_Reader)
+{
+    return r_Reader.pFooter->contentHash == HashJournalBlock(r_Reader.theMapping.pImage, static_cast<ulong>(r_Reader.pHeader->footerOffset));
+}
+
+/// <summary>
+/// Returns where a location label is in the mapping. The label is not NULL-terminated.
+/// </summary>
+/// <param name="r_Reader">The reader of an opened file</param>
+/// <param name="labelIndex">The label wanted, such as a segment's labelIndex</param>
+/// <param name="ppch_Label">Returns the first character of the label</param>
+/// <param name="r_LabelLength">Returns the number of characters in the label</param>
+/// <returns>true if there is such a label, otherwise false</returns>
+bool GetSeriesLabel(const SeriesFileReader & r_Reader, uint32_t labelIndex, const char ** ppch_Label, ulong & r_LabelLength)
+{
+    if (labelIndex >= r_Reader.pHeader->labelCount)
+    {
+        return false;
+    }
+
+    *ppch_Label   = r_Reader.pLabelText + r_Reader.pLabelOffsets[labelIndex];
+    r_LabelLength = r_Reader.pLabelOffsets[labelIndex + 1] - r_Reader.pLabelOffsets[labelIndex];
+
+    return true;
+}
+
+/// <summary>
+/// Decodes the timestamps and values of one segment in to arrays which the caller
+/// provides, each holding the segment's sampleCount entries
+/// </summary>
+/// <param name="r_Reader">The reader of an opened file</param>
+/// <param name="whichSegment">The entry in the segment table</param>
+/// <param name="pEpochSeconds">Returns when each value was recorded, or nullptr if not wanted</param>
+/// <param name="pCounts">Returns the values, or nullptr if not wanted</param>
+/// <returns>true if the segment was decoded, false if its time column runs out</returns>
+bool DecodeSeriesSegment(const SeriesFileReader & r_Reader,
+    ulong whichSegment,
+    long long * pEpochSeconds,
+    uint32_t * pCounts)
+{
+    if (whichSegment >= r_Reader.pHeader->segmentCount)
+    {
+        return false;
+    }
+
+    const SeriesSegment & r_Segment = r_Reader.pSegments[whichSegment];
+
+    if (nullptr != pEpochSeconds)
+    {
+        const uchar * pNext     = r_Reader.pTimes + r_Segment.timeOffset;
+        const uchar * pEnd      = r_Reader.pTimes + r_Reader.pFooter->timeColumn.sectionLength;
+        long long     lastEpoch = r_Segment.startEpoch;
+
+        for (uint32_t thisSample = 0; thisSample < r_Segment.sampleCount; thisSample++)
+        {
+            uint64_t zigZag   = 0;
+            ulong    theShift = static_cast<ulong>(0);
+
+            // Most gaps are a single octet
+            while (pNext < pEnd && (*pNext & 0x80) != 0 && theShift < 63)
+            {
+                zigZag   |= static_cast<uint64_t>(*pNext++ & 0x7F) << theShift;
+                theShift += 7;
+            }
+
+            if (pNext == pEnd)
+            {
+                return false;
+            }
+
+            zigZag |= static_cast<uint64_t>(*pNext++ & 0x7F) << theShift;
+
+            lastEpoch += static_cast<long long>(zigZag >> 1) ^ -static_cast<long long>(zigZag & 1);
+
+            pEpochSeconds[thisSample] = lastEpoch;
+        }
+    }
+
+    if (nullptr != pCounts)
+    {
+        const uchar * pPacked  = r_Reader.pCounts + r_Segment.countOffset;
+        uint64_t      theMask  = (static_cast<uint64_t>(1) << r_Segment.countBits) - 1;
+        uint64_t      bitIndex = 0;
+
+        for (uint32_t thisSample = 0; thisSample < r_Segment.sampleCount; thisSample++)
+        {
+            uint64_t theWord;
+
+            // The padding after the column keeps this load inside the mapping
+            (void)memcpy(&theWord, pPacked + (bitIndex >> 3), sizeof(theWord));
+
+            pCounts[thisSample] = static_cast<uint32_t>((theWord >> (bitIndex & 7)) & theMask);
+
+            bitIndex += r_Segment.countBits;
+        }
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Decodes a whole series file back in to a sample store
+/// </summary>
+/// <param name="r_Reader">The reader of an opened file</param>
+/// <param name="r_Store">Returns the values, replacing what it held</param>
+/// <returns>true if every segment was decoded, otherwise false</returns>
+bool ReadSeriesFile(const SeriesFileReader & r_Reader, SampleStore & r_Store)
+{
+    const SeriesFileHeader & r_Header = *r_Reader.pHeader;
+
+    ResetSampleStore(r_Store, 0);
+
+    r_Store.epochSeconds.resize(static_cast<size_t>(r_Header.sampleCount));
+    r_Store.counts.resize(static_cast<size_t>(r_Header.sampleCount));
+
+    for (uint32_t thisLabel = 0; thisLabel < r_Header.labelCount; thisLabel++)
+    {
+        const char * pch_Label   = nullptr;
+        ulong        labelLength = static_cast<ulong>(0);
+
+        (void)GetSeriesLabel(r_Reader, thisLabel, &pch_Label, labelLength);
+
+        r_Store.labels.push_back(string(pch_Label, labelLength));
+    }
+
+    for (uint32_t thisSegment = 0; thisSegment < r_Header.segmentCount; thisSegment++)
+    {
+        const SeriesSegment & r_Segment = r_Reader.pSegments[thisSegment];
+        SampleSegment         theSegment;
+
+        if (false == DecodeSeriesSegment(r_Reader,
+            thisSegment,
+            r_Store.epochSeconds.data() + r_Segment.firstSample,
+            r_Store.counts.data() + r_Segment.firstSample))
+        {
+            return false;
+        }
+
+        theSegment.firstSample = static_cast<ulong>(r_Segment.firstSample);
+        theSegment.sampleCount = static_cast<ulong>(r_Segment.sampleCount);
+        theSegment.startEpoch  = r_Segment.startEpoch;
+        theSegment.recordRate  = r_Segment.recordRate;
+        theSegment.labelIndex  = (r_Segment.labelIndex == SERIES_NO_LABEL) ? SAMPLE_STORE_NO_LABEL : static_cast<ulong>(r_Segment.labelIndex);
+
+        r_Store.segments.push_back(theSegment);
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Parses one "dd/Mon/yy hh:mm:ss,count" line of a comma-delimited file
+/// </summary>
+/// <param name="pch_Line">The NULL-terminated line</param>
+/// <param name="r_Epoch">Returns when the value was recorded, in seconds since 1970</param>
+/// <param name="r_CountValue">Returns the CPS/CPM/CPH value</param>
+/// <returns>true if the line was a value, false if it was anything else</returns>
+static bool ParseCSVSampleLine(const char * pch_Line, long long & r_Epoch, ulong & r_CountValue)
+{
+    char * pch_Next = const_cast<char *>(pch_Line);
+    ulong  theDay   = strtoul(pch_Next, &pch_Next, 10);
+    ulong  theMonth = static_cast<ulong>(0);
+    ulong  theYear;
+    ulong  theHour;
+    ulong  theMinute;
+    ulong  theSecond;
+
+    if (pch_Next == pch_Line || '/' != *pch_Next++)
+    {
+        return false;
+    }
+
+    while (theMonth < 12 && 0 != strncmp(pch_Next, theMonths[theMonth], 3))
+    {
+        theMonth++;
+    }
+
+    if (theMonth == 12 || '/' != pch_Next[3])
+    {
+        return false;
+    }
+
+    pch_Next += 4;
+
+    theYear    = strtoul(pch_Next, &pch_Next, 10);
+    theHour    = strtoul(pch_Next, &pch_Next, 10);
+    theMinute  = strtoul(++pch_Next, &pch_Next, 10);
+    theSecond  = strtoul(++pch_Next, &pch_Next, 10);
+
+    if (',' != *pch_Next++)
+    {
+        return false;
+    }
+
+    r_CountValue = strtoul(pch_Next, nullptr, 10);
+    r_Epoch      = EpochFromCivil(2000 + theYear, theMonth + 1, theDay, theHour, theMinute, theSecond);
+
+    return true;
+}
+
+/// <summary>
+/// Reads a comma-delimited file made by this program back in to a sample store. Older
+/// files start straight in with the values while newer ones have a header, which names
+/// the location label given to every value unless it is the plain "Date/Time" header,
+/// so the first line is only taken as a header if it is not a value. The comma-delimited
+/// file leaves out where the date/time stamp frames were, so a new segment is started
+/// wherever the clock does not move on by whole minutes, which is what a new date/time
+/// stamp usually does.
+/// </summary>
+/// <param name="pch_CSVFileName">The comma-delimited file</param>
+/// <param name="r_Store">Returns the values, replacing what it held</param>
+/// <returns>true if the file was read, false if it could not be opened or a line was not understood</returns>
+bool ReadCSVSampleFile(const char * pch_CSVFileName, SampleStore & r_Store)
+{
+    FILE *    pCSVFile      = nullptr;
+    char      theLine[512]  = { 0 };
+    long long lastEpoch     = 0;
+    bool      isFirstLine   = true;
+    bool      wasUnderstood = true;
+
+    ResetSampleStore(r_Store, 0);
+
+    if (0 != fopen_s(&pCSVFile, pch_CSVFileName, "rb"))
+    {
+        return false;
+    }
+
+    while (true == wasUnderstood && nullptr != fgets(theLine, sizeof(theLine), pCSVFile))
+    {
+        long long thisEpoch  = 0;
+        ulong     countValue = static_cast<ulong>(0);
+
+        if ('\r' == theLine[0] || '\n' == theLine[0] || 0 == theLine[0])
+        {
+            continue;
+        }
+
+        if (false == ParseCSVSampleLine(theLine, thisEpoch, countValue))
+        {
+            // The header is either "Date/Time,Counts" or the location label followed by ",Counts"
+            char * pch_Comma = strrchr(theLine, ',');
+
+            if (false == isFirstLine)
+            {
+                wasUnderstood = false;
+            }
+            else if (nullptr != pch_Comma && pch_Comma != theLine && 0 != strncmp(theLine, "Date/Time,", 10))
+            {
+                *pch_Comma = 0;
+
+                SetSampleSegmentLabel(r_Store, theLine);
+            }
+
+            isFirstLine = false;
+            continue;
+        }
+
+        isFirstLine = false;
+
+        if (true == r_Store.counts.empty() ||
+            thisEpoch <= lastEpoch ||
+            ((thisEpoch - lastEpoch) % SERIES_CSV_SAMPLE_SECONDS) != 0)
+        {
+            StartSampleSegment(r_Store, thisEpoch, static_cast<uchar>(2));
+        }
+
+        AppendSample(r_Store, thisEpoch, static_cast<uint32_t>(countValue));
+
+        lastEpoch = thisEpoch;
+    }
+
+    (void)fclose(pCSVFile);
+
+    return wasUnderstood;
+}
+
+/// <summary>
+/// Returns true if a file name ends with the text passed by argument
+/// </summary>
+static bool HasFileNameSuffix(const string & r_FileName, const char * pch_Suffix)
+{
+    size_t suffixLength = strlen(pch_Suffix);
+
+    return r_FileName.size() >= suffixLength && 0 == r_FileName.compare(r_FileName.size() - suffixLength, suffixLength, pch_Suffix);
+}
+
+/// <summary>
+/// Fills a sample store from whichever kind of decoded output or image a file is:
+/// a series file is mapped and decoded, a comma-delimited file is read, and anything
+/// else is taken to be a FLASH image and decoded
+/// </summary>
+/// <param name="pch_FileName">The *.ReadGeiger.series, *.ReadReiger.csv or *.ReadGeiger.bin file</param>
+/// <param name="r_Store">Returns the values, replacing what it held</param>
+/// <returns>true if the file was read, otherwise false</returns>
+bool LoadSampleFile(const char * pch_FileName, SampleStore & r_Store)
+{
+    string theFileName = pch_FileName;
+    bool   wasRead     = false;
+
+    if (true == HasFileNameSuffix(theFileName, DATA_OUTPUT_SERIES_FILE_NAME))
+    {
+        SeriesFileReader theReader;
+
+        if (true == OpenSeriesFile(pch_FileName, theReader))
+        {
+            wasRead = ReadSeriesFile(theReader, r_Store);
+
+            CloseSeriesFile(theReader);
+        }
+    }
+    else if (true == HasFileNameSuffix(theFileName, DATA_OUTPUT_CSV_FILE_NAME))
+    {
+        wasRead = ReadCSVSampleFile(pch_FileName, r_Store);
+    }
+    else
+    {
+        MappedFlashImage  theImage;
+        FlashImageSummary theSummary;
+
+        if (true == MapFlashImageFile(pch_FileName, theImage))
+        {
+            wasRead = DecodeFlashImage(theImage.pImage, theImage.imageSize, nullptr, &r_Store, theSummary);
+
+            UnmapFlashImageFile(theImage);
+        }
+    }
+
+    return wasRead;
+}
+
+/// <summary>
+/// Decodes a series file and reports what it holds and how long it took
+/// </summary>
+static bool DisplaySeriesFile(const string & r_SeriesFileName)
+{
+    SeriesFileReader theReader;
+    SampleStore      theStore;
+
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    if (false == OpenSeriesFile(r_SeriesFileName.c_str(), theReader))
+    {
+        (void)printf("Error: %s is not a whole series file\n", r_SeriesFileName.c_str());
+        return false;
+    }
+
+    bool wasRead = VerifySeriesFile(theReader) && ReadSeriesFile(theReader, theStore);
+
+    double elapsedSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    if (true == wasRead)
+    {
+        (void)printf("%8lu samples, %4lu segments, %2lu labels, %8lu octets, read in %.3f ms  %s\n",
+            static_cast<ulong>(theReader.pHeader->sampleCount),
+            static_cast<ulong>(theReader.pHeader->segmentCount),
+            static_cast<ulong>(theReader.pHeader->labelCount),
+            theReader.theMapping.imageSize,
+            elapsedSeconds * 1000.0,
+            r_SeriesFileName.c_str());
+    }
+    else
+    {
+        (void)printf("Error: %s is damaged\n", r_SeriesFileName.c_str());
+    }
+
+    CloseSeriesFile(theReader);
+
+    return wasRead;
+}
+
+/// <summary>
+/// Displays how the series conversion is used
+/// </summary>
+static void DisplaySeriesUsage(void)
+{
+    (void)printf("Usage: ReadGeiger -series <directory|pattern> [...] [-out <directory>]\n");
+    (void)printf("  Each *.%s and *.%s named is converted in to a *.%s file,\n",
+        DATA_OUTPUT_FILE_NAME, DATA_OUTPUT_CSV_FILE_NAME, DATA_OUTPUT_SERIES_FILE_NAME);
+    (void)printf("  and each *.%s named is read back and checked.\n", DATA_OUTPUT_SERIES_FILE_NAME);
+}
+
+/// <summary>
+/// The entry point for the series conversion. FLASH images are decoded, comma-delimited
+/// files are read, and either becomes a series file; series files are checked.
+/// </summary>
+/// <param name="argc">The number of arguments following "-series"</param>
+/// <param name="argv">The arguments following "-series"</param>
+/// <returns>0 if every file was converted or checked, otherwise 1</returns>
+int RunSeriesConvert(int argc, char * argv[])
+{
+    vector<string> inputFileNames;
+    string         outputDirectory;
+    ulong          failedCount     = static_cast<ulong>(0);
+
+    for (int thisArgument = 0; thisArgument < argc; thisArgument++)
+    {
+        if (0 == strcmp(argv[thisArgument], "-out") && thisArgument + 1 < argc)
+        {
+            outputDirectory = argv[++thisArgument];
+        }
+        else
+        {
+            CollectInputFileNames(argv[thisArgument], BATCH_INPUT_FILE_PATTERN, inputFileNames);
+        }
+    }
+
+    if (inputFileNames.empty())
+    {
+        DisplaySeriesUsage();
+        (void)printf("There were no files found to convert\n");
+        return 1;
+    }
+
+    for (size_t thisFile = 0; thisFile < inputFileNames.size(); thisFile++)
+    {
+        const string & r_InputFileName = inputFileNames[thisFile];
+        SampleStore    theStore;
+
+        if (true == HasFileNameSuffix(r_InputFileName, DATA_OUTPUT_SERIES_FILE_NAME))
+        {
+            failedCount += (true == DisplaySeriesFile(r_InputFileName)) ? 0 : 1;
+            continue;
+        }
+
+        // Name the output after the FLASH image that the input came from
+        string imageFileName = r_InputFileName;
+
+        if (true == HasFileNameSuffix(r_InputFileName, DATA_OUTPUT_CSV_FILE_NAME))
+        {
+            imageFileName.replace(imageFileName.size() - strlen(DATA_OUTPUT_CSV_FILE_NAME), string::npos, DATA_OUTPUT_FILE_NAME);
+        }
+
+        bool wasRead = LoadSampleFile(r_InputFileName.c_str(), theStore);
+
+        string seriesFileName = BuildOutputFileName(imageFileName, outputDirectory, DATA_OUTPUT_SERIES_FILE_NAME);
+
+        if (false == wasRead || false == WriteSeriesFile(theStore, seriesFileName.c_str()))
+        {
+            (void)printf("FAILED  %s\n", r_InputFileName.c_str());
+            failedCount++;
+            continue;
+        }
+
+        (void)printf("%8lu samples  %s\n", static_cast<ulong>(theStore.counts.size()), seriesFileName.c_str());
+    }
+
+    return (failedCount == static_cast<ulong>(0)) ? 0 : 1;
+}
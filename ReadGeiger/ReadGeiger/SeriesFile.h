@@ -0,0 +1,114 @@
+// ----------------------------------------------------------------------
+// SeriesFile.h
+//
+// A compact binary form of the decoded CPS/CPM/CPH values which is read
+// by mapping the file in to memory rather than by parsing text. The
+// file holds the same columns as the SampleStore:
+//
+//   header          fixed size, says what the file holds and where the
+//                   footer is
+//   segment table   one entry per date/time stamp frame
+//   time column     the gap before each value in seconds, as a zig-zag
+//                   variable length integer, most of them one octet
+//   count column    each segment's values packed in as few bits as the
+//                   segment's largest value needs
+//   label table     the location strings, each stored once
+//   footer          where each of the sections is and a hash of them
+//
+// Every section starts on an 8 octet boundary. Values are stored little
+// endian, which is what every system this program builds on uses, so
+// the header, footer and segment table are used in place.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include "Portable.h"
+#include "FlashImage.h"
+#include "SampleStore.h"
+
+#define SERIES_FILE_MAGIC           "RGSERIES"
+#define SERIES_FOOTER_MAGIC         "RGSEREND"
+#define SERIES_FILE_VERSION         static_cast<uint32_t>(1)
+#define SERIES_NO_LABEL             static_cast<uint32_t>(0xFFFFFFFF)
+
+// What a directory selects when it is named instead of series files
+#define SERIES_INPUT_FILE_PATTERN   "*." DATA_OUTPUT_SERIES_FILE_NAME
+
+// The gap between values which a comma-delimited file is expected to have
+#define SERIES_CSV_SAMPLE_SECONDS   60
+
+typedef struct series_file_header_t
+{
+    char     fileMagic[8];          // SERIES_FILE_MAGIC, not terminated
+    uint32_t formatVersion;         // SERIES_FILE_VERSION
+    uint32_t headerLength;          // sizeof(SeriesFileHeader)
+    uint64_t sampleCount;           // The number of values in the file
+    uint32_t segmentCount;          // The number of entries in the segment table
+    uint32_t labelCount;            // The number of entries in the label table
+    int64_t  firstEpoch;            // When the first value was recorded, seconds since 1970
+    int64_t  lastEpoch;             // When the last value was recorded
+    uint32_t lowestCount;           // The lowest value in the file
+    uint32_t highestCount;          // The highest value in the file
+    uint64_t countTotal;            // The sum of all of the values
+    uint64_t footerOffset;          // Where the SeriesFileFooter is
+} SeriesFileHeader;
+
+typedef struct series_segment_t
+{
+    uint64_t firstSample;           // The index of the segment's first value
+    uint32_t sampleCount;           // The number of values in the segment
+    uint32_t labelIndex;            // Index in to the label table, or SERIES_NO_LABEL
+    int64_t  startEpoch;            // The date/time stamp of the segment in seconds since 1970
+    uint64_t timeOffset;            // Where the segment's gaps start in the time column
+    uint64_t countOffset;           // Where the segment's packed values start in the count column
+    uint8_t  recordRate;            // 0 = off, 1 = CPS, 2 = CPM, 3 = CPM once per hour
+    uint8_t  countBits;             // Bits used for each value, 0 when they are all 0
+    uint8_t  reservedOctets[6];     // Always 0
+} SeriesSegment;
+
+typedef struct series_section_t
+{
+    uint64_t sectionOffset;         // Where the section starts in the file
+    uint64_t sectionLength;         // The number of octets in the section
+} SeriesSection;
+
+typedef struct series_file_footer_t
+{
+    SeriesSection segmentTable;     // SeriesSegment entries
+    SeriesSection timeColumn;       // Zig-zag variable length gaps
+    SeriesSection countColumn;      // Bit packed values, followed by 8 octets of 0
+    SeriesSection labelTable;       // labelCount + 1 uint32_t offsets then the strings
+    uint64_t      contentHash;      // FNV-1a of every octet before the footer
+    char          footerMagic[8];   // SERIES_FOOTER_MAGIC, not terminated
+} SeriesFileFooter;
+
+typedef struct series_file_reader_t
+{
+    MappedFlashImage         theMapping;    // The mapped file
+    const SeriesFileHeader * pHeader;       // The header, in the mapping
+    const SeriesFileFooter * pFooter;       // The footer, in the mapping
+    const SeriesSegment *    pSegments;     // The segment table, in the mapping
+    const uchar *            pTimes;        // The time column, in the mapping
+    const uchar *            pCounts;       // The count column, in the mapping
+    const uint32_t *         pLabelOffsets; // The label offsets, in the mapping
+    const char *             pLabelText;    // The label strings, in the mapping
+} SeriesFileReader;
+
+extern bool WriteSeriesFile(const SampleStore & r_Store, const char * pch_SeriesFileName);
+
+extern bool OpenSeriesFile(const char * pch_SeriesFileName, SeriesFileReader & r_Reader);
+extern void CloseSeriesFile(SeriesFileReader & r_Reader);
+extern bool VerifySeriesFile(const SeriesFileReader & r_Reader);
+extern bool GetSeriesLabel(const SeriesFileReader & r_Reader, uint32_t labelIndex, const char ** ppch_Label, ulong & r_LabelLength);
+extern bool DecodeSeriesSegment(const SeriesFileReader & r_Reader,
+    ulong whichSegment,
+    long long * pEpochSeconds,
+    uint32_t * pCounts);
+extern bool ReadSeriesFile(const SeriesFileReader & r_Reader, SampleStore & r_Store);
+
+extern bool ReadCSVSampleFile(const char * pch_CSVFileName, SampleStore & r_Store);
+extern bool LoadSampleFile(const char * pch_FileName, SampleStore & r_Store);
+
+extern int RunSeriesConvert(int argc, char * argv[]);
@@ -0,0 +1,264 @@
+// ----------------------------------------------------------------------
+// SyncCursor.cpp
+//
+// The per-device local image and cursor files used by the incremental
+// retrieval of history data. Both files are named after the device's
+// serial number and both are replaced atomically so that an interrupted
+// visit leaves the previous visit's files in place.
+//
+// ----------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SyncCursor.h"
+#include "DownloadJournal.h"
+#include "FrameDecoder.h"
+
+/// <summary>
+/// Converts the seven octets that GETSERIAL returns in to hexadecimal text, the same
+/// way that the serial number is displayed on the console
+/// </summary>
+/// <param name="pSerialNumber">The seven octets of the serial number</param>
+/// <param name="pch_Buffer">Returns the NULL-terminated text, 15 octets or more</param>
+/// <param name="bufferSize">The size of that buffer</param>
+void FormatDeviceSerialNumber(const uchar * pSerialNumber, char * pch_Buffer, size_t bufferSize)
+{
+    (void)sprintf_s(pch_Buffer, bufferSize, "%02x%02x%02x%02x%02x%02x%02x",
+        pSerialNumber[0], pSerialNumber[1], pSerialNumber[2], pSerialNumber[3],
+        pSerialNumber[4], pSerialNumber[5], pSerialNumber[6]);
+}
+
+/// <summary>
+/// Finds where the valid history data in an image ends, which is where the device
+/// will write its next octet
+/// </summary>
+/// <param name="pImage">The FLASH history image</param>
+/// <param name="imageSize">The number of octets in the image</param>
+/// <returns>The offset of the end of the data, or imageSize if the image is full</returns>
+ulong FindEndOfHistoryData(const uchar * pImage, ulong imageSize)
+{
+    FrameDecoder theDecoder;
+    FrameEvent   theEvent;
+    ulong        endOfData = imageSize;
+
+    StartFrameDecoder(theDecoder, pImage, imageSize);
+
+    while (true == GetNextFrameEvent(theDecoder, theEvent))
+    {
+        if (FrameEventEndOfData == theEvent.eventType)
+        {
+            endOfData = theEvent.imageOffset;
+        }
+    }
+
+    return endOfData;
+}
+
+/// <summary>
+/// Builds the name of one of the device's files, "SERIAL.ReadGeiger.sync" for example
+/// </summary>
+void BuildSyncFileName(const char * pch_SerialNumber, const char * pch_FileName, char * pch_Buffer, size_t bufferSize)
+{
+    (void)sprintf_s(pch_Buffer, bufferSize, "%s.%s", pch_SerialNumber, pch_FileName);
+}
+
+/// <summary>
+/// Writes a buffer to a temporary file and puts it in place of the file passed by argument
+/// </summary>
+static bool WriteFileAtomically(const char * pch_FileName, const void * pBuffer, ulong bufferSize)
+{
+    FILE * pOutputFile            = nullptr;
+    char   temporaryFileName[301] = { 0 };
+    bool   wasWritten             = false;
+
+    BuildTemporaryFileName(pch_FileName, temporaryFileName, sizeof(temporaryFileName));
+
+    if (0 == fopen_s(&pOutputFile, temporaryFileName, "wb"))
+    {
+        wasWritten = (1 == fwrite(pBuffer, bufferSize, 1, pOutputFile));
+
+        wasWritten = (0 == fclose(pOutputFile)) && wasWritten;
+    }
+
+    if (false == wasWritten || false == CommitFileAtomically(temporaryFileName, pch_FileName))
+    {
+        (void)remove(temporaryFileName);
+
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Loads the cursor and the local image of the device whose serial number is passed
+/// by argument. If either one is missing or damaged, or the image up to the end of
+/// the data is not the one the cursor was written for, the cursor is marked as not
+/// valid, in which case the entire history must be retrieved.
+/// </summary>
+/// <param name="pch_SerialNumber">The device's serial number as hexadecimal text</param>
+/// <param name="r_Cursor">Returns the cursor</param>
+/// <param name="pImage">Returns the local image</param>
+/// <param name="imageSize">The number of octets in the image</param>
+/// <returns>true if the cursor is valid, otherwise false</returns>
+bool LoadSyncCursor(const char * pch_SerialNumber, SyncCursor & r_Cursor, uchar * pImage, ulong imageSize)
+{
+    FILE * pInputFile        = nullptr;
+    char   theFileName[301]  = { 0 };
+    char   cursorRecord[101] = { 0 };
+    char * pch_Field         = nullptr;
+
+    (void)strcpy_s(r_Cursor.serialNumber, sizeof(r_Cursor.serialNumber), pch_SerialNumber);
+
+    r_Cursor.isValid          = false;
+    r_Cursor.endOfDataAddress = static_cast<ulong>(0);
+    r_Cursor.saveAddress      = static_cast<ulong>(0);
+    r_Cursor.prefixHash       = 0;
+
+    // The cursor is a single record: the end of data address, the save address, then
+    // the hash of the local image up to the end of the data
+    BuildSyncFileName(pch_SerialNumber, SYNC_CURSOR_FILE_NAME, theFileName, sizeof(theFileName));
+
+    if (0 != fopen_s(&pInputFile, theFileName, "rb"))
+    {
+        return false;
+    }
+
+    bool haveRecord = (nullptr != fgets(cursorRecord, sizeof(cursorRecord), pInputFile));
+
+    (void)fclose(pInputFile);
+
+    if (false == haveRecord)
+    {
+        return false;
+    }
+
+    r_Cursor.endOfDataAddress = strtoul(cursorRecord, &pch_Field, 10);
+
+    if (',' != *pch_Field)
+    {
+        return false;
+    }
+
+    r_Cursor.saveAddress = strtoul(pch_Field + 1, &pch_Field, 10);
+
+    if (',' != *pch_Field)
+    {
+        return false;
+    }
+
+    r_Cursor.prefixHash = strtoull(pch_Field + 1, nullptr, 16);
+
+    // The local image must be all there
+    BuildSyncFileName(pch_SerialNumber, SYNC_IMAGE_FILE_NAME, theFileName, sizeof(theFileName));
+
+    if (0 != fopen_s(&pInputFile, theFileName, "rb"))
+    {
+        return false;
+    }
+
+    bool haveImage = (1 == fread(pImage, imageSize, 1, pInputFile));
+
+    (void)fclose(pInputFile);
+
+    r_Cursor.isValid = (true == haveImage && r_Cursor.endOfDataAddress <= imageSize &&
+        HashJournalBlock(pImage, r_Cursor.endOfDataAddress) == r_Cursor.prefixHash);
+
+    return r_Cursor.isValid;
+}
+
+/// <summary>
+/// Builds the name of the device's local image file, "SERIAL.ReadGeiger.sync" for example
+/// </summary>
+void BuildSyncImageFileName(const char * pch_SerialNumber, char * pch_Buffer, size_t bufferSize)
+{
+    BuildSyncFileName(pch_SerialNumber, SYNC_IMAGE_FILE_NAME, pch_Buffer, bufferSize);
+}
+
+/// <summary>
+/// Stores the cursor alone, for when the local image has already been put in place
+/// some other way, see HistoryWriter.cpp
+/// </summary>
+/// <param name="r_Cursor">The cursor to store</param>
+/// <returns>true if the cursor was stored, otherwise false</returns>
+bool SaveSyncCursorRecord(const SyncCursor & r_Cursor)
+{
+    char theFileName[301]  = { 0 };
+    char cursorRecord[101] = { 0 };
+
+    (void)sprintf_s(cursorRecord, sizeof(cursorRecord), "%lu,%lu,%016llx\n",
+        r_Cursor.endOfDataAddress, r_Cursor.saveAddress, static_cast<unsigned long long>(r_Cursor.prefixHash));
+
+    BuildSyncFileName(r_Cursor.serialNumber, SYNC_CURSOR_FILE_NAME, theFileName, sizeof(theFileName));
+
+    return WriteFileAtomically(theFileName, cursorRecord, static_cast<ulong>(strlen(cursorRecord)));
+}
+
+/// <summary>
+/// Stores the local image and then the cursor. The image is written first so that a
+/// cursor is never left describing an image which was not written.
+/// </summary>
+/// <param name="r_Cursor">The cursor to store</param>
+/// <param name="pImage">The local image to store</param>
+/// <param name="imageSize">The number of octets in the image</param>
+/// <returns>true if both were stored, otherwise false</returns>
+bool SaveSyncCursor(const SyncCursor & r_Cursor, const uchar * pImage, ulong imageSize)
+{
+    char theFileName[301] = { 0 };
+
+    BuildSyncImageFileName(r_Cursor.serialNumber, theFileName, sizeof(theFileName));
+
+    if (false == WriteFileAtomically(theFileName, pImage, imageSize))
+    {
+        return false;
+    }
+
+    return SaveSyncCursorRecord(r_Cursor);
+}
+
+/// <summary>
+/// Forgets everything kept for the device from earlier visits other than its local
+/// image: the cursor, and the journal and partial image of an interrupted visit. The
+/// next retrieval starts from address 0.
+/// </summary>
+/// <param name="pch_SerialNumber">The device's serial number as hexadecimal text</param>
+void DiscardSyncCursor(const char * pch_SerialNumber)
+{
+    char theFileName[301] = { 0 };
+
+    BuildSyncFileName(pch_SerialNumber, SYNC_CURSOR_FILE_NAME, theFileName, sizeof(theFileName));
+    (void)remove(theFileName);
+
+    BuildSyncFileName(pch_SerialNumber, SYNC_JOURNAL_FILE_NAME, theFileName, sizeof(theFileName));
+    (void)remove(theFileName);
+
+    BuildSyncFileName(pch_SerialNumber, SYNC_PARTIAL_FILE_NAME, theFileName, sizeof(theFileName));
+    (void)remove(theFileName);
+}
+
+/// <summary>
+/// Decides where in the device's FLASH the retrieval should start. The device only
+/// ever appends to its history until it gets erased, after which its dataSaveAddress
+/// goes backwards; in that case, or when there is no valid cursor, everything must be
+/// retrieved starting from address 0. A device which was erased and has since written
+/// past where it was, or another device answering with the same serial number, is not
+/// caught here; see IsSyncHistoryMatching() in DeviceSession.cpp.
+/// </summary>
+/// <param name="r_Cursor">The cursor from the last visit</param>
+/// <param name="deviceSaveAddress">The dataSaveAddress the device reports now</param>
+/// <returns>The address to start retrieving from</returns>
+ulong GetSyncStartAddress(const SyncCursor & r_Cursor, ulong deviceSaveAddress)
+{
+    if (false == r_Cursor.isValid || deviceSaveAddress < r_Cursor.saveAddress)
+    {
+        return static_cast<ulong>(0);
+    }
+
+    if (r_Cursor.endOfDataAddress < SYNC_OVERLAP_OCTETS)
+    {
+        return static_cast<ulong>(0);
+    }
+
+    return r_Cursor.endOfDataAddress - SYNC_OVERLAP_OCTETS;
+}
@@ -0,0 +1,44 @@
+// ----------------------------------------------------------------------
+// SyncCursor.h
+//
+// Each device, known by its serial number, gets a local copy of its
+// FLASH history image and a cursor which records where the history
+// data ended the last time the device was visited. On the next visit
+// only the octets written since then need to be retrieved and spliced
+// in to the local copy.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include "Portable.h"
+
+#define SYNC_IMAGE_FILE_NAME    "ReadGeiger.sync"
+#define SYNC_CURSOR_FILE_NAME   "ReadGeiger.cursor"
+
+// The retrieval starts this many octets before where the data ended last
+// time so that a frame which was being written at the time is read again.
+// As many octets at the start of the FLASH and before where the data ended
+// are read again and compared with the local image before anything else.
+#define SYNC_OVERLAP_OCTETS     static_cast<ulong>(16)
+
+typedef struct sync_cursor_t
+{
+    char     serialNumber[15];      // The device's serial number as hexadecimal text
+    bool     isValid;               // true if the cursor and the local image were both found and agree
+    ulong    endOfDataAddress;      // Where the history data ended at the last visit
+    ulong    saveAddress;           // The device's dataSaveAddress at the last visit
+    uint64_t prefixHash;            // FNV-1a over the local image up to endOfDataAddress
+} SyncCursor;
+
+extern void FormatDeviceSerialNumber(const uchar * pSerialNumber, char * pch_Buffer, size_t bufferSize);
+extern ulong FindEndOfHistoryData(const uchar * pImage, ulong imageSize);
+
+extern bool LoadSyncCursor(const char * pch_SerialNumber, SyncCursor & r_Cursor, uchar * pImage, ulong imageSize);
+extern void BuildSyncFileName(const char * pch_SerialNumber, const char * pch_FileName, char * pch_Buffer, size_t bufferSize);
+extern void BuildSyncImageFileName(const char * pch_SerialNumber, char * pch_Buffer, size_t bufferSize);
+extern bool SaveSyncCursorRecord(const SyncCursor & r_Cursor);
+extern bool SaveSyncCursor(const SyncCursor & r_Cursor, const uchar * pImage, ulong imageSize);
+extern void DiscardSyncCursor(const char * pch_SerialNumber);
+extern ulong GetSyncStartAddress(const SyncCursor & r_Cursor, ulong deviceSaveAddress);